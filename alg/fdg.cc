@@ -1,91 +1,410 @@
 #include "alg/fdg.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <immintrin.h>
+#define HAVE_AVX2_KERNEL 1
+#endif
+
 namespace fdg {
 
 const Bias Bias::None =       {0, 0};
 const Bias Bias::Horizontal = {0.1, 1.0};
 const Bias Bias::Vertical   = {1.0, 0.1};
 
-void Node::ComputeForces(
-        const std::map<int32_t, std::unique_ptr<Node>>& nodes) {
+void Node::Print() {
+    printf("node {\n");
+    printf("  id: %d\n", id_);
+    printf("  x: %f y: %f\n", pos_.x, pos_.y);
+    for (const auto& c : connection_) {
+        printf("  connection { destid: %d k: %f bias: {x:%f y:%f} color: %#08x width: %f }\n",
+                c.destid, c.k, c.bias.x, c.bias.y, c.color, c.width);
+    }
+    printf("}\n");
+}
+
+void Graph::Print() {
+    for(const auto& n : nodes_)
+        n.second->Print();
+}
 
-    // The charges on all the nodes repel each other
-    for(const auto& other : nodes) {
-        if (other.first == id_)
-            continue;
+void Graph::Compute(double deltaT) {
+    Load();
+    Step(deltaT);
+    Store();
+}
 
-        // Coulomb's law: F = k_e * c1 * c2 / r^2
-        // For us, k_e = 1.0
-        Vec2 diff = pos_ - other.second->pos_;
-        double r = diff.length(); // < 0.01 ? 0.01 : diff.length();
-        double f = (charge_ * other.second->charge_) / (r * r);
-        force_ += diff.unit() * f;
+int Graph::Converge(double deltaT, int max_steps, double epsilon,
+                    const std::atomic<bool>* cancel) {
+    Load();
+    int steps = 0;
+    while (steps < max_steps && !(cancel && *cancel)) {
+        Step(deltaT);
+        steps++;
+        if (energy_ < epsilon)
+            break;
     }
+    Store();
+    return steps;
+}
 
-    // The springs attract connected nodes to each other
-    for(const auto& spring : connection_) {
-        const auto& other = nodes.find(spring.destid);
-        if (other == nodes.end()) {
-            // If we can't find a spring's destination node, skip.
-            continue;
+void Graph::Load() {
+    size_t n = nodes_.size();
+    b_.node.clear();
+    b_.x.resize(n); b_.y.resize(n);
+    b_.vx.resize(n); b_.vy.resize(n);
+    b_.fx.resize(n); b_.fy.resize(n);
+    b_.mass.resize(n); b_.charge.resize(n); b_.friction.resize(n);
+    b_.pause.resize(n);
+
+    std::map<int32_t, int> index;
+    for(const auto& it : nodes_) {
+        Node* node = it.second.get();
+        int i = b_.node.size();
+        index[it.first] = i;
+        b_.node.push_back(node);
+        b_.x[i] = node->pos_.x;
+        b_.y[i] = node->pos_.y;
+        b_.vx[i] = node->vel_.x;
+        b_.vy[i] = node->vel_.y;
+        b_.fx[i] = node->force_.x;
+        b_.fy[i] = node->force_.y;
+        b_.mass[i] = node->mass_;
+        b_.charge[i] = node->charge_;
+        b_.friction[i] = node->friction_;
+        b_.pause[i] = node->pause_;
+    }
+
+    b_.src.clear(); b_.dst.clear();
+    b_.k.clear(); b_.biasx.clear(); b_.biasy.clear();
+    for(size_t i=0; i<n; i++) {
+        for(const auto& spring : b_.node[i]->connection_) {
+            const auto& other = index.find(spring.destid);
+            // Skip springs to missing nodes and to the node itself.
+            if (other == index.end() || other->second == int(i))
+                continue;
+            b_.src.push_back(i);
+            b_.dst.push_back(other->second);
+            b_.k.push_back(spring.k);
+            b_.biasx.push_back(spring.bias.x);
+            b_.biasy.push_back(spring.bias.y);
         }
-        // If the node is connected to itself, skip
-        if (other->first == id_)
+    }
+}
+
+void Graph::Store() {
+    for(size_t i=0; i<b_.node.size(); i++) {
+        Node* node = b_.node[i];
+        node->pos_ = Vec2(b_.x[i], b_.y[i]);
+        node->vel_ = Vec2(b_.vx[i], b_.vy[i]);
+        node->force_ = Vec2(b_.fx[i], b_.fy[i]);
+    }
+}
+
+void Graph::Step(double deltaT) {
+    Repulse();
+    Attract();
+    Apply(deltaT);
+}
+
+namespace {
+// Graphs smaller than this use the symmetric single-threaded loop.
+const int kSmallGraph = 64;
+// Graphs at least this large split the repulsion pass across threads.
+const int kParallelGraph = 512;
+const int kBlockSize = 64;
+
+// Accumulate the repulsion on body (x, y, q) from bodies [0, n).  Bodies
+// at the same position (including the body itself) exert no force.
+void RowForce(double x, double y, double q, const double* bx,
+              const double* by, const double* bq, int n,
+              double* fx, double* fy) {
+    double sx = 0.0, sy = 0.0;
+    for(int j=0; j<n; j++) {
+        double dx = x - bx[j];
+        double dy = y - by[j];
+        double r2 = dx*dx + dy*dy;
+        if (r2 == 0.0)
             continue;
+        double f = q * bq[j] / (r2 * std::sqrt(r2));
+        sx += dx * f;
+        sy += dy * f;
+    }
+    *fx += sx;
+    *fy += sy;
+}
 
-        // Hooke's law: F = kx
-        // Since we apply the spring's force to both nodes, divide by 2.
-        Vec2 diff = pos_ - other->second->pos_;
-        double x = diff.length();
-        double f = spring.k * x / 2.0;
-        Vec2 force = diff.unit() * f;
+#ifdef HAVE_AVX2_KERNEL
+__attribute__((target("avx2,fma")))
+void RowForceAvx2(double x, double y, double q, const double* bx,
+                  const double* by, const double* bq, int n,
+                  double* fx, double* fy) {
+    const __m256d vx = _mm256_set1_pd(x);
+    const __m256d vy = _mm256_set1_pd(y);
+    const __m256d vq = _mm256_set1_pd(q);
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d half = _mm256_set1_pd(0.5);
+    const __m256d threehalf = _mm256_set1_pd(1.5);
+    __m256d sx = zero, sy = zero;
+    int j = 0;
+    for(; j+4<=n; j+=4) {
+        __m256d dx = _mm256_sub_pd(vx, _mm256_loadu_pd(bx + j));
+        __m256d dy = _mm256_sub_pd(vy, _mm256_loadu_pd(by + j));
+        __m256d r2 = _mm256_fmadd_pd(dx, dx, _mm256_mul_pd(dy, dy));
+        // 1/r from the single precision estimate plus two Newton-Raphson
+        // steps, which is much cheaper than a double sqrt and divide and
+        // plenty accurate for a layout.
+        __m256d rinv = _mm256_cvtps_pd(_mm_rsqrt_ps(_mm256_cvtpd_ps(r2)));
+        __m256d h = _mm256_mul_pd(half, r2);
+        rinv = _mm256_mul_pd(rinv, _mm256_fnmadd_pd(
+                    h, _mm256_mul_pd(rinv, rinv), threehalf));
+        rinv = _mm256_mul_pd(rinv, _mm256_fnmadd_pd(
+                    h, _mm256_mul_pd(rinv, rinv), threehalf));
+        __m256d r3 = _mm256_mul_pd(rinv, _mm256_mul_pd(rinv, rinv));
+        __m256d f = _mm256_mul_pd(_mm256_mul_pd(vq, _mm256_loadu_pd(bq + j)),
+                                  r3);
+        // Zero the lanes where r == 0 (they hold inf or nan).
+        f = _mm256_andnot_pd(_mm256_cmp_pd(r2, zero, _CMP_EQ_OQ), f);
+        sx = _mm256_fmadd_pd(dx, f, sx);
+        sy = _mm256_fmadd_pd(dy, f, sy);
+    }
+    double ax[4], ay[4];
+    _mm256_storeu_pd(ax, sx);
+    _mm256_storeu_pd(ay, sy);
+    *fx += (ax[0] + ax[1]) + (ax[2] + ax[3]);
+    *fy += (ay[0] + ay[1]) + (ay[2] + ay[3]);
+    RowForce(x, y, q, bx + j, by + j, bq + j, n - j, fx, fy);
+}
 
-        // Apply any bias to the force
-        if (spring.bias.x != 0.0 || spring.bias.y != 0.0) {
-            force.x *= spring.bias.x;
-            force.y *= spring.bias.y;
+bool HaveAvx2() {
+    static const bool avx2 = __builtin_cpu_supports("avx2") &&
+                             __builtin_cpu_supports("fma");
+    return avx2;
+}
+#endif
+}  // namespace
+
+void Graph::Repulse() {
+    // The charges on all the nodes repel each other.
+    // Coulomb's law: F = k_e * c1 * c2 / r^2
+    // For us, k_e = 1.0
+    int n = b_.node.size();
+    if (theta_ > 0.0) {
+        BuildTree();
+        ForEach(n, [this](int begin, int end) {
+            for(int i=begin; i<end; i++)
+                TreeForce(0, i);
+        });
+        return;
+    }
+    if (n >= kSmallGraph) {
+        // Every body sums the force from all the others, which does twice
+        // the arithmetic of the symmetric loop below, but vectorizes and
+        // lets each thread write only its own bodies.
+        ForEach(n, [this](int begin, int end) {
+            RepulseRange(begin, end);
+        });
+        return;
+    }
+    const double* x = b_.x.data();
+    const double* y = b_.y.data();
+    const double* q = b_.charge.data();
+    double* fx = b_.fx.data();
+    double* fy = b_.fy.data();
+    for(int i=0; i<n; i++) {
+        for(int j=i+1; j<n; j++) {
+            double dx = x[i] - x[j];
+            double dy = y[i] - y[j];
+            double r = std::sqrt(dx*dx + dy*dy);
+            // f = q1 * q2 / r^2 in the direction of (dx, dy) / r
+            double f = q[i] * q[j] / (r * r * r);
+            fx[i] += dx * f; fy[i] += dy * f;
+            fx[j] -= dx * f; fy[j] -= dy * f;
         }
-        // Apply the force.  The other node feels the opposite force
-        force_ -= force;
-        other->second->force_ += force;
     }
 }
 
-void Node::Print() {
-    printf("node {\n");
-    printf("  id: %d\n", id_);
-    printf("  x: %f y: %f\n", pos_.x, pos_.y);
-    for (const auto& c : connection_) {
-        printf("  connection { destid: %d k: %f bias: {x:%f y:%f} color: %#08x width: %f }\n",
-                c.destid, c.k, c.bias.x, c.bias.y, c.color, c.width);
+void Graph::RepulseRange(int begin, int end) {
+    int n = b_.node.size();
+    auto kernel = RowForce;
+#ifdef HAVE_AVX2_KERNEL
+    if (HaveAvx2())
+        kernel = RowForceAvx2;
+#endif
+    for(int i=begin; i<end; i++) {
+        kernel(b_.x[i], b_.y[i], b_.charge[i],
+               b_.x.data(), b_.y.data(), b_.charge.data(), n,
+               &b_.fx[i], &b_.fy[i]);
     }
-    printf("}\n");
 }
 
-void Node::ApplyForces(double deltaT) {
-    // Newton's 2nd Law: F = ma
-    acc_ = force_ / mass_;
-    force_ = Vec2(0, 0);
+void Graph::ForEach(int n, const std::function<void(int, int)>& fn) {
+    if (n < kParallelGraph || threads_ == 1) {
+        fn(0, n);
+        return;
+    }
+    if (!executor_)
+        executor_.reset(new util::Executor(threads_));
+    int blocks = (n + kBlockSize - 1) / kBlockSize;
+    executor_->ParallelFor(blocks, [&fn, n](int b) {
+        fn(b * kBlockSize, std::min(n, (b + 1) * kBlockSize));
+    });
+}
 
-    // Equations of motion
-    vel_ = vel_ * (1.0 - friction_) + acc_ * deltaT;
-    Vec2 delta = vel_ * deltaT;
-    if (pause_ || delta.length() < 1e-6)
+void Graph::BuildTree() {
+    int n = b_.node.size();
+    tree_.clear();
+    if (n == 0)
         return;
+    double x0 = b_.x[0], y0 = b_.y[0], x1 = x0, y1 = y0;
+    for(int i=1; i<n; i++) {
+        x0 = std::min(x0, b_.x[i]); x1 = std::max(x1, b_.x[i]);
+        y0 = std::min(y0, b_.y[i]); y1 = std::max(y1, b_.y[i]);
+    }
+    double size = std::max(x1 - x0, y1 - y0) * 1.001 + 1e-9;
+    tree_.push_back(Cell{x0, y0, size, 0, 0, 0, {-1, -1, -1, -1}, -1, 0});
+    for(int i=0; i<n; i++)
+        Insert(0, i, 0);
+    // Turn the charge weighted sums into centers of charge.
+    for(auto& cell : tree_) {
+        if (cell.charge != 0.0) {
+            cell.cx /= cell.charge;
+            cell.cy /= cell.charge;
+        }
+    }
+}
+
+void Graph::Insert(int c, int body, int depth) {
+    // Bodies closer together than this are lumped into one leaf.
+    const int kMaxDepth = 24;
+    // Find or create the child of cell c which contains body i.
+    auto child = [this](int c, int i) {
+        const Cell& cell = tree_[c];
+        double half = cell.size / 2.0;
+        int q = (b_.x[i] >= cell.x0 + half) | (b_.y[i] >= cell.y0 + half) << 1;
+        if (cell.child[q] < 0) {
+            Cell ch{cell.x0 + (q & 1) * half, cell.y0 + (q >> 1) * half, half,
+                    0, 0, 0, {-1, -1, -1, -1}, -1, 0};
+            tree_.push_back(ch);
+            tree_[c].child[q] = tree_.size() - 1;
+        }
+        return tree_[c].child[q];
+    };
+    auto add = [this](int c, int i) {
+        Cell& cell = tree_[c];
+        cell.cx += b_.charge[i] * b_.x[i];
+        cell.cy += b_.charge[i] * b_.y[i];
+        cell.charge += b_.charge[i];
+        cell.count++;
+    };
 
-    pos_ += delta;
+    for(;;) {
+        add(c, body);
+        if (tree_[c].count == 1) {
+            tree_[c].body = body;
+            return;
+        }
+        if (depth >= kMaxDepth)
+            return;
+        int old = tree_[c].body;
+        if (old >= 0) {
+            // Push the leaf's body down a level.
+            tree_[c].body = -1;
+            int oc = child(c, old);
+            add(oc, old);
+            tree_[oc].body = old;
+        }
+        c = child(c, body);
+        depth++;
+    }
 }
 
-void Graph::Print() {
-    for(const auto& n : nodes_)
-        n.second->Print();
+void Graph::TreeForce(int c, int i) {
+    const Cell& cell = tree_[c];
+    double x = b_.x[i], y = b_.y[i];
+    bool leaf = cell.child[0] < 0 && cell.child[1] < 0 &&
+                cell.child[2] < 0 && cell.child[3] < 0;
+    if (leaf && cell.body == i && cell.count == 1)
+        return;
+
+    bool inside = x >= cell.x0 && x < cell.x0 + cell.size &&
+                  y >= cell.y0 && y < cell.y0 + cell.size;
+    double cx = cell.cx, cy = cell.cy, q = cell.charge;
+    double dx = x - cx, dy = y - cy;
+    double r2 = dx*dx + dy*dy;
+    // Open the cell if it's too close (or contains the body), unless it
+    // is a leaf.
+    if (!leaf && (inside || cell.size * cell.size >= theta_ * theta_ * r2)) {
+        for(int ch : cell.child) {
+            if (ch >= 0)
+                TreeForce(ch, i);
+        }
+        return;
+    }
+    if (inside) {
+        // A leaf of coincident bodies which includes this one: remove
+        // the body's own charge from the aggregate.
+        double rest = q - b_.charge[i];
+        if (rest <= 0.0)
+            return;
+        cx = (cx * q - x * b_.charge[i]) / rest;
+        cy = (cy * q - y * b_.charge[i]) / rest;
+        q = rest;
+        dx = x - cx; dy = y - cy;
+        r2 = dx*dx + dy*dy;
+    }
+    double r = std::sqrt(r2);
+    double f = b_.charge[i] * q / (r2 * r);
+    b_.fx[i] += dx * f;
+    b_.fy[i] += dy * f;
 }
 
-void Graph::Compute(double deltaT) {
-    for(const auto& n : nodes_)
-        n.second->ComputeForces(nodes_);
-    for(const auto& n : nodes_)
-        n.second->ApplyForces(deltaT);
+void Graph::Attract() {
+    // The springs attract connected nodes to each other.
+    for(size_t s=0; s<b_.src.size(); s++) {
+        int i = b_.src[s], j = b_.dst[s];
+        // Hooke's law: F = kx
+        // Since we apply the spring's force to both nodes, divide by 2.
+        double f = b_.k[s] / 2.0;
+        double fx = (b_.x[i] - b_.x[j]) * f;
+        double fy = (b_.y[i] - b_.y[j]) * f;
+
+        // Apply any bias to the force
+        if (b_.biasx[s] != 0.0 || b_.biasy[s] != 0.0) {
+            fx *= b_.biasx[s];
+            fy *= b_.biasy[s];
+        }
+        // Apply the force.  The other node feels the opposite force
+        b_.fx[i] -= fx; b_.fy[i] -= fy;
+        b_.fx[j] += fx; b_.fy[j] += fy;
+    }
+}
+
+void Graph::Apply(double deltaT) {
+    energy_ = 0.0;
+    for(size_t i=0; i<b_.node.size(); i++) {
+        // Newton's 2nd Law: F = ma
+        double ax = b_.fx[i] / b_.mass[i];
+        double ay = b_.fy[i] / b_.mass[i];
+        b_.fx[i] = b_.fy[i] = 0.0;
+
+        // Equations of motion
+        double damp = 1.0 - b_.friction[i];
+        b_.vx[i] = b_.vx[i] * damp + ax * deltaT;
+        b_.vy[i] = b_.vy[i] * damp + ay * deltaT;
+        double dx = b_.vx[i] * deltaT;
+        double dy = b_.vy[i] * deltaT;
+        if (b_.pause[i] || dx*dx + dy*dy < 1e-12)
+            continue;
+
+        b_.x[i] += dx;
+        b_.y[i] += dy;
+        energy_ += 0.5 * b_.mass[i] *
+                   (b_.vx[i] * b_.vx[i] + b_.vy[i] * b_.vy[i]);
+    }
 }
 
 }  // namepsace fdg
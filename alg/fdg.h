@@ -1,13 +1,16 @@
 #ifndef Z2UTIL_ALG_FDG_H
 #define Z2UTIL_ALG_FDG_H
 
+#include <atomic>
 #include <cmath>
+#include <functional>
 #include <map>
 #include <memory>
 #include <string>
 #include <vector>
 
 #include "alg/vec2.h"
+#include "util/executor.h"
 
 namespace fdg {
 
@@ -34,7 +37,7 @@ class Node {
   public:
     explicit Node(int32_t id, const Vec2& position)
       : id_(id), start_pos_(position), pos_(position),
-        vel_(0, 0), acc_(0, 0), force_(0, 0),
+        vel_(0, 0), force_(0, 0),
         mass_(1.0), charge_(1.0), friction_(0.01), pause_(false) {}
 
     explicit Node(const Vec2& position) : Node(0, position) {}
@@ -61,15 +64,12 @@ class Node {
     inline std::vector<Spring>* mutable_connection() { return &connection_; }
 
     void Print();
-    void ComputeForces(
-            const std::map<int32_t, std::unique_ptr<Node>>& nodes);
-    void ApplyForces(double deltaT);
   private:
+    friend class Graph;
     int32_t id_;
     Vec2 start_pos_;
     Vec2 pos_;
     Vec2 vel_;
-    Vec2 acc_;
     Vec2 force_;
     double mass_;
     double charge_;
@@ -78,9 +78,13 @@ class Node {
     std::vector<Spring> connection_;
 };
 
+// The simulation works on a struct-of-arrays copy of the nodes, which is
+// loaded from the Nodes before and stored back after each call to Compute
+// or Converge.  Repulsion is either computed exactly over all pairs
+// (theta == 0) or approximated with a Barnes-Hut quadtree.
 class Graph {
   public:
-    explicit Graph() {}
+    explicit Graph() : theta_(0.0), energy_(0.0), threads_(0) {}
 
     inline Node* AddNode(Node* node) {
         nodes_[node->id()].reset(node);
@@ -103,10 +107,68 @@ class Graph {
     }
 
     void Print();
+    // Advance the simulation by one step.
     void Compute(double deltaT);
+    // Advance the simulation by up to max_steps steps, stopping early once
+    // the total kinetic energy falls below epsilon or cancel becomes true.
+    // Returns the number of steps taken.
+    int Converge(double deltaT, int max_steps, double epsilon,
+                 const std::atomic<bool>* cancel=nullptr);
     void Clear() { nodes_.clear(); }
+
+    // The Barnes-Hut opening angle.  Larger values are faster but less
+    // accurate; 0 computes the exact all-pairs repulsion.
+    inline double theta() const { return theta_; }
+    inline void set_theta(double theta) { theta_ = theta; }
+    // The total kinetic energy after the last step.
+    inline double energy() const { return energy_; }
+    // Number of threads for the repulsion pass on large graphs (0 = one
+    // per CPU).  The threads are started the first time they're needed.
+    inline void set_threads(int n) { threads_ = n; executor_.reset(); }
   private:
+    struct Bodies {
+        std::vector<Node*> node;
+        std::vector<double> x, y;
+        std::vector<double> vx, vy;
+        std::vector<double> fx, fy;
+        std::vector<double> mass, charge, friction;
+        std::vector<bool> pause;
+        // Springs, with the endpoints as indices into the arrays above.
+        std::vector<int> src, dst;
+        std::vector<double> k, biasx, biasy;
+    };
+    // A quadtree cell.  Leaves hold a single body, except when bodies
+    // are too close together to separate.
+    struct Cell {
+        double x0, y0, size;
+        double cx, cy, charge;
+        int child[4];
+        int body;
+        int count;
+    };
+
+    void Load();
+    void Store();
+    void Step(double deltaT);
+    void Repulse();
+    // Run fn(begin, end) over [0, n) in blocks, on the executor if the
+    // graph is big enough to be worth it.
+    void ForEach(int n, const std::function<void(int, int)>& fn);
+    // Exact repulsion on bodies [begin, end) from all other bodies.
+    void RepulseRange(int begin, int end);
+    void BuildTree();
+    void Insert(int cell, int body, int depth);
+    void TreeForce(int cell, int body);
+    void Attract();
+    void Apply(double deltaT);
+
     std::map<int32_t, std::unique_ptr<Node>> nodes_;
+    double theta_;
+    double energy_;
+    Bodies b_;
+    std::vector<Cell> tree_;
+    int threads_;
+    std::unique_ptr<util::Executor> executor_;
 };
 
 }  // namespace fdg
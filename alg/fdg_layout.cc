@@ -0,0 +1,152 @@
+#include "alg/fdg_layout.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace fdg {
+namespace {
+// Publish the positions at least this often during the initial
+// convergence so the UI can show the layout settling.
+const int kConvergeBatch = 60;
+}  // namespace
+
+Layout::Layout(Graph* graph)
+  : graph_(graph),
+    cancel_(false),
+    converging_(false),
+    continuous_(false),
+    fresh_(false) {}
+
+Layout::~Layout() {
+    Stop();
+}
+
+void Layout::Start(double deltaT, int converge_steps, double epsilon) {
+    Stop();
+    index_.clear();
+    view_.clear();
+    for(const auto& n : graph_->nodes()) {
+        index_[n.first] = view_.size();
+        view_.push_back(n.second->pos());
+    }
+    front_ = back_ = view_;
+    fresh_ = false;
+    cancel_ = false;
+    converging_ = converge_steps > 0;
+    thread_ = std::thread(&Layout::Run, this, deltaT, converge_steps, epsilon);
+}
+
+void Layout::Stop() {
+    if (!thread_.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        cancel_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+    // The Graph belongs to the caller again: apply anything the worker
+    // didn't get to and make the final positions visible.
+    ApplyMoves();
+    Publish();
+    Sync();
+    converging_ = false;
+}
+
+void Layout::set_continuous(bool continuous) {
+    std::lock_guard<std::mutex> lock(mu_);
+    if (continuous_ != continuous) {
+        continuous_ = continuous;
+        cv_.notify_all();
+    }
+}
+
+void Layout::Sync() {
+    std::unique_lock<std::mutex> lock(mu_, std::try_to_lock);
+    if (!lock.owns_lock() || !fresh_)
+        return;
+    view_.swap(front_);
+    fresh_ = false;
+    // Moves the worker hasn't seen yet aren't in the published positions.
+    for(const auto& m : moves_)
+        view_[m.index] = m.pos;
+}
+
+Vec2 Layout::pos(int32_t id) const {
+    auto it = index_.find(id);
+    return it == index_.end() ? Vec2() : view_[it->second];
+}
+
+void Layout::Move(int32_t id, const Vec2& pos, bool pin) {
+    auto it = index_.find(id);
+    if (it == index_.end())
+        return;
+    view_[it->second] = pos;
+    std::lock_guard<std::mutex> lock(mu_);
+    moves_.push_back(MoveRequest{it->second, pos, pin});
+    cv_.notify_all();
+}
+
+void Layout::ApplyMoves() {
+    std::vector<MoveRequest> moves;
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        moves.swap(moves_);
+    }
+    if (moves.empty())
+        return;
+    std::vector<Node*> nodes;
+    for(const auto& n : graph_->nodes())
+        nodes.push_back(n.second.get());
+    for(const auto& m : moves) {
+        nodes[m.index]->set_pos(m.pos);
+        nodes[m.index]->set_pause(m.pin);
+    }
+}
+
+void Layout::Publish() {
+    int i = 0;
+    for(const auto& n : graph_->nodes())
+        back_[i++] = n.second->pos();
+    std::lock_guard<std::mutex> lock(mu_);
+    back_.swap(front_);
+    fresh_ = true;
+}
+
+void Layout::Run(double deltaT, int converge_steps, double epsilon) {
+    int steps = 0;
+    while (!cancel_ && steps < converge_steps) {
+        ApplyMoves();
+        int batch = std::min(kConvergeBatch, converge_steps - steps);
+        int n = graph_->Converge(deltaT, batch, epsilon, &cancel_);
+        steps += n;
+        Publish();
+        if (n < batch)
+            break;
+    }
+    converging_ = false;
+
+    auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(deltaT));
+    auto next = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(mu_);
+    while (!cancel_) {
+        if (!continuous_ && moves_.empty()) {
+            cv_.wait(lock);
+            continue;
+        }
+        bool step = continuous_;
+        lock.unlock();
+        ApplyMoves();
+        if (step)
+            graph_->Compute(deltaT);
+        Publish();
+        lock.lock();
+
+        // Step at a fixed rate, independent of the frame rate.
+        next = std::max(next + period, std::chrono::steady_clock::now());
+        cv_.wait_until(lock, next, [this]() { return cancel_.load(); });
+    }
+}
+
+}  // namespace fdg
@@ -0,0 +1,75 @@
+#ifndef Z2UTIL_ALG_FDG_LAYOUT_H
+#define Z2UTIL_ALG_FDG_LAYOUT_H
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "alg/fdg.h"
+
+namespace fdg {
+
+// Runs the simulation of a Graph on a worker thread.
+//
+// While the worker runs it owns the Graph.  After each batch of steps it
+// publishes the node positions into a double buffer, which the UI thread
+// picks up with Sync() without ever waiting for the simulation.  Node moves
+// from the UI are queued and applied by the worker between steps.
+class Layout {
+  public:
+    explicit Layout(Graph* graph);
+    ~Layout();
+
+    // Start the worker.  It first runs up to converge_steps steps (stopping
+    // early once the kinetic energy falls below epsilon) and then keeps
+    // stepping every deltaT seconds while continuous simulation is enabled.
+    void Start(double deltaT, int converge_steps, double epsilon);
+    // Cancel any in-flight layout and wait for the worker to exit.
+    void Stop();
+    inline bool running() const { return thread_.joinable(); }
+    // True while the initial convergence is still in progress.
+    inline bool converging() const { return converging_; }
+
+    void set_continuous(bool continuous);
+    // Pick up the most recently published positions, unless the worker is
+    // publishing at this very moment.
+    void Sync();
+    // The position of a node as of the last Sync().
+    Vec2 pos(int32_t id) const;
+    // Move a node.  A pinned node is not moved by the simulation.
+    void Move(int32_t id, const Vec2& pos, bool pin);
+
+  private:
+    struct MoveRequest {
+        int index;
+        Vec2 pos;
+        bool pin;
+    };
+    void Run(double deltaT, int converge_steps, double epsilon);
+    void ApplyMoves();
+    void Publish();
+
+    Graph* graph_;
+    std::thread thread_;
+    std::atomic<bool> cancel_;
+    std::atomic<bool> converging_;
+    std::map<int32_t, int> index_;
+
+    // Guards everything below.
+    std::mutex mu_;
+    std::condition_variable cv_;
+    bool continuous_;
+    bool fresh_;
+    std::vector<MoveRequest> moves_;
+    // back_ is written by the worker, view_ is read by the UI, and front_
+    // is handed between them by swapping.
+    std::vector<Vec2> back_;
+    std::vector<Vec2> front_;
+    std::vector<Vec2> view_;
+};
+
+}  // namespace fdg
+#endif // Z2UTIL_ALG_FDG_LAYOUT_H
@@ -44,7 +44,7 @@ void PalaceGenerator::Generate() {
     } while(!ok);
 
     SimplePrint();
-    holder_.reset(new MapHolder(mapper_));
+    holder_.reset(new Sideview(rom_));
     for(const auto& r : rooms_) {
         PrepareRoom(r.room);
     }
@@ -249,32 +249,32 @@ bool PalaceGenerator::SelectSpecialRooms() {
     return true;
 }
 
-#define WINDOW(x, y)           MapCommand(holder_.get(), x, (y)<<4, 0x00, 0x00)
-#define UNICORNHEAD(x, y)      MapCommand(holder_.get(), x, (y)<<4, 0x01, 0x00)
-#define WOLFHEAD(x, y)         MapCommand(holder_.get(), x, (y)<<4, 0x02, 0x00)
-#define CRYSTALRETURN(x, y)    MapCommand(holder_.get(), x, (y)<<4, 0x03, 0x00)
-#define LOCKEDDOOR(x, y)       MapCommand(holder_.get(), x, (y)<<4, 0x05, 0x00)
-#define CLOUD1(x, y)           MapCommand(holder_.get(), x, (y)<<4, 0x07, 0x00)
-#define CLOUD2(x, y)           MapCommand(holder_.get(), x, (y)<<4, 0x08, 0x00)
-#define IKSTATUE(x, y)         MapCommand(holder_.get(), x, (y)<<4, 0x09, 0x00)
-
-#define HORIZPIT1(x, y, w)     MapCommand(holder_.get(), x, (y)<<4, 0x10|((w)-1), 0x00)
-#define PALACEBRICKS1(x, y, w) MapCommand(holder_.get(), x, (y)<<4, 0x20|((w)-1), 0x00)
-#define BREAKBLOCK1(x, y, w)   MapCommand(holder_.get(), x, (y)<<4, 0x30|((w)-1), 0x00)
-#define STEELBRICKS(x, y, w)   MapCommand(holder_.get(), x, (y)<<4, 0x40|((w)-1), 0x00)
-#define CRUMBLEBRIDGE(x, y, w) MapCommand(holder_.get(), x, (y)<<4, 0x50|((w)-1), 0x00)
-#define PALACEBRICKS2(x, y, w) MapCommand(holder_.get(), x, (y)<<4, 0x70|((w)-1), 0x00)
-#define CURTAINS(x, y, w)      MapCommand(holder_.get(), x, (y)<<4, 0x80|((w)-1), 0x00)
-#define BREAKBLOCK2(x, y, w)   MapCommand(holder_.get(), x, (y)<<4, 0x90|((w)-1), 0x00)
-#define FAKEWALL(x, y, w)      MapCommand(holder_.get(), x, (y)<<4, 0xA0|((w)-1), 0x00)
-#define BREAKBLOCKV(x, y, h)   MapCommand(holder_.get(), x, (y)<<4, 0xB0|((h)-1), 0x00)
-#define COLUMN(x, y, h)        MapCommand(holder_.get(), x, (y)<<4, 0xC0|((h)-1), 0x00)
+#define WINDOW(x, y)           SideviewCommand(x, (y)<<4, 0x00, 0x00)
+#define UNICORNHEAD(x, y)      SideviewCommand(x, (y)<<4, 0x01, 0x00)
+#define WOLFHEAD(x, y)         SideviewCommand(x, (y)<<4, 0x02, 0x00)
+#define CRYSTALRETURN(x, y)    SideviewCommand(x, (y)<<4, 0x03, 0x00)
+#define LOCKEDDOOR(x, y)       SideviewCommand(x, (y)<<4, 0x05, 0x00)
+#define CLOUD1(x, y)           SideviewCommand(x, (y)<<4, 0x07, 0x00)
+#define CLOUD2(x, y)           SideviewCommand(x, (y)<<4, 0x08, 0x00)
+#define IKSTATUE(x, y)         SideviewCommand(x, (y)<<4, 0x09, 0x00)
+
+#define HORIZPIT1(x, y, w)     SideviewCommand(x, (y)<<4, 0x10|((w)-1), 0x00)
+#define PALACEBRICKS1(x, y, w) SideviewCommand(x, (y)<<4, 0x20|((w)-1), 0x00)
+#define BREAKBLOCK1(x, y, w)   SideviewCommand(x, (y)<<4, 0x30|((w)-1), 0x00)
+#define STEELBRICKS(x, y, w)   SideviewCommand(x, (y)<<4, 0x40|((w)-1), 0x00)
+#define CRUMBLEBRIDGE(x, y, w) SideviewCommand(x, (y)<<4, 0x50|((w)-1), 0x00)
+#define PALACEBRICKS2(x, y, w) SideviewCommand(x, (y)<<4, 0x70|((w)-1), 0x00)
+#define CURTAINS(x, y, w)      SideviewCommand(x, (y)<<4, 0x80|((w)-1), 0x00)
+#define BREAKBLOCK2(x, y, w)   SideviewCommand(x, (y)<<4, 0x90|((w)-1), 0x00)
+#define FAKEWALL(x, y, w)      SideviewCommand(x, (y)<<4, 0xA0|((w)-1), 0x00)
+#define BREAKBLOCKV(x, y, h)   SideviewCommand(x, (y)<<4, 0xB0|((h)-1), 0x00)
+#define COLUMN(x, y, h)        SideviewCommand(x, (y)<<4, 0xC0|((h)-1), 0x00)
 // Apparently bridge doesn't work.
-#define BRIDGE(x, y, w)        MapCommand(holder_.get(), x, (y)<<4, 0xD0|((w)-1), 0x00)
-#define PIT(x, y, w)           MapCommand(holder_.get(), x, (y)<<4, 0xF0|((w)-1), 0x00)
-#define LAVA(x, w)             MapCommand(holder_.get(), x, 0xF0, 0x10|((w)-1), 0x00)
-#define ELEVATOR(x)            MapCommand(holder_.get(), x, 0xF0, 0x50, 0x00)
-#define SET_FLOOR(x, arg)      MapCommand(holder_.get(), x, 0xD0, arg, 0x00)
+#define BRIDGE(x, y, w)        SideviewCommand(x, (y)<<4, 0xD0|((w)-1), 0x00)
+#define PIT(x, y, w)           SideviewCommand(x, (y)<<4, 0xF0|((w)-1), 0x00)
+#define LAVA(x, w)             SideviewCommand(x, 0xF0, 0x10|((w)-1), 0x00)
+#define ELEVATOR(x)            SideviewCommand(x, 0xF0, 0x50, 0x00)
+#define SET_FLOOR(x, arg)      SideviewCommand(x, 0xD0, arg, 0x00)
 
 void PalaceGenerator::MakeFakeCeiling(int r, int x, int w, int downto) {
     int odd = downto & 1;
@@ -372,7 +372,7 @@ int PalaceGenerator::MakeElevator(int r, int x, int floor_val) {
 
 void PalaceGenerator::PrepareEntranceRoom(int r) {
     int start = opt_.start_room();
-    MapConnection connection(mapper_);
+    MapConnection connection(rom_);
 
     holder_->Parse(palace_maps_[start+r]);
     connection.Parse(palace_maps_[start+r]);
@@ -439,13 +439,13 @@ void PalaceGenerator::PrepareEntranceRoom(int r) {
     } else {
         connection.set_down(63, 0);
     }
-    holder_->Save();
+    holder_->Save(true);
     connection.Save();
 }
 
 void PalaceGenerator::PrepareBossRoom(int r) {
     int start = opt_.start_room();
-    MapConnection connection(mapper_);
+    MapConnection connection(rom_);
     memset(&gen_, 0, sizeof(gen_));
 
     holder_->Parse(palace_maps_[start+r]);
@@ -496,7 +496,7 @@ void PalaceGenerator::PrepareBossRoom(int r) {
     connection.set_right(63, 0);
     connection.set_up(rooms_[r].up, 0);
     connection.set_down(rooms_[r].down, 0);
-    holder_->Save();
+    holder_->Save(true);
     connection.Save();
 }
 
@@ -505,7 +505,7 @@ void PalaceGenerator::PrepareItemRoom(int r) {
                      rooms_[r].has_right ? LEFT :
                      bit() ? LEFT : RIGHT;
     int start = opt_.start_room();
-    MapConnection connection(mapper_);
+    MapConnection connection(rom_);
     memset(&gen_, 0, sizeof(gen_));
 
     holder_->Parse(palace_maps_[start+r]);
@@ -558,7 +558,7 @@ void PalaceGenerator::PrepareItemRoom(int r) {
     connection.set_right(rooms_[r].right, 0);
     connection.set_up(rooms_[r].up, 2);
     connection.set_down(rooms_[r].down, 2);
-    holder_->Save();
+    holder_->Save(true);
     connection.Save();
 }
 
@@ -574,7 +574,7 @@ void PalaceGenerator::PrepareRoom(int r) {
         return;
     }
     int start = opt_.start_room();
-    MapConnection connection(mapper_);
+    MapConnection connection(rom_);
     memset(&gen_, 0, sizeof(gen_));
 
     holder_->Parse(palace_maps_[start+r]);
@@ -628,7 +628,7 @@ void PalaceGenerator::PrepareRoom(int r) {
     connection.set_right(rooms_[r].right, 0);
     connection.set_up(rooms_[r].up, 2);
     connection.set_down(rooms_[r].down, 2);
-    holder_->Save();
+    holder_->Save(true);
     connection.Save();
 
 }
@@ -770,7 +770,7 @@ void PalaceGenerator::MakeCubby(int r, int w) {
 
 void PalaceGenerator::FixElevatorConnections() {
     int start = opt_.start_room();
-    MapConnection connection(mapper_);
+    MapConnection connection(rom_);
 
     for(const auto& r : rooms_) {
         connection.Parse(palace_maps_[start+r.room]);
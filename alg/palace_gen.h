@@ -8,7 +8,8 @@
 #include <vector>
 
 #include "imwidget/map_command.h"
-#include "nes/mapper.h"
+#include "nes/rom_context.h"
+#include "nes/sideview.h"
 #include "proto/generator.pb.h"
 #include "proto/rominfo.pb.h"
 
@@ -33,7 +34,7 @@ class PalaceGenerator {
 
     void Generate();
     void SimplePrint();
-    inline void set_mapper(Mapper* m) { mapper_ = m; }
+    inline void set_rom(RomContext* rom) { rom_ = rom; }
   private:
     enum Direction { LEFT, RIGHT, UP, DOWN, };
     struct RoomGen {
@@ -74,9 +75,9 @@ class PalaceGenerator {
     std::mt19937 rng_;
     std::uniform_real_distribution<double> real_;
     int room_;
-    Mapper* mapper_;
+    RomContext* rom_;
     Map palace_maps_[64];
-    std::unique_ptr<MapHolder> holder_;
+    std::unique_ptr<Sideview> holder_;
     RoomGen gen_;
 
     static const FloorCeiling fpos_[];
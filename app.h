@@ -3,7 +3,9 @@
 #include <memory>
 #include <string>
 
+#include "commands.h"
 #include "imwidget/imapp.h"
+#include "imwidget/area_search.h"
 #include "imwidget/drops.h"
 #include "imwidget/editor.h"
 #include "imwidget/enemyattr.h"
@@ -22,15 +24,14 @@
 #include "imwidget/tile_transform.h"
 #include "imwidget/object_table.h"
 #include "imwidget/xptable.h"
-#include "nes/cartridge.h"
-#include "nes/mapper.h"
-#include "nes/memory.h"
+#include "nes/rom_context.h"
 
 namespace z2util {
 
 class Z2Edit: public ImApp {
   public:
-    Z2Edit(const std::string& name) : ImApp(name, 1280, 720) {}
+    Z2Edit(const std::string& name)
+      : ImApp(name, 1280, 720), commands_(&rom_) {}
     ~Z2Edit() override {}
 
     void Init() override;
@@ -39,7 +40,7 @@ class Z2Edit: public ImApp {
     void Draw() override;
 
     void Load(const std::string& filename);
-    void Source(const std::string& filename, DebugConsole* console=nullptr);
+    void Source(const std::string& filename);
 
     // movekeepout is tri-state:
     // -1: default action based on FLAGS_move_from_keepout
@@ -48,48 +49,23 @@ class Z2Edit: public ImApp {
     void LoadPostProcess(int movekeepout);
     void Help(const std::string& topickey);
   private:
-    void LoadFile(DebugConsole* console, int argc, char **argv);
-    void SaveFile(DebugConsole* console, int argc, char **argv);
-    void HexdumpBytes(DebugConsole* console, int argc, char **argv);
-    void WriteBytes(DebugConsole* console, int argc, char **argv);
-    void WriteText(DebugConsole* console, int argc, char **argv);
-    void WriteMapper(DebugConsole* console, int argc, char **argv);
-    void HexdumpWords(DebugConsole* console, int argc, char **argv);
-    void WriteWords(DebugConsole* console, int argc, char **argv);
-    void Unassemble(DebugConsole* console, int argc, char **argv);
-    void Assemble(DebugConsole* console, int argc, char **argv);
-    void EnemyList(DebugConsole* console, int argc, char **argv);
-    void InsertPrg(DebugConsole* console, int argc, char **argv);
-    void CopyPrg(DebugConsole* console, int argc, char **argv);
-    void InsertChr(DebugConsole* console, int argc, char **argv);
-    void CopyChr(DebugConsole* console, int argc, char **argv);
-    void CharClear(DebugConsole* console, int argc, char **argv);
-    void CharCopy(DebugConsole* console, int argc, char **argv);
-    void MemMove(DebugConsole* console, int argc, char **argv);
-    void Swap(DebugConsole* console, int argc, char **argv);
-    void BCopy(DebugConsole* console, int argc, char **argv);
-    void SetVar(DebugConsole* console, int argc, char **argv);
-    void Source(DebugConsole* console, int argc, char **argv);
-    void RestoreBank(DebugConsole* console, int argc, char **argv);
-    void DumpTownText(DebugConsole* console, int argc, char **argv);
-    void ConnTable(DebugConsole* console, int argc, char **argv);
-    void SendMessage(DebugConsole* console, int argc, char **argv);
+    // Refresh the editors which don't follow the ChangeBus.
+    void RefreshEditors();
+    void LoadFile(Console* console, int argc, char **argv);
+    void SaveFile(Console* console, int argc, char **argv);
+    void ConnTable(Console* console, int argc, char **argv);
+    void SendMessage(Console* console, int argc, char **argv);
     void SpawnEmulator();
     void SpawnEmulator(uint8_t bank, uint8_t region, uint8_t world,
         uint8_t town_code, uint8_t palace_code, uint8_t connector,
         uint8_t room, uint8_t page, uint8_t prev_region);
-    int EncodedText(int ch);
-    bool ParseChr(const std::string& a, int* bank, uint8_t *addr);
 
     bool loaded_;
-    int ibase_;
-    int bank_;
-    int chrbank_;
-    int text_encoding_;
     std::string save_filename_;
     std::string export_filename_;
     NesHardwarePalette* hwpal_;
     std::unique_ptr<NesChrView> chrview_;
+    std::unique_ptr<z2util::AreaSearch> area_search_;
     std::unique_ptr<z2util::SimpleMap> simplemap_;
     std::unique_ptr<z2util::Drops> drops_;
     std::unique_ptr<z2util::Editor> editor_;
@@ -105,10 +81,9 @@ class Z2Edit: public ImApp {
     std::unique_ptr<z2util::EnemyEditor> enemy_editor_;
     std::unique_ptr<z2util::ExperienceTable> experience_table_;
 
-    Cartridge cartridge_;
+    RomContext rom_;
+    RomCommands commands_;
     Project project_;
-    z2util::Memory memory_;
-    std::unique_ptr<Mapper> mapper_;
 };
 
 }  // namespace z2util
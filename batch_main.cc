@@ -0,0 +1,218 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <gflags/gflags.h>
+
+#include "commands.h"
+#include "ips/bps.h"
+#include "ips/ips.h"
+#include "nes/cpu6502.h"
+#include "nes/memory.h"
+#include "nes/rom_context.h"
+#include "postprocess.h"
+#include "util/config.h"
+#include "util/console.h"
+#include "util/executor.h"
+#include "util/file.h"
+#include "util/logging.h"
+#include "absl/strings/str_split.h"
+#include "zelda2_config.h"
+
+DEFINE_string(config, "", "ROM info config file");
+DEFINE_string(script, "", "Comma separated list of command scripts to run");
+DEFINE_string(output_dir, "", "Directory for the output ROMs or patches");
+DEFINE_bool(ips, false, "Write IPS patches instead of ROMs");
+DEFINE_bool(bps, false, "Write BPS patches instead of ROMs");
+DEFINE_int32(threads, 0, "Number of worker threads (0 = number of CPUs)");
+DEFINE_bool(verbose, false, "Print the console output for every ROM");
+DEFINE_bool(move_from_keepout, true, "Move maps out of known keepout areas");
+
+const char kUsage[] =
+R"ZZZ(<flags> [rom.nes ...]
+
+Description:
+  Apply debug console command scripts to many Zelda II ROMs without
+  starting the editor.
+
+Usage:
+  z2edit_batch --script a.txt,b.txt --output_dir out/ [--ips|--bps] rom.nes ...
+
+  Each ROM is loaded, every script is run against it as if by the 'source'
+  command and the result is written to the output directory under the
+  same name (or with an .ips or .bps extension when --ips or --bps is
+  given).
+)ZZZ";
+
+namespace z2util {
+
+// A console which keeps its output so it can be printed in order once
+// the worker threads are done.
+class BatchConsole: public Console {
+  public:
+    BatchConsole() : errors_(0) {}
+    void ClearLog() override { log_.clear(); }
+    inline const std::string& log() const { return log_; }
+    inline int errors() const { return errors_; }
+
+  protected:
+    void Output(const char* line) override {
+        if (strstr(line, "[error]") || !strncmp(line, "Unknown command", 15))
+            errors_++;
+        log_.append(PlainText(line));
+        if (log_.empty() || log_.back() != '\n')
+            log_.push_back('\n');
+    }
+
+  private:
+    std::string log_;
+    int errors_;
+};
+
+struct BatchResult {
+    bool ok;
+    std::string output;
+    std::string log;
+};
+
+class BatchRunner {
+  public:
+    BatchRunner(const std::vector<std::string>& scripts)
+      : scripts_(scripts) {}
+
+    BatchResult Process(const std::string& filename);
+
+  private:
+    const std::vector<std::string>& scripts_;
+};
+
+BatchResult BatchRunner::Process(const std::string& filename) {
+    BatchResult result{false, "", ""};
+    std::string original;
+    if (!File::GetContents(filename, &original)) {
+        result.log = "[error] Couldn't read " + filename + "\n";
+        return result;
+    }
+
+    RomContext rom;
+    if (!rom.LoadRom(original, FLAGS_move_from_keepout)) {
+        result.log = "[error] " + filename +
+                     " is not a NES file or uses an unknown mapper\n";
+        return result;
+    }
+    RomCommands commands(&rom);
+    BatchConsole console;
+    commands.set_reload_cb([&](int movekeepout) {
+        if (movekeepout == -1) {
+            movekeepout = FLAGS_move_from_keepout;
+        }
+        rom.Reload(movekeepout);
+    });
+    commands.Register(&console);
+
+    for(const auto& script : scripts_) {
+        if (!console.Source(script)) {
+            console.AddLog("[error] Couldn't read %s", script.c_str());
+        }
+    }
+    result.log = console.log();
+    if (console.errors()) {
+        return result;
+    }
+
+    std::string base = File::Basename(filename);
+    const std::string& modified = rom.SaveRom();
+    std::string patch;
+    if (FLAGS_ips || FLAGS_bps) {
+        auto dot = base.rfind('.');
+        if (dot != std::string::npos) {
+            base.resize(dot);
+        }
+        if (FLAGS_bps) {
+            base += ".bps";
+            patch = bps::CreatePatch(original, modified);
+        } else {
+            base += ".ips";
+            patch = ips::CreatePatch(
+                original, modified,
+                rom.cartridge()->DirtyRanges(Cartridge::EXPORT));
+        }
+    }
+    result.output = FLAGS_output_dir + "/" + base;
+    if (!File::SetContents(result.output,
+                           FLAGS_ips || FLAGS_bps ? patch : modified)) {
+        result.log += "[error] Couldn't write " + result.output + "\n";
+        return result;
+    }
+    result.ok = true;
+    return result;
+}
+
+}  // namespace z2util
+
+int main(int argc, char *argv[]) {
+    gflags::SetUsageMessage(kUsage);
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+    logging::logging_init();
+
+    if (FLAGS_script.empty() || FLAGS_output_dir.empty() || argc < 2) {
+        printf("%s %s\n", argv[0], kUsage);
+        return 1;
+    }
+    auto status = File::MakeDirs(FLAGS_output_dir);
+    if (!status.ok()) {
+        fprintf(stderr, "Couldn't create %s: %s\n", FLAGS_output_dir.c_str(),
+                status.ToString().c_str());
+        return 1;
+    }
+
+    auto* config = ConfigLoader<z2util::RomInfo>::Get();
+    auto postprocess = [](z2util::RomInfo* ri) {
+        z2util::PostProcessConfig(ri, nullptr);
+    };
+    if (!FLAGS_config.empty()) {
+        config->Load(FLAGS_config, postprocess);
+    } else {
+        config->Parse(kZelda2Cfg, postprocess);
+    }
+    // The config and the tables derived from it are shared by the worker
+    // threads.  Build them here so the workers only ever read them.
+    z2util::KeepoutTable::Get();
+    Cpu warmup;
+
+    std::vector<std::string> scripts = absl::StrSplit(
+            FLAGS_script, ',', absl::SkipEmpty());
+    std::vector<std::string> roms(argv + 1, argv + argc);
+    std::vector<z2util::BatchResult> results(roms.size());
+    z2util::BatchRunner runner(scripts);
+
+    int nthreads = FLAGS_threads;
+    if (nthreads <= 0) {
+        nthreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    nthreads = std::min(nthreads, int(roms.size()));
+
+    util::Executor executor(nthreads);
+    executor.ParallelFor(roms.size(), [&](int i) {
+        results[i] = runner.Process(roms[i]);
+    });
+
+    int failed = 0;
+    for(size_t i=0; i<roms.size(); ++i) {
+        const auto& r = results[i];
+        if (r.ok) {
+            printf("%s -> %s\n", roms[i].c_str(), r.output.c_str());
+        } else {
+            printf("%s: FAILED\n", roms[i].c_str());
+            failed++;
+        }
+        if (!r.ok || FLAGS_verbose) {
+            fputs(r.log.c_str(), stdout);
+        }
+    }
+    printf("Processed %zu ROMs, %d failed.\n", roms.size(), failed);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,916 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "commands.h"
+#include "nes/cpu6502.h"
+#include "nes/chr_util.h"
+#include "nes/sideview.h"
+#include "nes/text_encoding.h"
+#include "nes/text_list.h"
+#include "proto/rominfo.pb.h"
+#include "util/config.h"
+#include "absl/strings/str_split.h"
+
+namespace z2util {
+
+RomCommands::RomCommands(RomContext* rom)
+  : rom_(rom),
+    ibase_(0),
+    bank_(0),
+    chrbank_(0),
+    text_encoding_(0),
+    unassemble_addr_(0),
+    area_index_(nullptr) {}
+
+void RomCommands::Register(Console* console) {
+    console->RegisterCommand("wm", "Write mapper register.", this, &RomCommands::WriteMapper);
+    console->RegisterCommand("header", "Print iNES header.", this, &RomCommands::PrintHeader);
+
+    console->RegisterCommand("db", "Hexdump bytes (via mapper).", this, &RomCommands::HexdumpBytes);
+    console->RegisterCommand("dbp", "Hexdump PRG bytes.", this, &RomCommands::HexdumpBytes);
+    console->RegisterCommand("dbc", "Hexdump CHR bytes.", this, &RomCommands::HexdumpBytes);
+    console->RegisterCommand("dw", "Hexdump words (via mapper).", this, &RomCommands::HexdumpWords);
+    console->RegisterCommand("dwp", "Hexdump PRG words.", this, &RomCommands::HexdumpWords);
+    console->RegisterCommand("dwc", "Hexdump CHR words.", this, &RomCommands::HexdumpWords);
+    console->RegisterCommand("dtt", "Dump Town Text.", this, &RomCommands::DumpTownText);
+    console->RegisterCommand("wb", "Write bytes (via mapper).", this, &RomCommands::WriteBytes);
+    console->RegisterCommand("wbp", "Write PRG bytes.", this, &RomCommands::WriteBytes);
+    console->RegisterCommand("wbc", "Write CHR bytes.", this, &RomCommands::WriteBytes);
+    console->RegisterCommand("ww", "Write words (via mapper).", this, &RomCommands::WriteWords);
+    console->RegisterCommand("wwp", "Write PRG words.", this, &RomCommands::WriteWords);
+    console->RegisterCommand("wwc", "Write CHR words.", this, &RomCommands::WriteWords);
+    console->RegisterCommand("wt", "Write text bytes (via mapper).", this, &RomCommands::WriteText);
+    console->RegisterCommand("wtp", "Write PRG text bytes.", this, &RomCommands::WriteText);
+    console->RegisterCommand("wtc", "Write CHR text bytes.", this, &RomCommands::WriteText);
+    console->RegisterCommand("elist", "Dump Enemy List.", this, &RomCommands::EnemyList);
+    console->RegisterCommand("u", "Disassemble Code.", this, &RomCommands::Unassemble);
+    console->RegisterCommand("asm", "Assemble Code.", this, &RomCommands::Assemble);
+    console->RegisterCommand("insertprg", "Insert a PRG bank.", this, &RomCommands::InsertPrg);
+    console->RegisterCommand("copyprg", "Copy a PRG bank to another bank.", this, &RomCommands::CopyPrg);
+    console->RegisterCommand("insertchr", "Insert a CHR bank.", this, &RomCommands::InsertChr);
+    console->RegisterCommand("copychr", "Copy a CHR bank to another bank.", this, &RomCommands::CopyChr);
+    console->RegisterCommand("charclear", "Clear an individual char.", this, &RomCommands::CharClear);
+    console->RegisterCommand("charcopy", "Copy an individual char.", this, &RomCommands::CharCopy);
+    console->RegisterCommand("charswap", "Swap an individual char.", this, &RomCommands::CharCopy);
+    console->RegisterCommand("memmove", "Move memory within a PRG bank.", this, &RomCommands::MemMove);
+    console->RegisterCommand("swap", "Swap memory within a PRG bank.", this, &RomCommands::Swap);
+    console->RegisterCommand("bcopy", "Copy memory between PRG banks.", this, &RomCommands::BCopy);
+    console->RegisterCommand("set", "Set variables.", this, &RomCommands::SetVar);
+    console->RegisterCommand("source", "Read and execute debugconsole commands from file.", this, &RomCommands::Source);
+    console->RegisterCommand("restore", "Read/restore a PRG bank from a NES file.", this, &RomCommands::RestoreBank);
+    console->RegisterCommand("search", "Find the areas containing a tile, item or enemy.", this, &RomCommands::Search);
+    console->RegisterCommand("sideview", "Print or replace an area's sideview.", this, &RomCommands::EditSideview);
+    console->RegisterCommand("enemies", "Print or replace an area's enemy lists.", this, &RomCommands::EditEnemies);
+}
+
+void RomCommands::WriteMapper(Console* console, int argc, char **argv) {
+    rom_->mapper()->DebugWriteReg(console, argc, argv);
+}
+
+void RomCommands::PrintHeader(Console* console, int argc, char **argv) {
+    rom_->cartridge()->PrintHeader(console, argc, argv);
+}
+
+int RomCommands::EncodedText(int ch) {
+    if (text_encoding_ == 1) {
+        ch = TextEncoding::FromZelda2(ch);
+    } else {
+        ch = TextEncoding::Identity(ch);
+    }
+    return ch ? ch : '.';
+}
+
+void RomCommands::HexdumpBytes(Console* console, int argc, char **argv) {
+    // The hexdump command will be one of 'db', 'dbp' or 'dbc', standing
+    // for 'dump bytes', 'dump bytes prg' and 'dump bytes chr'.  The
+    // prg and chr versions can optionally take a bank number.
+    int bank = bank_;
+    int mode = argv[0][2];
+    int index = 0;
+    if (argc < 2) {
+        console->AddLog("[error] %s: Wrong number of arguments.", argv[0]);
+        if (mode) {
+            console->AddLog("[error] %s [b=<bank>] <addr> <length>", argv[0]);
+        } else {
+            console->AddLog("[error] %s <addr> <length>", argv[0]);
+        }
+        return;
+    }
+
+    if (mode && !strncmp(argv[1], "b=", 2)) {
+        bank = strtoul(argv[1]+2, 0, ibase_);
+        index++;
+    }
+    uint32_t addr = strtoul(argv[index+1], 0, ibase_);
+    int len = (argc == 3 + index) ? strtoul(argv[index+2], 0, ibase_) : 64;
+
+    char line[128], chr[17];
+    int i, n;
+    uint8_t val;
+
+    for(i=n=0; i < len; i++) {
+        if (mode == 'p') {
+            val = rom_->mapper()->ReadPrgBank(bank, addr+i);
+        } else if (mode == 'c') {
+            val = rom_->mapper()->ReadChrBank(bank, addr+i);
+        } else {
+            val = rom_->mapper()->Read(addr+i);
+        }
+        if (i % 16 == 0) {
+            if (i) {
+                n += sprintf(line+n, "  %s", chr);
+                console->AddLog("%s", line);
+            }
+            n = sprintf(line, "%04x: ", addr+i);
+            memset(chr, 0, sizeof(chr));
+        }
+        n += sprintf(line+n, " %02x", val);
+        chr[i%16] = EncodedText(val);
+    }
+    if (i % 16) {
+        i = 3*(16 - i%16);
+    } else {
+        i = 0;
+    }
+    n += sprintf(line+n, " %*c%s", i, ' ', chr);
+    console->AddLog("%s", line);
+}
+
+void RomCommands::WriteBytes(Console* console, int argc, char **argv) {
+    int bank = bank_;
+    int mode = argv[0][2];
+    int index = 0;
+    if (argc < 3) {
+        console->AddLog("[error] %s: Wrong number of arguments.", argv[0]);
+        if (mode) {
+            console->AddLog("[error] %s [b=<bank>] <addr> <val> ...", argv[0]);
+        } else {
+            console->AddLog("[error] %s <addr> <val> ...", argv[0]);
+        }
+        return;
+    }
+
+    if (mode && !strncmp(argv[1], "b=", 2)) {
+        bank = strtoul(argv[1]+2, 0, ibase_);
+        index++;
+    }
+    uint32_t addr = strtoul(argv[index+1], 0, ibase_);
+
+    for(int i=2+index; i<argc; i++) {
+        uint8_t val = strtoul(argv[i], 0, ibase_);
+        if (mode == 'p') {
+            rom_->mapper()->WritePrgBankLegit(bank, addr++, val);
+        } else if (mode == 'c') {
+            rom_->mapper()->WriteChrBank(bank, addr++, val);
+        } else {
+            rom_->mapper()->Write(addr++, val);
+        }
+    }
+}
+
+void RomCommands::WriteText(Console* console, int argc, char **argv) {
+    int bank = bank_;
+    int mode = argv[0][2];
+    int index = 0;
+    if (argc < 3) {
+        console->AddLog("[error] %s: Wrong number of arguments.", argv[0]);
+        if (mode) {
+            console->AddLog("[error] %s [b=<bank>] <addr> <val> ...", argv[0]);
+        } else {
+            console->AddLog("[error] %s <addr> <val> ...", argv[0]);
+        }
+        return;
+    }
+
+    if (mode && !strncmp(argv[1], "b=", 2)) {
+        bank = strtoul(argv[1]+2, 0, ibase_);
+        index++;
+    }
+    uint32_t addr = strtoul(argv[index+1], 0, ibase_);
+
+    for(int i=2+index; i<argc; i++) {
+        for(char *val = argv[i]; *val; val++) {
+            int ch = *val;
+            if (text_encoding_ == 1) {
+                ch = TextEncoding::ToZelda2(ch);
+                if (ch == 0) ch = 0xf4;
+            }
+            if (mode == 'p') {
+                rom_->mapper()->WritePrgBankLegit(bank, addr++, ch);
+            } else if (mode == 'c') {
+                rom_->mapper()->WriteChrBank(bank, addr++, ch);
+            } else {
+                rom_->mapper()->Write(addr++, ch);
+            }
+        }
+    }
+}
+
+void RomCommands::HexdumpWords(Console* console, int argc, char **argv) {
+    int bank = bank_;
+    int mode = argv[0][2];
+    int index = 0;
+    if (argc < 2) {
+        console->AddLog("[error] %s: Wrong number of arguments.", argv[0]);
+        if (mode) {
+            console->AddLog("[error] %s [b=<bank>] <addr> <length>", argv[0]);
+        } else {
+            console->AddLog("[error] %s <addr> <length>", argv[0]);
+        }
+        return;
+    }
+
+    if (mode && !strncmp(argv[1], "b=", 2)) {
+        bank = strtoul(argv[1]+2, 0, ibase_);
+        index++;
+    }
+    uint32_t addr = strtoul(argv[index+1], 0, ibase_);
+    int len = (argc == 3 + index) ? strtoul(argv[index+2], 0, ibase_) : 64;
+
+    char line[128], chr[17];
+    int i, n;
+    uint16_t val;
+
+    for(i=n=0; i < len; i+=2) {
+        if (i % 16 == 0) {
+            if (i) {
+                n += sprintf(line+n, "  %s", chr);
+                console->AddLog("%s", line);
+            }
+            n = sprintf(line, "%04x: ", addr+i);
+            memset(chr, 0, sizeof(chr));
+        }
+        if (mode == 'p') {
+            val = uint16_t(rom_->mapper()->ReadPrgBank(bank, addr+i+1)) << 8 |
+                  uint16_t(rom_->mapper()->ReadPrgBank(bank, addr+i));
+        } else if (mode == 'c') {
+            val = uint16_t(rom_->mapper()->ReadChrBank(bank, addr+i+1)) << 8 |
+                  uint16_t(rom_->mapper()->ReadChrBank(bank, addr+i));
+        } else {
+            val = uint16_t(rom_->mapper()->Read(addr+i+1)) << 8 |
+                  uint16_t(rom_->mapper()->Read(addr+i));
+        }
+        n += sprintf(line+n, " %04x", val);
+        chr[i%16] = EncodedText(uint8_t(val));
+        val >>= 8;
+        chr[i%16] = EncodedText(uint8_t(val));
+    }
+    if (i % 16) {
+        i = 3*(16 - i%16);
+    } else {
+        i = 0;
+    }
+    n += sprintf(line+n, " %*c%s", i, ' ', chr);
+    console->AddLog("%s", line);
+}
+
+void RomCommands::WriteWords(Console* console, int argc, char **argv) {
+    int bank = bank_;
+    int mode = argv[0][2];
+    int index = 0;
+    if (argc < 3) {
+        console->AddLog("[error] %s: Wrong number of arguments.", argv[0]);
+        if (mode) {
+            console->AddLog("[error] %s [b=<bank>] <addr> <val> ...", argv[0]);
+        } else {
+            console->AddLog("[error] %s <addr> <val> ...", argv[0]);
+        }
+        return;
+    }
+
+    if (mode && !strncmp(argv[1], "b=", 2)) {
+        bank = strtoul(argv[1]+2, 0, ibase_);
+        index++;
+    }
+    uint32_t addr = strtoul(argv[index+1], 0, ibase_);
+
+    for(int i=2+index; i<argc; i++) {
+        uint16_t val = strtoul(argv[i], 0, ibase_);
+        if (mode == 'p') {
+            rom_->mapper()->WritePrgBankLegit(bank, addr++, val);
+            rom_->mapper()->WritePrgBankLegit(bank, addr++, val>>8);
+        } else if (mode == 'c') {
+            rom_->mapper()->WriteChrBank(bank, addr++, val);
+            rom_->mapper()->WriteChrBank(bank, addr++, val>>8);
+        } else {
+            rom_->mapper()->Write(addr++, val);
+            rom_->mapper()->Write(addr++, val>>8);
+        }
+    }
+}
+
+void RomCommands::MemMove(Console* console, int argc, char **argv) {
+    int bank = -1;
+    if (argc < 5 || strncmp(argv[1], "b=", 2) != 0) {
+        console->AddLog("[error] %s: Wrong number of arguments.", argv[0]);
+        console->AddLog("[error] %s b=<bank> <dst> <src> <len>",  argv[0]);
+        return;
+    }
+
+    bank = strtoul(argv[1]+2, 0, ibase_);
+    int32_t dst = strtoul(argv[2], 0, ibase_);
+    int32_t src = strtoul(argv[3], 0, ibase_);
+    int32_t len = strtoul(argv[4], 0, ibase_);
+
+    if (dst < src) {
+        for(int i=0; i<len; i++, dst++, src++) {
+            rom_->mapper()->WritePrgBankLegit(bank, dst, rom_->mapper()->ReadPrgBank(bank, src));
+        }
+    } else if (dst > src) {
+        dst += len-1; src += len-1;
+        for(int i=0; i<len; i++, dst--, src--) {
+            rom_->mapper()->WritePrgBankLegit(bank, dst, rom_->mapper()->ReadPrgBank(bank, src));
+        }
+    } else {
+        console->AddLog("[error] dst and src are the same!");
+    }
+}
+
+void RomCommands::Swap(Console* console, int argc, char **argv) {
+    int bank = -1;
+    if (argc < 5 || strncmp(argv[1], "b=", 2) != 0) {
+        console->AddLog("[error] %s: Wrong number of arguments.", argv[0]);
+        console->AddLog("[error] %s b=<bank> <dst> <src> <len>",  argv[0]);
+        return;
+    }
+
+    bank = strtoul(argv[1]+2, 0, ibase_);
+    int32_t dst = strtoul(argv[2], 0, ibase_);
+    int32_t src = strtoul(argv[3], 0, ibase_);
+    int32_t len = strtoul(argv[4], 0, ibase_);
+
+    for(int i=0; i<len; i++, dst++, src++) {
+        uint8_t a = rom_->mapper()->ReadPrgBank(bank, src);
+        uint8_t b = rom_->mapper()->ReadPrgBank(bank, dst);
+        rom_->mapper()->WritePrgBankLegit(bank, dst, a);
+        rom_->mapper()->WritePrgBankLegit(bank, src, b);
+    }
+}
+
+void RomCommands::BCopy(Console* console, int argc, char **argv) {
+    if (argc < 4) {
+        console->AddLog("[error] %s: Wrong number of arguments.", argv[0]);
+        console->AddLog("[error] %s  <bank:dst> <bank:src> <len>",  argv[0]);
+        return;
+    }
+
+    int32_t srcb, srca, dstb, dsta, len;
+    char *endp;
+
+    dstb = strtoul(argv[1], &endp, ibase_);
+    if (*endp != ':') {
+        console->AddLog("[error] bad dst argument.  Expected bank:address.");
+        return;
+    }
+    dsta = strtoul(endp+1, 0, ibase_);
+
+    srcb = strtoul(argv[2], &endp, ibase_);
+    if (*endp != ':') {
+        console->AddLog("[error] bad src argument.  Expected bank:address.");
+        return;
+    }
+    srca = strtoul(endp+1, 0, ibase_);
+
+    len = strtoul(argv[3], 0, ibase_);
+
+    for(int i=0; i<len; i++, dsta++, srca++) {
+        rom_->mapper()->WritePrgBankLegit(dstb, dsta, rom_->mapper()->ReadPrgBank(srcb, srca));
+    }
+}
+
+void RomCommands::EnemyList(Console* console, int argc, char **argv) {
+    char buf[1024];
+    int bank = bank_;
+    int mode = argv[0][2];
+    int index = 0;
+    if (argc < 3) {
+        console->AddLog("[error] %s: Wrong number of arguments.", argv[0]);
+        if (mode) {
+            console->AddLog("[error] %s [b=<bank>] <addr> <val> ...", argv[0]);
+        } else {
+            console->AddLog("[error] %s <addr> <val> ...", argv[0]);
+        }
+        return;
+    }
+
+    if (mode && !strncmp(argv[1], "b=", 2)) {
+        bank = strtoul(argv[1]+2, 0, ibase_);
+        index++;
+    }
+    uint32_t addr = strtoul(argv[index+1], 0, ibase_);
+    int len = (argc == 3 + index) ? strtoul(argv[index+2], 0, ibase_) : 64;
+
+    while(len > 0) {
+        int listlen = rom_->mapper()->ReadPrgBank(bank, addr);
+        buf[0] = buf[1] = 0;
+        console->AddLog("%04x: %02x (copied to %04x)", addr, listlen, addr-0x18a0);
+
+        addr++; len--;
+        int j=0;
+        for(int i=1; i<listlen && len; i++, len--) {
+            j += sprintf(buf+j, " %02x", rom_->mapper()->ReadPrgBank(bank, addr++));
+        }
+        console->AddLog("    [%s]", buf+1);
+    }
+}
+
+void RomCommands::Unassemble(Console* console, int argc, char **argv) {
+    int bank = bank_;
+    uint16_t& addr = unassemble_addr_;
+
+    int index = 0;
+    if (argc < 2) {
+        console->AddLog("[error] %s: Wrong number of arguments.", argv[0]);
+        console->AddLog("[error] %s [b=<bank>] <addr> <length>", argv[0]);
+        return;
+    }
+
+    if (!strncmp(argv[1], "b=", 2)) {
+        bank = strtoul(argv[1]+2, 0, ibase_);
+        index++;
+    }
+    addr = strtoul(argv[index+1], 0, ibase_);
+    int len = (argc == 3 + index) ? strtoul(argv[index+2], 0, ibase_) : 10;
+
+    Cpu cpu(rom_->mapper());
+    cpu.set_bank(bank);
+    for(int i=0; i<len; i++) {
+        std::string instruction = cpu.Disassemble(&addr);
+        console->AddLog("%s", instruction.c_str());
+    }
+}
+
+void RomCommands::Assemble(Console* console, int argc, char **argv) {
+    int bank = bank_;
+    uint16_t addr;
+
+    int index = 0;
+    if (argc < 2) {
+        console->AddLog("[error] %s: Wrong number of arguments.", argv[0]);
+        console->AddLog("[error] %s [b=<bank>] <addr>", argv[0]);
+        return;
+    }
+
+    if (!strncmp(argv[1], "b=", 2)) {
+        bank = strtoul(argv[1]+2, 0, ibase_);
+        index++;
+    }
+    addr = (index+1 < argc) ? strtoul(argv[index+1], 0, ibase_) : 0;
+
+    struct State {
+        uint16_t addr;
+        Cpu cpu;
+    };
+
+    State* state = new State{addr, rom_->mapper()};
+    state->cpu.set_bank(bank);
+    console->AddLog("#{88f}Entering assembler mode (bank=%d).  '.end' to leave.", bank);
+    console->PushLineCallback([state](Console* console, const char *cmdline) {
+        const char *errors[] = {
+            "None", "End", "Meta", "Invalid Opcode", "Invalid Operand",
+            "Invalid Addressing Mode",
+        };
+        std::string line(cmdline);
+        if (line == "quit") {
+            console->AddLog("#{88f}No 'quit' in assembler mode. Did you mean '.end'?");
+            return;
+        }
+        if (line == "help" || line == ".help") {
+            for(const auto& h : Cpu::asmhelp()) {
+                console->AddLog("%s", h.c_str());
+            }
+            return;
+        }
+        uint16_t prev = state->addr;
+        auto err = state->cpu.Assemble(line, &state->addr);
+        if (err == Cpu::AsmError::None) {
+            const char *comment = strchr(cmdline, ';');
+            if (prev != state->addr) {
+                std::string instruction = state->cpu.Disassemble(&prev);
+                console->AddLog("#{8f8}%-40s %s",
+                    instruction.c_str(), comment ? comment : "");
+            } else if (comment) {
+                console->AddLog("#{8f8}%s", comment);
+            }
+        } else if (err == Cpu::AsmError::Meta) {
+            console->AddLog("#{88f}%04x: %s", prev, cmdline);
+            if (prev != state->addr) {
+                console->AddLog("#{88f}%04x:", state->addr);
+            }
+        } else if (err == Cpu::AsmError::End) {
+            const auto& errors = state->cpu.ApplyFixups();
+            for(const auto& e : errors) {
+                console->AddLog("#{f88}%s", e.c_str());
+            }
+            console->AddLog("#{88f}Leaving assembler mode");
+            delete state;
+            console->PopLineCallback();
+            return;
+        } else {
+            console->AddLog("#{f88}%s: '%s'", errors[int(err)], cmdline);
+        }
+    });
+}
+
+void RomCommands::InsertPrg(Console* console, int argc, char **argv) {
+    int bank = bank_;
+    if (argc < 2) {
+        console->AddLog("[error] %s: Wrong number of arguments.", argv[0]);
+        console->AddLog("[error] %s <bank>", argv[0]);
+        return;
+    }
+
+    bank = strtoul(argv[1], 0, ibase_);
+    rom_->cartridge()->InsertPrg(bank, nullptr);
+    console->AddLog("#{0f0}Added PRG bank %d", bank);
+}
+
+void RomCommands::CopyPrg(Console* console, int argc, char **argv) {
+    uint8_t src, dst;
+    if (argc < 3) {
+        console->AddLog("[error] %s: Wrong number of arguments.", argv[0]);
+        console->AddLog("[error] %s <src> <dst>", argv[0]);
+        return;
+    }
+
+    src = strtoul(argv[1], 0, ibase_);
+    dst = strtoul(argv[2], 0, ibase_);
+    for(int i=0; i<16384; i++) {
+        rom_->mapper()->WritePrgBankLegit(dst, i, rom_->mapper()->ReadPrgBank(src, i));
+    }
+    console->AddLog("#{0f0}Copied PRG bank %d to %d", src, dst);
+}
+
+void RomCommands::InsertChr(Console* console, int argc, char **argv) {
+    int bank = bank_;
+    if (argc < 2) {
+        console->AddLog("[error] %s: Wrong number of arguments.", argv[0]);
+        console->AddLog("[error] %s <bank>", argv[0]);
+        return;
+    }
+
+    bank = strtoul(argv[1], 0, ibase_);
+    rom_->cartridge()->InsertChr(bank, nullptr);
+    console->AddLog("#{0f0}Added CHR bank %d", bank);
+}
+
+void RomCommands::CopyChr(Console* console, int argc, char **argv) {
+    uint8_t src, dst;
+    if (argc < 3) {
+        console->AddLog("[error] %s: Wrong number of arguments.", argv[0]);
+        console->AddLog("[error] %s <src> <dst>", argv[0]);
+        return;
+    }
+
+    src = strtoul(argv[1], 0, ibase_);
+    dst = strtoul(argv[2], 0, ibase_);
+    for(int i=0; i<4096; i++) {
+        rom_->mapper()->WriteChrBank(dst, i, rom_->mapper()->ReadChrBank(src, i));
+    }
+    console->AddLog("#{0f0}Copied CHR bank %d to %d", src, dst);
+}
+
+bool RomCommands::ParseChr(const std::string& a, int* bank, uint8_t* addr) {
+    *bank = chrbank_;
+    const char* s = a.c_str();
+    const char* t = strchr(s, ':');
+    if (t) {
+        *bank = strtoul(s, 0, ibase_);
+        s = t+1;
+    }
+    *addr = strtoul(s, 0, ibase_);
+    return true;
+}
+
+void RomCommands::CharClear(Console* console, int argc, char **argv) {
+    int bank = chrbank_;
+    uint8_t chr;
+    bool with_id = false;
+    if (argc < 2) {
+        console->AddLog("[error] Usage: %s [char{,char,char...}] [with_id]", argv[0]);
+        return;
+    }
+    if (!strcmp(argv[2], "true")) {
+        with_id = true;
+    }
+    ChrUtil util(rom_->mapper());
+    for(const auto& s : absl::StrSplit(argv[1], ',')) {
+        ParseChr(std::string(s), &bank, &chr);
+        util.Clear(bank, chr, with_id);
+    }
+}
+
+void RomCommands::CharCopy(Console* console, int argc, char **argv) {
+    int sbank, dbank;
+    uint8_t src, dst;
+    if (argc < 3) {
+        console->AddLog("[error] Usage: %s [dstchar] [srcchar]", argv[0]);
+        return;
+    }
+    ParseChr(argv[1], &dbank, &dst);
+    ParseChr(argv[2], &sbank, &src);
+    ChrUtil util(rom_->mapper());
+    if (!strcmp(argv[0], "charcopy")) {
+        util.Copy(dbank, dst, sbank, src);
+    } else if (!strcmp(argv[0], "charswap")) {
+        util.Swap(dbank, dst, sbank, src);
+    } else {
+        console->AddLog("[error] Usage: %s [dstchar] [srcchar]", argv[0]);
+    }
+}
+
+void RomCommands::SetVar(Console* console, int argc, char **argv) {
+    if (argc < 3) {
+        console->AddLog("[error] Usage: %s [var] [number]", argv[0]);
+        console->AddLog("Current 'ibase': %d "
+                        "(zero means autodetect with C prefixes)", ibase_);
+        console->AddLog("Current 'bank': %d", bank_);
+        console->AddLog("Current 'text' encoding: %d", text_encoding_);
+        for(const auto& v : vars_) {
+            console->AddLog("Current '%s': %s", v.first.c_str(),
+                            v.second->c_str());
+        }
+        return;
+    }
+    for(int i=1; i<argc; i++) {
+        if (!strcmp(argv[i], "ibase")) {
+            ibase_ = strtoul(argv[++i], 0, 0);
+        } else if (!strcmp(argv[i], "bank")) {
+            bank_ = strtoul(argv[++i], 0, ibase_);
+        } else if (!strcmp(argv[i], "chrbank")) {
+            chrbank_ = strtoul(argv[++i], 0, ibase_);
+        } else if (!strcmp(argv[i], "text")) {
+            text_encoding_ = strtoul(argv[++i], 0, ibase_);
+        } else if (vars_.find(argv[i]) != vars_.end()) {
+            std::string* var = vars_[argv[i]];
+            *var = argv[++i];
+        } else if (!strcmp(argv[i], "mapper")) {
+            uint8_t m = strtoul(argv[++i], 0, 0);
+            rom_->cartridge()->set_mapper(m);
+        } else {
+            console->AddLog("[error] Unknown var '%s'", argv[1]);
+        }
+    }
+}
+
+void RomCommands::Source(Console* console, int argc, char **argv) {
+    if (argc != 2) {
+        console->AddLog("[error] Usage: %s [file]", argv[0]);
+        return;
+    }
+    if (!console->Source(argv[1])) {
+        console->AddLog("[error] Couldn't read %s", argv[1]);
+    }
+}
+
+void RomCommands::RestoreBank(Console* console, int argc, char **argv) {
+    int move = -1;
+    if (argc < 4) {
+        console->AddLog("[error] %s: Wrong number of arguments.", argv[0]);
+        console->AddLog("[error] %s <nesfile> <frombank> <tobank> [move=<0,1>]",  argv[0]);
+        return;
+    }
+
+    const char *nesfile = argv[1];
+    uint32_t from = strtoul(argv[2], 0, ibase_);
+    uint32_t to = strtoul(argv[3], 0, ibase_);
+    if (argc == 5) {
+        if (!strcmp(argv[4], "move=0")) move = 0;
+        if (!strcmp(argv[4], "move=1")) move = 1;
+    }
+
+    Cartridge kart;
+    if (!kart.IsNESFile(nesfile)) {
+        console->AddLog("[error] %s is not a NES file", nesfile);
+        return;
+    }
+    kart.LoadFile(nesfile);
+    if (from >= kart.prglen()) {
+        console->AddLog("[error] %s only has %u banks", nesfile, kart.prglen());
+        return;
+    }
+    if (to >= rom_->cartridge()->prglen()) {
+        console->AddLog("[error] Current image only has %u banks",
+                        rom_->cartridge()->prglen());
+        return;
+    }
+    for(int i=0; i<16384; i++) {
+        uint8_t data = kart.ReadPrg(from*16384 + i);
+        rom_->mapper()->WritePrgBankLegit(to, i, data);
+    }
+    if (reload_cb_) {
+        reload_cb_(move);
+    }
+}
+
+void RomCommands::DumpTownText(Console* console, int argc, char **argv) {
+    if (argc != 3) {
+        console->AddLog("[error] Usage: %s [towncode] [enemyid]", argv[0]);
+        return;
+    }
+    uint8_t towncode = strtoul(argv[1], 0, ibase_);
+    uint8_t enemyid = strtoul(argv[2], 0, ibase_);
+
+    if (enemyid < 10) {
+        console->AddLog("[error] Enemy IDs less than 10 do not have text");
+        return;
+    }
+    const auto& text_table = ConfigLoader<RomInfo>::GetConfig().text_table();
+    enemyid -= 10;
+
+    char text[256];
+    uint8_t world = towncode >> 2;
+    uint8_t index = enemyid * 4 + (towncode & 3);
+    Address ptable = rom_->mapper()->ReadAddr(text_table.pointer(), world * 2);
+    int len = (index < 64) ? 2 : 1;
+
+    for(int i=0; i<len; i++) {
+        const auto& region = text_table.index(world * 2 + i);
+        if (index >= region.length())
+            continue;
+
+        int offset = rom_->mapper()->Read(region, index);
+        Address str = rom_->mapper()->ReadAddr(ptable, offset * 2);
+
+        for(int j=0, ch=0; j<254; j++) {
+            ch = rom_->mapper()->Read(str, j);
+            if (ch == 255) {
+                text[j] = 0;
+                break;
+            }
+            ch = TextEncoding::FromZelda2(ch);
+            if (ch == 0) ch = '_';
+            text[j] = ch;
+        }
+        console->AddLog("%d (@%04x): %s", i, str.address(), text);
+    }
+}
+
+void RomCommands::Search(Console* console, int argc, char **argv) {
+    AreaIndex::Kind kind;
+    if (argc == 2 && !strcmp(argv[1], "rebuild") && area_index_) {
+        area_index_->Rebuild(rom_);
+        area_index_->Wait();
+        return;
+    }
+    if (argc != 3 || !AreaIndex::ParseKind(argv[1], &kind)) {
+        console->AddLog("[error] Usage: %s <tile|item|enemy> <id>", argv[0]);
+        console->AddLog("[error]        %s rebuild", argv[0]);
+        return;
+    }
+    int id = strtoul(argv[2], 0, ibase_);
+
+    AreaIndex* index = area_index_;
+    if (!index) {
+        if (!own_index_) own_index_.reset(new AreaIndex);
+        index = own_index_.get();
+        index->Build(rom_);
+    } else if (!index->valid()) {
+        index->Rebuild(rom_);
+    }
+    index->Wait();
+
+    const auto& ri = ConfigLoader<RomInfo>::GetConfig();
+    auto result = index->Find(kind, id);
+    int total = 0;
+    for(const auto& r : result) {
+        char buf[80] = "";
+        int j = 0;
+        size_t n = 0;
+        for(; n < r.points.size() && j < 60; n++) {
+            j += snprintf(buf+j, sizeof(buf)-j, " (%d,%d)",
+                          r.points[n].x, r.points[n].y);
+        }
+        console->AddLog("%s:%s%s", ri.map(r.area).name().c_str(), buf,
+                        n < r.points.size() ? " ..." : "");
+        total += r.points.size();
+    }
+    console->AddLog("%s %02x: %d locations in %d areas",
+                    AreaIndex::KindName(kind), id, total, int(result.size()));
+}
+
+// Parses "<cmd> <map name> [<byte> ...]" for the sideview and enemies
+// commands.  The map name may be quoted if it contains spaces.
+bool RomCommands::ParseMapBytes(Console* console, int argc, char **argv,
+                                const Map** map,
+                                std::vector<uint8_t>* bytes) {
+    if (argc < 2) {
+        console->AddLog("[error] Usage: %s <map name> [<byte> ...]", argv[0]);
+        return false;
+    }
+    *map = nullptr;
+    for(const auto& m : ConfigLoader<RomInfo>::GetConfig().map()) {
+        if (m.name() == argv[1]) {
+            *map = &m;
+            break;
+        }
+    }
+    if (*map == nullptr || (*map)->type() == MapType::OVERWORLD) {
+        console->AddLog("[error] %s: no sideview area named '%s'",
+                        argv[0], argv[1]);
+        return false;
+    }
+    bytes->clear();
+    for(int i=2; i<argc; i++) {
+        bytes->push_back(strtoul(argv[i], 0, ibase_));
+    }
+    return true;
+}
+
+void RomCommands::EditSideview(Console* console, int argc, char **argv) {
+    const Map* map;
+    std::vector<uint8_t> bytes;
+    if (!ParseMapBytes(console, argc, argv, &map, &bytes)) {
+        return;
+    }
+    Sideview sideview(rom_);
+    sideview.Parse(*map);
+    if (!bytes.empty()) {
+        // The first byte is the length; the caller needn't get it right.
+        if (bytes.size() < 4) {
+            console->AddLog("[error] %s: a sideview has at least 4 bytes",
+                            argv[0]);
+            return;
+        }
+        bytes[0] = bytes.size();
+        sideview.Parse(bytes);
+        // Shared data is copied rather than changed under the other maps.
+        auto status = sideview.Save(false);
+        if (!status.ok()) {
+            console->AddLog("[error] %s: %s", argv[0],
+                            status.error_message().c_str());
+            return;
+        }
+        if (area_index_) {
+            area_index_->Update(rom_, sideview.map());
+        }
+    }
+
+    console->AddLog("%s: bank=%d address=%04x length=%d flags=%02x "
+                    "ground=%02x back=%02x", map->name().c_str(),
+                    sideview.bank(), sideview.address(), sideview.length(),
+                    sideview.flags(), sideview.ground(), sideview.back());
+    for(const auto* m : sideview.SharedWith()) {
+        console->AddLog("    shared with %s", m->name().c_str());
+    }
+    for(const auto& cmd : sideview.command()) {
+        if (cmd.absy() < 13 && cmd.object() == 15) {
+            console->AddLog("    x=%-2d y=%-2d %02x %02x  %s", cmd.absx(),
+                            cmd.absy(), cmd.object(), cmd.extra(),
+                            sideview.ObjectName(cmd));
+        } else {
+            console->AddLog("    x=%-2d y=%-2d %02x     %s", cmd.absx(),
+                            cmd.absy(), cmd.object(),
+                            sideview.ObjectName(cmd));
+        }
+    }
+}
+
+void RomCommands::EditEnemies(Console* console, int argc, char **argv) {
+    const Map* map;
+    std::vector<uint8_t> bytes;
+    if (!ParseMapBytes(console, argc, argv, &map, &bytes)) {
+        return;
+    }
+    SideviewEnemies enemies(rom_);
+    enemies.Parse(*map);
+    if (!bytes.empty()) {
+        // Encounter areas take both lists, each with its own length byte.
+        enemies.Parse(bytes);
+        if (!enemies.Save()) {
+            console->AddLog("[error] %s: the enemy lists in bank %d "
+                            "don't fit", argv[0], map->pointer().bank());
+            return;
+        }
+        if (area_index_) {
+            area_index_->Update(rom_, *map);
+        }
+    }
+
+    TextListPack text(rom_);
+    if (map->type() == MapType::TOWN) {
+        text.Unpack(map->pointer().bank());
+    }
+    SideviewEnemies* lists[] = { &enemies, enemies.large() };
+    for(auto* list : lists) {
+        if (list == nullptr)
+            continue;
+        console->AddLog("%s%s:", map->name().c_str(),
+                        list == &enemies ? "" : " (large encounter)");
+        for(const auto& e : list->data()) {
+            console->AddLog("    x=%-2d y=%-2d enemy=%02x", e.x, e.y,
+                            e.enemy);
+            for(int j=0; j<3; j++) {
+                std::string val;
+                if (e.text[j] >= 0 &&
+                    text.Get(map->code() >> 2, e.text[j], &val)) {
+                    console->AddLog("        text %d: %s", e.text[j],
+                                    val.c_str());
+                }
+            }
+        }
+    }
+}
+
+}  // namespace z2util
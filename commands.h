@@ -0,0 +1,84 @@
+#ifndef Z2UTIL_COMMANDS_H
+#define Z2UTIL_COMMANDS_H
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "nes/area_index.h"
+#include "nes/rom_context.h"
+#include "proto/rominfo.pb.h"
+#include "util/console.h"
+
+namespace z2util {
+
+// The ROM editing console commands (hexdump, write, copy, assemble, etc).
+// These only need a RomContext, so they are shared by the editor and the
+// headless batch tool.
+class RomCommands {
+  public:
+    explicit RomCommands(RomContext* rom);
+
+    void Register(Console* console);
+    // The index used by 'search'.  Without one, 'search' indexes the ROM
+    // itself each time it's used.
+    inline void set_area_index(AreaIndex* index) { area_index_ = index; }
+    // Called after 'restore' replaces a PRG bank.  The argument has the
+    // same meaning as Z2Edit::LoadPostProcess's movekeepout argument.
+    inline void set_reload_cb(std::function<void(int)> cb) {
+        reload_cb_ = cb;
+    }
+    // Make a string variable settable via the 'set' command.
+    inline void AddVar(const char* name, std::string* var) {
+        vars_[name] = var;
+    }
+    inline int ibase() const { return ibase_; }
+
+  private:
+    void HexdumpBytes(Console* console, int argc, char **argv);
+    void WriteBytes(Console* console, int argc, char **argv);
+    void WriteText(Console* console, int argc, char **argv);
+    void WriteMapper(Console* console, int argc, char **argv);
+    void PrintHeader(Console* console, int argc, char **argv);
+    void HexdumpWords(Console* console, int argc, char **argv);
+    void WriteWords(Console* console, int argc, char **argv);
+    void Unassemble(Console* console, int argc, char **argv);
+    void Assemble(Console* console, int argc, char **argv);
+    void EnemyList(Console* console, int argc, char **argv);
+    void InsertPrg(Console* console, int argc, char **argv);
+    void CopyPrg(Console* console, int argc, char **argv);
+    void InsertChr(Console* console, int argc, char **argv);
+    void CopyChr(Console* console, int argc, char **argv);
+    void CharClear(Console* console, int argc, char **argv);
+    void CharCopy(Console* console, int argc, char **argv);
+    void MemMove(Console* console, int argc, char **argv);
+    void Swap(Console* console, int argc, char **argv);
+    void BCopy(Console* console, int argc, char **argv);
+    void SetVar(Console* console, int argc, char **argv);
+    void Source(Console* console, int argc, char **argv);
+    void RestoreBank(Console* console, int argc, char **argv);
+    void DumpTownText(Console* console, int argc, char **argv);
+    void Search(Console* console, int argc, char **argv);
+    void EditSideview(Console* console, int argc, char **argv);
+    void EditEnemies(Console* console, int argc, char **argv);
+    bool ParseMapBytes(Console* console, int argc, char **argv,
+                       const Map** map, std::vector<uint8_t>* bytes);
+    int EncodedText(int ch);
+    bool ParseChr(const std::string& a, int* bank, uint8_t *addr);
+
+    RomContext* rom_;
+    int ibase_;
+    int bank_;
+    int chrbank_;
+    int text_encoding_;
+    uint16_t unassemble_addr_;
+    std::map<std::string, std::string*> vars_;
+    std::function<void(int)> reload_cb_;
+    AreaIndex* area_index_;
+    std::unique_ptr<AreaIndex> own_index_;
+};
+
+}  // namespace z2util
+#endif // Z2UTIL_COMMANDS_H
@@ -0,0 +1,121 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+#include <gflags/gflags.h>
+
+#include "nes/chr_util.h"
+
+DEFINE_int32(banks, 64, "Number of random 256-tile banks to check.");
+DEFINE_int32(iterations, 2000, "Timing iterations per decoder.");
+DEFINE_int32(seed, 1, "Random seed.");
+
+using z2util::ChrUtil;
+
+// The per-pixel loop that Z2ObjectCache::BlitTile and
+// NesChrView::RenderChr used before ChrUtil::DecodeTiles existed.
+static void DecodeBitByBit(const uint8_t* chr, int ntiles, uint8_t* pixels) {
+    for(int tile=0; tile<ntiles; tile++) {
+        for(int row=0; row<8; row++) {
+            uint8_t a = chr[16*tile + row];
+            uint8_t b = chr[16*tile + row + 8];
+            for(int col=0; col<8; col++, a<<=1, b<<=1) {
+                uint8_t color = (a & 0x80) >> 7 | (b & 0x80) >> 6;
+                pixels[64*tile + 8*row + col] = color;
+            }
+        }
+    }
+}
+
+typedef void (*Decoder)(const uint8_t*, int, uint8_t*);
+
+static int Compare(const char* name, Decoder decode,
+                   const std::vector<uint8_t>& chr,
+                   const std::vector<uint8_t>& expect) {
+    int ntiles = chr.size() / 16;
+    std::vector<uint8_t> got(ntiles * 64);
+    decode(chr.data(), ntiles, got.data());
+    for(size_t i=0; i<got.size(); i++) {
+        if (got[i] != expect[i]) {
+            printf("%s: mismatch at tile %zu pixel %zu: got %d want %d\n",
+                   name, i / 64, i % 64, got[i], expect[i]);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static double Time(Decoder decode, const std::vector<uint8_t>& chr) {
+    int ntiles = chr.size() / 16;
+    std::vector<uint8_t> out(ntiles * 64);
+    auto start = std::chrono::steady_clock::now();
+    for(int i=0; i<FLAGS_iterations; i++) {
+        decode(chr.data(), ntiles, out.data());
+        // Keep the compiler from dropping the loop.
+        asm volatile("" : : "r"(out.data()) : "memory");
+    }
+    std::chrono::duration<double, std::micro> d =
+        std::chrono::steady_clock::now() - start;
+    return d.count() / FLAGS_iterations;
+}
+
+int main(int argc, char *argv[]) {
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+    // Every combination of plane bytes, one pair per tile row, followed by
+    // some random banks.
+    std::vector<uint8_t> chr;
+    for(int a=0; a<256; a++) {
+        for(int b=0; b<256; b+=8) {
+            uint8_t tile[16];
+            for(int row=0; row<8; row++) {
+                tile[row] = a;
+                tile[row + 8] = b + row;
+            }
+            chr.insert(chr.end(), tile, tile + 16);
+        }
+    }
+    std::mt19937 rng(FLAGS_seed);
+    for(int i=0; i<FLAGS_banks * 256 * 16; i++) {
+        chr.push_back(rng());
+    }
+
+    std::vector<uint8_t> expect(chr.size() * 4);
+    DecodeBitByBit(chr.data(), chr.size() / 16, expect.data());
+
+    int errors = 0;
+    errors += Compare("DecodeTiles", ChrUtil::DecodeTiles, chr, expect);
+    errors += Compare("DecodeTilesScalar", ChrUtil::DecodeTilesScalar,
+                      chr, expect);
+
+    // The palette variant goes through the batching wrapper; use odd tile
+    // counts so the partial batch is exercised.
+    const uint32_t palette[4] = { 0xFF000000, 0xFF666666,
+                                  0xFFAAAAAA, 0xFFFFFFFF };
+    for(int ntiles : {1, 15, 16, 17, 255}) {
+        std::vector<uint32_t> rgba(ntiles * 64);
+        ChrUtil::DecodeTiles(chr.data(), ntiles, palette, rgba.data());
+        for(int i=0; i<ntiles*64; i++) {
+            if (rgba[i] != palette[expect[i]]) {
+                printf("DecodeTiles(palette): mismatch with %d tiles at "
+                       "pixel %d\n", ntiles, i);
+                errors++;
+                break;
+            }
+        }
+    }
+
+    printf("%zu tiles checked: %s\n", chr.size() / 16,
+           errors ? "FAILED" : "ok");
+
+    // Time one 256-tile bank, the size NesChrView decodes per frame.
+    std::vector<uint8_t> bank(chr.end() - 256*16, chr.end());
+    printf("bit-by-bit        %8.2f us/bank\n", Time(DecodeBitByBit, bank));
+    printf("DecodeTilesScalar %8.2f us/bank\n",
+           Time(ChrUtil::DecodeTilesScalar, bank));
+    printf("DecodeTiles       %8.2f us/bank\n",
+           Time(ChrUtil::DecodeTiles, bank));
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,242 @@
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+#include <gflags/gflags.h>
+
+#include "nes/mapper.h"
+#include "nes/rom_context.h"
+#include "nes/z2decompress.h"
+#include "postprocess.h"
+#include "proto/rominfo.pb.h"
+#include "util/config.h"
+#include "util/logging.h"
+#include "zelda2_config.h"
+
+DEFINE_string(config, "", "ROM info config file (default: built-in)");
+DEFINE_int32(seed, 1, "Seed for the synthetic ROM contents.");
+DEFINE_int32(iterations, 200, "Timed passes over every sideview area.");
+DEFINE_bool(fresh, false, "Use a new decompressor for every area in the "
+            "timed passes, as the AreaRenderer does.");
+DEFINE_bool(area_hashes, false, "Print the running hash after each area.");
+DEFINE_string(dump, "", "Print the decompressed map of the named area.");
+DECLARE_int32(loglevel);
+
+namespace z2util {
+
+// Fills a ROM with random bytes, then writes a random but config-valid
+// sideview into every area the config knows about, so every decompressor
+// handler gets exercised.  The ROM contents depend only on the seed,
+// which makes the output hashes comparable between builds.
+class SyntheticRom {
+  public:
+    explicit SyntheticRom(uint32_t seed) : seed_(seed) {}
+    bool Build(RomContext* rom);
+
+  private:
+    int Random() {
+        seed_ = seed_ * 1103515245 + 12345;
+        return (seed_ >> 16) & 0xFF;
+    }
+    static int SideviewBank(const Map& map) {
+        // The palaces share the bank the game copies them to.
+        if (map.type() == MapType::PALACE ||
+            map.type() == MapType::GREAT_PALACE)
+            return 0x1c;
+        return map.pointer().bank();
+    }
+    int WriteSideview(int bank, int addr, int area, bool background);
+
+    uint32_t seed_;
+    Mapper* mapper_;
+    // Valid object ids by area and object set.
+    std::vector<int> valid_[Z2Decompress::NR_AREAS][Z2Decompress::NR_SETS];
+};
+
+bool SyntheticRom::Build(RomContext* rom) {
+    std::string data("NES\x1a", 4);
+    data.push_back(16);
+    data.push_back(16);
+    data.push_back(0x10);
+    data.resize(16);
+    for(int i=0; i<16*16384 + 16*8192; i++) {
+        data.push_back(Random());
+    }
+    if (!rom->LoadRom(data, false))
+        return false;
+    mapper_ = rom->mapper();
+
+    const auto& ri = ConfigLoader<RomInfo>::GetConfig();
+    for(const auto& d : ri.decompress()) {
+        valid_[d.area()][d.type()].push_back(d.id());
+    }
+
+    std::map<int, int> next;
+    std::map<int, int> bankarea;
+    for(const auto& m : ri.map()) {
+        if (m.type() == MapType::OVERWORLD || !m.pointer().address())
+            continue;
+        int bank = SideviewBank(m);
+        if (!next.count(bank))
+            next[bank] = 0xB000;
+        bankarea[bank] = m.type();
+        int addr = next[bank];
+        next[bank] += WriteSideview(bank, addr, m.type(), false);
+        mapper_->WritePrgBankLegit(m.pointer().bank(),
+                                   m.pointer().address(), addr & 0xFF);
+        mapper_->WritePrgBankLegit(m.pointer().bank(),
+                                   m.pointer().address() + 1, addr >> 8);
+    }
+    // The background maps: point all seven background slots of each bank
+    // at one extra sideview.
+    for(const auto& b : bankarea) {
+        WriteSideview(b.first, 0xBF80, b.second, true);
+        for(int k=0; k<7; k++) {
+            mapper_->WritePrgBankLegit(b.first, 2*k, 0x80);
+            mapper_->WritePrgBankLegit(b.first, 2*k + 1, 0xBF);
+        }
+    }
+    return true;
+}
+
+int SyntheticRom::WriteSideview(int bank, int addr, int area,
+                                bool background) {
+    std::vector<uint8_t> b(4);
+    b[1] = Random();
+    b[2] = Random();
+    b[3] = Random();
+    if (background || Random() < 160)
+        b[3] &= ~7;
+    int objset = !!(b[1] & 0x80);
+    int n = 4 + Random() % 24;
+    for(int i=0; i<n; i++) {
+        int y = Random() % 16;
+        int xs = Random() % 4;
+        int obj = Random();
+        if (y < 13 && obj != 15) {
+            int set = (obj & 1) ? objset + 1 : 0;
+            const auto& v = valid_[area][set];
+            if (!v.empty()) {
+                int id = v[Random() % v.size()];
+                obj = set ? ((id & 0xF0) | (Random() & 15)) : id;
+            }
+        } else if (y == 15) {
+            int set = (obj & 1) ? 4 : 3;
+            const auto& v = valid_[area][set];
+            if (!v.empty()) {
+                int id = v[Random() % v.size()];
+                obj = set == 4 ? ((id & 0xF0) | (Random() & 15)) : id;
+            }
+        }
+        b.push_back(y << 4 | xs);
+        b.push_back(obj);
+        if (y < 13 && obj == 15)
+            b.push_back(Random());
+    }
+    b[0] = b.size();
+    mapper_->WritePrgBytesLegit(bank, addr, b.data(), b.size());
+    return b.size();
+}
+
+// FNV-1a over everything a caller can observe about a decompressed map.
+uint64_t Hash(uint64_t h, const Z2Decompress& d) {
+    auto mix = [&h](uint64_t v) { h = (h ^ v) * 1099511628211ull; };
+    for(int y=0; y<d.height(); y++) {
+        for(int x=0; x<d.width(); x++) {
+            mix(d.map(x, y));
+            mix(d.item(x, y));
+        }
+    }
+    mix(d.length() ^ d.mapwidth() << 8);
+    return h;
+}
+
+}  // namespace z2util
+
+int main(int argc, char *argv[]) {
+    // The random ROM is full of invalid items.  Don't time the logging of
+    // them unless asked to.
+    gflags::SetCommandLineOptionWithMode("loglevel", "0",
+                                         gflags::SET_FLAGS_DEFAULT);
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+    logging::logging_init();
+    using namespace z2util;
+
+    auto* config = ConfigLoader<RomInfo>::Get();
+    auto postprocess = [](RomInfo* ri) { PostProcessConfig(ri, nullptr); };
+    if (!FLAGS_config.empty()) {
+        config->Load(FLAGS_config, postprocess);
+    } else {
+        config->Parse(kZelda2Cfg, postprocess);
+    }
+
+    RomContext rom;
+    SyntheticRom synthetic(FLAGS_seed);
+    if (!synthetic.Build(&rom)) {
+        fprintf(stderr, "Couldn't load the synthetic ROM\n");
+        return 1;
+    }
+
+    std::vector<const Map*> sideviews;
+    for(const auto& m : config->GetConfig().map()) {
+        if (m.type() != MapType::OVERWORLD && m.pointer().address())
+            sideviews.push_back(&m);
+    }
+
+    Z2Decompress d;
+    d.set_mapper(rom.mapper());
+    uint64_t hash = 1469598103934665603ull;
+    for(const Map* m : sideviews) {
+        d.Init();
+        d.Decompress(*m);
+        hash = Hash(hash, d);
+        if (FLAGS_area_hashes) {
+            printf("%s %016llx\n", m->name().c_str(),
+                   (unsigned long long)hash);
+        }
+        if (m->name() == FLAGS_dump) {
+            d.Print();
+        }
+    }
+
+    // The overworlds, each decoded by a fresh decompressor and by one that
+    // has been used for sideviews, which must agree.
+    uint64_t ohash = 1469598103934665603ull;
+    int noverworld = 0;
+    for(const auto& m : config->GetConfig().map()) {
+        if (m.type() != MapType::OVERWORLD)
+            continue;
+        Z2Decompress fresh;
+        fresh.set_mapper(rom.mapper());
+        fresh.Decompress(m);
+        d.Decompress(m);
+        ohash = Hash(ohash, fresh);
+        ohash = Hash(ohash, d);
+        noverworld++;
+    }
+    printf("%d overworlds hash %016llx\n", noverworld,
+           (unsigned long long)ohash);
+
+    auto start = std::chrono::steady_clock::now();
+    for(int i=0; i<FLAGS_iterations; i++) {
+        for(const Map* m : sideviews) {
+            if (FLAGS_fresh) {
+                Z2Decompress f;
+                f.set_mapper(rom.mapper());
+                f.Init();
+                f.Decompress(*m);
+            } else {
+                d.Init();
+                d.Decompress(*m);
+            }
+        }
+    }
+    std::chrono::duration<double, std::micro> t =
+        std::chrono::steady_clock::now() - start;
+    double pass = t.count() / FLAGS_iterations;
+    printf("%zu areas hash %016llx  %.1f us/pass (%.2f us/area)\n",
+           sideviews.size(), (unsigned long long)hash, pass,
+           pass / sideviews.size());
+    return 0;
+}
@@ -0,0 +1,73 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <gflags/gflags.h>
+
+#include "alg/fdg.h"
+
+DEFINE_int32(steps, 100, "Simulation steps per measurement.");
+DEFINE_double(delta_t, 0.01, "Simulation time step.");
+DEFINE_double(theta, 0.5, "Barnes-Hut opening angle for the tree runs.");
+
+// Build a w x h grid of nodes joined to their right and lower neighbors,
+// jittered a little so no two nodes line up exactly.
+static void BuildGrid(fdg::Graph* graph, int w, int h) {
+    graph->Clear();
+    for(int y=0; y<h; y++) {
+        for(int x=0; x<w; x++) {
+            int id = y * w + x;
+            double jitter = 0.1 * std::sin(id * 12.9898);
+            fdg::Node* node = graph->AddNode(
+                id, Vec2(x * 10.0 + jitter, y * 10.0 - jitter));
+            auto* spring = node->mutable_connection();
+            if (x + 1 < w) {
+                spring->emplace_back(fdg::Spring{id + 1, 1.0,
+                        fdg::Bias::Horizontal, 0xFFFFFFFF, 1.0, 0, 0});
+            }
+            if (y + 1 < h) {
+                spring->emplace_back(fdg::Spring{id + w, 1.0,
+                        fdg::Bias::Vertical, 0xFFFFFFFF, 1.0, 0, 0});
+            }
+        }
+    }
+}
+
+// Run the simulation and report the time per step, plus a checksum of the
+// final positions so runs with different thread counts can be compared.
+static void Run(int w, int h, int threads, double theta) {
+    fdg::Graph graph;
+    BuildGrid(&graph, w, h);
+    graph.set_threads(threads);
+    graph.set_theta(theta);
+    // The first step starts the executor's threads; don't count it.
+    graph.Compute(FLAGS_delta_t);
+
+    auto start = std::chrono::steady_clock::now();
+    for(int i=0; i<FLAGS_steps; i++) {
+        graph.Compute(FLAGS_delta_t);
+    }
+    std::chrono::duration<double, std::micro> d =
+        std::chrono::steady_clock::now() - start;
+
+    double sum = 0;
+    for(const auto& n : graph.nodes()) {
+        const Vec2& p = n.second->pos();
+        sum += p.x * p.x + p.y * p.y;
+    }
+    printf("%5d nodes  threads=%d  theta=%-4g %12.1f us/step  "
+           "checksum=%.6f\n", w * h, threads, theta,
+           d.count() / FLAGS_steps, sum);
+}
+
+int main(int argc, char *argv[]) {
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+    const int grids[][2] = { {5, 10}, {20, 25}, {50, 100} };
+    for(const auto& g : grids) {
+        for(double theta : {0.0, FLAGS_theta}) {
+            Run(g[0], g[1], 1, theta);
+            Run(g[0], g[1], 0, theta);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,126 @@
+#include "imwidget/area_cache.h"
+
+#include <set>
+#include <gflags/gflags.h>
+
+#include "util/config.h"
+#include "util/crc.h"
+
+DEFINE_int32(area_cache_mb, 64,
+             "Memory budget for cached sideview renderings (MiB)");
+
+namespace z2util {
+
+AreaCache* AreaCache::Get() {
+    static AreaCache cache;
+    return &cache;
+}
+
+AreaCache::AreaCache()
+  : size_(0) {}
+
+std::string AreaCache::Key(Mapper* mapper, const Map& map) {
+    const auto& ri = ConfigLoader<RomInfo>::GetConfig();
+    std::set<int> prg, chr;
+
+    auto add = [&prg](const Address& a) {
+        if (a.address()) prg.insert(a.bank());
+    };
+    add(map.address());
+    add(map.pointer());
+    add(map.palette());
+    add(map.connector());
+    add(map.doors());
+    for(const auto& a : map.palettes()) add(a);
+    for(const auto& a : map.objtable()) add(a);
+    if (map.pointer().address()) {
+        add(mapper->ReadAddr(map.pointer(), 0));
+    }
+    // Palaces always live in bank 0x1c; see Z2Decompress::Decompress.
+    if (map.type() == MapType::PALACE || map.type() == MapType::GREAT_PALACE) {
+        prg.insert(0x1c);
+    }
+    // Item and enemy sprites come from the map's CHR bank pair or from
+    // the banks named in the item info config.
+    chr.insert(map.chr().bank() & ~1);
+    chr.insert(map.chr().bank() | 1);
+    for(const auto& info : ri.enemies()) {
+        if (info.world() == map.world() && info.overworld() == map.overworld()) {
+            chr.insert(info.chr().bank());
+            add(info.sprite_table());
+        }
+    }
+    chr.insert(ri.items().chr().bank());
+    add(ri.items().sprite_table());
+
+    uint32_t crc = 0;
+    for(int bank : prg) {
+        auto data = mapper->PrgBankSpan(bank, 0x8000, 0x4000);
+        crc = Crc32(crc, data.data(), data.size());
+    }
+    for(int bank : chr) {
+        auto data = mapper->ChrBankSpan(bank, 0, 0x1000);
+        crc = Crc32(crc, data.data(), data.size());
+    }
+
+    std::string key = map.SerializeAsString();
+    int generation = ConfigLoader<RomInfo>::Generation();
+    key.append(reinterpret_cast<const char*>(&generation), sizeof(generation));
+    key.append(reinterpret_cast<const char*>(&crc), sizeof(crc));
+    return key;
+}
+
+std::shared_ptr<GLBitmap> AreaCache::Find(const std::string& key) {
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+        return nullptr;
+    }
+    lru_.splice(lru_.begin(), lru_, it->second);
+    return it->second->bitmap;
+}
+
+void AreaCache::Insert(const std::string& key, const std::string& name,
+                       std::shared_ptr<GLBitmap> bitmap) {
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+        size_ -= it->second->size;
+        lru_.erase(it->second);
+        index_.erase(it);
+    }
+    size_t size = bitmap->width() * bitmap->height() * sizeof(uint32_t);
+    lru_.push_front(Entry{key, name, bitmap, size});
+    index_[key] = lru_.begin();
+    size_ += size;
+    Evict();
+}
+
+void AreaCache::Invalidate(const std::string& name) {
+    for(auto it = lru_.begin(); it != lru_.end(); ) {
+        if (it->name == name) {
+            size_ -= it->size;
+            index_.erase(it->key);
+            it = lru_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void AreaCache::Clear() {
+    lru_.clear();
+    index_.clear();
+    size_ = 0;
+}
+
+void AreaCache::Evict() {
+    size_t budget = size_t(FLAGS_area_cache_mb) << 20;
+    // Always keep the most recent entry, even if it's over budget.
+    while (size_ > budget && lru_.size() > 1) {
+        const auto& e = lru_.back();
+        size_ -= e.size;
+        index_.erase(e.key);
+        lru_.pop_back();
+    }
+}
+
+}  // namespace z2util
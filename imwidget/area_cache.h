@@ -0,0 +1,55 @@
+#ifndef Z2UTIL_IMWIDGET_AREA_CACHE_H
+#define Z2UTIL_IMWIDGET_AREA_CACHE_H
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "imwidget/glbitmap.h"
+#include "nes/mapper.h"
+#include "proto/rominfo.pb.h"
+
+namespace z2util {
+
+// A process-wide LRU cache of rendered sideview areas.
+//
+// Entries are keyed by the map definition and a checksum of the ROM banks
+// the area is rendered from (map data, object tables, palettes and CHR),
+// so an area which hasn't changed is only decompressed and rendered once,
+// no matter how many times it is opened or refreshed.
+class AreaCache {
+  public:
+    static AreaCache* Get();
+
+    // Compute the cache key for a map from its definition and the current
+    // ROM contents.
+    static std::string Key(Mapper* mapper, const Map& map);
+
+    // Returns the cached bitmap for key, or nullptr.
+    std::shared_ptr<GLBitmap> Find(const std::string& key);
+    void Insert(const std::string& key, const std::string& name,
+                std::shared_ptr<GLBitmap> bitmap);
+    // Drop every entry for the named map.
+    void Invalidate(const std::string& name);
+    void Clear();
+
+  private:
+    AreaCache();
+    void Evict();
+
+    struct Entry {
+        std::string key;
+        std::string name;
+        std::shared_ptr<GLBitmap> bitmap;
+        size_t size;
+    };
+    typedef std::list<Entry> List;
+    // Most recently used first.
+    List lru_;
+    std::unordered_map<std::string, List::iterator> index_;
+    size_t size_;
+};
+
+}  // namespace z2util
+#endif // Z2UTIL_IMWIDGET_AREA_CACHE_H
@@ -0,0 +1,149 @@
+#include "imwidget/area_renderer.h"
+
+#include "imwidget/area_cache.h"
+#include "imwidget/simplemap.h"
+#include "nes/cartridge.h"
+#include "nes/rom_context.h"
+
+namespace z2util {
+namespace {
+
+// Shrink a bitmap by averaging each factor x factor block of pixels.
+std::unique_ptr<GLBitmap> Shrink(GLBitmap* src, int factor) {
+    int w = src->width() / factor;
+    int h = src->height() / factor;
+    std::unique_ptr<GLBitmap> dst(new GLBitmap(w, h));
+    const uint32_t* s = src->data();
+    int n = factor * factor;
+    for(int y=0; y<h; y++) {
+        for(int x=0; x<w; x++) {
+            uint32_t sum[4] = {0, 0, 0, 0};
+            for(int yy=0; yy<factor; yy++) {
+                const uint32_t* row = s + (y*factor + yy) * src->width();
+                for(int xx=0; xx<factor; xx++) {
+                    uint32_t p = row[x*factor + xx];
+                    sum[0] += p & 0xFF;
+                    sum[1] += (p >> 8) & 0xFF;
+                    sum[2] += (p >> 16) & 0xFF;
+                    sum[3] += p >> 24;
+                }
+            }
+            dst->SetPixel(x, y, (sum[0] / n) | (sum[1] / n) << 8 |
+                                (sum[2] / n) << 16 | (sum[3] / n) << 24);
+        }
+    }
+    return dst;
+}
+
+}  // namespace
+
+// The workers share the snapshot, but only ever read it.
+struct AreaRenderer::Snapshot {
+    explicit Snapshot(const Cartridge& cart) : rom(new RomContext(cart)) {}
+    std::unique_ptr<RomContext> rom;
+};
+
+AreaRenderer::AreaRenderer(int nthreads)
+  : generation_(0),
+    pending_(0),
+    executor_(new util::Executor(nthreads)) {}
+
+AreaRenderer::~AreaRenderer() {
+    Cancel();
+    executor_.reset();
+}
+
+int AreaRenderer::Level(float scale) {
+    int level = 0;
+    while (level + 1 < kLevels && scale * (2 << level) <= 1.0) {
+        level++;
+    }
+    return level;
+}
+
+std::string AreaRenderer::LevelKey(const std::string& key, int level) {
+    return level ? key + "#" + std::to_string(level) : key;
+}
+
+void AreaRenderer::Request(Mapper* mapper, int id, const Map& map,
+                           int level) {
+    if (!snapshot_) {
+        snapshot_ = std::make_shared<Snapshot>(*mapper->cartridge());
+        keys_.clear();
+    }
+    auto k = keys_.find(id);
+    if (k == keys_.end()) {
+        k = keys_.emplace(id, AreaCache::Key(mapper, map)).first;
+    }
+    const std::string& key = k->second;
+
+    pending_++;
+    auto bitmap = AreaCache::Get()->Find(LevelKey(key, level));
+    if (bitmap) {
+        hits_.push_back(Result{id, level, std::move(bitmap)});
+        return;
+    }
+    Done done{generation_, id, level, key, map.name(), {}};
+    executor_->Submit([this, snapshot=snapshot_, done, map]() {
+        Render(*snapshot, done, map);
+    });
+}
+
+void AreaRenderer::Render(const Snapshot& snapshot, Done done,
+                          const Map& map) {
+    if (done.generation != generation_)
+        return;
+    SimpleMap simple(snapshot.rom.get(), map);
+    std::shared_ptr<GLBitmap> bitmap = simple.RenderToNewBuffer();
+    for(int level=0; level<kLevels; level++) {
+        if (level) {
+            bitmap = Shrink(bitmap.get(), 2);
+        }
+        if (level >= done.level) {
+            done.bitmaps.push_back(bitmap);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mu_);
+    done_.push_back(std::move(done));
+}
+
+void AreaRenderer::Cancel() {
+    generation_++;
+    snapshot_.reset();
+    keys_.clear();
+    pending_ = 0;
+    hits_.clear();
+    std::lock_guard<std::mutex> lock(mu_);
+    done_.clear();
+}
+
+std::vector<AreaRenderer::Result> AreaRenderer::Poll() {
+    std::vector<Result> result;
+    result.swap(hits_);
+    std::vector<Done> done;
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        done.swap(done_);
+    }
+    auto* cache = AreaCache::Get();
+    for(auto& d : done) {
+        if (d.generation != generation_)
+            continue;
+        // Cache the requested level and the smaller ones, which are cheap
+        // and likely to be wanted when zooming out.  Insert the requested
+        // level last so it's the last to be evicted.
+        for(int i=d.bitmaps.size()-1; i>=0; i--) {
+            cache->Insert(LevelKey(d.key, d.level + i), d.name, d.bitmaps[i]);
+        }
+        result.push_back(Result{d.id, d.level, d.bitmaps[0]});
+    }
+    pending_ -= result.size();
+    if (pending_ == 0) {
+        // Everything asked for is done; don't hold on to the ROM copy.
+        snapshot_.reset();
+    }
+    return result;
+}
+
+}  // namespace z2util
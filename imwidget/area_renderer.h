@@ -0,0 +1,81 @@
+#ifndef Z2UTIL_IMWIDGET_AREA_RENDERER_H
+#define Z2UTIL_IMWIDGET_AREA_RENDERER_H
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "imwidget/glbitmap.h"
+#include "nes/mapper.h"
+#include "proto/rominfo.pb.h"
+#include "util/executor.h"
+
+namespace z2util {
+
+// Renders sideview areas on worker threads, at several levels of detail.
+// Level n is the area reduced by 2^n on each axis, so callers drawing a
+// small version of an area only have to keep a small bitmap around.
+//
+// The areas are rendered from a private copy of the ROM, taken at the
+// first Request when nothing is pending, so the editor can keep changing
+// the ROM while they render.  Finished areas go into the AreaCache and
+// are handed back by Poll.  Request, Cancel and Poll must be called from
+// the UI thread.
+class AreaRenderer {
+  public:
+    static const int kLevels = 4;
+
+    struct Result {
+        int id;
+        int level;
+        std::shared_ptr<GLBitmap> bitmap;
+    };
+
+    // nthreads <= 0 means one thread per CPU.
+    explicit AreaRenderer(int nthreads=0);
+    ~AreaRenderer();
+
+    // The most reduced level which still has at least one texel per pixel
+    // when drawn at scale.
+    static int Level(float scale);
+
+    // Render level of map and return it from Poll under id.  Areas which
+    // are already cached are returned by the next Poll without rendering.
+    void Request(Mapper* mapper, int id, const Map& map, int level);
+    // Drop all outstanding requests and the ROM copy.
+    void Cancel();
+    // Return the areas which have finished since the last Poll.
+    std::vector<Result> Poll();
+    // The number of requests which haven't been returned by Poll yet.
+    inline int pending() const { return pending_; }
+
+  private:
+    struct Snapshot;
+    struct Done {
+        int generation;
+        int id;
+        int level;
+        std::string key;
+        std::string name;
+        // Levels level ... kLevels-1.
+        std::vector<std::shared_ptr<GLBitmap>> bitmaps;
+    };
+    void Render(const Snapshot& snapshot, Done done, const Map& map);
+    static std::string LevelKey(const std::string& key, int level);
+
+    std::shared_ptr<Snapshot> snapshot_;
+    // Cache keys by id, computed from the ROM when snapshot_ was taken.
+    std::map<int, std::string> keys_;
+    std::atomic<int> generation_;
+    int pending_;
+    std::mutex mu_;
+    std::vector<Done> done_;
+    std::vector<Result> hits_;
+    // Last, so the workers are stopped before anything above goes away.
+    std::unique_ptr<util::Executor> executor_;
+};
+
+}  // namespace z2util
+#endif // Z2UTIL_IMWIDGET_AREA_RENDERER_H
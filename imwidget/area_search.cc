@@ -0,0 +1,107 @@
+#include "imwidget/area_search.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "imwidget/simplemap.h"
+#include "proto/rominfo.pb.h"
+#include "util/config.h"
+#include "imgui.h"
+
+namespace z2util {
+
+void AreaSearch::Search() {
+    results_ = AreaIndex::Get()->Find(AreaIndex::Kind(kind_), id_);
+}
+
+bool AreaSearch::Draw() {
+    if (!visible_)
+        return false;
+
+    ImGui::SetNextWindowSize(ImVec2(500, 400), ImGuiCond_FirstUseEver);
+    ImGui::Begin("Area Search", &visible_);
+    AreaIndex* index = AreaIndex::Get();
+    bool search = false;
+
+    ImGui::PushItemWidth(100);
+    search |= ImGui::Combo("Kind", &kind_, "Tile\0Item\0Enemy\0\0");
+    ImGui::SameLine();
+    char buf[8];
+    sprintf(buf, "%02x", id_);
+    ImGui::PushItemWidth(25);
+    if (ImGui::InputText("Id", buf, 3,
+                         ImGuiInputTextFlags_CharsHexadecimal)) {
+        id_ = strtoul(buf, 0, 16);
+        search = true;
+    }
+    ImGui::PopItemWidth();
+    ImGui::PopItemWidth();
+    if (kind_ == AreaIndex::ITEM && id_ < ObjectNames::MAX_COLLECTABLE &&
+        rom_) {
+        ImGui::SameLine();
+        ImGui::Text("%s", rom_->object_names().collectable_name(id_));
+    }
+
+    ImGui::SameLine();
+    if (ImGui::Button("Reindex") && rom_) {
+        index->Rebuild(rom_);
+    }
+
+    // Pick up results from a rebuild as it makes progress.
+    int pending = index->pending();
+    if (pending != pending_) {
+        pending_ = pending;
+        search = true;
+    }
+    if (search) {
+        Search();
+    }
+    if (pending) {
+        ImGui::Text("Indexing %d areas...", pending);
+    }
+
+    ImGui::Separator();
+    DrawResults();
+    ImGui::End();
+    return false;
+}
+
+void AreaSearch::DrawResults() {
+    const auto& ri = ConfigLoader<RomInfo>::GetConfig();
+    int total = 0;
+    ImGui::BeginChild("results");
+    ImGui::Columns(3, "results", true);
+    ImGui::Text("Area"); ImGui::NextColumn();
+    ImGui::Text("Count"); ImGui::NextColumn();
+    ImGui::Text("First"); ImGui::NextColumn();
+    ImGui::Separator();
+    for(const auto& r : results_) {
+        if (r.area >= ri.map_size())
+            continue;
+        const Map& map = ri.map(r.area);
+        const auto& first = r.points.front();
+        ImGui::PushID(r.area);
+        if (map.type() == MapType::OVERWORLD) {
+            // Overworlds live in the overworld editor; there's no
+            // window to spawn for them.
+            ImGui::Text("%s", map.name().c_str());
+        } else if (ImGui::Selectable(map.name().c_str())) {
+            if (rom_) {
+                SimpleMap::Spawn(rom_, map, first.x / 16);
+            }
+        }
+        ImGui::NextColumn();
+        ImGui::Text("%d", int(r.points.size()));
+        ImGui::NextColumn();
+        ImGui::Text("(%d, %d)", first.x, first.y);
+        ImGui::NextColumn();
+        ImGui::PopID();
+        total += r.points.size();
+    }
+    ImGui::Columns(1);
+    ImGui::Separator();
+    ImGui::Text("%d matches in %d areas", total, int(results_.size()));
+    ImGui::EndChild();
+}
+
+}  // namespace z2util
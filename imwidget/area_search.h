@@ -0,0 +1,37 @@
+#ifndef Z2UTIL_IMWIDGET_AREA_SEARCH_H
+#define Z2UTIL_IMWIDGET_AREA_SEARCH_H
+#include <vector>
+#include "imwidget/imwidget.h"
+#include "nes/area_index.h"
+#include "nes/rom_context.h"
+
+namespace z2util {
+
+// Find every area which uses a tile, item or enemy.  Results come from
+// the AreaIndex, so searching doesn't decompress anything.
+class AreaSearch: public ImWindowBase {
+  public:
+    AreaSearch()
+      : ImWindowBase(false),
+      rom_(nullptr),
+      kind_(0),
+      id_(0),
+      pending_(-1) {}
+
+    bool Draw() override;
+    void Refresh() override { Search(); }
+    inline void set_rom(RomContext* rom) { rom_ = rom; }
+
+  private:
+    void Search();
+    void DrawResults();
+
+    RomContext* rom_;
+    int kind_;
+    int id_;
+    int pending_;
+    std::vector<AreaIndex::Result> results_;
+};
+
+}  // namespace z2util
+#endif // Z2UTIL_IMWIDGET_AREA_SEARCH_H
@@ -0,0 +1,98 @@
+#include "imwidget/change_bus.h"
+
+#include <algorithm>
+
+#include "nes/cartridge.h"
+
+namespace z2util {
+
+ChangeBus* ChangeBus::Get() {
+    static ChangeBus singleton;
+    return &singleton;
+}
+
+ChangeBus::Subscriber* ChangeBus::Find(const void* owner) {
+    for(auto& s : subscribers_) {
+        if (s.owner == owner)
+            return &s;
+    }
+    return nullptr;
+}
+
+void ChangeBus::Subscribe(const void* owner, Kind kind, int id,
+                          std::function<void()> refresh) {
+    Subscriber* s = Find(owner);
+    if (s == nullptr) {
+        subscribers_.push_back(Subscriber{owner, {}, nullptr});
+        s = &subscribers_.back();
+    }
+    s->keys.emplace(kind, id);
+    s->refresh = refresh;
+}
+
+void ChangeBus::Unsubscribe(const void* owner) {
+    subscribers_.erase(
+        std::remove_if(subscribers_.begin(), subscribers_.end(),
+                       [owner](const Subscriber& s) {
+                           return s.owner == owner;
+                       }),
+        subscribers_.end());
+}
+
+bool ChangeBus::Subscribed(const void* owner) const {
+    for(const auto& s : subscribers_) {
+        if (s.owner == owner)
+            return true;
+    }
+    return false;
+}
+
+void ChangeBus::Changed(Kind kind, int id) {
+    changed_.emplace(kind, id);
+}
+
+void ChangeBus::Collect(Cartridge* cartridge) {
+    if (!cartridge->IsDirty(Cartridge::REFRESH))
+        return;
+    uint32_t prg = cartridge->prg_offset();
+    uint32_t chr = cartridge->chr_offset();
+    for(const auto& r : cartridge->DirtyRanges(Cartridge::REFRESH)) {
+        // Split the range at the PRG/CHR boundary and mark every bank
+        // it touches.
+        for(uint32_t a = std::max(r.first, prg); a < std::min(r.second, chr);
+            a = (a - prg) / 0x4000 * 0x4000 + prg + 0x4000) {
+            Changed(PRG, (a - prg) / 0x4000);
+        }
+        for(uint32_t a = std::max(r.first, chr); a < r.second;
+            a = (a - chr) / 0x1000 * 0x1000 + chr + 0x1000) {
+            Changed(CHR, (a - chr) / 0x1000);
+        }
+    }
+    cartridge->ClearDirty(Cartridge::REFRESH);
+}
+
+void ChangeBus::Publish() {
+    if (changed_.empty())
+        return;
+    std::set<Key> changed;
+    changed.swap(changed_);
+    std::vector<const void*> owners;
+    for(const auto& s : subscribers_) {
+        for(const auto& k : s.keys) {
+            if (changed.count(k)) {
+                owners.push_back(s.owner);
+                break;
+            }
+        }
+    }
+    for(const void* owner : owners) {
+        // An earlier refresh may have dropped this owner.
+        Subscriber* s = Find(owner);
+        if (s && s->refresh) {
+            auto refresh = s->refresh;
+            refresh();
+        }
+    }
+}
+
+}  // namespace z2util
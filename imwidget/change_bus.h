@@ -0,0 +1,63 @@
+#ifndef Z2UTIL_IMWIDGET_CHANGE_BUS_H
+#define Z2UTIL_IMWIDGET_CHANGE_BUS_H
+#include <functional>
+#include <set>
+#include <utility>
+#include <vector>
+
+class Cartridge;
+namespace z2util {
+
+// Tells widgets which parts of the ROM and config have changed, so that
+// after an edit only the widgets showing those parts re-read them.
+//
+// Widgets subscribe to the PRG banks (16 KiB), CHR banks (4 KiB, as the
+// CHR viewer numbers them) and RomInfo fields (by field number) that they
+// render.  Changes are batched: Changed and Collect record them, and
+// Publish calls each affected subscriber's refresh function once.  The
+// bus belongs to the UI thread.
+class ChangeBus {
+  public:
+    enum Kind {
+        PRG,
+        CHR,
+        CONFIG,
+    };
+
+    // The bus for the ROM open in the editor.
+    static ChangeBus* Get();
+
+    // Call refresh when key (kind, id) changes.  An owner has one refresh
+    // function; subscribing again adds a key and replaces the function.
+    void Subscribe(const void* owner, Kind kind, int id,
+                   std::function<void()> refresh);
+    // Drop all of owner's keys.  Owners must unsubscribe before they are
+    // destroyed.
+    void Unsubscribe(const void* owner);
+    bool Subscribed(const void* owner) const;
+
+    void Changed(Kind kind, int id);
+    // Record the banks written since the last Collect, from the
+    // cartridge's REFRESH dirty pages.
+    void Collect(Cartridge* cartridge);
+    // Refresh the subscribers of everything changed since the last
+    // Publish.  Refresh functions may subscribe and unsubscribe.
+    void Publish();
+
+  private:
+    typedef std::pair<Kind, int> Key;
+    struct Subscriber {
+        const void* owner;
+        std::set<Key> keys;
+        std::function<void()> refresh;
+    };
+    Subscriber* Find(const void* owner);
+
+    // In order of first subscription, so refreshes happen in a
+    // predictable order.
+    std::vector<Subscriber> subscribers_;
+    std::set<Key> changed_;
+};
+
+}  // namespace z2util
+#endif // Z2UTIL_IMWIDGET_CHANGE_BUS_H
@@ -1,7 +1,5 @@
-#include <stdarg.h>
 #include <stdlib.h>
 #include "imwidget/debug_console.h"
-#include "util/logging.h"
 
 DebugConsole::DebugConsole(const char* name)
   : ImWindowBase(false, false),
@@ -10,24 +8,10 @@ DebugConsole::DebugConsole(const char* name)
     memset(inputbuf_, 0, sizeof(inputbuf_));
     history_pos_ = -1;
     AddLog("Welcome to %s!", name_);
-    shorthelp_.insert(std::make_pair("clear", "Clear the window"));
-    shorthelp_.insert(std::make_pair("history", "Show command history"));
-    shorthelp_.insert(std::make_pair("help", "Show command help"));
 }
 
 DebugConsole::~DebugConsole() {
     ClearLog();
-    for (int i = 0; i < history_.Size; i++)
-        free(history_[i]);
-}
-
-void DebugConsole::PushLineCallback(std::function<
-            void(DebugConsole* console, const char* line)> line_cb) {
-    line_cb_.push_back(line_cb);
-}
-
-void DebugConsole::PopLineCallback() {
-    line_cb_.pop_back();
 }
 
 void  DebugConsole::ClearLog() {
@@ -37,31 +21,10 @@ void  DebugConsole::ClearLog() {
     scroll_to_bottom_ = true;
 }
 
-void DebugConsole::RegisterCommand(const char* command, const char* shorthelp,
-        std::function<void(DebugConsole*, int, char**)> fn) {
-    shorthelp_.insert(std::make_pair(command, shorthelp));
-    commands_.insert(std::make_pair(command, fn));
-}
-
-void  DebugConsole::AddLog(const char* fmt, ...) {
-    char buf[1024];
-    va_list args;
-    va_start(args, fmt);
-    vsnprintf(buf, sizeof(buf), fmt, args);
-    buf[sizeof(buf)-1] = 0;
-    va_end(args);
-    items_.push_back(strdup(buf));
+void  DebugConsole::Output(const char* line) {
+    items_.push_back(strdup(line));
     scroll_to_bottom_ = true;
-
-    char *log = buf;
-    if (log[0] == '#' && buf[1] == '{')
-        log += 6;
-
-    char *end = log + strlen(log) - 1;
-    while(end > log && (*end == '\r' || *end == '\n')) {
-        *end-- = '\0';
-    }
-    LOG(INFO, "$$ ", log);
+    Console::Output(line);
 }
 
 bool DebugConsole::Draw() {
@@ -159,86 +122,8 @@ bool DebugConsole::Draw() {
 }
 
 void  DebugConsole::ExecCommand(const char* command_line) {
-    if (!line_cb_.empty()) {
-        line_cb_.back()(this, command_line);
-        return;
-    }
-    AddLog("#{fc8}%s\n", command_line);
-
-    // Insert into history. First find match and delete it so it can be pushed to the back. This isn't trying to be smart or optimal.
     history_pos_ = -1;
-    for (int i = history_.Size-1; i >= 0; i--)
-        if (strcasecmp(history_[i], command_line) == 0) {
-            free(history_[i]);
-            history_.erase(history_.begin() + i);
-            break;
-        }
-    history_.push_back(strdup(command_line));
-
-    // Process command
-    if (strcasecmp(command_line, "CLEAR") == 0) {
-        ClearLog();
-    } else if (strcasecmp(command_line, "HELP") == 0) {
-        AddLog("Commands:");
-        for(const auto& c : shorthelp_) {
-            AddLog("- %s: %s", c.first, c.second);
-        }
-    } else if (strcasecmp(command_line, "HISTORY") == 0) {
-        for (int i = history_.Size >= 10 ? history_.Size - 10 : 0; i < history_.Size;
-                i++)
-            AddLog("%3d: %s\n", i, history_[i]);
-    } else {
-        int argc = 0;
-        char *argv[128];
-        char *command = strdup(command_line);
-        char *orig = command;
-
-        argv[argc] = nullptr;
-        while(*command) {
-            while(isspace(*command))
-                *command++ = '\0';
-
-            if (*command == '#') {
-                *command++ = '\0';
-                break;
-            }
-
-            if (*command) {
-                bool quote = *command == '"';
-                if (quote) {
-                    argv[argc++] = ++command;
-                    while(*command && *command != '"') {
-                        command +=  (*command == '\\' && command[1]) ? 2 : 1;
-                    }
-                    if (*command == '"') {
-                        *command++ = '\0';
-                    } else {
-                        AddLog("[error] Unterminated string.");
-                        argc = 0;
-                        break;
-                    }
-                } else {
-                    argv[argc++] = command;
-                    while(*command && !isspace(*command)) {
-                        command++;
-                    }
-                }
-            } else {
-                break;
-            }
-        }
-        if (argc && strlen(argv[0])) {
-            for(const auto& c : commands_) {
-                if (!strcasecmp(argv[0], c.first)) {
-                    c.second(this, argc, argv);
-                    free(orig);
-                    return;
-                }
-            }
-            AddLog("Unknown command: '%s'\n", argv[0]);
-        }
-        free(orig);
-    }
+    Console::ExecCommand(command_line);
 }
 
 int DebugConsole::TextEditCallbackStub(ImGuiTextEditCallbackData* data) {
@@ -312,12 +197,12 @@ int  DebugConsole::TextEditCallback(ImGuiTextEditCallbackData* data) {
         const int prev_history_pos = history_pos_;
         if (data->EventKey == ImGuiKey_UpArrow) {
             if (history_pos_ == -1)
-                history_pos_ = history_.Size - 1;
+                history_pos_ = int(history_.size()) - 1;
             else if (history_pos_ > 0)
                 history_pos_--;
         } else if (data->EventKey == ImGuiKey_DownArrow) {
             if (history_pos_ != -1)
-                if (++history_pos_ >= history_.Size)
+                if (++history_pos_ >= int(history_.size()))
                     history_pos_ = -1;
         }
 
@@ -325,7 +210,7 @@ int  DebugConsole::TextEditCallback(ImGuiTextEditCallbackData* data) {
         if (prev_history_pos != history_pos_) {
             data->CursorPos = data->SelectionStart = data->SelectionEnd = data->BufTextLen
                               = (int)snprintf(data->Buf, (size_t)data->BufSize, "%s",
-                                              (history_pos_ >= 0) ? history_[history_pos_] : "");
+                                              (history_pos_ >= 0) ? history_[history_pos_].c_str() : "");
             data->BufDirty = true;
         }
     }
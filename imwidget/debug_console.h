@@ -1,40 +1,21 @@
 #ifndef SYNTHY_IMWIDGET_DEBUG_CONSOLE_H
 #define SYNTHY_IMWIDGET_DEBUG_CONSOLE_H
-#include <string>
-#include <map>
-#include <functional>
-#include <vector>
 #include "imwidget/imwidget.h"
+#include "util/console.h"
 #include "imgui.h"
 
 
-class DebugConsole: public ImWindowBase {
+class DebugConsole: public ImWindowBase, public Console {
   public:
     DebugConsole(const char* name);
     DebugConsole(): DebugConsole("DebugConsole") {}
     ~DebugConsole() override;
 
-    void RegisterCommand(const char* cmd, const char* shorthelp,
-                         std::function<void(DebugConsole* console,
-                                            int argc, char **argv)> fn);
-
-    template<typename T>
-    inline void RegisterCommand(const char* cmd, const char* shorthelp,
-                         T* that, void (T::*fn)(DebugConsole* console,
-                                                int argc, char **argv)) {
-        RegisterCommand(cmd, shorthelp, [=](DebugConsole* console,
-                                            int argc, char **argv) {
-            (that->*fn)(console, argc, argv);
-        });
-    }
-
-    void ClearLog();
-    void AddLog(const char* fmt, ...);
+    void ClearLog() override;
     bool Draw() override;
-    void ExecCommand(const char* command_line);
-    void PushLineCallback(std::function<
-            void(DebugConsole* console, const char* line)> line_cb);
-    void PopLineCallback();
+    void ExecCommand(const char* command_line) override;
+  protected:
+    void Output(const char* line) override;
   private:
     int TextEditCallback(ImGuiTextEditCallbackData* data);
 
@@ -44,14 +25,8 @@ class DebugConsole: public ImWindowBase {
     char inputbuf_[256];
     ImVector<char*> items_;
     bool scroll_to_bottom_;
-    ImVector<char*> history_;
-    // -1: new line, 0..history_.Size-1 browsing history.
+    // -1: new line, 0..history_.size()-1 browsing history.
     int history_pos_;
-    std::map<const char*, const char*> shorthelp_;
-    std::map<const char*, std::function<void(DebugConsole* console,
-                                             int argc, char **argv)>> commands_;
-    std::vector<std::function<
-        void(DebugConsole* console, const char* line)>> line_cb_;
 };
 
 #endif // SYNTHY_IMWIDGET_DEBUG_CONSOLE_H
@@ -1,7 +1,6 @@
 #include "imwidget/drops.h"
 
 #include "imwidget/imapp.h"
-#include "imwidget/map_command.h"
 #include "nes/mapper.h"
 #include "proto/rominfo.pb.h"
 #include "util/config.h"
@@ -12,7 +11,6 @@ namespace z2util {
 void Drops::Refresh() {
     changed_ = false;
     drop_type_ = 0;
-    MapCommand::Init();
     Unpack();
 }
 
@@ -56,11 +54,13 @@ void Drops::DrawDropTable() {
         ImGui::SameLine();
         changed_ |= ImGui::Combo(
                 "##small", data_.small+i,
-                MapCommand::collectable_names_, MapCommand::MAX_COLLECTABLE);
+                rom_->object_names().collectable_names(),
+                ObjectNames::MAX_COLLECTABLE);
         ImGui::SameLine();
         changed_ |= ImGui::Combo(
                 "##large", data_.large+i,
-                MapCommand::collectable_names_, MapCommand::MAX_COLLECTABLE);
+                rom_->object_names().collectable_names(),
+                ObjectNames::MAX_COLLECTABLE);
         ImGui::PopID();
     }
 }
@@ -91,7 +91,8 @@ void Drops::DrawDropper(const ItemDrop::Dropper& d, int n) {
     if (d.item().address()) {
         changed_ |= ImGui::Combo(
                 "Item", &drop->item,
-                MapCommand::collectable_names_, MapCommand::MAX_COLLECTABLE);
+                rom_->object_names().collectable_names(),
+                ObjectNames::MAX_COLLECTABLE);
     }
     if (d.enemy().address()) {
         const char* list[256];
@@ -3,9 +3,9 @@
 #include <vector>
 
 #include "imwidget/imwidget.h"
+#include "nes/rom_context.h"
 #include "proto/rominfo.pb.h"
 
-class Mapper;
 namespace z2util {
 
 class Drops: public ImWindowBase {
@@ -14,7 +14,10 @@ class Drops: public ImWindowBase {
 
     void Refresh() override;
     bool Draw() override;
-    inline void set_mapper(Mapper* m) { mapper_ = m; };
+    inline void set_rom(RomContext* rom) {
+        rom_ = rom;
+        mapper_ = rom->mapper();
+    }
   private:
     void DrawDropTable();
     void DrawDropper(const ItemDrop::Dropper& d, int n);
@@ -33,6 +36,7 @@ class Drops: public ImWindowBase {
         std::vector<Drop> drop;
     };
     struct Unpacked data_;
+    RomContext* rom_;
     Mapper* mapper_;
     int drop_type_;
     bool changed_;
@@ -4,6 +4,7 @@
 #include "alg/terrain.h"
 #include "imwidget/imapp.h"
 #include "imwidget/editor.h"
+#include "nes/area_index.h"
 #include "nes/z2decompress.h"
 #include "util/config.h"
 #include "util/imgui_impl_sdl.h"
@@ -60,6 +61,8 @@ Editor::Editor()
     scale_(2.0),
     editor_(nullptr),
     map_(nullptr),
+    rom_(nullptr),
+    mapper_(nullptr),
     mouse_origin_(0, 0),
     mouse_focus_(false),
     mapsel_(0)
@@ -262,6 +265,7 @@ void Editor::SaveMap() {
 
     *(map_->mutable_address()) = addr;
     map_->set_length(data.size());
+    AreaIndex::Get()->Update(rom_, *map_);
     encounters_.Save();
     connections_.Save();
     changed_ = false;
@@ -8,6 +8,7 @@
 #include "imwidget/map_connect.h"
 #include "imwidget/randomize.h"
 #include "imwidget/overworld_encounters.h"
+#include "nes/rom_context.h"
 #include "nes/z2objcache.h"
 #include "imgui.h"
 
@@ -35,7 +36,10 @@ class Editor: public ImWindowBase {
     bool Draw() override;
     void Refresh() override;
 
-    inline void set_mapper(Mapper* m) { mapper_ = m; }
+    inline void set_rom(RomContext* rom) {
+        rom_ = rom;
+        mapper_ = rom->mapper();
+    }
 
     void DrawTile(int x, int y, uint16_t tile, int mode, float* props);
     void DrawRect(int x0, int y0, int x1, int y1, uint32_t color);
@@ -62,6 +66,7 @@ class Editor: public ImWindowBase {
     int hidden_palace_tile_;
     int hidden_town_tile_;
 
+    RomContext* rom_;
     Mapper* mapper_;
     NesHardwarePalette* hwpal_;
     Z2ObjectCache cache_;
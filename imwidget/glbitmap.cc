@@ -5,7 +5,8 @@
 GLBitmap::GLBitmap()
   : width_(0),
     height_(0),
-    texture_id_(0) {}
+    texture_id_(0),
+    data_(nullptr) {}
 
 GLBitmap::GLBitmap(int w, int h, uint32_t* data)
   : width_(w),
@@ -34,24 +35,33 @@ uint32_t* GLBitmap::Allocate(uint32_t* data, bool claim_ownership) {
     data_ = data ? data : new uint32_t[width_ * height_]();
     owned_data_.reset(claim_ownership ? data_ : nullptr);
 
-    if (texture_id_)
+    if (texture_id_) {
         glDeleteTextures(1, &texture_id_);
-
-    glEnable(GL_TEXTURE_2D);
-    glGenTextures(1, &texture_id_);
-    glBindTexture(GL_TEXTURE_2D, texture_id_);
-    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA,
-                 width_, height_, 0, GL_RGBA,
-                 GL_UNSIGNED_BYTE, (void*)data_);
-    glBindTexture(GL_TEXTURE_2D, 0);
+        texture_id_ = 0;
+    }
     return data_;
 }
 
+GLuint GLBitmap::texture_id() {
+    if (!texture_id_ && data_) {
+        glEnable(GL_TEXTURE_2D);
+        glGenTextures(1, &texture_id_);
+        glBindTexture(GL_TEXTURE_2D, texture_id_);
+        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA,
+                     width_, height_, 0, GL_RGBA,
+                     GL_UNSIGNED_BYTE, (void*)data_);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+    return texture_id_;
+}
+
 void GLBitmap::Update() {
+    if (!texture_id_)
+        return;
     glBindTexture(GL_TEXTURE_2D, texture_id_);
     glTexSubImage2D(GL_TEXTURE_2D, 0,
                     0, 0, width_, height_,
@@ -59,10 +69,22 @@ void GLBitmap::Update() {
     glBindTexture(GL_TEXTURE_2D, 0);
 }
 
+void GLBitmap::Update(int x, int y, int w, int h) {
+    if (!texture_id_)
+        return;
+    glBindTexture(GL_TEXTURE_2D, texture_id_);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, width_);
+    glTexSubImage2D(GL_TEXTURE_2D, 0,
+                    x, y, w, h,
+                    GL_RGBA, GL_UNSIGNED_BYTE, (void*)(data_ + y*width_ + x));
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
 void GLBitmap::Draw(int w, int h) {
     if (w == 0) w = width_;
     if (h == 0) h = height_;
-    ImGui::Image(ImTextureID(uintptr_t(texture_id_)), ImVec2(w, h));
+    ImGui::Image(ImTextureID(uintptr_t(texture_id())), ImVec2(w, h));
 }
 
 void GLBitmap::DrawAt(int x, int y, int w, int h) {
@@ -7,6 +7,10 @@
 // FIXME(cfrantz): probably include the real opengl headers
 #include <SDL2/SDL_opengl.h>
 
+// An RGBA bitmap and the GL texture it is drawn from.  The texture is
+// created from the pixels the first time the bitmap is drawn; until then
+// Update is a no-op, so a GLBitmap can be built and drawn into on a thread
+// without a GL context and handed to the UI thread afterwards.
 class GLBitmap {
   public:
     GLBitmap();
@@ -16,12 +20,17 @@ class GLBitmap {
 
     uint32_t* Allocate(uint32_t* data=nullptr, bool claim_ownership=true);
     void Update();
+    // Upload only the given rectangle of the bitmap to the texture.
+    void Update(int x, int y, int w, int h);
     void Draw(int w=0, int h=0);
     void DrawAt(int x, int y, int w=0, int h=0);
     void DrawAt(int x, int y, float scale);
 
     inline uint32_t* data() { return data_; }
-    inline GLuint texture_id() { return texture_id_; }
+    // Creates the texture if it doesn't exist yet.
+    GLuint texture_id();
+    // Whether the texture has been created, i.e. the bitmap was drawn.
+    inline bool has_texture() const { return texture_id_ != 0; }
     inline void SetPixel(int x, int y, uint32_t color) {
         data_[y * width_ + x] = color;
     }
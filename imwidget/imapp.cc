@@ -89,7 +89,7 @@ void ImApp::InitControllers() {
     }
 }
 
-void ImApp::Quit(DebugConsole* console, int argc, char **argv) {
+void ImApp::Quit(Console* console, int argc, char **argv) {
     running_ = false;
 }
 
@@ -37,14 +37,14 @@ class ImApp {
 
     // Convenience helpers for registering debug console commands
     inline void RegisterCommand(const char* cmd, const char* shorthelp,
-                                std::function<void(DebugConsole*,
+                                std::function<void(Console*,
                                                    int argc, char **argv)> fn) {
         console_.RegisterCommand(cmd, shorthelp, fn);
     }
 
     template<typename T>
     inline void RegisterCommand(const char* cmd, const char* shorthelp,
-                         T* that, void (T::*fn)(DebugConsole*,
+                         T* that, void (T::*fn)(Console*,
                                                 int argc, char **argv)) {
         console_.RegisterCommand(cmd, shorthelp, that, fn);
     }
@@ -66,7 +66,7 @@ class ImApp {
     std::vector<std::unique_ptr<ImWindowBase>> draw_callback_;
 
   private:
-    void Quit(DebugConsole* console, int argc, char **argv);
+    void Quit(Console* console, int argc, char **argv);
     static void AudioCallback_(void* userdata, uint8_t* stream, int len);
 
     static ImApp* singleton_;
@@ -1,9 +1,9 @@
 #ifndef Z2UTIL_IMWIDGET_IMWIDGET_H
 #define Z2UTIL_IMWIDGET_IMWIDGET_H
-
+#include <atomic>
 
 inline int UniqueID() {
-    static int id;
+    static std::atomic<int> id;
     return ++id;
 }
 
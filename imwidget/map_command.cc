@@ -2,13 +2,13 @@
 #include <algorithm>
 #include "imwidget/map_command.h"
 
+#include "imwidget/area_cache.h"
 #include "imwidget/error_dialog.h"
 #include "imwidget/imapp.h"
 #include "imwidget/imutil.h"
-#include "imwidget/overworld_encounters.h"
 #include "imwidget/simplemap.h"
 #include "imgui.h"
-#include "nes/enemylist.h"
+#include "nes/area_index.h"
 #include "util/config.h"
 #include "absl/strings/str_cat.h"
 
@@ -16,131 +16,54 @@
 
 namespace z2util {
 
-const DecompressInfo* MapCommand::info_[NR_AREAS][NR_SETS][16];
-const char* MapCommand::object_names_[NR_AREAS][NR_SETS][16];
-const char* MapCommand::collectable_names_[MAX_COLLECTABLE];
-void MapCommand::Init() {
-    static bool done;
-    static char names[NR_AREAS][NR_SETS][16][64];
-    static char collectable[MAX_COLLECTABLE][32];
-    if (done)
-        return;
-    memset(info_, 0, sizeof(info_));
-    memset(object_names_, 0, sizeof(object_names_));
-    for(int i=0; i<NR_AREAS; i++) {
-        for(int j=0; j<NR_SETS; j++) {
-            for(int k=0; k<16; k++) {
-                if (j==0 && k==15) {
-                    sprintf(names[i][j][k], "%02x: collectable",
-                            (j==0 || j==3)? k : k<<4);
-                } else {
-                    sprintf(names[i][j][k], "%02x: ???",
-                            (j==0 || j==3)? k : k<<4);
-                }
-                object_names_[i][j][k] = names[i][j][k];
-            }
-        }
-    }
-    const auto& ri = ConfigLoader<RomInfo>::GetConfig();
-    for(const auto& d : ri.decompress()) {
-        int id = d.id();
-        int val = id;
-        if (id & 0xF0) {
-            id >>= 4;
-        }
-        snprintf(names[d.area()][d.type()][id], 63,
-                 "%02x: %s", val, d.comment().c_str());
-        info_[d.area()][d.type()][id] = &d;
-    }
-    for(int i=0; i<MAX_COLLECTABLE; i++) {
-        const auto& c = ri.items().info().find(i);
-        if (c == ri.items().info().end()) {
-            snprintf(collectable[i], 31, "%02x: ???", i);
-        } else {
-            snprintf(collectable[i], 31, "%02x: %s", i, c->second.name().c_str());
-        }
-        collectable_names_[i] = collectable[i];
-    }
-    done = true;
-}
-
-MapCommand::MapCommand(const MapHolder* holder, uint8_t position,
-                       uint8_t object, uint8_t extra)
-  : id_(UniqueID()),
+MapCommand::MapCommand(const MapHolder* holder, SideviewCommand* command,
+                       int id)
+  : id_(id),
     holder_(holder),
-    show_origin_(true),
-    position_(position),
-    object_(object),
-    extra_(extra),
-    summary_(nullptr)
-{
-    data_.x = position_ & 0xf;
-    data_.y = position_ >> 4;
-    Init();
-}
+    command_(command) {}
 
-MapCommand::MapCommand(const MapHolder* holder, int x0, uint8_t position,
-                       uint8_t object, uint8_t extra)
-  : MapCommand(holder, position, object, extra)
-{
-    if (data_.y == 14) {
-        data_.absx = data_.x * 16;
-    } else {
-        data_.absx = data_.x + x0;
-    }
-}
-
-MapCommand::MapCommand(const MapCommand& other)
-  : id_(UniqueID()),
-    holder_(other.holder_),
-    show_origin_(other.show_origin_),
-    position_(other.position_),
-    object_(other.object_),
-    extra_(other.extra_),
-    data_(other.data_),
-    summary_(nullptr) {}
-
-MapCommand MapCommand::Copy() {
-    MapCommand copy = *this;
-    copy.id_ = UniqueID();
-    return copy;
+const char* MapCommand::Summary() const {
+    return holder_->sideview().ObjectName(*command_);
 }
 
 bool MapCommand::Draw(bool abscoord, bool popup) {
     bool changed = false;
+    int* y = command_->mutable_absy();
     const char *xpos = "x position";
     const char *ypos = "y position";
-    if (data_.y == 13) {
-        summary_ = ypos = "new floor ";
-    } else if (data_.y == 14) {
-        summary_ = ypos = "x skip    ";
+    if (*y == 13) {
+        ypos = "new floor ";
+    } else if (*y == 14) {
+        ypos = "x skip    ";
         xpos = "to screen#";
-    } else if (data_.y == 15) {
+    } else if (*y == 15) {
         ypos = "extra obj ";
     }
 
     ImGui::PushID(id_);
     ImGui::PushItemWidth(100);
-    changed |= ImGui::InputInt(ypos, &data_.y);
-    Clamp(&data_.y, 0, 15);
+    changed |= ImGui::InputInt(ypos, y);
+    Clamp(y, 0, 15);
 
     if (!popup) ImGui::SameLine();
-    if (data_.y != 14 && abscoord) {
-        changed |= ImGui::InputInt(xpos, &data_.absx);
-        Clamp(&data_.absx, 0, 63);
+    if (*y != 14 && abscoord) {
+        changed |= ImGui::InputInt(xpos, command_->mutable_absx());
+        Clamp(command_->mutable_absx(), 0, 63);
     } else {
-        changed |= ImGui::InputInt(xpos, &data_.x);
-        Clamp(&data_.x, 0, 15);
+        changed |= ImGui::InputInt(xpos, command_->mutable_relx());
+        Clamp(command_->mutable_relx(), 0, 15);
     }
 
-    if (data_.y == 13 || data_.y == 14) {
+    if (*y == 13 || *y == 14) {
         if (!popup) ImGui::SameLine();
-        int val = object_;
+        int val = command_->object();
         if (ImGui::InputInt("param", &val)) {
-            object_ = val;
+            command_->set_object(val);
             changed |= true;
         }
     } else {
+        const ObjectNames& on = holder_->object_names();
+        const char *names[ObjectNames::NR_SETS * 16];
         int n = 0;
         int large_start = 0;
         int extra_start = 0;
@@ -148,75 +71,76 @@ bool MapCommand::Draw(bool abscoord, bool popup) {
         int type = holder_->map().type();
         int oindex = 1 + !!(holder_->flags() & 0x80);
 
-        for(int i=0; i<NR_SETS; i++) {
+        for(int i=0; i<ObjectNames::NR_SETS; i++) {
             if (i==1) large_start = n;
             if (i==3) extra_small_start = n;
             if (i==4) extra_start = n;
             if ((i==1 || i==2) && i != oindex)
                 continue;
             for(int j=0; j<16; j++) {
-                names_[n++] = object_names_[type][i][j];
+                names[n++] = on.object_name(type, i, j);
             }
         }
 
-        if (data_.y == 15) {
+        uint8_t object = command_->object();
+        int index, param;
+        int extra = command_->extra();
+        if (*y == 15) {
             // y==15 means objects in the "extra" object set, which is not
-            // to be confused with the extra_ data element, meant to hold
-            // the ID of collectable items.
-            if ((object_ & 0xF0) == 0) {
+            // to be confused with the extra byte, meant to hold the ID of
+            // collectable items.
+            if ((object & 0xF0) == 0) {
                 oindex = 3;
-                data_.object = extra_small_start + object_;
-                data_.param = 0;
+                index = extra_small_start + object;
+                param = 0;
             } else {
                 oindex = 4;
-                data_.object = extra_start + (object_ >> 4);
-                data_.param = object_ & 0x0F;
+                index = extra_start + (object >> 4);
+                param = object & 0x0F;
             }
-        } else if ((object_ & 0xF0) == 0) {
+        } else if ((object & 0xF0) == 0) {
             oindex = 0;
-            data_.object = object_ & 0x0F;
-            data_.param = 0;
+            index = object & 0x0F;
+            param = 0;
         } else {
-            data_.object = large_start + (object_ >> 4);
-            data_.param = object_ & 0x0F;
+            index = large_start + (object >> 4);
+            param = object & 0x0F;
         }
-        data_.extra = extra_;
 
         ImGui::PushItemWidth(200);
         if (!popup) ImGui::SameLine();
-        changed |= ImGui::Combo("id", &data_.object, names_, n);
-        summary_ = names_[data_.object];
+        changed |= ImGui::Combo("id", &index, names, n);
         ImGui::PopItemWidth();
         if (changed) {
-            printf("changed to %d (%02x) %s\n", data_.object, data_.object,
-                    names_[data_.object]);
+            printf("changed to %d (%02x) %s\n", index, index, names[index]);
         }
 
         // All of the object names start with their ID in hex, so we just
         // parse the value out of the name.
-        object_ = strtoul(names_[data_.object], 0, 16);
+        object = strtoul(names[index], 0, 16);
 
         // If the index from the combobox is >= the "extra" items, then
         // set y to the magic 'extra items' value.
-        if (data_.object >= extra_small_start) {
-            data_.y = 15;
-        } else if (data_.object < extra_small_start && data_.y == 15) {
-            data_.y = 12;
+        if (index >= extra_small_start) {
+            *y = 15;
+        } else if (index < extra_small_start && *y == 15) {
+            *y = 12;
         }
         if (oindex !=0 && oindex != 3) {
             if (!popup) ImGui::SameLine();
-            changed |= ImGui::InputInt("param", &data_.param);
-            Clamp(&data_.param, 0, 15);
-            object_ |= data_.param;
-        } else if (object_ == 15) {
+            changed |= ImGui::InputInt("param", &param);
+            Clamp(&param, 0, 15);
+            object |= param;
+        } else if (object == 15) {
             if (!popup) ImGui::SameLine();
             ImGui::PushItemWidth(200);
-            changed |= ImGui::Combo("##collectable", &data_.extra,
-                                    collectable_names_, MAX_COLLECTABLE);
-            summary_ = collectable_names_[data_.extra];
+            changed |= ImGui::Combo("##collectable", &extra,
+                                    holder_->object_names().collectable_names(),
+                                    ObjectNames::MAX_COLLECTABLE);
             ImGui::PopItemWidth();
-            extra_ = data_.extra;
+            command_->set_extra(extra);
         }
+        command_->set_object(object);
     }
     ImGui::PopItemWidth();
     ImGui::PopID();
@@ -231,44 +155,45 @@ MapCommand::DrawResult MapCommand::DrawPopup(float scale) {
     uint32_t color = 0xFFFFFFFF;
     auto* draw = ImGui::GetWindowDrawList();
     float size = 16.0 * scale;
-    float yp = data_.y;
+    int absx = command_->absx();
+    float yp = command_->absy();
     if (yp > 13) yp = 13;
 
-    if (show_origin_) {
-        ImVec2 a = ImVec2(abs.x + data_.absx * size, abs.y + yp * size);
+    if (holder_->show_origin()) {
+        ImVec2 a = ImVec2(abs.x + absx * size, abs.y + yp * size);
         ImVec2 b = ImVec2(a.x + size, a.y + size);
         draw->AddRect(a, b, color, 0, ~0, 2.0f);
-        if (data_.y == 13) {
+        if (command_->absy() == 13) {
             // New floor
             for(int i=0; i<16; i+=4) {
-                ImVec2 a = ImVec2(abs.x + data_.absx * size + (i + 4) * scale,
+                ImVec2 a = ImVec2(abs.x + absx * size + (i + 4) * scale,
                                   abs.y + yp * size + 8 * scale);
-                ImVec2 b = ImVec2(abs.x + data_.absx * size + (i + 0) * scale,
+                ImVec2 b = ImVec2(abs.x + absx * size + (i + 0) * scale,
                                   abs.y + yp * size + 14 * scale);
                 draw->AddLine(a, b, color);
             }
-        } else if (data_.y == 14) {
+        } else if (command_->absy() == 14) {
             // X skip
-            ImVec2 a = ImVec2(abs.x + data_.absx * size + 4 * scale,
+            ImVec2 a = ImVec2(abs.x + absx * size + 4 * scale,
                               abs.y + yp * size + 4 * scale);
-            ImVec2 b = ImVec2(abs.x + data_.absx * size + 4 * scale,
+            ImVec2 b = ImVec2(abs.x + absx * size + 4 * scale,
                               abs.y + yp * size + 12 * scale);
-            ImVec2 c = ImVec2(abs.x + data_.absx * size + 12 * scale,
+            ImVec2 c = ImVec2(abs.x + absx * size + 12 * scale,
                               abs.y + yp * size + 8 * scale);
             draw->AddTriangleFilled(a, b, c, color);
         }
     }
 
     ImGui::PushID(-id_);
-    ImGui::SetCursorPos(ImVec2(pos.x + data_.absx * size, pos.y + yp * size));
+    ImGui::SetCursorPos(ImVec2(pos.x + absx * size, pos.y + yp * size));
     ImGui::InvisibleButton("button", ImVec2(size, size));
     if (ImGui::IsItemHovered()) {
-        ImGui::SetTooltip("%s", summary_ ? summary_ : "unknown");
+        ImGui::SetTooltip("%s", Summary());
         int delta = int(ImGui::GetIO().MouseWheel);
-        if (delta && (object_ & 0xF0) != 0) {
-            data_.param = object_ & 0x0F;
-            data_.param = Clamp(data_.param - delta, 0, 15);
-            object_ = (object_ & 0xF0) | data_.param;
+        uint8_t object = command_->object();
+        if (delta && (object & 0xF0) != 0) {
+            int param = Clamp((object & 0x0F) - delta, 0, 15);
+            command_->set_object((object & 0xF0) | param);
             result = DR_CHANGED;
         }
     }
@@ -278,12 +203,12 @@ MapCommand::DrawResult MapCommand::DrawPopup(float scale) {
             int y = int((ImGui::GetIO().MousePos.y - abs.y) / size);
             x = Clamp(x, 0, 64);
             y = Clamp(y, 0, 12);
-            if (x != data_.absx) {
-                data_.absx = x;
+            if (x != absx) {
+                *command_->mutable_absx() = x;
                 result = DR_CHANGED;
             }
             if (yp < 13 && y != yp) {
-                data_.y = y;
+                *command_->mutable_absy() = y;
                 result = DR_CHANGED;
             }
         }
@@ -306,16 +231,13 @@ MapCommand::DrawResult MapCommand::DrawPopup(float scale) {
     return result;
 }
 
-std::vector<uint8_t> MapCommand::Command() {
-    position_ = (data_.y << 4) | data_.x;
-    if (data_.y < 13 && object_ == 15) {
-        return {position_, object_, extra_};
-    }
-    return {position_, object_};
-}
-
 
-MapHolder::MapHolder(Mapper* m) : mapper_(m) {}
+MapHolder::MapHolder(RomContext* rom)
+  : rom_(rom),
+    sideview_(rom),
+    show_origin_(true),
+    data_changed_(false),
+    addr_changed_(false) {}
 MapHolder::MapHolder() : MapHolder(nullptr) {}
 
 const char* ground_names[] = {
@@ -329,55 +251,32 @@ const char* ground_names[] = {
     "TileSet (outside)",
 };
 
-void MapHolder::Unpack() {
-    data_.objset = !!(flags_ & 0x80);
-    data_.width = 1 + ((flags_ >> 5) & 3);
-    data_.grass = !!(flags_ & 0x08);
-    data_.bushes = !!(flags_ & 0x04);
-    data_.ceiling = !(ground_ & 0x80);
-    data_.ground = (ground_ >> 4) & 7;
-    data_.floor = ground_ & 0xf;
-    data_.spal = (back_ >> 6) & 3;
-    data_.bpal = (back_ >> 3) & 7;
-    data_.bmap = back_ & 7;
-}
-
-void MapHolder::Pack() {
-    flags_ = (data_.objset << 7) |
-             ((data_.width-1) << 5) |
-             (int(data_.grass) << 3) |
-             (int(data_.bushes) << 2);
-    ground_ = (int(!data_.ceiling) << 7) | (data_.ground << 4) | (data_.floor);
-    back_ = (data_.spal << 6) | (data_.bpal << 3) | data_.bmap;
-}
-
-void BytesToHexString(const uint8_t(&bytes)[255], char(&hexStr)[511]) {
-    uint8_t length = bytes[0];
-    for (uint8_t i = 0; i < length; ++i) {
-        std::sprintf(&hexStr[i * 2], "%02X", bytes[i]);
+std::string BytesToHexString(const std::vector<uint8_t>& bytes) {
+    size_t length = bytes.empty() ? 0 : std::min<size_t>(bytes[0],
+                                                         bytes.size());
+    std::string hex;
+    char buf[3];
+    for(size_t i = 0; i < length; ++i) {
+        snprintf(buf, sizeof(buf), "%02X", bytes[i]);
+        hex += buf;
     }
-    hexStr[length * 2] = '\0'; // null-terminate
+    return hex;
 }
 
-void HexStringToBytes(const char(&hexStr)[511], uint8_t(&bytes)[255]) {
-    size_t j = 1;
-    for (size_t i = 0; i < 510; i += 2) {
-        j = i / 2;
-        unsigned int byte;
-        if (std::sscanf(&hexStr[i], "%2X", &byte) != 1) {
+std::vector<uint8_t> HexStringToBytes(const char* hex) {
+    std::vector<uint8_t> bytes;
+    unsigned int byte;
+    for(size_t i = 0; hex[i] && hex[i+1]; i += 2) {
+        if (std::sscanf(hex + i, "%2X", &byte) != 1) {
             break;
         }
-        bytes[j] = static_cast<uint8_t>(byte);
+        bytes.push_back(byte);
     }
-    bytes[0] = static_cast<uint8_t>(j); // put length in first byte
-}
-
-void MapHolder::ReadSideview() {
-    uint8_t length = mapper_->ReadPrgBank(map_bank_, map_addr_);
-    for (uint8_t i = 0; i < length; ++i) {
-        uint8_t b = mapper_->ReadPrgBank(map_bank_, map_addr_ + i);
-        sideviewBytes_[i] = b;
+    if (bytes.empty()) {
+        bytes.push_back(1);
     }
+    bytes[0] = bytes.size(); // put length in first byte
+    return bytes;
 }
 
 MapHolder::DrawResult MapHolder::Draw() {
@@ -385,96 +284,105 @@ MapHolder::DrawResult MapHolder::Draw() {
     char abuf[8];
     bool changed = false;
     bool achanged = false;
-    char sideviewHex[511] = { '0', '1', '\0' };
+    char sideviewHex[511];
     bool hchanged = false;
-    Unpack();
+    const Map& map = sideview_.map();
+    Sideview::Unpacked* data = sideview_.mutable_data();
+    sideview_.Unpack();
 
     ImGui::Text("Map pointer at bank=0x%x address=0x%04x",
-                map_.pointer().bank(), map_.pointer().address());
+                map.pointer().bank(), map.pointer().address());
 
     ImGui::AlignTextToFramePadding();
-    ImGui::Text("Map address at bank=0x%x address=", map_bank_);
+    ImGui::Text("Map address at bank=0x%x address=", sideview_.bank());
 
     ImGui::PushItemWidth(100);
-    sprintf(abuf, "%04x", map_addr_);
+    sprintf(abuf, "%04x", sideview_.address());
     ImGui::SameLine();
     achanged = ImGui::InputText("##addr", abuf, 5,
                                 ImGuiInputTextFlags_CharsHexadecimal |
                                 ImGuiInputTextFlags_EnterReturnsTrue);
     if (achanged) {
-        map_addr_ = strtoul(abuf, 0, 16);
-        Parse();
+        sideview_.set_address(strtoul(abuf, 0, 16));
+        sideview_.Parse();
         addr_changed_ |= achanged;
         return DR_PALETTE_CHANGED;
     }
 
     ImGui::Text("SideView data [Press Enter after you paste here] [Updated on Commit to ROM]");
-    BytesToHexString(sideviewBytes_, sideviewHex);
+    snprintf(sideviewHex, sizeof(sideviewHex), "%s",
+             BytesToHexString(sideview_.bytes()).c_str());
     ImGui::PushItemWidth(800);
     hchanged = ImGui::InputText("bytes", sideviewHex, 510,
         ImGuiInputTextFlags_CharsHexadecimal |
         ImGuiInputTextFlags_EnterReturnsTrue);
     if (hchanged) {
-        HexStringToBytes(sideviewHex, sideviewBytes_);
-        Parse();
-        changed = true;
+        sideview_.Parse(HexStringToBytes(sideviewHex));
+        data_changed_ = true;
         return DR_PALETTE_CHANGED;
     }
 
     ImGui::PushItemWidth(100);
-    ImGui::Text("Length = %d bytes.", length_);
+    ImGui::Text("Length = %d bytes.", sideview_.length());
 
     ImGui::Text("Flags:");
-    changed |= ImGui::InputInt("Object Set", &data_.objset);
-    Clamp(&data_.objset, 0, 1);
+    changed |= ImGui::InputInt("Object Set", &data->objset);
+    Clamp(&data->objset, 0, 1);
 
     ImGui::SameLine();
-    changed |= ImGui::InputInt("Width", &data_.width);
-    Clamp(&data_.width, 1, 4);
+    changed |= ImGui::InputInt("Width", &data->width);
+    Clamp(&data->width, 1, 4);
 
     ImGui::SameLine();
-    changed |= ImGui::Checkbox("Grass", &data_.grass);
+    changed |= ImGui::Checkbox("Grass", &data->grass);
 
     ImGui::SameLine();
-    changed |= ImGui::Checkbox("Bushes", &data_.bushes);
+    changed |= ImGui::Checkbox("Bushes", &data->bushes);
 
     ImGui::SameLine();
-    changed |= ImGui::Checkbox("Cursor Moves Left", &cursor_moves_left_);
+    bool cursor_moves_left = sideview_.cursor_moves_left();
+    if (ImGui::Checkbox("Cursor Moves Left", &cursor_moves_left)) {
+        sideview_.set_cursor_moves_left(cursor_moves_left);
+        changed = true;
+    }
 
     ImGui::Text("Ground:");
-    changed |= ImGui::Checkbox("Ceiling", &data_.ceiling);
+    changed |= ImGui::Checkbox("Ceiling", &data->ceiling);
 
     ImGui::SameLine();
-    changed |= ImGui::InputInt(ground_names[data_.ground], &data_.ground);
-    Clamp(&data_.ground, 0, 7);
+    changed |= ImGui::InputInt(ground_names[data->ground], &data->ground);
+    Clamp(&data->ground, 0, 7);
 
     ImGui::SameLine();
-    changed |= ImGui::InputInt("Floor", &data_.floor);
-    Clamp(&data_.floor, 0, 15);
+    changed |= ImGui::InputInt("Floor", &data->floor);
+    Clamp(&data->floor, 0, 15);
 
     ImGui::Text("Background:");
-    if (ImGui::InputInt("Spr Palette", &data_.spal)) {
+    if (ImGui::InputInt("Spr Palette", &data->spal)) {
         changed |= true;
         result = DR_PALETTE_CHANGED;
     }
-    Clamp(&data_.spal, 0, 3);
+    Clamp(&data->spal, 0, 3);
 
     ImGui::SameLine();
-    if (ImGui::InputInt("BG Palette", &data_.bpal)) {
+    if (ImGui::InputInt("BG Palette", &data->bpal)) {
         changed |= true;
         result = DR_PALETTE_CHANGED;
     }
-    Clamp(&data_.bpal, 0, 7);
+    Clamp(&data->bpal, 0, 7);
 
     ImGui::SameLine();
-    changed |= ImGui::InputInt("BG Map", &data_.bmap);
-    Clamp(&data_.bmap, 0, 7);
+    changed |= ImGui::InputInt("BG Map", &data->bmap);
+    Clamp(&data->bmap, 0, 7);
+    // The command editors look at the object set in the flags.
+    sideview_.Pack();
 
     ImGui::Text("Command List:");
     ImGui::BeginChild("commands", ImGui::GetContentRegionAvail(), true);
 
+    auto* command = sideview_.mutable_command();
     int i = 0, lastx = 0;;
-    for(auto it = command_.begin(); it < command_.end(); ++it, ++i) {
+    for(auto it = command->begin(); it < command->end(); ++it, ++i) {
         auto next = it + 1;
         bool create = false;
         bool copy = false;
@@ -491,7 +399,7 @@ MapHolder::DrawResult MapHolder::Draw() {
             ImGui::SetTooltip("Insert a new command\nCtrl+Click to copy");
 
         ImGui::SameLine();
-        if (ImGui::Button(ICON_FA_CARET_DOWN)) {
+        if (ImGui::Button(ICON_FA_CARET_DOWN) && next < command->end()) {
             changed = true;
             std::swap(*it, *next);
         }
@@ -499,174 +407,77 @@ MapHolder::DrawResult MapHolder::Draw() {
           ImGui::SetTooltip("Move command down");
 
         ImGui::SameLine();
-        changed |= it->Draw(true);
+        changed |= MapCommand(this, &*it, i).Draw(true);
 
         ImGui::SameLine();
         if (ImGui::Button(ICON_FA_TIMES_CIRCLE)) {
             changed = true;
-            it = command_.erase(it);
+            it = command->erase(it);
         }
         if (ImGui::IsItemHovered())
           ImGui::SetTooltip("Delete this command");
         ImGui::PopID();
         if (create) {
-            if (copy)
-                it = command_.insert(it, it->Copy());
-            else
-                it = command_.emplace(it, this, it->absx(), 0, 0, 0);
+            if (copy) {
+                SideviewCommand dup = *it;
+                it = command->insert(it, dup);
+            } else {
+                it = command->emplace(it, it->absx(), 0, 0, 0);
+            }
         }
     }
     if (ImGui::Button(ICON_FA_CARET_SQUARE_O_UP)) {
         changed = true;
-        command_.emplace_back(this, lastx, 0, 0, 0);
+        command->emplace_back(lastx, 0, 0, 0);
     }
     if (ImGui::IsItemHovered())
         ImGui::SetTooltip("Append a new command");
 
     ImGui::EndChild();
     ImGui::PopItemWidth();
-    Pack();
+    sideview_.Pack();
     data_changed_ |= changed;
     return (changed && result == DR_NONE) ? DR_CHANGED : result;;
 }
 
 bool MapHolder::DrawPopup(float scale) {
     bool changed = false;
-    for(auto it = command_.begin(); it < command_.end(); ++it) {
-        auto result = it->DrawPopup(scale);
+    auto* command = sideview_.mutable_command();
+    int i = 0;
+    ImGui::PushID("commands");
+    for(auto it = command->begin(); it < command->end(); ++it, ++i) {
+        auto result = MapCommand(this, &*it, i).DrawPopup(scale);
         switch(result) {
             case MapCommand::DR_NONE:
                 break;
             case MapCommand::DR_CHANGED:
                 changed |= true;
                 break;
-            case MapCommand::DR_COPY:
-                it = command_.insert(it, it->Copy());
+            case MapCommand::DR_COPY: {
+                SideviewCommand dup = *it;
+                it = command->insert(it, dup);
                 changed |= true;
                 break;
+            }
             case MapCommand::DR_DELETE:
-                it = command_.erase(it);
+                it = command->erase(it);
                 changed |= true;
                 break;
         }
     }
+    ImGui::PopID();
     data_changed_ |= changed;
     return changed;
 }
 
 void MapHolder::Parse(const z2util::Map& map, uint16_t altaddr) {
-    map_ = map;
-    // For side view maps, the map address is the address of a pointer
-    // to the real address.  Read it and set the real address.
-    Address address = mapper_->ReadAddr(map.pointer(), 0);
-    if (altaddr) {
-        address.set_address(altaddr);
-    }
-    if (map.type() == MapType::PALACE || map.type() == MapType::GREAT_PALACE) {
-        map_bank_ = 0x1c;
-    }
-    else {
-        map_bank_ = address.bank();
-    }
-    *map_.mutable_address() = address;
-    map_addr_ = address.address();
-    ReadSideview();
-    Parse();
-}
-
-void MapHolder::Parse() {
-    length_ = sideviewBytes_[0];
-    flags_ = sideviewBytes_[1];
-    ground_ = sideviewBytes_[2];
-    back_ = sideviewBytes_[3];
-    Unpack();
-
-    command_.clear();
-    int absx = 0;
-    for(int i=4; i<length_; i+=2) {
-        uint8_t pos = sideviewBytes_[i];
-        uint8_t obj = sideviewBytes_[i + 1];
-        uint8_t extra = 0;
-
-        int y = pos >> 4;
-        if (y < 13 && obj == 15) {
-            i++;
-            extra = sideviewBytes_[i + 1];
-        }
-        command_.emplace_back(this, absx, pos, obj, extra);
-        absx = command_.back().absx();
-    }
+    sideview_.Parse(map, altaddr);
     data_changed_ = false;
     addr_changed_ = false;
 }
 
-std::vector<uint8_t> MapHolder::MapDataWorker(std::vector<MapCommand>& list) {
-    std::vector<uint8_t> map = {length_, flags_, ground_, back_};
-    for(auto& cmd : list) {
-        auto bytes = cmd.Command();
-        map.insert(map.end(), bytes.begin(), bytes.end());
-#ifndef NDEBUG
-        // Turn this log message off in non-debug builds, as this method is
-        // in the sideview editors draw loop.
-        LOG(INFO, "CMD: op = ", HEX(bytes[0]), " ", HEX(bytes[1]));
-#endif
-    }
-    map[0] = map.size();
-    return map;
-}
-
-void MapHolder::Append(const MapCommand& cmd) {
-    command_.push_back(cmd);
-}
-
-void MapHolder::Extend(const std::vector<MapCommand>& cmds) {
-    command_.insert(command_.end(), cmds.begin(), cmds.end());
-}
-
-std::vector<uint8_t> MapHolder::MapData() {
-    return MapDataWorker(command_);
-}
-
-std::vector<uint8_t> MapHolder::MapDataAbs() {
-    std::vector<MapCommand> copy = command_;
-    if (!cursor_moves_left_) {
-        std::stable_sort(copy.begin(), copy.end(),
-            [](const MapCommand& a, const MapCommand& b) {
-                if (a.absx() == b.absx()) {
-                    // Adjust y-coordinate so meta-ops appear before normal
-                    // map commands.
-                    int ya = (a.absy() + 3) % 16;
-                    int yb = (b.absy() + 3) % 16;
-                    return ya < yb;
-                }
-                return a.absx() < b.absx();
-            });
-    }
-    int x = 0;
-    for(auto it = copy.begin(); it < copy.end(); ++it) {
-        if (it->absy() == 14) {
-            // Erase any "skip" commands, as we'll re-synthesize them
-            // as needed.
-            it = copy.erase(it);
-            if (it == copy.end())
-                break;
-        }
-        int deltax = it->absx() - x;
-        if (deltax < 0 || deltax > 15) {
-            int nx = it->absx() & ~15;
-            it = copy.emplace(it, this, x, 0xE0 | (nx/16), 0, 0);
-            it++;
-            x = nx;
-            deltax = it->absx() - x;
-        }
-        it->set_relx(deltax);
-        x = it->absx();
-    }
-
-    return MapDataWorker(copy);
-}
-
 void MapHolder::Save(std::function<void()> finish, bool force) {
+    const Map& map = sideview_.map();
     if (!addr_changed_ && !data_changed_) {
         LOG(INFO, "No changes; nothing to save.");
         // Nothing to save.
@@ -675,7 +486,9 @@ void MapHolder::Save(std::function<void()> finish, bool force) {
     }
     if (addr_changed_ && !data_changed_) {
         LOG(INFO, "Address only changed.");
-        mapper_->WriteWord(map_.pointer(), 0, map_addr_);
+        rom_->mapper()->WriteWord(map.pointer(), 0, sideview_.address());
+        AreaCache::Get()->Invalidate(map.name());
+        AreaIndex::Get()->Update(rom_, map);
         addr_changed_ = false;
         finish();
         return;
@@ -685,74 +498,31 @@ void MapHolder::Save(std::function<void()> finish, bool force) {
             "Both the map data and map address have been changed.\n"
             "Allocating a new address and saving data.\n");
     }
-    Pack();
-    std::vector<uint8_t> data = MapDataAbs();
-    LOG(INFO, "Saving ", map_.name(), " (", data.size(), " bytes)");
-
 
     // Determine if any other maps point to the same map data
-    const auto& ri = ConfigLoader<RomInfo>::GetConfig();
-    std::vector<const Map*> sameptr;
-    std::string names = absl::StrCat(map_.name(), "\n");
-    for(const auto& m : ri.map()) {
-        Address mptr = mapper_->ReadAddr(m.pointer(), 0);
-        if (m.name() != map_.name() &&
-            mptr.bank() == map_.address().bank() &&
-            mptr.address() == map_.address().address()) {
-            sameptr.push_back(&m);
-            absl::StrAppend(&names, "+ ", m.name(), "\n");
-            LOG(INFO, "Duplicate data: ", m.name());
-        }
+    std::vector<const Map*> sameptr = sideview_.SharedWith();
+    std::string names = absl::StrCat(map.name(), "\n");
+    for(const auto* m : sameptr) {
+        absl::StrAppend(&names, "+ ", m->name(), "\n");
     }
 
-    Address addr = map_.address();
-    addr.set_bank(map_bank_);
-    addr.set_address(0x8000 | addr.address());
-    bool needfree = false;
-
-    if (data.size() > length_ || !sameptr.empty()) {
-        // Search the entire bank and allocate memory
-        addr.set_address(0);
-        addr = mapper_->Alloc(addr, data.size());
-        if (addr.address() == 0) {
-            ErrorDialog::Spawn("Error Saving Map",
-                "Can't save map: ", map_.name(), "\n\n"
-                "Can't find ", data.size(), " free bytes in bank ", addr.bank());
-            LOG(ERROR, "Can't save map: can't find ", data.size(), "bytes"
-                       " in bank=", addr.bank());
+    // Capture everything we need to save into a lambda so we can defer the
+    // action until after the user responds to an ErrorDialog.
+    auto dosave = [this, sameptr, finish](bool clone) {
+        auto status = sideview_.Save(clone);
+        if (!status.ok()) {
+            ErrorDialog::Spawn("Error Saving Map", status.error_message());
             // Can't finish.
             return;
         }
-        needfree = true;
-        length_ = data.size();
-    }
-
-    // Capture everything we need to save into a lambda so we can defer the
-    // action until after the user responds to an ErrorDialog.
-    auto dosave = [this, addr, data, sameptr, needfree, finish](bool clone) {
         if (clone) {
             for(const auto* m : sameptr) {
-                mapper_->WriteWordLegit(m->pointer(), 0, addr.address());
-            }
-            // Free the existing memory if it was owned by the allocator.
-            if (needfree) {
-                LOGF(INFO, "Freeing old map at %04x", map_.address().address());
-                mapper_->Free(map_.address());
-            } else {
-                LOGF(INFO, "No free needed at %04x", map_.address().address());
+                AreaCache::Get()->Invalidate(m->name());
+                AreaIndex::Get()->Update(rom_, *m);
             }
         }
-        *map_.mutable_address() = addr;
-        map_addr_ = addr.address();
-
-        LOGF(INFO, "Saving map to {bank: %d address: 0x%04x}",
-                   addr.bank(), addr.address());
-
-        for(unsigned i=0; i<data.size(); i++) {
-            mapper_->WriteLegit(addr, i, data[i]);
-        }
-        mapper_->WriteWordLegit(map_.pointer(), 0, addr.address());
-        Parse(map_, 0);
+        AreaCache::Get()->Invalidate(sideview_.map().name());
+        AreaIndex::Get()->Update(rom_, sideview_.map());
         data_changed_ = false;
         addr_changed_ = false;
         finish();
@@ -782,8 +552,8 @@ void MapHolder::Save(std::function<void()> finish, bool force) {
 }
 
 
-MapConnection::MapConnection(Mapper* m)
-  : mapper_(m) {}
+MapConnection::MapConnection(RomContext* rom)
+  : rom_(rom) {}
 
 MapConnection::MapConnection()
   : MapConnection(nullptr) {}
@@ -798,14 +568,14 @@ void MapConnection::Parse(const Map& map) {
     area_ = map.area();
 
     for(int i=0; i<4; i++) {
-        val = mapper_->Read(connector_, i);
+        val = rom_->mapper()->Read(connector_, i);
         data_[i].destination = val >> 2;
         data_[i].start = val & 3;
         fixtarget_[i] = false;
     }
     if (doors_.address() && area_ < kMaxDoorArea) {
         for(int i=0; i<4; i++) {
-            val = mapper_->Read(doors_, i);
+            val = rom_->mapper()->Read(doors_, i);
             data_[i+4].destination = val >> 2;
             data_[i+4].start = val & 3;
             fixtarget_[i+4] = false;
@@ -822,21 +592,21 @@ void MapConnection::Save() {
     base.set_address(base.address() - 4*area_);
     for(int i=0; i<4; i++) {
         uint8_t val = (data_[i].destination << 2) | (data_[i].start & 3);
-        mapper_->Write(connector_, i, val);
+        rom_->mapper()->Write(connector_, i, val);
         if (fixtarget_[i] && data_[i].destination != 63) {
             // Point the target back to this room / screen.
             // The previously computed val is the offset from the base address.
-            mapper_->Write(base, val, (area_ << 2) | i);
+            rom_->mapper()->Write(base, val, (area_ << 2) | i);
         }
     }
     if (doors_.address() && area_ < kMaxDoorArea) {
         for(int i=0; i<4; i++) {
             uint8_t val = (data_[i+4].destination << 2) | (data_[i+4].start & 3);
-            mapper_->Write(doors_, i, val);
+            rom_->mapper()->Write(doors_, i, val);
             if (fixtarget_[i+4] && data_[i+4].destination != 63) {
                 // Point the target back to this room / screen.
                 // The previously computed val is the offset from the base address.
-                mapper_->Write(base, val, (area_ << 2) | i);
+                rom_->mapper()->Write(base, val, (area_ << 2) | i);
             }
         }
     }
@@ -914,7 +684,7 @@ bool MapConnection::Draw() {
         if (data_[i].destination != len-1) {
             ImGui::SameLine();
             if (ImGui::Button(buttonlabel[i])) {
-                SimpleMap::Spawn(mapper_, *maps[data_[i].destination],
+                SimpleMap::Spawn(rom_, *maps[data_[i].destination],
                                  data_[i].start);
             }
 
@@ -926,27 +696,24 @@ bool MapConnection::Draw() {
     return chg;
 }
 
-MapEnemyList::MapEnemyList(Mapper* m)
-  : mapper_(m),
+MapEnemyList::MapEnemyList(RomContext* rom)
+  : rom_(rom),
     show_origin_(true),
-    is_large_(false),
-    is_encounter_(false),
-    world_(0),
-    overworld_(0),
-    subworld_(0),
-    area_(0),
-    display_(0) { }
+    display_(0),
+    enemies_(rom),
+    text_(rom) { }
 
 MapEnemyList::MapEnemyList() : MapEnemyList(nullptr) {}
 
 void MapEnemyList::Init() {
     const auto& ri = ConfigLoader<RomInfo>::GetConfig();
+    const Map& map = enemies_.map();
     for(int i=0; i<256; i++)
         names_[i] = "???";
 
     max_names_ = 0;
     for(const auto& e : ri.enemies()) {
-        if (e.world() == world_ && e.overworld() == overworld_) {
+        if (e.world() == map.world() && e.overworld() == map.overworld()) {
             for(const auto& info : e.info()) {
                 names_[info.first] = info.second.name().c_str();
                 if (info.first >= max_names_)
@@ -954,120 +721,14 @@ void MapEnemyList::Init() {
             }
         }
     }
-    data_.clear();
-}
-
-void MapEnemyList::LoadText(Unpacked* item) {
-    item->text[0] = item->text[1] = item->text[2] = -1;
-    if (map_.type() == MapType::TOWN && item->enemy >= 10) {
-        const auto& tt = ConfigLoader<RomInfo>::GetConfig().text_table();
-        const auto& ie = ConfigLoader<RomInfo>::GetConfig().item_effects();
-        int townsperson = item->enemy - 10;
-        int town = map_.code();
-        int idxtbl = (town >> 2) * 2;
-        int index = townsperson * 4 + (town & 3);
-        for(int j=0; j<2; j++, idxtbl++) {
-            if (index < tt.index(idxtbl).length()) {
-                item->text[j] = mapper_->Read(tt.index(idxtbl),
-                                                     index);
-                LOGF(INFO, "Enemy %d (townsperson %d), line %d: %04x -> %d",
-                     item->enemy, townsperson, j,
-                     tt.index(idxtbl).address()+index, item->text[j]);
-                if (item->text[j] == 255) {
-                    LOGF(ERROR, "Enemy $%02x has an invalid text index.", item->enemy);
-                }
-            }
-        }
-        if (item->enemy == 0x0f || item->enemy == 0x0d) {
-            // Wise man (wizard or knight) has a third dialog: "Go now..."
-            // Encoded under townsperson 15 dialog 2.
-            index = 15 * 4 + (town&3);
-            idxtbl = (town >> 2) * 2 + 1;
-            item->text[2] = mapper_->Read(tt.index(idxtbl), index);
-            if (item->text[2] == 255) {
-                LOGF(ERROR, "Enemy $%02x has an invalid text index.", item->enemy);
-            }
-        }
-        if (townsperson >= 9 && townsperson < 9+4) {
-            item->condition = mapper_->Read(ie.conditions_table(),
-                    (townsperson-9)*8 + town);
-        }
-    }
-}
-
-void MapEnemyList::ReadEnemyList() {
-    Address addr = mapper_->ReadAddr(pointer_, 0x7e);
-    uint16_t delta = 0x18a0;
-
-    // uint8_t length = mapper_->ReadPrgBank(map_bank_, map_addr_);
-    uint8_t length = mapper_->Read(addr, delta);
-    for (uint8_t i = 0; i < length; ++i) {
-        // uint8_t b = mapper_->ReadPrgBank(map_bank_, map_addr_ + i);
-        uint8_t b = mapper_->Read(addr, delta + i);
-        enemyListBytes_[i] = b;
-    }
-
-    if (is_encounter_) {
-        uint16_t delta2 = delta + length;
-        uint8_t length2 = mapper_->Read(addr, delta);
-        for (uint8_t i = 0; i < length2; ++i) {
-            // uint8_t b = mapper_->ReadPrgBank(map_bank_, map_addr_ + i);
-            uint8_t b = mapper_->Read(addr, delta2 + i);
-            enemyListBytes_[i] = b;
-        }
-    }
 }
 
 void MapEnemyList::Parse(const Map& map) {
-    map_ = map;
-    pointer_ = map.pointer();
-    world_ = map.world();
-    area_ = map.area();
-    overworld_ = map.overworld();
-    subworld_ = map.subworld();
-
+    enemies_.Parse(map);
+    display_ = 0;
     Init();
-    if (map_.type() == MapType::TOWN) {
-        text_.set_mapper(mapper_);
-        text_.Unpack(map_.pointer().bank());
-    }
-
-    // Check if this is an overworld random encounter area
-    OverworldEncounters enc;
-    enc.set_mapper(mapper_);
-    enc.set_map(map);
-    enc.Unpack();
-    is_encounter_ = enc.IsEncounter(area_);
-    ReadEnemyList();
-    Parse();
-}
-
-void MapEnemyList::Parse() {
-    data_.clear();
-
-    int delta = 0;
-    uint8_t length = enemyListBytes_[0];
-    if (is_large_) {
-        delta = length;
-        length = enemyListBytes_[delta];
-    }
-    for (int i = 1; i < length; i += 2) {
-        uint8_t pos = enemyListBytes_[delta + i];
-        uint8_t enemy = enemyListBytes_[delta + i + 1];
-        int y = pos >> 4;
-        y = (y == 0) ? 1 : y + 2;
-        data_.emplace_back(enemy & 0x3f,
-            (pos & 0xf) | (enemy & 0xc0) >> 2, y);
-
-        LoadText(&data_.back());
-    }
-
-    // Encounters have 2 enemy lists, so make another widget
-    large_.reset(nullptr);
-    if (is_encounter_ && !is_large_) {
-        large_.reset(new MapEnemyList(mapper_));
-        large_->is_large_ = true;
-        large_->Parse();
+    if (map.type() == MapType::TOWN) {
+        text_.Unpack(map.pointer().bank());
     }
 }
 
@@ -1124,14 +785,14 @@ MapEnemyList::DrawResult MapEnemyList::DrawOnePopup(Unpacked* item,
 }
 
 bool MapEnemyList::DrawPopup(float scale) {
-    if (large_ && large_->display_) {
-        return large_->DrawPopup(scale);
-    }
+    bool large = display_ && enemies_.large();
+    auto* list = large ? enemies_.large()->mutable_data()
+                       : enemies_.mutable_data();
 
     bool changed = false;
     int i=0;
-    for(auto it=data().begin(); it<data().end(); ++it, ++i) {
-        ImGui::PushID(-(i | (is_large_ << 8)));
+    for(auto it=list->begin(); it<list->end(); ++it, ++i) {
+        ImGui::PushID(-(i | (large << 8)));
         auto result = DrawOnePopup(&*it, scale);
         switch(result) {
             case MapEnemyList::DR_NONE:
@@ -1140,11 +801,11 @@ bool MapEnemyList::DrawPopup(float scale) {
                 changed |= true;
                 break;
             case MapEnemyList::DR_COPY:
-                it = data_.insert(it, *it);
+                it = list->insert(it, *it);
                 changed |= true;
                 break;
             case MapEnemyList::DR_DELETE:
-                it = data_.erase(it);
+                it = list->erase(it);
                 changed |= true;
                 break;
         }
@@ -1153,67 +814,14 @@ bool MapEnemyList::DrawPopup(float scale) {
     return changed;
 }
 
-std::vector<uint8_t> MapEnemyList::Pack() {
-    std::vector<uint8_t> packed;
-
-    uint8_t n = 1 + data_.size() * 2;
-    packed.push_back(n);
-    for(const auto& data : data_) {
-        int y = data.y;
-        y = (y <= 1) ? 0 : y-2;
-        uint8_t pos = (y << 4) | (data.x & 0x0F);
-        uint8_t enemy = (data.enemy & 0x3f) | (data.x & 0x30) << 2;
-        packed.push_back(pos);
-        packed.push_back(enemy);
-    }
-    return packed;
-}
-
 void MapEnemyList::Save() {
-    EnemyListPack ep(mapper_);
-    ep.Unpack(pointer_.bank());
-    auto data = Pack();
-    if (large_) {
-        auto more = large_->Pack();
-        data.insert(data.end(), more.begin(), more.end());
-    }
-    ep.Add(area_ + 63 * subworld_, data);
-    ep.Pack();
-
-    if (map_.type() == MapType::TOWN) {
-        const auto& tt = ConfigLoader<RomInfo>::GetConfig().text_table();
-        const auto& ie = ConfigLoader<RomInfo>::GetConfig().item_effects();
-        for(const auto& data : data_) {
-            if (data.enemy < 10)
-                continue;
-
-            int townsperson = data.enemy - 10;
-            int town = map_.code();
-            int idxtbl = (town >> 2) * 2;
-            int index = townsperson * 4 + (town & 3);
-            for(int j=0; j<2; j++, idxtbl++) {
-                if (index < tt.index(idxtbl).length()) {
-                    if (data.text[j] < 0) {
-                        LOGF(ERROR, "No text for EnemyID $%02x. Skipping.", data.enemy);
-                    } else {
-                        mapper_->WriteLegit(tt.index(idxtbl), index, data.text[j]);
-                    }
-                }
-            }
-            if (data.text[2] != -1) {
-                // Wise man (wizard or knight) has a third dialog: "Go now..."
-                // Encoded under townsperson 15 dialog 2.
-                index = 15 * 4 + (town & 3);
-                idxtbl = (town >> 2) * 2 + 1;
-                mapper_->WriteLegit(tt.index(idxtbl), index, data.text[2]);
-            }
-            if (townsperson >= 9 && townsperson < 9+4) {
-                mapper_->WriteLegit(ie.conditions_table(), (townsperson-9)*8 + town,
-                        data.condition);
-            }
-        }
+    if (!enemies_.Save()) {
+        ErrorDialog::Spawn("Error Saving Enemies",
+            "Can't save the enemies for ", enemies_.map().name(), ":\n"
+            "the enemy lists in bank ", enemies_.map().pointer().bank(),
+            " don't fit.");
     }
-    Parse(map_);
+    AreaIndex::Get()->Update(rom_, enemies_.map());
 }
 
 bool MapEnemyList::DrawOne(Unpacked* item, bool popup) {
@@ -1227,15 +835,15 @@ bool MapEnemyList::DrawOne(Unpacked* item, bool popup) {
     ImGui::PushItemWidth(400);
     if (ImGui::Combo("enemy", &item->enemy, names_, max_names_)) {
         chg |= true;
-        LoadText(item);
+        enemies_.LoadText(item);
     }
     ImGui::PopItemWidth();
 
-    if (map_.type() == MapType::TOWN) {
+    if (enemies_.map().type() == MapType::TOWN) {
         const auto& tt = ConfigLoader<RomInfo>::GetConfig().text_table();
         int townsperson = item->enemy - 10;
         for(int i=0; i<3; i++) {
-            int world = map_.code() >> 2;
+            int world = enemies_.map().code() >> 2;
             int index = item->text[i];
             if (index < 0)
                 continue;
@@ -1300,71 +908,78 @@ bool MapEnemyList::DrawOne(Unpacked* item, bool popup) {
 
 bool MapEnemyList::Draw() {
     bool chg = false;
-    char enemiesHex[511] = { '0', '1', '\0' };
+    char enemiesHex[511];
     bool hchanged = false;
 
-    Address addr = mapper_->ReadAddr(pointer_, 0x7e);
+    Address ptr = enemies_.pointer();
+    Address addr = enemies_.address();
     ImGui::Text("Map enemy table pointer at bank=0x%x address=0x%04x",
-                pointer_.bank(), pointer_.address() + 0x7e);
+                ptr.bank(), ptr.address());
     ImGui::Text("Map enemy table address at bank=0x%x address=0x%04x",
-                addr.bank(), addr.address() + 0x18a0);
+                addr.bank(), addr.address() + SideviewEnemies::kRomOffset);
     ImGui::Text("Map enemy table RAM addresss=0x%04x", addr.address());
 
     ImGui::Text("Enemies data [Press Enter after you paste here] [Updated on Commit to ROM]");
-    BytesToHexString(enemyListBytes_, enemiesHex);
+    snprintf(enemiesHex, sizeof(enemiesHex), "%s",
+             BytesToHexString(enemies_.bytes()).c_str());
     ImGui::PushItemWidth(400);
     hchanged = ImGui::InputText("bytes", enemiesHex, 510,
         ImGuiInputTextFlags_CharsHexadecimal |
         ImGuiInputTextFlags_EnterReturnsTrue);
     if (hchanged) {
-        HexStringToBytes(enemiesHex, enemyListBytes_);
-        Parse();
+        enemies_.Parse(HexStringToBytes(enemiesHex));
         return DR_CHANGED;
     }
 
-    if (is_encounter_) {
-        if (is_large_) {
+    chg |= DrawList(enemies_.mutable_data(), false);
+    if (enemies_.large()) {
+        ImGui::Separator();
+        chg |= DrawList(enemies_.large()->mutable_data(), true);
+    }
+    return chg;
+}
+
+bool MapEnemyList::DrawList(std::vector<Unpacked>* list, bool large) {
+    bool chg = false;
+    if (enemies_.is_encounter()) {
+        if (large) {
             ImGui::RadioButton("Large Enemy Encounter", &display_, 1);
         } else {
-            ImGui::RadioButton("Small Enemy Encounter", &large_->display_, 0);
+            ImGui::RadioButton("Small Enemy Encounter", &display_, 0);
         }
     }
 
     int i=0;
-    ImGui::PushID(is_large_ ? 1 : 0);
-    for(auto it=data_.begin(); it<data_.end(); ++it, ++i) {
-        ImGui::PushID(i | (is_large_ << 8));
+    ImGui::PushID(large ? 1 : 0);
+    for(auto it=list->begin(); it<list->end(); ++it, ++i) {
+        ImGui::PushID(i | (large << 8));
         chg |= DrawOne(&*it, false);
 
         ImGui::SameLine();
         if (ImGui::Button(ICON_FA_TIMES_CIRCLE)) {
             chg = true;
-            data_.erase(it);
+            list->erase(it);
         }
         if (ImGui::IsItemHovered())
             ImGui::SetTooltip("Delete this enemy");
         ImGui::PopID();
-        if (map_.type() == MapType::TOWN) {
+        if (enemies_.map().type() == MapType::TOWN) {
             ImGui::Separator();
         }
     }
     if (ImGui::Button(ICON_FA_CARET_SQUARE_O_UP)) {
         chg = true;
-        data_.emplace_back(0, 0, 0);
+        list->emplace_back(0, 0, 0);
     }
     if (ImGui::IsItemHovered())
         ImGui::SetTooltip("Add a new enemy");
     ImGui::PopID();
-
-    if (large_) {
-        ImGui::Separator();
-        chg |= large_->Draw();
-    }
     return chg;
 }
 
 std::vector<MapEnemyList::Unpacked>& MapEnemyList::data() {
-    return (large_ && large_->display_) ? large_->data_ : data_;
+    return (display_ && enemies_.large()) ? *enemies_.large()->mutable_data()
+                                          : *enemies_.mutable_data();
 }
 
 
@@ -1,17 +1,23 @@
 #ifndef Z2UTIL_IMWIDGET_MAP_COMMAND_H
 #define Z2UTIL_IMWIDGET_MAP_COMMAND_H
 #include <cstdint>
+#include <functional>
 #include <string>
 #include <memory>
 #include <vector>
 
 #include "proto/rominfo.pb.h"
 #include "nes/mapper.h"
+#include "nes/object_names.h"
+#include "nes/rom_context.h"
+#include "nes/sideview.h"
 #include "nes/text_list.h"
 
 namespace z2util {
 
 class MapHolder;
+// Draws one command of a MapHolder's sideview.  MapCommands are made
+// afresh each time the holder draws, so they keep no state of their own.
 class MapCommand {
   public:
     enum DrawResult {
@@ -20,56 +26,21 @@ class MapCommand {
         DR_COPY,
         DR_DELETE,
     };
-    MapCommand(const MapHolder* holder, uint8_t position, uint8_t object,
-               uint8_t extra);
-    MapCommand(const MapHolder* holder, int x0, uint8_t position,
-               uint8_t object, uint8_t extra);
-    MapCommand(const MapCommand& other);
+    MapCommand(const MapHolder* holder, SideviewCommand* command, int id);
 
-    MapCommand Copy();
     bool Draw(bool abscoord=false, bool popup=false);
     DrawResult DrawPopup(float scale);
-    std::vector<uint8_t> Command();
-    // areas: overword sideviews, towns, palaces, great palace
-    const static int NR_AREAS = 4;
-    // sets: small objects, object set 0, object set 1,
-    // extra small objects, extra objects
-    const static int NR_SETS = 5;
-    const static int MAX_COLLECTABLE = 36;
-    static const DecompressInfo* info_[NR_AREAS][NR_SETS][16];
-    static const char* object_names_[NR_AREAS][NR_SETS][16];
-    static const char *collectable_names_[MAX_COLLECTABLE];
-    inline int absx() const { return data_.absx; }
-    inline int absy() const { return data_.y; }
-    inline void set_relx(int x) { data_.x = x; }
-    inline int relx() const { return data_.x; }
-    inline uint8_t object() const { return object_; }
-    inline void set_show_origin(bool s) { show_origin_ = s; }
-    static void Init();
+    // The object or collectable name, or the kind of meta-command.
+    const char* Summary() const;
   private:
     int id_;
     const MapHolder* holder_;
-    bool show_origin_;
-    uint8_t position_;
-    uint8_t object_;
-    uint8_t extra_;
-    struct {
-        int absx;
-        int x, y;
-        int object;
-        int param;
-        int extra;
-        int extra_param;
-    } data_;
-    char obuf_[4];
-    char ebuf_[4];
-    const char *summary_;
-    const char *names_[100];
-
-    static int newid();
+    SideviewCommand* command_;
 };
 
 
+// The sideview editor.  The sideview itself is kept in a Sideview; this
+// adds the widgets, the change tracking and the editor's caches.
 class MapHolder {
   public:
     enum DrawResult {
@@ -77,94 +48,47 @@ class MapHolder {
         DR_CHANGED,
         DR_PALETTE_CHANGED,
     };
-    struct Unpacked {
-        int objset;
-        int width;
-        bool grass;
-        bool bushes;
-        bool ceiling;
-        int ground;
-        int floor;
-        int spal;
-        int bpal;
-        int bmap;
-    };
 
     MapHolder();
-    MapHolder(Mapper* m);
+    MapHolder(RomContext* rom);
     DrawResult Draw();
     bool DrawPopup(float scale);
-    void Save() { Save([](){}, true); }
     void Save(std::function<void()> finish, bool force=false);
     void Parse(const Map& map, uint16_t altaddr=0);
-    void Parse();
-    std::vector<uint8_t> MapData();
-    std::vector<uint8_t> MapDataAbs();
-    void ReadSideview();
-    void Clear(const Unpacked& data) {
-        command_.clear();
-        data_ = data;
-        data_changed_ = true;
-        cursor_moves_left_ = false;
+    inline std::vector<uint8_t> MapDataAbs() {
+        return sideview_.MapDataAbs();
     }
-    void Append(const MapCommand& cmd);
-    void Extend(const std::vector<MapCommand>& cmds);
-    inline std::vector<MapCommand>* mutable_command() { return &command_; }
-    inline void set_mapper(Mapper* m) { mapper_ = m; }
-    inline uint8_t flags() const { return flags_; };
-    inline uint8_t ground() const { return ground_; };
-    inline uint8_t back() const { return back_; };
-
-    inline void set_objset(int val) { data_.objset = val; }
-    inline void set_width(int val) { data_.width = val; }
-    inline void set_grass(bool val) { data_.grass = val; }
-    inline void set_bushes(bool val) { data_.bushes = val; }
-    inline void set_ceiling(bool val) { data_.ceiling = val; }
-    inline void set_ground(int val) { data_.ground = val; }
-    inline void set_floor(int val) { data_.floor = val; }
-    inline void set_spal(int val) { data_.spal = val; }
-    inline void set_bpal(int val) { data_.bpal = val; }
-    inline void set_bmap(int val) { data_.bmap = val; }
-
-    inline const Map& map() const { return map_; }
+    inline void set_rom(RomContext* rom) {
+        rom_ = rom;
+        sideview_.set_rom(rom);
+    }
+    inline const Sideview& sideview() const { return sideview_; }
+    inline const ObjectNames& object_names() const {
+        return rom_->object_names();
+    }
+    inline uint8_t flags() const { return sideview_.flags(); };
+    inline const Map& map() const { return sideview_.map(); }
     inline bool cursor_moves_left() {
-        return cursor_moves_left_;
+        return sideview_.cursor_moves_left();
     }
     inline void set_cursor_moves_left(bool v) {
-        cursor_moves_left_ = v;
-    }
-    inline void set_show_origin(bool s) {
-        for(auto& c : command_) {
-            c.set_show_origin(s);
-        }
+        sideview_.set_cursor_moves_left(v);
     }
+    inline bool show_origin() const { return show_origin_; }
+    inline void set_show_origin(bool s) { show_origin_ = s; }
   private:
-    std::vector<uint8_t> MapDataWorker(std::vector<MapCommand>& cmd);
-    void Unpack();
-    void Pack();
-
-    uint8_t sideviewBytes_[255] = { 1 };
-    uint8_t length_;
-    uint8_t flags_;
-    uint8_t ground_;
-    uint8_t back_;
-    bool cursor_moves_left_;
-    std::vector<MapCommand> command_;
-    Map map_;
-    Mapper* mapper_;
+    RomContext* rom_;
+    Sideview sideview_;
+    bool show_origin_;
     bool data_changed_;
     bool addr_changed_;
-    uint16_t map_addr_;
-    uint16_t map_bank_;
-
-    Unpacked data_;
 };
 
 class MapConnection {
   public:
     MapConnection();
-    MapConnection(Mapper* m);
-    inline void set_mapper(Mapper* m) { mapper_ = m; }
+    MapConnection(RomContext* rom);
+    inline void set_rom(RomContext* rom) { rom_ = rom; }
 
     bool Draw();
     void Parse(const Map& map);
@@ -199,7 +123,7 @@ class MapConnection {
     }
     static constexpr int kMaxDoorArea = 32;
   private:
-    Mapper* mapper_;
+    RomContext* rom_;
     Address connector_;
     Address doors_;
     int world_;
@@ -211,6 +135,7 @@ class MapConnection {
     bool fixtarget_[8];
 };
 
+// The enemy list editor, for the lists kept in a SideviewEnemies.
 class MapEnemyList {
   public:
     enum DrawResult {
@@ -219,48 +144,32 @@ class MapEnemyList {
         DR_COPY,
         DR_DELETE,
     };
-    struct Unpacked {
-        Unpacked(int e_, int x_, int y_)
-            : enemy(e_), x(x_), y(y_), text{-1, -1, -1}, condition{0} {}
-        int enemy;
-        int x, y;
-        int text[3];
-        int condition;
-    };
+    typedef SideviewEnemies::Unpacked Unpacked;
     MapEnemyList();
-    MapEnemyList(Mapper* m);
+    MapEnemyList(RomContext* rom);
     void Init();
-    inline void set_mapper(Mapper* m) { mapper_ = m; }
+    inline void set_rom(RomContext* rom) {
+        rom_ = rom;
+        enemies_.set_rom(rom);
+        text_.set_rom(rom);
+    }
 
     bool Draw();
     bool DrawOne(Unpacked* item, bool popup);
     DrawResult DrawOnePopup(Unpacked* item, float scale);
     bool DrawPopup(float scale);
-    void ReadEnemyList();
     void Parse(const Map& map);
-    void Parse();
-    std::vector<uint8_t> Pack();
     void Save();
+    // The list being shown: the small or large encounter list.
     std::vector<Unpacked>& data();
     inline void set_show_origin(bool s) { show_origin_ = s; }
   private:
-    void LoadText(Unpacked* item);
+    bool DrawList(std::vector<Unpacked>* list, bool large);
 
-    Mapper* mapper_;
+    RomContext* rom_;
     bool show_origin_;
-    bool is_large_;
-    bool is_encounter_;
-    Address pointer_;
-    Map map_;
-    int world_;
-    int overworld_;
-    int subworld_;
-    int area_;
     int display_;
-
-    uint8_t enemyListBytes_[255] = { 1 };
-    std::vector<Unpacked> data_;
-    std::unique_ptr<MapEnemyList> large_;
+    SideviewEnemies enemies_;
     const char *names_[256];
     int max_names_;
     TextListPack text_;
@@ -1,7 +1,6 @@
 #include "imgui.h"
 #include "imwidget/imapp.h"
 #include "imwidget/map_connect.h"
-#include "imwidget/multimap.h"
 #include "imwidget/imutil.h"
 #include "util/config.h"
 
@@ -158,6 +157,18 @@ void OverworldConnector::Write() {
     }
 }
 
+void OverworldConnector::Destination(int* world, int* overworld,
+                                     int* subworld) const {
+    *world = dest_world_;
+    if (dest_world_ == 0 && dest_overworld_ == 0) {
+        *overworld = overworld_;
+        *subworld = subworld_;
+    } else {
+        *overworld = 0;
+        *subworld = 0;
+    }
+}
+
 void OverworldConnector::StartEmulator() {
     const auto& misc = ConfigLoader<RomInfo>::GetConfig().misc();
     uint8_t towns = misc.town_connection_id();
@@ -203,13 +214,10 @@ void OverworldConnector::StartEmulator() {
 bool OverworldConnector::DrawInPopup() {
     bool chg = false;
     if (ImGui::Button("View Area")) {
-        if (dest_world_ == 0 && dest_overworld_ == 0) {
-            MultiMap::Spawn(mapper_,
-                            dest_world_, overworld_, subworld_, map_);
-        } else {
-            MultiMap::Spawn(mapper_,
-                            dest_world_, 0, 0, map_);
-        }
+        int params[4];
+        Destination(&params[0], &params[1], &params[2]);
+        params[3] = map_;
+        ImApp::Get()->ProcessMessage("view_area", params);
     }
     ImGui::SameLine();
     if (ImGui::Button("Emulate")) {
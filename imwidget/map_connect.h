@@ -23,6 +23,11 @@ class OverworldConnector {
     inline int ypos() const { return y_; }
     inline int dx() const { return dx_; }
     inline int dy() const { return dy_; }
+    inline int map() const { return map_; }
+    inline bool entry_right() const { return entry_right_; }
+    // The world, overworld and subworld of the sideview area this
+    // connector leads to (as passed to MultiMap::Spawn).
+    void Destination(int* world, int* overworld, int* subworld) const;
     inline void drag_start() { if (!drag_) { drag_ = true; dx_ = dy_ = 0; } }
     inline bool drag_finalize(float scale) {
         if (drag_) {
@@ -102,6 +107,7 @@ class OverworldConnectorList {
     void Save();
     std::vector<std::string> Print() const;
 
+    inline const std::vector<OverworldConnector>& list() const { return list_; }
     inline bool show() const { return show_; }
     inline bool changed() const { return changed_; }
     inline void set_scale(float s) { scale_ = s; }
@@ -12,22 +12,6 @@ DECLARE_bool(hackjam2020);
 
 namespace z2util {
 
-const char* MiscellaneousHacks::collectable_names_[MAX_COLLECTABLE];
-
-void MiscellaneousHacks::Init() {
-    static char collectable[MAX_COLLECTABLE][32];
-    const auto& ri = ConfigLoader<RomInfo>::GetConfig();
-    for(int i=0; i<MAX_COLLECTABLE; i++) {
-        const auto& c = ri.items().info().find(i);
-        if (c == ri.items().info().end()) {
-            snprintf(collectable[i], 31, "%02x: ???", i);
-        } else {
-            snprintf(collectable[i], 31, "%02x: %s", i, c->second.name().c_str());
-        }
-        collectable_names_[i] = collectable[i];
-    }
-}
-
 bool MiscellaneousHacks::Draw() {
     if (!visible_)
         return false;
@@ -74,7 +58,9 @@ bool MiscellaneousHacks::DrawPalaceCompletionItems() {
         item = mapper_->Read(addr, 8+offset);
         snprintf(palace, sizeof(palace), "P%d", i+1);
         ImGui::SameLine();
-        if (ImGui::Combo(palace, &item, collectable_names_, MAX_COLLECTABLE)) {
+        if (ImGui::Combo(palace, &item,
+                         rom_->object_names().collectable_names(),
+                         ObjectNames::MAX_COLLECTABLE)) {
             mapper_->Write(addr, 8+offset, item);
             if (i==3) {
                 // Palace 4 gets to be in both banks.
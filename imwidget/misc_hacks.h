@@ -1,16 +1,15 @@
 #ifndef Z2UTIL_IMWIDGET_MISC_HACKS_H
 #define Z2UTIL_IMWIDGET_MISC_HACKS_H
 #include "imwidget/imwidget.h"
+#include "nes/rom_context.h"
 #include "proto/rominfo.pb.h"
 
-class Mapper;
 namespace z2util {
 
 class MiscellaneousHacks: public ImWindowBase {
   public:
-    MiscellaneousHacks(): ImWindowBase(false), tab_(0) { Init(); }
+    MiscellaneousHacks(): ImWindowBase(false), tab_(0) {}
 
-    void Init();
     void Refresh() override {
         CheckOverworldTileHack();
     }
@@ -20,9 +19,10 @@ class MiscellaneousHacks: public ImWindowBase {
     bool DrawDynamicBanks();
     bool DrawSwimEnables();
     void CheckOverworldTileHack();
-    inline void set_mapper(Mapper* m) { mapper_ = m; };
-
-    const static int MAX_COLLECTABLE = 36;
+    inline void set_rom(RomContext* rom) {
+        rom_ = rom;
+        mapper_ = rom->mapper();
+    }
   private:
     template<class GETALL, class GET, class CHECK>
     int Hack(const char* hackname, int n, GETALL getall, GET get, CHECK check);
@@ -35,8 +35,8 @@ class MiscellaneousHacks: public ImWindowBase {
     void PutGameHack(const GameHack& hack);
 
     int tab_;
+    RomContext* rom_;
     Mapper* mapper_;
-    static const char *collectable_names_[MAX_COLLECTABLE];
 };
 
 }  // namespace
@@ -1,9 +1,12 @@
 #include "imwidget/multimap.h"
 
+#include "imwidget/area_cache.h"
 #include "imwidget/imapp.h"
 #include "imwidget/imutil.h"
 #include "imwidget/map_command.h"
+#include "imwidget/map_connect.h"
 #include "imwidget/simplemap.h"
+#include "nes/area_index.h"
 #include "util/config.h"
 #include "util/macros.h"
 #include "absl/strings/str_cat.h"
@@ -12,43 +15,88 @@
 #include <gflags/gflags.h>
 
 DEFINE_bool(town_hack, true, "World 2 towns are really in world 1");
+DEFINE_double(multimap_theta, 0.0,
+              "Barnes-Hut opening angle for the multimap layout (0 = exact)");
+DEFINE_double(multimap_epsilon, 1e-4,
+              "Stop pre-converging the multimap layout once the total "
+              "kinetic energy falls below this value");
 
 namespace z2util {
 namespace {
 const double kInvalidStrength = 0.000001;
+const double kOverworldStrength = 0.05;
+// The size of an area which hasn't been rendered yet.
+const int kPlaceholderWidth = 1024;
+const int kPlaceholderHeight = 208;
 }  // namespace
 
-MultiMap* MultiMap::Spawn(Mapper* m, int world, int overworld, int subworld,
-                          int map) {
-    MultiMap* mm = new MultiMap(m, world, overworld, subworld, map);
+MultiMap* MultiMap::Spawn(RomContext* rom, int world, int overworld,
+                          int subworld, int map) {
+    MultiMap* mm = new MultiMap(rom, world, overworld, subworld, map);
     mm->Init();
     ImApp::Get()->AddDrawCallback(mm);
     return mm;
 }
 
-void MultiMap::Init() {
-    const auto& ri = ConfigLoader<RomInfo>::GetConfig();
+MultiMap* MultiMap::SpawnRom(RomContext* rom) {
+    MultiMap* mm = new MultiMap(rom, 0, 0, 0, 0);
+    mm->whole_rom_ = true;
+    mm->Init();
+    ImApp::Get()->AddDrawCallback(mm);
+    return mm;
+}
 
+int MultiMap::FindGroup(int world, int overworld, int subworld) {
+    const auto& ri = ConfigLoader<RomInfo>::GetConfig();
     if (FLAGS_town_hack) {
-        if (world_ == 2) world_ = 1;
+        if (world == 2) world = 1;
+    }
+    // only care about the subworld in world 0 (overworlds)
+    if (world) subworld = 0;
+    for(size_t i=0; i<groups_.size(); i++) {
+        const auto& g = groups_[i];
+        if (g.world == world && g.overworld == overworld &&
+            g.subworld == subworld) {
+            return i;
+        }
     }
-    visited_room0_ = 0;
-    int n = 0;
+
+    Group group{world, overworld, subworld, int(maps_.size()), 0, 0};
     for(const auto& m : ri.map()) {
         if (m.type() != MapType::OVERWORLD
-            && m.world() == world_
-            && m.overworld() == overworld_
-            // only care about the subworld in world 0 (overworlds)
-            && (world_ || m.subworld() == subworld_)) {
-            maps_[n] = m;
-            visited_[n] = false;
-            n++;
+            && m.world() == world
+            && m.overworld() == overworld
+            && (world || m.subworld() == subworld)) {
+            maps_.push_back(m);
+            visited_.push_back(false);
+            group.size++;
         }
     }
+    groups_.push_back(group);
+    return groups_.size() - 1;
+}
+
+void MultiMap::Init() {
+    if (FLAGS_town_hack) {
+        if (world_ == 2) world_ = 1;
+    }
+    layout_.Stop();
+    renderer_.Cancel();
     location_.clear();
     graph_.Clear();
-
-    title_ = absl::StrCat("MultiMap: ", maps_[start_].name());
+    maps_.clear();
+    visited_.clear();
+    groups_.clear();
+
+    int group = -1;
+    if (whole_rom_) {
+        title_ = "MultiMap: Entire ROM";
+    } else {
+        group = FindGroup(world_, overworld_, subworld_);
+        title_ = absl::StrCat("MultiMap: ",
+                              start_ < groups_[group].size
+                                  ? maps_[start_].name() : "");
+    }
     auto *sc = ConfigLoader<SessionConfig>::MutableConfig();
     mcfg_ = &(*sc->mutable_multimap())[title_];
     if (!mcfg_->initialized()) {
@@ -63,25 +111,28 @@ void MultiMap::Init() {
         mcfg_->set_show_arrows(true);
     }
     title_ = absl::StrCat(title_, "##", id_);
-    if (start_ != 0) {
-        // Room 0 is often used as the destination for illegal exits
-        visited_[0] = true;
-    }
     if (mcfg_->pre_converge()) {
         mcfg_->clear_room();
     }
-    Traverse(start_, 0, 0, -1);
-    if (start_ != 0 && visited_room0_) {
-        auto* node = AddRoom(0, 0, 4);
-        node->set_charge(0.001);
-    }
-
-    if (mcfg_->pre_converge()) {
-        for(int i=0; i<10000; i++) {
-            graph_.Compute(1.0/60.0);
+    if (whole_rom_) {
+        TraverseRom();
+    } else {
+        if (start_ != 0) {
+            // Room 0 is often used as the destination for illegal exits
+            visited_[0] = true;
+        }
+        Traverse(group, start_, 0, 0, -1);
+        if (start_ != 0 && groups_[group].room0) {
+            auto* node = AddRoom(0, 0, 4);
+            node->set_charge(0.001);
         }
     }
 
+    graph_.set_theta(FLAGS_multimap_theta);
+    dragging_ = -1;
+    layout_.Start(1.0/60.0, mcfg_->pre_converge() ? 10000 : 0,
+                  FLAGS_multimap_epsilon);
+
     if (pgo_.grid_width() == 0) pgo_.set_grid_width(8);
     if (pgo_.grid_height() == 0) pgo_.set_grid_height(8);
     if (pgo_.num_rooms() == 0) pgo_.set_num_rooms(14);
@@ -89,34 +140,39 @@ void MultiMap::Init() {
     pgo_.set_world(world_);
 }
 
-fdg::Node* MultiMap::AddRoom(int room, double x, double y) {
-    SimpleMap simple(mapper_, maps_[room]);
-    auto buffer(simple.RenderToNewBuffer());
-    buffer->Update();
+fdg::Node* MultiMap::AddRoom(int id, double x, double y) {
+    // The area is drawn as a placeholder until the renderer is done.
+    int level = AreaRenderer::Level(mcfg_->scale());
+    renderer_.Request(rom_->mapper(), id, maps_[id], level);
 
-    const std::string& name = maps_[room].name();
+    const std::string& name = maps_[id].name();
     auto pos = (*mcfg_->mutable_room())[name];
     if (pos.x() == 0.0 && pos.y() == 0.0) {
-        pos.set_x(double(x) + double(room) / 1000.0);
-        pos.set_y(double(y) + double(room) / 1000.0);
+        pos.set_x(double(x) + double(id) / 1000.0);
+        pos.set_y(double(y) + double(id) / 1000.0);
     }
-    fdg::Node *node = graph_.AddNode(room, Vec2(pos.x(), pos.y()));
+    fdg::Node *node = graph_.AddNode(id, Vec2(pos.x(), pos.y()));
     location_.emplace(std::make_pair(
-                room, DrawLocation{node, std::move(buffer)}));
+                id, DrawLocation{node, kPlaceholderWidth, kPlaceholderHeight,
+                                 level, level, nullptr}));
     return node;
 }
 
-void MultiMap::Traverse(int room, double x, double y, int from, double strength) {
+void MultiMap::Traverse(int group, int room, double x, double y, int from,
+                        double strength) {
+    const Group& g = groups_[group];
     if (room == 0)
-        visited_room0_++;
-    if (room == 63 || visited_[room])
+        groups_[group].room0++;
+    if (room == 63 || room >= g.size || visited_[g.base + room])
         return;
-    visited_[room] = true;
+    visited_[g.base + room] = true;
 
-    auto* node = AddRoom(room, x, y);
+    // Connections leading outside of the group go nowhere.
+    auto id = [&g](int d) { return d < g.size ? g.base + d : -1; };
+    auto* node = AddRoom(g.base + room, x, y);
     MapConnection conn;
-    conn.set_mapper(mapper_);
-    conn.Parse(maps_[room]);
+    conn.set_rom(rom_);
+    conn.Parse(maps_[g.base + room]);
 
     double k, w;
     int d;
@@ -128,7 +184,7 @@ void MultiMap::Traverse(int room, double x, double y, int from, double strength)
     k = (d || d == from) ? strength : kInvalidStrength;
     col = (k <= kInvalidStrength) ? GRAY : YELLOW;
     w   = (k <= kInvalidStrength) ? 1 : 3;
-    spring->emplace_back(fdg::Spring{d, k, fdg::Bias::Horizontal, col, w,
+    spring->emplace_back(fdg::Spring{id(d), k, fdg::Bias::Horizontal, col, w,
                                      Direction::LEFT, conn.left().start+1});
 
     // blue
@@ -136,7 +192,7 @@ void MultiMap::Traverse(int room, double x, double y, int from, double strength)
     k = (d || d == from) ? strength : kInvalidStrength;
     col = (k <= kInvalidStrength) ? GRAY : BLUE;
     w   = (k <= kInvalidStrength) ? 1 : 6;
-    spring->emplace_back(fdg::Spring{d, k, fdg::Bias::Vertical, col, w,
+    spring->emplace_back(fdg::Spring{id(d), k, fdg::Bias::Vertical, col, w,
                                      Direction::DOWN, Direction::UP});
 
     // green
@@ -144,7 +200,7 @@ void MultiMap::Traverse(int room, double x, double y, int from, double strength)
     k = (d || d == from) ? strength : kInvalidStrength;
     col = (k <= kInvalidStrength) ? GRAY : GREEN;
     w   = (k <= kInvalidStrength) ? 1 : 3;
-    spring->emplace_back(fdg::Spring{d, k, fdg::Bias::Vertical, col, w,
+    spring->emplace_back(fdg::Spring{id(d), k, fdg::Bias::Vertical, col, w,
                                      Direction::UP, Direction::DOWN});
 
     // red
@@ -152,13 +208,13 @@ void MultiMap::Traverse(int room, double x, double y, int from, double strength)
     k = (d || d == from) ? strength : kInvalidStrength;
     col = (k <= kInvalidStrength) ? GRAY : RED;
     w   = (k <= kInvalidStrength) ? 1 : 6;
-    spring->emplace_back(fdg::Spring{d, k, fdg::Bias::Horizontal, col, w,
+    spring->emplace_back(fdg::Spring{id(d), k, fdg::Bias::Horizontal, col, w,
                                      Direction::RIGHT, conn.right().start+1});
 
-    Traverse(conn.left().destination,  x-2.0, y, room, 1.0);
-    Traverse(conn.down().destination,  x, y+2.0, room, 1.0);
-    Traverse(conn.up().destination,    x, y-2.0, room, 1.0);
-    Traverse(conn.right().destination, x+2.0, y, room, 1.0);
+    Traverse(group, conn.left().destination,  x-2.0, y, room, 1.0);
+    Traverse(group, conn.down().destination,  x, y+2.0, room, 1.0);
+    Traverse(group, conn.up().destination,    x, y-2.0, room, 1.0);
+    Traverse(group, conn.right().destination, x+2.0, y, room, 1.0);
 
     if (mcfg_->show_doors()) {
         const double kWeakStrength = 0.1;
@@ -171,9 +227,73 @@ void MultiMap::Traverse(int room, double x, double y, int from, double strength)
             k = (d || d == from) ? kWeakStrength : kInvalidStrength;
             col = (k <= kInvalidStrength) ? GRAY : ORANGE;
             w   = (k <= kInvalidStrength) ? 1 : 3;
-            spring->emplace_back(fdg::Spring{d, k, fdg::Bias::Vertical, col, w,
+            spring->emplace_back(fdg::Spring{id(d), k, fdg::Bias::Vertical, col, w,
                                              door+5, conn.door(door).start+1});
-            Traverse(d, x-1.5+door, y+1.0, room, kWeakStrength);
+            Traverse(group, d, x-1.5+door, y+1.0, room, kWeakStrength);
+        }
+    }
+}
+
+void MultiMap::TraverseRom() {
+    const auto& ri = ConfigLoader<RomInfo>::GetConfig();
+    struct Entry {
+        int group;
+        int room;
+        double x, y;
+    };
+    std::vector<Entry> entries;
+
+    // Each overworld is a node linked to every area its connectors lead
+    // to.  The overworlds are spread out horizontally, with the areas
+    // they lead to initially placed beneath them.
+    double x = 0;
+    for(const auto& m : ri.map()) {
+        if (m.type() != MapType::OVERWORLD)
+            continue;
+        OverworldConnectorList clist;
+        clist.Init(rom_->mapper(), m.connector(), m.overworld(), m.subworld());
+
+        int id = maps_.size();
+        maps_.push_back(m);
+        visited_.push_back(true);
+        auto* node = AddRoom(id, x, -6.0);
+        auto* spring = node->mutable_connection();
+        int n = 0;
+        for(const auto& c : clist.list()) {
+            int world, overworld, subworld;
+            c.Destination(&world, &overworld, &subworld);
+            int group = FindGroup(world, overworld, subworld);
+            const Group& g = groups_[group];
+            if (c.map() >= g.size)
+                continue;
+            spring->emplace_back(fdg::Spring{
+                    g.base + c.map(), kOverworldStrength, fdg::Bias::None,
+                    CYAN, 2, Direction::NONE,
+                    c.entry_right() ? Direction::RIGHT : Direction::LEFT});
+            entries.push_back(Entry{group, c.map(),
+                                    x + 2.0 * (n % 8), 2.0 * (n / 8)});
+            n++;
+        }
+        x += 16.0;
+    }
+
+    // Area 0 of a group is only an area in its own right if a connector
+    // leads to it; otherwise it's where the illegal exits go.
+    for(const auto& g : groups_) {
+        visited_[g.base] = true;
+    }
+    for(const auto& e : entries) {
+        if (e.room == 0)
+            visited_[groups_[e.group].base] = false;
+    }
+    for(const auto& e : entries) {
+        Traverse(e.group, e.room, e.x, e.y, -1);
+    }
+    for(size_t i=0; i<groups_.size(); i++) {
+        const auto& g = groups_[i];
+        if (g.room0 && g.size && location_.find(g.base) == location_.end()) {
+            auto* node = AddRoom(g.base, 16.0 * i, 4);
+            node->set_charge(0.001);
         }
     }
 }
@@ -189,9 +309,9 @@ Vec2 MultiMap::Position(const Vec2& pos) {
 }
 
 Vec2 MultiMap::Position(const DrawLocation& dl, Direction side) {
-    float w = dl.buffer->width() * mcfg_->scale();
-    float h = dl.buffer->height() * mcfg_->scale();
-    Vec2 pos = Position(dl.node->pos()) + Vec2(0, 24);
+    float w = dl.width * mcfg_->scale();
+    float h = dl.height * mcfg_->scale();
+    Vec2 pos = Position(layout_.pos(dl.node->id())) + Vec2(0, 24);
     switch(side) {
         case LEFT:  pos += Vec2(0, h/2.0); break;
         case DOWN:  pos += Vec2(w/2.0, h); break;
@@ -239,20 +359,19 @@ void MultiMap::DrawConnections(const DrawLocation& dl) {
 
 void MultiMap::DrawOne(const DrawLocation& dl) {
     int map = dl.node->id();
-    Vec2 pos = origin_ + Position(dl.node->pos());
+    Vec2 npos = layout_.pos(map);
+    Vec2 pos = origin_ + Position(npos);
     Vec2 button_height(0, 24);
     ImGui::SetCursorPos(pos);
     const std::string& name = maps_[dl.node->id()].name();
     if (mcfg_->show_labels() &&
         ImGui::Button(name.c_str())) {
-        SimpleMap::Spawn(mapper_, maps_[map]);
+        SimpleMap::Spawn(rom_, maps_[map]);
     }
     pos += button_height;
     ImGui::SetCursorPos(pos);
-    ImGui::InvisibleButton(maps_[dl.node->id()].name().c_str(),
-                           ImVec2(dl.buffer->width() * mcfg_->scale(),
-                                  dl.buffer->height() * mcfg_->scale()));
-    dl.node->set_pause(false);
+    ImVec2 size(dl.width * mcfg_->scale(), dl.height * mcfg_->scale());
+    ImGui::InvisibleButton(maps_[dl.node->id()].name().c_str(), size);
     if (ImGui::IsItemActive()) {
         drag_ |= true;
         if (ImGui::IsMouseDragging()) {
@@ -260,13 +379,57 @@ void MultiMap::DrawOne(const DrawLocation& dl) {
                                   (1024.0 * mcfg_->zoom_x() * mcfg_->scale()),
                               ImGui::GetIO().MouseDelta.y /
                                   (224.0 * mcfg_->zoom_y() * mcfg_->scale()));
-            dl.node->set_pos(dl.node->pos() + delta);
-            dl.node->set_pause(true);
+            npos += delta;
+            layout_.Move(map, npos, true);
+            dragging_ = map;
+        }
+    } else if (dragging_ == map) {
+        // Let go of the node.
+        layout_.Move(map, npos, false);
+        dragging_ = -1;
+    }
+    (*mcfg_->mutable_room())[name].set_x(npos.x);
+    (*mcfg_->mutable_room())[name].set_y(npos.y);
+    if (dl.buffer) {
+        // Until a better matching level arrives, the current one is
+        // stretched to size.
+        dl.buffer->DrawAt(pos.x, pos.y, int(size.x), int(size.y));
+    } else {
+        Vec2 p = absolute_ + Position(npos) + button_height;
+        ImGui::GetWindowDrawList()->AddRectFilled(
+                p, p + Vec2(size.x, size.y), GRAY);
+    }
+}
+
+void MultiMap::UpdateLevels() {
+    for(const auto& r : renderer_.Poll()) {
+        auto it = location_.find(r.id);
+        if (it == location_.end())
+            continue;
+        auto& dl = it->second;
+        // Drop results for a level we no longer want, unless there's
+        // nothing to draw yet.
+        if (r.level != dl.want && dl.buffer)
+            continue;
+        dl.width = r.bitmap->width() << r.level;
+        dl.height = r.bitmap->height() << r.level;
+        dl.level = r.level;
+        dl.buffer = r.bitmap;
+    }
+
+    // Only the level for the current zoom is kept, so zooming out frees
+    // the larger bitmaps (unless the AreaCache still holds them).
+    int level = AreaRenderer::Level(mcfg_->scale());
+    for(auto& it : location_) {
+        auto& dl = it.second;
+        if (dl.want != level) {
+            dl.want = level;
+            if (dl.level != level) {
+                renderer_.Request(rom_->mapper(), it.first,
+                                  maps_[it.first], level);
+            }
         }
     }
-    (*mcfg_->mutable_room())[name].set_x(dl.node->pos().x);
-    (*mcfg_->mutable_room())[name].set_y(dl.node->pos().y);
-    dl.buffer->DrawAt(pos.x, pos.y, mcfg_->scale());
 }
 
 void MultiMap::DrawLegend() {
@@ -288,6 +451,10 @@ void MultiMap::DrawLegend() {
         ImGui::Text("Down Exit: ");
         DrawArrow(Vec2(200, 8)+p, Vec2(100, 8)+p, BLUE);
 
+        p = ImGui::GetCursorScreenPos();
+        ImGui::Text("Overworld: ");
+        DrawArrow(Vec2(100, 8)+p, Vec2(200, 8)+p, CYAN);
+
         p = ImGui::GetCursorScreenPos();
         ImGui::Text("Illegal Exit:");
         DrawArrow(Vec2(100, 8)+p, Vec2(200, 8)+p, GRAY);
@@ -331,8 +498,12 @@ void MultiMap::DrawGen() {
 
         if (ImGui::Button("Generate")) {
             PalaceGenerator pgen(pgo_);
-            pgen.set_mapper(mapper_);
+            pgen.set_rom(rom_);
             pgen.Generate();
+            // The generator rewrites the palace's sideviews behind the
+            // editor's back.
+            AreaCache::Get()->Clear();
+            AreaIndex::Get()->Rebuild(rom_);
             Init();
         }
         ImGui::EndPopup();
@@ -340,8 +511,16 @@ void MultiMap::DrawGen() {
 }
 
 bool MultiMap::Draw() {
-    if (!visible_)
+    if (!visible_) {
+        // Don't keep simulating a closed window.
+        layout_.Stop();
         return false;
+    }
+    if (!layout_.running()) {
+        layout_.Start(1.0/60.0, 0, FLAGS_multimap_epsilon);
+    }
+    layout_.Sync();
+    UpdateLevels();
 
     drag_ = false;
     ImGui::SetNextWindowSize(ImVec2(1024, 700), ImGuiCond_FirstUseEver);
@@ -394,11 +573,15 @@ bool MultiMap::Draw() {
 
     ImGui::SameLine();
     ImApp::Get()->HelpButton("overworld-editor");
+    if (renderer_.pending()) {
+        ImGui::SameLine();
+        ImGui::Text("Rendering %d areas...", renderer_.pending());
+    }
 
     Vec2 minv(1e9, 1e9);
     Vec2 maxv(-1e9, -1e9);
     for(const auto& dl : location_) {
-        Vec2 p = dl.second.node->pos();
+        Vec2 p = layout_.pos(dl.second.node->id());
         minv.x = std::min(minv.x, p.x);
         minv.y = std::min(minv.y, p.y);
         maxv.x = std::max(maxv.x, p.x);
@@ -424,8 +607,8 @@ bool MultiMap::Draw() {
     ImGui::EndChild();
     ImGui::End();
 
-    if (mcfg_->continuous_converge() && !(drag_ && mcfg_->pause_converge()))
-        graph_.Compute(1.0/60.0);
+    layout_.set_continuous(mcfg_->continuous_converge() &&
+                           !(drag_ && mcfg_->pause_converge()));
 
     return false;
 }
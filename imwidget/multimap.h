@@ -5,10 +5,13 @@
 #include <vector>
 
 #include "alg/fdg.h"
+#include "alg/fdg_layout.h"
+#include "imwidget/area_renderer.h"
 #include "imwidget/glbitmap.h"
 #include "imwidget/imutil.h"
 #include "imwidget/imwidget.h"
 #include "nes/mapper.h"
+#include "nes/rom_context.h"
 #include "nes/z2decompress.h"
 #include "nes/z2objcache.h"
 #include "proto/rominfo.pb.h"
@@ -20,16 +23,23 @@ namespace z2util {
 
 class MultiMap: public ImWindowBase {
   public:
-    static MultiMap* Spawn(Mapper* m,
+    static MultiMap* Spawn(RomContext* rom,
                            int world, int overworld, int subworld,int map);
+    // Show every overworld and all of the sideview areas reachable from
+    // their connectors.
+    static MultiMap* SpawnRom(RomContext* rom);
 
-    MultiMap(Mapper* mapper, int world, int overworld, int subworld, int map)
+    MultiMap(RomContext* rom, int world, int overworld, int subworld,
+             int map)
         : ImWindowBase(),
-        mapper_(mapper),
+        rom_(rom),
+        whole_rom_(false),
         world_(world),
         overworld_(overworld),
         subworld_(subworld),
-        start_(map)
+        start_(map),
+        layout_(&graph_),
+        dragging_(-1)
     {}
 
     void Init();
@@ -38,7 +48,27 @@ class MultiMap: public ImWindowBase {
   private:
     struct DrawLocation {
         fdg::Node *node;
-        std::unique_ptr<GLBitmap> buffer;
+        // The size of the area at full resolution.
+        int width, height;
+        // The level of detail of buffer, and the level requested from the
+        // renderer for the current zoom.
+        int level, want;
+        // Shared with the AreaCache.  Null until the area has been
+        // rendered.
+        std::shared_ptr<GLBitmap> buffer;
+    };
+    // The sideview areas which number their connections the same way:
+    // the areas of one world, or of one overworld in world 0.  Area n of
+    // the group is maps_[base + n].
+    struct Group {
+        int world;
+        int overworld;
+        int subworld;
+        int base;
+        int size;
+        // Number of connections to area 0 (the destination of illegal
+        // exits).
+        int room0;
     };
     enum Direction {
         NONE,
@@ -51,7 +81,8 @@ class MultiMap: public ImWindowBase {
         DOOR3,
         DOOR4,
     };
-    fdg::Node* AddRoom(int room, double x, double y);
+    int FindGroup(int world, int overworld, int subworld);
+    fdg::Node* AddRoom(int id, double x, double y);
     Vec2 Position(const Vec2& pos);
     Vec2 Position(const DrawLocation& dl, Direction side);
     void DrawArrow(const Vec2& a, const Vec2&b, uint32_t color,
@@ -59,12 +90,18 @@ class MultiMap: public ImWindowBase {
     void DrawConnections(const DrawLocation& dl);
     void DrawOne(const DrawLocation& dl);
     void DrawGen();
-    void Traverse(int room, double x, double y, int from, double strength=1.0);
+    void Traverse(int group, int room, double x, double y, int from,
+                  double strength=1.0);
+    void TraverseRom();
     void Sort();
     void DrawLegend();
+    // Collect finished areas from the renderer and ask it for the level
+    // of detail which matches the zoom.
+    void UpdateLevels();
 
     int id_;
-    Mapper* mapper_;
+    RomContext* rom_;
+    bool whole_rom_;
     int world_;
     int overworld_;
     int subworld_;
@@ -72,11 +109,17 @@ class MultiMap: public ImWindowBase {
     std::string title_;
     int maxx_;
     int maxy_;
-    Map maps_[64];
-    bool visited_[64];
-    int visited_room0_;
+    // Indexed by node id.
+    std::vector<Map> maps_;
+    std::vector<bool> visited_;
+    std::vector<Group> groups_;
     std::map<int32_t, DrawLocation> location_;
+    AreaRenderer renderer_;
     fdg::Graph graph_;
+    // Simulates graph_ on a worker thread.  Node positions must be read
+    // and changed through the layout, not the nodes.
+    fdg::Layout layout_;
+    int dragging_;
 
     MultiMapConfig* mcfg_;
     PalaceGeneratorOptions pgo_;
@@ -90,6 +133,7 @@ class MultiMap: public ImWindowBase {
     static const uint32_t BLUE   = 0xF0FF0000;
     static const uint32_t YELLOW = 0xF000EEFD;
     static const uint32_t ORANGE = 0xF0008BFF;
+    static const uint32_t CYAN   = 0xF0FFFF00;
     static const uint32_t GRAY   = 0x60808080;
 };
 
@@ -1,7 +1,10 @@
 #include <cstdio>
+#include <cstring>
+#include "imwidget/change_bus.h"
 #include "imwidget/error_dialog.h"
 #include "imwidget/imapp.h"
 #include "imwidget/neschrview.h"
+#include "nes/chr_util.h"
 #include "imgui.h"
 
 #ifdef HAVE_NFD
@@ -10,13 +13,25 @@
 
 NesChrView::NesChrView(int bank)
   : ImWindowBase(false),
-  bank_(bank), mode_(true), grid_(true) {
+  bank_(bank), stale_(true), mode_(true), grid_(true) {
     int sz = grid_ ? 160 : 128;
     bitmap_.reset(new GLBitmap(sz, sz));
 }
 
 NesChrView::NesChrView() : NesChrView(0) {}
 
+NesChrView::~NesChrView() {
+    z2util::ChangeBus::Get()->Unsubscribe(this);
+}
+
+void NesChrView::Watch() {
+    auto* bus = z2util::ChangeBus::Get();
+    bus->Unsubscribe(this);
+    bus->Subscribe(this, z2util::ChangeBus::CHR, bank_,
+                   [this]() { stale_ = true; });
+    stale_ = true;
+}
+
 void NesChrView::RenderChr() {
     uint32_t pal[] = { 0xFF000000, 0xFF666666, 0xFFAAAAAA, 0xFFFFFFFF };
     uint32_t *image = bitmap_->data();
@@ -31,23 +46,25 @@ void NesChrView::RenderChr() {
         }
         image += width*inc + 1;
     }
+    // Decode the whole bank at once; tile t's pixels start at 64*t.
+    uint8_t chr[0x1000];
+    uint32_t pixels[256 * 64];
+    mapper_->ReadChrBytes(bank_, 0, chr, sizeof(chr));
+    z2util::ChrUtil::DecodeTiles(chr, 256, pal, pixels);
+
     // Draw the tiles on a 16x16 grid
     for(int y=0; y<16/inc; y++) {
         for(int x=0; x<16; x++, tile+=inc) {
             // Each tile is 8x8 or 8x16
             for(int row=0; row<8*inc; row++) {
-                uint8_t a = mapper_->ReadChrBank(
-                        bank_, 16*(tile + !!(row&8)) + (row & 7));
-                uint8_t b = mapper_->ReadChrBank(
-                        bank_, 16*(tile + !!(row&8)) + (row & 7) + 8);
-                for(int col=0; col<8; col++, a<<=1, b<<=1) {
-                    int color = ((a & 0x80) >> 7) | ((b & 0x80) >> 6);
-                    image[width*(sz*inc*y + row) + sz*x + col] = pal[color];
-                }
+                memcpy(&image[width*(sz*inc*y + row) + sz*x],
+                       &pixels[64*(tile + !!(row&8)) + 8*(row & 7)],
+                       8 * sizeof(uint32_t));
             }
         }
     }
     bitmap_->Update();
+    stale_ = false;
 }
 
 void NesChrView::Export(const std::string& filename) {
@@ -58,6 +75,8 @@ void NesChrView::Export(const std::string& filename) {
 }
 
 void NesChrView::Import(const std::string& filename) {
+    // Show the bank again, rather than whatever was loaded.
+    stale_ = true;
     if (!bitmap_->Load(filename)) {
         ErrorDialog::Spawn("Error Loading File",
                 "There was an error loading ", filename);
@@ -105,7 +124,9 @@ void NesChrView::MakeLabels() {
     }
     nr_labels_ = i;
     ImGui::PushItemWidth(200);
-    ImGui::Combo("Bank", &bank_, lptrs, nr_labels_);
+    if (ImGui::Combo("Bank", &bank_, lptrs, nr_labels_)) {
+        Watch();
+    }
     ImGui::PopItemWidth();
 }
 
@@ -120,13 +141,14 @@ bool NesChrView::Draw() {
 
     ImGui::SameLine();
     ImGui::PushItemWidth(100);
-    ImGui::Combo("Mode", &mode_, "8x8\0008x16\000\0");
+    stale_ |= ImGui::Combo("Mode", &mode_, "8x8\0008x16\000\0");
     ImGui::PopItemWidth();
 
     ImGui::SameLine();
     if (ImGui::Checkbox("Grid", &grid_)) {
         sz = grid_ ? 10 : 8;
         bitmap_.reset(new GLBitmap(16*sz, 16*sz));
+        stale_ = true;
     }
 
 #ifdef HAVE_NFD
@@ -173,8 +195,10 @@ bool NesChrView::Draw() {
         ImGui::Text("%02x", i * (mode_+1));
     }
 
-    // Render the CHR image
-    RenderChr();
+    // Render the CHR image, if anything changed since the last time.
+    if (stale_) {
+        RenderChr();
+    }
     ImGui::SetCursorPosY(y);
     bitmap_->Draw(sz*4*16, sz*4*16);
     ImGui::EndGroup();
@@ -11,18 +11,24 @@ class NesChrView: public ImWindowBase {
   public:
     NesChrView(int bank);
     NesChrView();
+    ~NesChrView();
 
     void RenderChr();
     void RenderChr8x8();
     void RenderChr8x16();
     void MakeLabels();
     bool Draw();
-    inline void set_mapper(Mapper* mapper) { mapper_ = mapper; }
+    inline void set_mapper(Mapper* mapper) { mapper_ = mapper; Watch(); }
     void Export(const std::string& filename);
     void Import(const std::string& filename);
   private:
+    // Follow changes to the current bank and render it again.
+    void Watch();
+
     Mapper* mapper_;
     int bank_;
+    // The bitmap needs to be rendered again.
+    bool stale_;
     std::unique_ptr<GLBitmap> bitmap_;
     char labels_[256][64];
     int nr_labels_;
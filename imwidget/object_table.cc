@@ -1,4 +1,5 @@
 #include "imwidget/object_table.h"
+#include "imwidget/change_bus.h"
 #include "imwidget/imutil.h"
 #include "util/config.h"
 
@@ -17,6 +18,10 @@ ObjectTable::ObjectTable()
     size_(FLAGS_hackjam2020 ? 64 : 16)
 {}
 
+ObjectTable::~ObjectTable() {
+    ChangeBus::Get()->Unsubscribe(this);
+}
+
 void ObjectTable::Init() {
     const auto& ri = ConfigLoader<RomInfo>::GetConfig();
     objtable_.clear();
@@ -35,6 +40,34 @@ void ObjectTable::Init() {
 
     cache_.set_mapper(mapper_);
     cache_.Init(*objtable_[selection_]);
+    Subscribe();
+}
+
+void ObjectTable::Subscribe() {
+    const auto& misc = ConfigLoader<RomInfo>::GetConfig().misc();
+    const Map* map = objtable_[selection_];
+    auto refresh = [this]() { Init(); };
+    auto* bus = ChangeBus::Get();
+    bus->Unsubscribe(this);
+    // The table points into the config's maps.
+    bus->Subscribe(this, ChangeBus::CONFIG, RomInfo::kMapFieldNumber,
+                   refresh);
+    for(const auto& objtable : map->objtable()) {
+        bus->Subscribe(this, ChangeBus::PRG, mapper_->PrgBankOf(objtable),
+                       refresh);
+    }
+    for(const auto& palette : map->palettes()) {
+        bus->Subscribe(this, ChangeBus::PRG, mapper_->PrgBankOf(palette),
+                       refresh);
+    }
+    bus->Subscribe(this, ChangeBus::PRG, mapper_->PrgBankOf(map->palette()),
+                   refresh);
+    if (map->type() == MapType::OVERWORLD) {
+        bus->Subscribe(this, ChangeBus::PRG,
+                       mapper_->PrgBankOf(misc.overworld_tile_palettes()),
+                       refresh);
+    }
+    bus->Subscribe(this, ChangeBus::CHR, map->chr().bank(), refresh);
 }
 
 bool ObjectTable::Draw() {
@@ -58,6 +91,7 @@ bool ObjectTable::Draw() {
     if (ImGui::Combo("Table", &selection_, names_.data(), names_.size())) {
         cache_.Init(*objtable_[selection_]);
         set_palette(palette_);
+        Subscribe();
         item_ = 0;
         if (objtable_[selection_]->type() == MapType::OVERWORLD) {
             size_ = FLAGS_hackjam2020 ? 64 : 16;
@@ -93,10 +127,10 @@ bool ObjectTable::Draw() {
         for(int x=0; x<8; x++, item++) {
             ImGui::SameLine();
             auto& bitmap = cache_.Get(item);
-            ImTextureID id = reinterpret_cast<ImTextureID>(bitmap.texture_id());
             ImVec2 size(bitmap.width()*scale_, bitmap.height()*scale_);
             ImGui::PushID(item);
-            if (ImGui::ImageButton(id, size)) {
+            if (ImGui::ImageButton(bitmap.texture_id(), size,
+                                   bitmap.uv0(), bitmap.uv1())) {
                 item_ = item;
             }
             ImGui::PopID();
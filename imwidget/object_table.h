@@ -12,11 +12,15 @@ namespace z2util {
 class ObjectTable: public ImWindowBase {
   public:
     ObjectTable();
+    ~ObjectTable();
     void Init();
     bool Draw() override;
 
     inline void set_mapper(Mapper* m) { mapper_ = m; }
   private:
+    // Subscribe to the banks the selected table is drawn from.
+    void Subscribe();
+
     int group_;
     int item_;
     int palette_;
@@ -1,5 +1,6 @@
 #include "imwidget/palette.h"
 
+#include "imwidget/change_bus.h"
 #include "imwidget/error_dialog.h"
 #include "imwidget/hwpalette.h"
 #include "imwidget/imapp.h"
@@ -14,6 +15,10 @@ DECLARE_bool(reminder_dialogs);
 
 namespace z2util {
 
+PaletteEditor::~PaletteEditor() {
+    ChangeBus::Get()->Unsubscribe(this);
+}
+
 void PaletteEditor::Init() {
     Load();
 }
@@ -99,9 +104,18 @@ bool PaletteEditor::Draw() {
 
 void PaletteEditor::Load() {
     const auto& ri = ConfigLoader<RomInfo>::GetConfig();
+    auto* bus = ChangeBus::Get();
+    // Re-read when the banks holding this group change, but don't throw
+    // away edits which haven't been committed.
+    auto refresh = [this]() { if (!changed_) Load(); };
+    bus->Unsubscribe(this);
+    bus->Subscribe(this, ChangeBus::CONFIG, RomInfo::kPalettesFieldNumber,
+                   refresh);
     data_.clear();
 
     for(const auto& p: ri.palettes(grpsel_).palette()) {
+        bus->Subscribe(this, ChangeBus::PRG, mapper_->PrgBankOf(p.address()),
+                       refresh);
         Unpacked elem;
         int len = p.length() ? p.length() : 16;
         for(int i=0; i<len; i++) {
@@ -10,6 +10,7 @@ class PaletteEditor: public ImWindowBase {
   public:
     PaletteEditor()
         : ImWindowBase(false), mapper_(nullptr), changed_(false),grpsel_(0) {}
+    ~PaletteEditor();
     void Init();
     void Refresh() override { Init(); }
     bool Draw() override;
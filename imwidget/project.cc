@@ -1,21 +1,49 @@
 #include "imwidget/project.h"
 
+#include <algorithm>
+#include <unordered_set>
+
+#include <gflags/gflags.h>
 #include "google/protobuf/text_format.h"
 #include "imwidget/imapp.h"
 #include "imwidget/error_dialog.h"
+#include "ips/bps.h"
 #include "ips/ips.h"
 #include "nes/cartridge.h"
 #include "util/compress.h"
 #include "util/config.h"
+#include "util/crc.h"
 #include "util/file.h"
 #include "util/logging.h"
 #include "util/os.h"
 #include "util/status.h"
 #include "util/statusor.h"
 
+DEFINE_int32(autosave, 300,
+             "Seconds between autosaves of a changed project (0 = never)");
+
 using google::protobuf::TextFormat;
 namespace z2util {
 
+Project::Project()
+  : ImWindowBase(false),
+    changed_(false),
+    selection_(0),
+    clean_size_(0),
+    export_base_(0),
+    edits_(0),
+    saved_edits_(0),
+    as_text_(false),
+    next_autosave_(0),
+    saving_(false),
+    save_stage_(0) {}
+
+Project::~Project() {
+    if (saver_) {
+        saver_->Wait();
+    }
+}
+
 void Project::Init() {}
 bool Project::Draw() {
     if (!visible_)
@@ -49,8 +77,12 @@ bool Project::Draw() {
     ImGui::ListBox("Commit History", &selection_, items, n, 15);
 
     if (ImGui::Button("Make Selection Current")) {
-        auto rom = ZLib::Uncompress(project_.history(selection_).rom());
-        if (rom.ok()) {
+        auto rom = Reconstruct(selection_);
+        if (rom.ok() && cartridge_->Restore(rom.ValueOrDie())) {
+            // Only the pages which differ were written, so only the
+            // widgets showing them need to re-read the ROM.
+            ImApp::Get()->ProcessMessage("romchanged", nullptr);
+        } else if (rom.ok()) {
             cartridge_->LoadRom(rom.ValueOrDie());
             ImApp::Get()->ProcessMessage("loadpostprocess",
                     reinterpret_cast<void*>(0));
@@ -58,11 +90,17 @@ bool Project::Draw() {
     }
     ImGui::SameLine();
     auto* history = project_.mutable_history();
-    if (ImGui::Button("Delete Selection")) {
+    if (ImGui::Button("Delete Selection") &&
+        selection_ < project_.history_size()) {
         history->erase(history->begin() + selection_);
+        edits_++;
+        if (selection_ >= project_.history_size()) {
+            selection_ = std::max(0, project_.history_size() - 1);
+        }
     }
     if (ImGui::InputText("Description", descr, sizeof(descr))) {
         history->Mutable(selection_)->set_description(descr);
+        edits_++;
     }
     ImGui::End();
     return false;
@@ -102,9 +140,17 @@ bool Project::Load(const std::string& filename, bool with_warnings) {
 bool Project::LoadWorker(const std::string& filename) {
     if (Cartridge::IsNESFile(filename)) {
         project_.Clear();
+        IndexChunks(false);
+        chunk_data_.clear();
+        clean_chunks_.clear();
+        filename_.clear();
         project_.set_name("New Project");
         cartridge_->LoadFile(filename);
         Commit("Unmodified ROM");
+        // The first commit is the ROM as loaded, so exports from it only
+        // need to look at what gets written from here on.
+        cartridge_->ClearDirty(Cartridge::EXPORT);
+        export_base_ = project_.history(0).create_time();
     } else {
         std::string content;
         if (!File::GetContents(filename, &content)) {
@@ -118,6 +164,13 @@ bool Project::LoadWorker(const std::string& filename) {
                 return false;
             }
         }
+        IndexChunks(false);
+        chunk_data_.clear();
+        clean_chunks_.clear();
+        export_base_ = 0;
+        filename_ = filename;
+        as_text_ = false;
+        saved_edits_ = edits_;
 #if 0
         LOG(INFO, "Loaded project: ", project_.name());
         LOG(INFO, "  compressed rom is ", project_.rom().size(), " bytes");
@@ -143,22 +196,111 @@ bool Project::LoadWorker(const std::string& filename) {
 }
 
 bool Project::Save(const std::string& filename, bool as_text) {
-    std::string content;
-    project_.set_rom(ZLib::Compress(cartridge_->SaveRom()));
-    *project_.mutable_settings() =
+    // Let any running save finish first.
+    if (saver_) {
+        saver_->Wait();
+    }
+    FinishSave();
+    SaveAsync(filename, as_text);
+    saver_->Wait();
+    return FinishSave();
+}
+
+bool Project::SaveAsync(const std::string& filename, bool as_text) {
+    if (saving_) {
+        LOG(WARN, "Not saving ", filename, ": a save is already running");
+        return false;
+    }
+    if (!saver_) {
+        saver_.reset(new util::Executor(1));
+    }
+    // Everything the save needs is captured here, so the editor can keep
+    // changing the project and ROM while the save runs.
+    IndexChunks(true);
+    auto snapshot = std::make_shared<ProjectFile>(project_);
+    *snapshot->mutable_settings() =
         ConfigLoader<SessionConfig>::Get()->GetConfig();
+    auto rom = std::make_shared<std::string>(cartridge_->SaveRom());
+    int edits = edits_;
+
+    saving_ = true;
+    save_stage_ = 0;
+    saver_->Submit([=]() {
+        auto result = new SaveResult{
+            WriteProject(snapshot.get(), *rom, filename, as_text),
+            filename, as_text, edits};
+        std::lock_guard<std::mutex> lock(save_mu_);
+        save_result_.reset(result);
+        saving_ = false;
+    });
+    return true;
+}
+
+util::Status Project::WriteProject(ProjectFile* project,
+                                   const std::string& rom,
+                                   const std::string& filename,
+                                   bool as_text) {
+    project->set_rom(ZLib::Compress(rom));
+    save_stage_ = 1;
+    std::string content;
     if (as_text) {
-        TextFormat::PrintToString(project_, &content);
+        TextFormat::PrintToString(*project, &content);
     } else {
-        project_.SerializeToString(&content);
+        project->SerializeToString(&content);
     }
-    bool ret = File::SetContents(filename, content);
-    if (ret) {
-        changed_ = false;
-    } else {
-        LOG(ERROR, "Could not save project: ", filename);
+    save_stage_ = 2;
+    // Write to a temporary file and rename it over the project, so a
+    // failed save never leaves a truncated project behind.
+    std::string tmp = filename + ".tmp";
+    if (!File::SetContents(tmp, content)) {
+        return util::Status(util::error::Code::UNKNOWN,
+                            absl::StrCat("Could not write ", tmp));
+    }
+    util::Status status = File::Rename(tmp, filename);
+    save_stage_ = 3;
+    return status;
+}
+
+bool Project::FinishSave() {
+    std::unique_ptr<SaveResult> result;
+    {
+        std::lock_guard<std::mutex> lock(save_mu_);
+        result = std::move(save_result_);
+    }
+    if (!result) {
+        return true;
+    }
+    if (!result->status.ok()) {
+        LOG(ERROR, "Could not save project ", result->filename, ": ",
+                   result->status.ToString());
+        ErrorDialog::Spawn("Save Failed", ErrorDialog::OK,
+                           "Could not save project " + result->filename +
+                           ":\n" + result->status.error_message());
+        return false;
+    }
+    changed_ = false;
+    saved_edits_ = result->edits;
+    filename_ = result->filename;
+    as_text_ = result->as_text;
+    return true;
+}
+
+void Project::Poll() {
+    FinishSave();
+    if (FLAGS_autosave <= 0)
+        return;
+    int64_t now = os::utime_now();
+    int64_t interval = FLAGS_autosave * 1000000LL;
+    if (next_autosave_ == 0) {
+        next_autosave_ = now + interval;
+    }
+    if (now < next_autosave_)
+        return;
+    next_autosave_ = now + interval;
+    if (!filename_.empty() && edits_ != saved_edits_ && !saving_) {
+        LOG(INFO, "Autosaving ", filename_);
+        SaveAsync(filename_, as_text_);
     }
-    return ret; 
 }
 
 bool Project::ImportRom(const std::string& filename) {
@@ -174,6 +316,30 @@ bool Project::ExportRom(const std::string& filename) {
 }
 
 util::Status Project::ExportIps(const std::string& filename, int original, int modified) {
+    Cartridge::Ranges ranges;
+    if (original == 1 && modified == 0 && project_.history_size() &&
+        project_.history(0).create_time() == export_base_) {
+        // Only what was written since the first commit can differ.
+        ranges = cartridge_->DirtyRanges(Cartridge::EXPORT);
+    } else {
+        ranges.emplace_back(0, UINT32_MAX);
+    }
+    return ExportPatch(filename, original, modified,
+        [&ranges](const std::string& orig, const std::string& mod) {
+            return ips::CreatePatch(orig, mod, ranges);
+        });
+}
+
+util::Status Project::ExportBps(const std::string& filename, int original, int modified) {
+    return ExportPatch(filename, original, modified,
+        [](const std::string& orig, const std::string& mod) {
+            return bps::CreatePatch(orig, mod);
+        });
+}
+
+util::Status Project::ExportPatch(
+        const std::string& filename, int original, int modified,
+        std::function<std::string(const std::string&, const std::string&)> create) {
     auto orig = rom(original);
     if (!orig.ok()) {
         return orig.status();
@@ -183,7 +349,7 @@ util::Status Project::ExportIps(const std::string& filename, int original, int m
         return mod.status();
     }
 
-    std::string patch = ips::CreatePatch(orig.ValueOrDie(), mod.ValueOrDie());
+    std::string patch = create(orig.ValueOrDie(), mod.ValueOrDie());
     if (!File::SetContents(filename, patch)) {
         return util::Status(util::error::Code::UNKNOWN, "Could not save file");
     }
@@ -210,14 +376,143 @@ StatusOr<std::string> Project::rom(int n) {
         return util::Status(util::error::Code::INVALID_ARGUMENT,
                             "Invalid history index");
     }
-    return ZLib::Uncompress(project_.history(n).rom());
+    return Reconstruct(n);
+}
+
+StatusOr<std::string> Project::Reconstruct(int n) {
+    if (n < 0 || n >= project_.history_size()) {
+        return util::Status(util::error::Code::INVALID_ARGUMENT,
+                            "Invalid history index");
+    }
+    const auto& commit = project_.history(n);
+    if (commit.chunk_size() == 0) {
+        // Saved before chunking.
+        return ZLib::Uncompress(commit.rom());
+    }
+    std::string rom;
+    rom.reserve(commit.size());
+    for(uint64_t id : commit.chunk()) {
+        auto chunk = LoadChunk(id);
+        if (!chunk.ok()) {
+            return chunk.status();
+        }
+        rom.append(*chunk.ValueOrDie());
+    }
+    if (rom.size() != commit.size()) {
+        return util::Status(util::error::Code::DATA_LOSS,
+                            "Commit chunks don't match the ROM size");
+    }
+    return rom;
+}
+
+void Project::Encode(int n, const std::string& rom, bool incremental) {
+    auto* commit = project_.mutable_history(n);
+    commit->clear_rom();
+    commit->clear_chunk();
+    commit->set_size(rom.size());
+    bool reuse = incremental && clean_size_ == rom.size();
+    auto add = [&](size_t start, size_t len) {
+        int k = commit->chunk_size();
+        if (reuse && k < int(clean_chunks_.size()) &&
+            chunk_index_.count(clean_chunks_[k]) &&
+            !cartridge_->IsDirty(Cartridge::COMMIT, start, start + len)) {
+            commit->add_chunk(clean_chunks_[k]);
+        } else {
+            commit->add_chunk(StoreChunk(rom.substr(start, len)));
+        }
+    };
+    // The first chunk is whatever doesn't fit evenly into kChunkSize
+    // (the iNES header), so the rest line up with the ROM banks.
+    size_t first = rom.size() % kChunkSize;
+    if (first) {
+        add(0, first);
+    }
+    for(size_t i=first; i<rom.size(); i+=kChunkSize) {
+        add(i, kChunkSize);
+    }
+    if (incremental) {
+        clean_chunks_.assign(commit->chunk().begin(), commit->chunk().end());
+        clean_size_ = rom.size();
+        cartridge_->ClearDirty(Cartridge::COMMIT);
+    }
+}
+
+uint64_t Project::StoreChunk(const std::string& data) {
+    uint64_t crc = Crc32(0, data.data(), data.size());
+    for(uint64_t n=0; ; n++) {
+        uint64_t id = crc << 32 | n;
+        if (chunk_index_.count(id) == 0) {
+            auto* chunk = project_.add_chunk();
+            chunk->set_id(id);
+            chunk->set_data(ZLib::Compress(data));
+            chunk->set_size(data.size());
+            chunk_index_[id] = project_.chunk_size() - 1;
+            chunk_data_[id] = data;
+            return id;
+        }
+        auto existing = LoadChunk(id);
+        if (existing.ok() && *existing.ValueOrDie() == data) {
+            return id;
+        }
+    }
+}
+
+StatusOr<const std::string*> Project::LoadChunk(uint64_t id) {
+    auto it = chunk_data_.find(id);
+    if (it != chunk_data_.end()) {
+        return &it->second;
+    }
+    auto index = chunk_index_.find(id);
+    if (index == chunk_index_.end()) {
+        return util::Status(util::error::Code::NOT_FOUND,
+                            "Commit refers to a missing chunk");
+    }
+    const auto& chunk = project_.chunk(index->second);
+    auto data = ZLib::Uncompress(chunk.data(), chunk.size());
+    if (!data.ok()) {
+        return data.status();
+    }
+    return &(chunk_data_[id] = data.ValueOrDie());
+}
+
+void Project::IndexChunks(bool collect) {
+    if (collect) {
+        std::unordered_set<uint64_t> live;
+        for(const auto& h : project_.history()) {
+            live.insert(h.chunk().begin(), h.chunk().end());
+        }
+        auto* chunks = project_.mutable_chunk();
+        chunks->erase(std::remove_if(chunks->begin(), chunks->end(),
+                          [&live](const Chunk& c) {
+                              return live.count(c.id()) == 0;
+                          }), chunks->end());
+        for(uint64_t id : clean_chunks_) {
+            if (live.count(id) == 0) {
+                // The id may be reused for other data.
+                clean_chunks_.clear();
+                break;
+            }
+        }
+        for(auto it=chunk_data_.begin(); it != chunk_data_.end(); ) {
+            if (live.count(it->first)) {
+                ++it;
+            } else {
+                it = chunk_data_.erase(it);
+            }
+        }
+    }
+    chunk_index_.clear();
+    for(int i=0; i<project_.chunk_size(); i++) {
+        chunk_index_[project_.chunk(i).id()] = i;
+    }
 }
 
 void Project::Commit(const std::string& message) {
     auto* commit = project_.add_history();
     commit->set_create_time(os::utime_now());
     commit->set_description(message);
-    commit->set_rom(ZLib::Compress(cartridge_->SaveRom()));
+    edits_++;
+    Encode(project_.history_size() - 1, cartridge_->SaveRom(), true);
 }
 
 }  // z2util
@@ -1,8 +1,18 @@
 #ifndef Z2UTIL_IMWIDGET_PROJECT_H
 #define Z2UTIL_IMWIDGET_PROJECT_H
 
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
 #include "imwidget/imwidget.h"
 #include "proto/project.pb.h"
+#include "util/executor.h"
 #include "util/status.h"
 #include "util/statusor.h"
 
@@ -11,27 +21,92 @@ namespace z2util {
 
 class Project: public ImWindowBase {
   public:
-    Project()
-      : ImWindowBase(false), changed_(false), selection_(0) {}
+    Project();
+    ~Project();
     void Init();
     bool Draw() override;
+    // Finish background saves and start autosaves.  Call once per frame.
+    void Poll();
 
     bool Load(const std::string& filename, bool with_warnings=true); 
     bool Save(const std::string& filename, bool as_text=false);
+    // Save on a background thread.  Returns false if a save is already
+    // in progress.
+    bool SaveAsync(const std::string& filename, bool as_text=false);
+    inline bool saving() const { return saving_; }
+    inline float save_progress() const { return save_stage_ / 3.0f; }
     bool ImportRom(const std::string& filename);
     bool ExportRom(const std::string& filename);
     util::Status ExportIps(const std::string& filename, int original=1, int modified=0);
+    util::Status ExportBps(const std::string& filename, int original=1, int modified=0);
     void Commit(const std::string& message);
 
     inline void set_cartridge(Cartridge* c) { cartridge_ = c; }
     inline const std::string& name() { return project_.name(); }
     StatusOr<std::string> rom(int n);
   private:
+    // ROMs are split into chunks of this size (after the iNES header),
+    // and each distinct chunk is stored once in the project.
+    static const int kChunkSize = 4096;
+
     bool LoadWorker(const std::string& filename);
+    util::Status ExportPatch(
+        const std::string& filename, int original, int modified,
+        std::function<std::string(const std::string&, const std::string&)> create);
+    // Compress, serialize and write a snapshot of the project.
+    util::Status WriteProject(ProjectFile* project, const std::string& rom,
+                              const std::string& filename, bool as_text);
+    // Apply the result of a finished background save, if there is one.
+    // Returns false if that save failed.
+    bool FinishSave();
+    // Reassemble the ROM of history entry n (0 = oldest).
+    StatusOr<std::string> Reconstruct(int n);
+    // Store rom in history entry n as a chunk manifest.  If incremental,
+    // rom is the cartridge image and chunks the cartridge hasn't written
+    // since the last incremental encode are reused without hashing.
+    void Encode(int n, const std::string& rom, bool incremental=false);
+    uint64_t StoreChunk(const std::string& data);
+    StatusOr<const std::string*> LoadChunk(uint64_t id);
+    // Rebuild chunk_index_, optionally dropping unreferenced chunks.
+    void IndexChunks(bool collect);
+
     Cartridge* cartridge_;
     bool changed_;
     int selection_;
     ProjectFile project_;
+    // Chunk id -> index in project_.chunk.
+    std::unordered_map<uint64_t, int> chunk_index_;
+    // Uncompressed chunk contents, filled in as chunks are used.
+    std::unordered_map<uint64_t, std::string> chunk_data_;
+    // The manifest of the cartridge image as of the last commit, for
+    // reuse of unwritten chunks.
+    std::vector<uint64_t> clean_chunks_;
+    size_t clean_size_;
+    // Create time of the commit which the cartridge's EXPORT dirty pages
+    // are relative to, or 0.
+    int64_t export_base_;
+
+    // Counts changes to the history; autosave runs when it differs from
+    // saved_edits_.
+    int edits_;
+    int saved_edits_;
+    // Where the project was last loaded from or saved to.
+    std::string filename_;
+    bool as_text_;
+    int64_t next_autosave_;
+
+    // The result of the last background save, for Poll to pick up.
+    struct SaveResult {
+        util::Status status;
+        std::string filename;
+        bool as_text;
+        int edits;
+    };
+    std::unique_ptr<util::Executor> saver_;
+    std::atomic<bool> saving_;
+    std::atomic<int> save_stage_;
+    std::mutex save_mu_;
+    std::unique_ptr<SaveResult> save_result_;
 };
 
 }  // z2util
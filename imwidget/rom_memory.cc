@@ -3,6 +3,7 @@
 #include "proto/rominfo.pb.h"
 #include "imwidget/imapp.h"
 #include "imwidget/imutil.h"
+#include "nes/memory.h"
 #include "util/config.h"
 #include "util/logging.h"
 #include <gflags/gflags.h>
@@ -17,38 +18,28 @@ namespace z2util {
 void RomMemory::Init() {}
 
 int RomMemory::FillFreeSpace(uint32_t color, uint32_t kocolor) {
-    const auto& ri = ConfigLoader<RomInfo>::GetConfig();
+    const auto& kotable = KeepoutTable::Get();
     Address addr;
     addr.set_bank(bank_);
     bool freespace = false;
-    bool keepout = false;
-    int len = 16384;
+    auto bank = mapper_->PrgBankSpan(bank_, 0x8000, 0x4000);
+    int len = bank.size();
     int total = 0;
     int j;
     for(int i=0; i<len; ++i) {
         addr.set_address(0x8000 + i);
-        keepout = false;
-        for(const auto ko : ri.misc().allocator_keepout()) {
-            if (ko.bank() == bank_) {
-                if (addr.address() >= ko.address() &&
-                    addr.address() < ko.address() + ko.length()) {
-                    int pix = addr.address() & 0x3FFF;
-                    viz_.SetPixel(pix % 128, pix/128, kocolor);
-                    freespace = false;
-                    keepout = true;
-                    break;
-                }
-            }
-        }
-        if (keepout) {
+        if (kotable.Contains(bank_, addr.address())) {
+            int pix = addr.address() & 0x3FFF;
+            viz_.SetPixel(pix % 128, pix/128, kocolor);
+            freespace = false;
             continue;
         }
-        int val = mapper_->Read(addr, 0);
+        int val = bank[i];
         if (val == 255) {
             if (!freespace) {
                 // We only consider it freespace if its >= 8 bytes of 0xFF.
                 for(j=0; j<8 && i+j<len; ++j) {
-                    if (mapper_->Read(addr, j) != 255) {
+                    if (bank[i+j] != 255) {
                         break;
                     }
                 }
@@ -68,13 +59,10 @@ int RomMemory::FillFreeSpace(uint32_t color, uint32_t kocolor) {
 }
 
 void RomMemory::FillKeepout(uint32_t color) {
-    const auto& ri = ConfigLoader<RomInfo>::GetConfig();
-    for(const auto ko : ri.misc().allocator_keepout()) {
-        if (ko.bank() == bank_) {
-            for(int i=0; i<ko.length(); ++i) {
-                int pix = (ko.address() + i) & 0x3FFF;
-                viz_.SetPixel(pix % 128, pix/128, color);
-            }
+    for(const auto& ko : KeepoutTable::Get().regions(bank_)) {
+        for(int a=ko.first; a<ko.second; ++a) {
+            int pix = a & 0x3FFF;
+            viz_.SetPixel(pix % 128, pix/128, color);
         }
     }
 }
@@ -123,15 +111,13 @@ int RomMemory::FillOverworld(const Address& addr, uint32_t color) {
 }
 
 int RomMemory::FillAllocRegions() {
-    Address addr;
-    addr.set_bank(bank_);
-    addr.set_address(0x8000);
-    int len = 16384;
+    auto bank = mapper_->PrgBankSpan(bank_, 0x8000, 0x4000);
+    int len = bank.size();
     int totallen = 0;
-    for(int i=0; i<len; ++i) {
-        int val = mapper_->ReadWord(addr, i);
+    for(int i=0; i+3<len; ++i) {
+        int val = bank[i] | bank[i+1] << 8;
         if (val == ALLOC_TOKEN) {
-            int regionlen = mapper_->ReadWord(addr, i+2);
+            int regionlen = bank[i+2] | bank[i+3] << 8;
             totallen += regionlen;
             uint32_t color = 0xFFFF00FF;
             for(int j=0; i<len && j<regionlen+4; ++j, ++i) {
@@ -223,10 +209,9 @@ void RomMemory::ProcessSideview() {
 RomMemory::RomData RomMemory::ReadLevel(const Address& addr) {
     RomData rd{uint16_t(addr.address()), 0};
     int len = mapper_->Read(addr, 0);
-    for(int i=0; i<len; i++) {
-        rd.data.emplace_back(mapper_->Read(addr, i));
-        mapper_->Write(addr, i, 0xff);
-    }
+    rd.data.resize(len);
+    mapper_->ReadBytes(addr, 0, rd.data.data(), len);
+    mapper_->Erase(addr, len);
     mapper_->Free(addr);
     return rd;
 }
@@ -234,10 +219,9 @@ RomMemory::RomData RomMemory::ReadLevel(const Address& addr) {
 RomMemory::RomData RomMemory::ReadOverworld(const Address& addr) {
     RomData rd{uint16_t(addr.address()), 0};
     int len = GetOverworldLength(addr);
-    for(int i=0; i<len; i++) {
-        rd.data.emplace_back(mapper_->Read(addr, i));
-        mapper_->Write(addr, i, 0xff);
-    }
+    rd.data.resize(len);
+    mapper_->ReadBytes(addr, 0, rd.data.data(), len);
+    mapper_->Erase(addr, len);
     if (len) {
         mapper_->Free(addr);
     }
@@ -248,16 +232,17 @@ void RomMemory::FreeAllocRegions() {
     Address addr;
     addr.set_bank(bank_);
     addr.set_address(0x8000);
-    int len = 16384;
+    auto bank = mapper_->PrgBankSpan(bank_, 0x8000, 0x4000);
+    int len = bank.size();
     int j;
-    for(int i=0; i<len; ++i) {
-        int val = mapper_->ReadWord(addr, i);
+    for(int i=0; i+3<len; ++i) {
+        int val = bank[i] | bank[i+1] << 8;
         if (val == ALLOC_TOKEN) {
-            int regionlen = mapper_->ReadWord(addr, i+2);
+            int regionlen = bank[i+2] | bank[i+3] << 8;
 
             // Check if the region appears to already be empty (all FF).
             for(j=0; j<regionlen && (j+i+4) < len; ++j) {
-                if (mapper_->Read(addr, i+j+4) != 255)
+                if (bank[i+j+4] != 255)
                     break;
             }
 
@@ -283,9 +268,7 @@ void RomMemory::WriteRomData(const RomData& rd) {
     Address addr;
     addr.set_bank(bank_);
     addr.set_address(rd.address);
-    for(size_t i=0; i<rd.data.size(); ++i) {
-        mapper_->Write(addr, i, rd.data[i]);
-    }
+    mapper_->WriteBytes(addr, 0, rd.data.data(), rd.data.size());
 }
 
 bool RomMemory::PlaceMap(std::vector<Region>* regions, RomData* map) {
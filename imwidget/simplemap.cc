@@ -1,6 +1,8 @@
 #include "imwidget/simplemap.h"
+#include <algorithm>
 #include <gflags/gflags.h>
 
+#include "imwidget/change_bus.h"
 #include "imwidget/imapp.h"
 #include "imwidget/imutil.h"
 #include "imwidget/error_dialog.h"
@@ -15,6 +17,7 @@ namespace z2util {
 
 SimpleMap::SimpleMap()
   : ImWindowBase(false),
+    watch_(false),
     changed_(false),
     object_box_(true),
     enemy_box_(true),
@@ -26,7 +29,8 @@ SimpleMap::SimpleMap()
     startscreen_(0),
     title_("Sideview Editor"),
     window_title_(title_),
-    grayout_(256, 208) {
+    grayout_(256, 208),
+    rom_(nullptr) {
     for(int y=0; y<grayout_.height(); y++) {
         for(int x=0; x<grayout_.width(); x++) {
             grayout_.SetPixel(x, y, 0xc0000000);
@@ -35,9 +39,9 @@ SimpleMap::SimpleMap()
     grayout_.Update();
 }
 
-SimpleMap::SimpleMap(Mapper* m, const Map& map, int startscreen)
+SimpleMap::SimpleMap(RomContext* rom, const Map& map, int startscreen)
   : SimpleMap() {
-    set_mapper(m);
+    set_rom(rom);
     SetMap(map);
     startscreen_ = startscreen;
     mapsel_ = -1;
@@ -46,43 +50,126 @@ SimpleMap::SimpleMap(Mapper* m, const Map& map, int startscreen)
     bgmap_ = map.world() == -1;
 }
 
-SimpleMap* SimpleMap::Spawn(Mapper* m, const Map& map, int startscreen) {
-    SimpleMap *sm = new SimpleMap(m, map, startscreen);
+SimpleMap::~SimpleMap() {
+    if (watch_) {
+        ChangeBus::Get()->Unsubscribe(this);
+    }
+}
+
+SimpleMap* SimpleMap::Spawn(RomContext* rom, const Map& map,
+                            int startscreen) {
+    SimpleMap *sm = new SimpleMap(rom, map, startscreen);
     sm->visible_ = true;
+    sm->Watch();
     ImApp::Get()->AddDrawCallback(sm);
     return sm;
 }
 
-void SimpleMap::DrawMap(const ImVec2& pos) {
-    float size = 16.0 * scale_;
-    auto* draw = ImGui::GetWindowDrawList();
-    auto sp = ImGui::GetCursorScreenPos();
-    for(int y=0; y<decomp_.height(); y++) {
-        for(int x=0; x<decomp_.width(); x++) {
-            cache_.Get(decomp_.map(x, y)).DrawAt(
-                    pos.x + x*size, pos.y + y*size, scale_);
-
+void SimpleMap::ComposeTiles(GLBitmap* buffer, int x0, int y0,
+                             int x1, int y1) {
+    int size = 16;
+    for(int y=y0; y<y1; y++) {
+        for(int x=x0; x<x1; x++) {
+            buffer->Blit(x*size, y*size, size, size,
+                         cache_.Get(decomp_.map(x, y)).data());
         }
     }
+    // Items may be larger than a tile, so check every item for overlap
+    // with the rectangle rather than only the ones inside it.
     for(int y=0; y<decomp_.height(); y++) {
         for(int x=0; x<decomp_.width(); x++) {
             uint8_t item = decomp_.item(x, y);
-            if (item != 0xFF) {
-                auto& sprite = items_.Get(item);
-                sprite.DrawAt(pos.x + x*size, pos.y + y*size, scale_);
-                if (item != ELEVATOR && !avail_.get(x) && avail_.show()) {
-                    float rx = sprite.width() * scale_ / 2.0;
-                    float ry = sprite.height() * scale_ / 2.0;
-                    draw->AddCircle(
-                            ImVec2(sp.x + x*size + rx, sp.y + y*size + ry),
-                            (rx+ry)/1.333, RED, 20, 2.0f);
-                    draw->AddLine(
-                            ImVec2(sp.x + x*size, sp.y + y*size),
-                            ImVec2(sp.x + x*size + sprite.width() * scale_,
-                                   sp.y + y*size + sprite.height() * scale_),
-                            RED, 2.0f);
+            if (item == 0xFF)
+                continue;
+            auto& sprite = items_.Get(item);
+            if (x >= x1 || x*size + sprite.width() <= x0*size ||
+                y >= y1 || y*size + sprite.height() <= y0*size)
+                continue;
+            buffer->Blit(x*size, y*size, sprite.width(), sprite.height(),
+                         sprite.data());
+        }
+    }
+}
 
-                }
+void SimpleMap::UpdateComposite() {
+    int width = decomp_.width();
+    int height = decomp_.height();
+    if (!composite_ || composite_->width() != width*16 ||
+        composite_->height() != height*16) {
+        composite_.reset(new GLBitmap(width*16, height*16));
+        InvalidateComposite();
+    }
+
+    int x0 = width, y0 = height, x1 = 0, y1 = 0;
+    if (shadow_.size() != size_t(width * height * 2)) {
+        shadow_.assign(width * height * 2, 0);
+        x0 = y0 = 0;
+        x1 = width;
+        y1 = height;
+    }
+    // Extend the dirty rectangle over a cell, including the area covered
+    // by an item sprite which is drawn there.
+    auto dirty = [&](int x, int y, uint8_t item) {
+        int w = 1, h = 1;
+        if (item != 0xFF) {
+            auto& sprite = items_.Get(item);
+            w = std::max(w, (sprite.width() + 15) / 16);
+            h = std::max(h, (sprite.height() + 15) / 16);
+        }
+        x0 = std::min(x0, x);
+        y0 = std::min(y0, y);
+        x1 = std::min(width, std::max(x1, x + w));
+        y1 = std::min(height, std::max(y1, y + h));
+    };
+    uint8_t* sh = shadow_.data();
+    for(int y=0; y<height; y++) {
+        for(int x=0; x<width; x++, sh+=2) {
+            uint8_t tile = decomp_.map(x, y);
+            uint8_t item = decomp_.item(x, y);
+            if (sh[0] != tile || sh[1] != item) {
+                dirty(x, y, sh[1]);
+                dirty(x, y, item);
+                sh[0] = tile;
+                sh[1] = item;
+            }
+        }
+    }
+    if (x0 >= x1 || y0 >= y1)
+        return;
+
+    // Tiles may have transparent pixels, so clear the area before
+    // compositing into it.
+    uint32_t* data = composite_->data();
+    for(int y=y0*16; y<y1*16; y++) {
+        std::fill(data + y*width*16 + x0*16, data + y*width*16 + x1*16, 0);
+    }
+    ComposeTiles(composite_.get(), x0, y0, x1, y1);
+    composite_->Update(x0*16, y0*16, (x1-x0)*16, (y1-y0)*16);
+}
+
+void SimpleMap::DrawMap(const ImVec2& pos) {
+    UpdateComposite();
+    float size = 16.0 * scale_;
+    auto* draw = ImGui::GetWindowDrawList();
+    auto sp = ImGui::GetCursorScreenPos();
+    composite_->DrawAt(pos.x, pos.y, scale_);
+    if (avail_.show()) {
+        for(int y=0; y<decomp_.height(); y++) {
+            for(int x=0; x<decomp_.width(); x++) {
+                uint8_t item = decomp_.item(x, y);
+                if (item == 0xFF || item == ELEVATOR || avail_.get(x))
+                    continue;
+                auto& sprite = items_.Get(item);
+                float rx = sprite.width() * scale_ / 2.0;
+                float ry = sprite.height() * scale_ / 2.0;
+                draw->AddCircle(
+                        ImVec2(sp.x + x*size + rx, sp.y + y*size + ry),
+                        (rx+ry)/1.333, RED, 20, 2.0f);
+                draw->AddLine(
+                        ImVec2(sp.x + x*size, sp.y + y*size),
+                        ImVec2(sp.x + x*size + sprite.width() * scale_,
+                               sp.y + y*size + sprite.height() * scale_),
+                        RED, 2.0f);
             }
         }
     }
@@ -100,23 +187,7 @@ void SimpleMap::DrawMap(const ImVec2& pos) {
 
 void SimpleMap::RenderToBuffer(GLBitmap *buffer) {
     int size = 16;
-    for(int y=0; y<decomp_.height(); y++) {
-        for(int x=0; x<decomp_.width(); x++) {
-            buffer->Blit(x*size, y*size, size, size,
-                         cache_.Get(decomp_.map(x, y)).data());
-
-        }
-    }
-    for(int y=0; y<decomp_.height(); y++) {
-        for(int x=0; x<decomp_.width(); x++) {
-            uint8_t item = decomp_.item(x, y);
-            if (item != 0xFF) {
-                auto& sprite = items_.Get(item);
-                buffer->Blit(x*size, y*size, sprite.width(), sprite.height(),
-                             sprite.data());
-            }
-        }
-    }
+    ComposeTiles(buffer, 0, 0, decomp_.width(), decomp_.height());
     for(const auto& e : enemies_.data()) {
         auto& sprite = enemy_.Get(e.enemy);
         buffer->Blit(e.x*size, e.y*size, sprite.width(), sprite.height(),
@@ -297,6 +368,7 @@ bool SimpleMap::Draw() {
             if (draw_result == MapHolder::DR_PALETTE_CHANGED) {
                 cache_.Clear();
                 cache_.set_palette(decomp_.palette());
+                InvalidateComposite();
             }
         }
     }
@@ -306,6 +378,7 @@ bool SimpleMap::Draw() {
 
 void SimpleMap::SetMap(const z2util::Map& map, int mapsel) {
     const auto& ri = ConfigLoader<RomInfo>::GetConfig();
+    Mapper* mapper = rom_->mapper();
     map_ = map;
     bgmap_ = map.world() == -1;
     if (mapsel != -1) mapsel_ = mapsel;
@@ -313,12 +386,13 @@ void SimpleMap::SetMap(const z2util::Map& map, int mapsel) {
     decomp_.Init();
     decomp_.Decompress(map);
     startscreen_ = 0;
+    InvalidateComposite();
 
-    connection_.set_mapper(mapper_);
-    cache_.set_mapper(mapper_);
+    connection_.set_rom(rom_);
+    cache_.set_mapper(mapper);
     cache_.Init(map);
 
-    items_.set_mapper(mapper_);
+    items_.set_mapper(mapper);
     Address ipal;
     // FIXME(cfrantz): hardcoded palette location
     ipal.set_bank(decomp_.palette().bank());
@@ -326,7 +400,7 @@ void SimpleMap::SetMap(const z2util::Map& map, int mapsel) {
     items_.Init(ri.items());
     items_.set_palette(ipal);
 
-    enemy_.set_mapper(mapper_);
+    enemy_.set_mapper(mapper);
     enemy_.Init(decomp_.EnemyInfo());
     enemy_.set_palette(ipal);
 
@@ -342,10 +416,10 @@ void SimpleMap::SetMap(const z2util::Map& map, int mapsel) {
         enemy_.set_chr(chr);
     }
 
-    holder_.set_mapper(mapper_);
-    enemies_.set_mapper(mapper_);
-    avail_.set_mapper(mapper_);
-    swapper_.set_mapper(mapper_);
+    holder_.set_rom(rom_);
+    enemies_.set_rom(rom_);
+    avail_.set_mapper(mapper);
+    swapper_.set_mapper(mapper);
     if (map_.type() != MapType::OVERWORLD) {
         cache_.set_palette(decomp_.palette());
         holder_.Parse(map);
@@ -359,6 +433,51 @@ void SimpleMap::SetMap(const z2util::Map& map, int mapsel) {
         swapper_.set_map(map);
     }
     changed_ = false;
+    if (watch_) {
+        Subscribe();
+    }
+}
+
+void SimpleMap::Watch() {
+    watch_ = true;
+    if (rom_) {
+        Subscribe();
+    }
+}
+
+void SimpleMap::Subscribe() {
+    // Re-read the area when anything it is drawn from changes (its bank,
+    // object tables, palettes or CHR), unless it has edits which haven't
+    // been committed.
+    auto refresh = [this]() {
+        if (!changed_) {
+            int screen = startscreen_;
+            SetMap(map_);
+            startscreen_ = screen;
+        }
+    };
+    const auto& misc = ConfigLoader<RomInfo>::GetConfig().misc();
+    Mapper* mapper = rom_->mapper();
+    auto* bus = ChangeBus::Get();
+    bus->Unsubscribe(this);
+    bus->Subscribe(this, ChangeBus::PRG, mapper->PrgBankOf(map_.address()),
+                   refresh);
+    for(const auto& objtable : map_.objtable()) {
+        bus->Subscribe(this, ChangeBus::PRG, mapper->PrgBankOf(objtable),
+                       refresh);
+    }
+    bus->Subscribe(this, ChangeBus::PRG,
+                   mapper->PrgBankOf(decomp_.palette()), refresh);
+    if (map_.type() == MapType::OVERWORLD) {
+        bus->Subscribe(this, ChangeBus::PRG,
+                       mapper->PrgBankOf(misc.overworld_tile_palettes()),
+                       refresh);
+    }
+    // Unless --render_items_in_known_banks is set, items and enemies are
+    // drawn from the even/odd pair containing the area's CHR bank.
+    int chr = cache_.chr().bank();
+    bus->Subscribe(this, ChangeBus::CHR, chr, refresh);
+    bus->Subscribe(this, ChangeBus::CHR, chr ^ 1, refresh);
 }
 
 }  // namespace z2util
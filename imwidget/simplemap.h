@@ -1,10 +1,13 @@
 #ifndef Z2UTIL_IMWIDGET_SIMPLEMAP_H
 #define Z2UTIL_IMWIDGET_SIMPLEMAP_H
+#include <memory>
 #include <string>
+#include <vector>
 #include "imwidget/glbitmap.h"
 #include "imwidget/imwidget.h"
 #include "imwidget/map_command.h"
 #include "nes/mapper.h"
+#include "nes/rom_context.h"
 #include "nes/z2decompress.h"
 #include "nes/z2objcache.h"
 #include "proto/rominfo.pb.h"
@@ -15,10 +18,19 @@ namespace z2util {
 
 class SimpleMap: public ImWindowBase {
   public:
-    static SimpleMap* Spawn(Mapper* m, const Map& map, int startscreen=0);
+    static SimpleMap* Spawn(RomContext* rom, const Map& map,
+                            int startscreen=0);
     SimpleMap();
-    SimpleMap(Mapper* m, const Map& map, int startscreen=0);
-    void set_mapper(Mapper* m) { mapper_ = m; decomp_.set_mapper(m); }
+    SimpleMap(RomContext* rom, const Map& map, int startscreen=0);
+    ~SimpleMap();
+    void set_rom(RomContext* rom) {
+        rom_ = rom;
+        decomp_.set_mapper(rom->mapper());
+    }
+    // Re-read the area when the ROM changes under it.  Only for windows
+    // on the UI thread: the ChangeBus isn't thread-safe, so SimpleMaps
+    // built by render workers never touch it.
+    void Watch();
     void Refresh() override { SetMap(map_); }
     bool Draw() override;
     void DrawMap(const ImVec2& pos);
@@ -28,6 +40,17 @@ class SimpleMap: public ImWindowBase {
     void RenderToBuffer(GLBitmap *buffer);
     std::unique_ptr<GLBitmap> RenderToNewBuffer();
   private:
+    // Draw the map tiles and items which touch the tile rectangle
+    // [x0, x1) x [y0, y1) into buffer.
+    void ComposeTiles(GLBitmap* buffer, int x0, int y0, int x1, int y1);
+    // Bring composite_ up to date with decomp_.  Only the tiles which
+    // differ from the previous composite are redrawn and uploaded.
+    void UpdateComposite();
+    inline void InvalidateComposite() { shadow_.clear(); }
+    // Subscribe to the banks the current area is drawn from.
+    void Subscribe();
+
+    bool watch_;
     bool changed_;
     bool object_box_;
     bool enemy_box_;
@@ -42,6 +65,10 @@ class SimpleMap: public ImWindowBase {
     std::string title_;
     std::string window_title_;
     GLBitmap grayout_;
+    // The tiles and items of the whole area, composited into one texture.
+    // shadow_ holds the (tile, item) pairs it was last composited from.
+    std::unique_ptr<GLBitmap> composite_;
+    std::vector<uint8_t> shadow_;
     Z2Decompress decomp_;
     MapHolder holder_;
     MapConnection connection_;
@@ -49,7 +76,7 @@ class SimpleMap: public ImWindowBase {
     MapItemAvailable avail_;
     MapSwapper swapper_;
 
-    Mapper* mapper_;
+    RomContext* rom_;
 
     Map map_;
     Z2ObjectCache cache_;
@@ -89,7 +89,7 @@ bool TextTableEditor::Draw() {
 
 void TextTableEditor::Load() {
     memset(data_, 0, sizeof(data_));
-    pack_.set_mapper(mapper_);
+    pack_.set_rom(rom_);
     pack_.Unpack(3);
     pack_.CheckIndex();
 
@@ -2,27 +2,27 @@
 #define Z2UTIL_IMWIDGET_TEXT_TABLE_H
 #include <vector>
 #include "imwidget/imwidget.h"
+#include "nes/rom_context.h"
 #include "nes/text_list.h"
 
-class Mapper;
 namespace z2util {
 
 class TextTableEditor: public ImWindowBase {
   public:
     TextTableEditor()
-        : ImWindowBase(false), mapper_(nullptr), changed_(false), world_(0) {}
+        : ImWindowBase(false), rom_(nullptr), changed_(false), world_(0) {}
     void Init();
     void Refresh() override { Init(); }
     bool Draw() override;
     int TotalLength();
 
-    inline void set_mapper(Mapper* m) { mapper_ = m; }
+    inline void set_rom(RomContext* rom) { rom_ = rom; }
   private:
     void Load();
     void Save();
 
 
-    Mapper* mapper_;
+    RomContext* rom_;
     bool changed_;
     int world_;
     TextListPack pack_;
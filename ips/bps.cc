@@ -0,0 +1,338 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "ips/bps.h"
+#include "util/crc.h"
+#include "util/status.h"
+#include "util/statusor.h"
+
+namespace bps {
+namespace {
+enum Action {
+    SOURCE_READ,
+    TARGET_READ,
+    SOURCE_COPY,
+    TARGET_COPY,
+};
+
+// Copies are found by hashing this many bytes.
+const size_t kHashLen = 4;
+const int kHashBits = 16;
+// How many earlier positions with the same hash to try.
+const int kMaxChain = 64;
+// Shorter matches cost more to describe than to send as data.
+const size_t kMinSourceRead = 4;
+const size_t kMinCopy = 6;
+
+void write_varint(std::string* p, uint64_t val) {
+    for(;;) {
+        uint8_t x = val & 0x7f;
+        val >>= 7;
+        if (val == 0) {
+            p->append(1, 0x80 | x);
+            break;
+        }
+        p->append(1, x);
+        val--;
+    }
+}
+
+void write_uint4(std::string* p, uint32_t val) {
+    p->append(1, (val >> 0) & 0xFF);
+    p->append(1, (val >> 8) & 0xFF);
+    p->append(1, (val >> 16) & 0xFF);
+    p->append(1, (val >> 24) & 0xFF);
+}
+
+uint32_t read_uint4(const std::string& p, size_t offset) {
+    return uint8_t(p[offset]) |
+           uint8_t(p[offset+1]) << 8 |
+           uint8_t(p[offset+2]) << 16 |
+           uint32_t(uint8_t(p[offset+3])) << 24;
+}
+
+// Read a varint from p at *offset, not reading at or past end.
+bool read_varint(const std::string& p, size_t* offset, size_t end,
+                 uint64_t* val) {
+    uint64_t data = 0, shift = 1;
+    for(int i=0; i<10; i++) {
+        if (*offset >= end)
+            return false;
+        uint8_t x = p[(*offset)++];
+        data += (x & 0x7f) * shift;
+        if (x & 0x80) {
+            *val = data;
+            return true;
+        }
+        shift <<= 7;
+        data += shift;
+    }
+    return false;
+}
+
+inline uint32_t Hash(const char* p) {
+    uint32_t x;
+    memcpy(&x, p, sizeof(x));
+    return (x * 2654435761u) >> (32 - kHashBits);
+}
+
+// The length of the common prefix of a and b, up to n.
+size_t MatchLength(const char* a, const char* b, size_t n) {
+    size_t i = 0;
+    while(i + sizeof(uint64_t) <= n) {
+        uint64_t x, y;
+        memcpy(&x, a + i, sizeof(x));
+        memcpy(&y, b + i, sizeof(y));
+        if (x != y)
+            break;
+        i += sizeof(uint64_t);
+    }
+    while(i < n && a[i] == b[i]) {
+        i++;
+    }
+    return i;
+}
+
+// Chains of positions in a buffer with the same hash, newest first.
+class HashChain {
+  public:
+    explicit HashChain(size_t size)
+      : head_(1 << kHashBits, -1), next_(size, -1) {}
+
+    void Insert(const char* data, size_t pos) {
+        uint32_t h = Hash(data + pos);
+        next_[pos] = head_[h];
+        head_[h] = pos;
+    }
+    inline int32_t First(const char* key) const { return head_[Hash(key)]; }
+    inline int32_t Next(int32_t pos) const { return next_[pos]; }
+
+  private:
+    std::vector<int32_t> head_;
+    std::vector<int32_t> next_;
+};
+
+class Encoder {
+  public:
+    Encoder(const std::string& source, const std::string& target,
+            std::string* patch)
+      : src_(source.data()), tgt_(target.data()),
+        ssize_(source.size()), tsize_(target.size()),
+        patch_(patch), source_chain_(ssize_), target_chain_(tsize_),
+        literal_(0), source_rel_(0), target_rel_(0) {}
+
+    void Encode() {
+        for(size_t i=0; i + kHashLen <= ssize_; i++) {
+            source_chain_.Insert(src_, i);
+        }
+        size_t pos = 0, indexed = 0;
+        while(pos < tsize_) {
+            size_t len = Step(pos);
+            pos += len;
+            // Everything before pos is available for target copies.
+            for(; indexed < pos && indexed + kHashLen <= tsize_; indexed++) {
+                target_chain_.Insert(tgt_, indexed);
+            }
+        }
+        Flush(tsize_);
+    }
+
+  private:
+    // Encode something at pos, returning how many bytes it covered.
+    size_t Step(size_t pos) {
+        size_t remain = tsize_ - pos;
+        size_t read = pos < ssize_ ?
+            MatchLength(src_ + pos, tgt_ + pos, std::min(remain, ssize_ - pos)) : 0;
+
+        Action action = TARGET_READ;
+        size_t best = 0, from = 0;
+        if (remain >= kHashLen) {
+            const char* key = tgt_ + pos;
+            int n = 0;
+            for(int32_t q = source_chain_.First(key); q >= 0 && n < kMaxChain;
+                q = source_chain_.Next(q), n++) {
+                size_t len = MatchLength(src_ + q, key, std::min(remain, ssize_ - q));
+                if (len > best) {
+                    action = SOURCE_COPY; best = len; from = q;
+                    if (len == remain) break;
+                }
+            }
+            n = 0;
+            for(int32_t q = target_chain_.First(key); q >= 0 && n < kMaxChain &&
+                best < remain; q = target_chain_.Next(q), n++) {
+                // The copy may overlap the data it produces, just as the
+                // decoder will run it.
+                size_t len = MatchLength(tgt_ + q, key, remain);
+                if (len > best) {
+                    action = TARGET_COPY; best = len; from = q;
+                }
+            }
+        }
+
+        if (read >= kMinSourceRead && read >= best) {
+            Flush(pos);
+            Command(SOURCE_READ, read);
+            literal_ = pos + read;
+            return read;
+        }
+        if (best >= kMinCopy) {
+            Flush(pos);
+            Command(action, best);
+            literal_ = pos + best;
+            int64_t* rel = action == SOURCE_COPY ? &source_rel_ : &target_rel_;
+            int64_t offset = int64_t(from) - *rel;
+            write_varint(patch_, uint64_t(offset < 0 ? -offset : offset) << 1 |
+                                 (offset < 0));
+            *rel = from + best;
+            return best;
+        }
+        // Leave the byte for the next TargetRead.
+        return 1;
+    }
+
+    void Command(Action action, size_t len) {
+        write_varint(patch_, uint64_t(len - 1) << 2 | action);
+    }
+
+    // Emit the pending target bytes before pos.
+    void Flush(size_t pos) {
+        if (pos > literal_) {
+            Command(TARGET_READ, pos - literal_);
+            patch_->append(tgt_ + literal_, pos - literal_);
+        }
+        literal_ = pos;
+    }
+
+    const char* src_;
+    const char* tgt_;
+    size_t ssize_;
+    size_t tsize_;
+    std::string* patch_;
+    HashChain source_chain_;
+    HashChain target_chain_;
+    // Start of the target bytes not yet covered by an action.
+    size_t literal_;
+    int64_t source_rel_;
+    int64_t target_rel_;
+};
+
+util::Status Error(const char* message) {
+    return util::Status(util::error::Code::INVALID_ARGUMENT, message);
+}
+
+}  // namespace
+
+bool IsPatch(const std::string& patch) {
+    return patch.compare(0, 4, "BPS1") == 0;
+}
+
+std::string CreatePatch(const std::string& source, const std::string& target,
+                        const std::string& metadata) {
+    std::string patch = "BPS1";
+    write_varint(&patch, source.size());
+    write_varint(&patch, target.size());
+    write_varint(&patch, metadata.size());
+    patch.append(metadata);
+
+    Encoder encoder(source, target, &patch);
+    encoder.Encode();
+
+    write_uint4(&patch, Crc32(0, source.data(), source.size()));
+    write_uint4(&patch, Crc32(0, target.data(), target.size()));
+    write_uint4(&patch, Crc32(0, patch.data(), patch.size()));
+    return patch;
+}
+
+StatusOr<std::string> ApplyPatch(const std::string& source,
+                                 const std::string& patch) {
+    if (!IsPatch(patch) || patch.size() < 4 + 3 + 12) {
+        return Error("Bad BPS header");
+    }
+    size_t end = patch.size() - 12;
+    if (Crc32(0, patch.data(), patch.size() - 4) != read_uint4(patch, end + 8)) {
+        return util::Status(util::error::Code::DATA_LOSS,
+                            "BPS patch is corrupt");
+    }
+    size_t i = 4;
+    uint64_t ssize, tsize, msize;
+    if (!read_varint(patch, &i, end, &ssize) ||
+        !read_varint(patch, &i, end, &tsize) ||
+        !read_varint(patch, &i, end, &msize) ||
+        msize > end - i) {
+        return Error("Premature end of patch reading header");
+    }
+    i += msize;
+    if (ssize != source.size() ||
+        Crc32(0, source.data(), source.size()) != read_uint4(patch, end)) {
+        return util::Status(util::error::Code::FAILED_PRECONDITION,
+                            "BPS patch is for a different source file");
+    }
+
+    std::string target(tsize, '\0');
+    size_t out = 0;
+    int64_t source_rel = 0, target_rel = 0;
+    while(i < end) {
+        uint64_t data, offset;
+        if (!read_varint(patch, &i, end, &data)) {
+            return Error("Premature end of patch reading action");
+        }
+        uint64_t len = (data >> 2) + 1;
+        if (len > tsize - out) {
+            return Error("Patch writes past the end of the target");
+        }
+        switch(data & 3) {
+        case SOURCE_READ:
+            if (out + len > ssize) {
+                return Error("Patch reads past the end of the source");
+            }
+            memcpy(&target[out], source.data() + out, len);
+            break;
+        case TARGET_READ:
+            if (len > end - i) {
+                return Error("Premature end of patch reading data");
+            }
+            memcpy(&target[out], patch.data() + i, len);
+            i += len;
+            break;
+        case SOURCE_COPY:
+        case TARGET_COPY: {
+            if (!read_varint(patch, &i, end, &offset)) {
+                return Error("Premature end of patch reading offset");
+            }
+            bool src = (data & 3) == SOURCE_COPY;
+            int64_t* rel = src ? &source_rel : &target_rel;
+            *rel += (offset & 1) ? -int64_t(offset >> 1) : int64_t(offset >> 1);
+            if (src) {
+                if (*rel < 0 || uint64_t(*rel) + len > ssize) {
+                    return Error("Patch copies from outside the source");
+                }
+                memcpy(&target[out], source.data() + *rel, len);
+            } else {
+                if (*rel < 0 || uint64_t(*rel) >= out) {
+                    return Error("Patch copies from outside the target");
+                }
+                // The copy may overlap itself, so go a byte at a time.
+                for(uint64_t k=0; k<len; k++) {
+                    target[out + k] = target[*rel + k];
+                }
+            }
+            *rel += len;
+            break;
+        }
+        }
+        out += len;
+    }
+    if (out != tsize) {
+        return Error("Patch doesn't fill the target");
+    }
+    if (Crc32(0, target.data(), target.size()) != read_uint4(patch, end + 4)) {
+        return util::Status(util::error::Code::DATA_LOSS,
+                            "Patched file has the wrong CRC");
+    }
+    return target;
+}
+
+}  // namespace bps
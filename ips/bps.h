@@ -0,0 +1,21 @@
+#ifndef Z2UTIL_IPS_BPS_H
+#define Z2UTIL_IPS_BPS_H
+
+#include <string>
+#include "util/statusor.h"
+
+namespace bps {
+
+// Create a BPS patch which turns source into target.  Unlike IPS, BPS
+// can copy runs from elsewhere in the source or the target, so data
+// which has only moved costs a few bytes instead of being re-sent.
+std::string CreatePatch(const std::string& source, const std::string& target,
+                        const std::string& metadata="");
+// Apply a BPS patch, checking the CRCs of the source, target and patch.
+StatusOr<std::string> ApplyPatch(const std::string& source, const std::string& patch);
+// True if patch looks like a BPS patch.
+bool IsPatch(const std::string& patch);
+
+}  // namespace
+
+#endif // Z2UTIL_IPS_BPS_H
@@ -1,4 +1,6 @@
+#include <algorithm>
 #include <cstdint>
+#include <cstring>
 #include <string>
 
 #include "ips/ips.h"
@@ -7,6 +9,14 @@
 
 namespace ips {
 namespace {
+// The largest record, and the cost in bytes of a record header
+// (offset, length) and of an entire RLE record (offset, 0, length, value).
+const size_t kMaxRecord = 0xFFFF;
+const size_t kHeader = 5;
+const size_t kRleRecord = 8;
+// A record at this offset would be read as the end-of-patch marker.
+const size_t kEofOffset = 0x454F46;
+
 void write_uint3(std::string *p, uint32_t val) {
     p->append(1, (val >> 16) & 0xFF);
     p->append(1, (val >> 8) & 0xFF);
@@ -31,58 +41,192 @@ int32_t read_uint(const std::string& p, size_t offset, size_t len) {
     }
     return ret;
 }
-}  // namespace
 
-std::string CreatePatch(const std::string& original, const std::string& modified) {
-    std::string patch = "PATCH";
-    size_t len = original.size();
-    size_t i;
-    for(i=0; i<len; i++) {
-        if (i >= modified.size())
+// Return the first index in [i, n) where a and b differ, or n.
+size_t FindDiff(const char* a, const char* b, size_t i, size_t n) {
+    // Skip matching data a word at a time, then find the byte.
+    while(i + sizeof(uint64_t) <= n) {
+        uint64_t x, y;
+        memcpy(&x, a + i, sizeof(x));
+        memcpy(&y, b + i, sizeof(y));
+        if (x != y)
             break;
-        if (original.at(i) == modified.at(i))
-            continue;
+        i += sizeof(uint64_t);
+    }
+    while(i < n && a[i] == b[i]) {
+        i++;
+    }
+    return i;
+}
+
+// Return the first index in [i, n) where a and b are the same, or n.
+size_t FindSame(const char* a, const char* b, size_t i, size_t n) {
+    while(i < n && a[i] != b[i]) {
+        i++;
+    }
+    return i;
+}
+
+// Return the length of the run of data[i] in [i, n).
+size_t RunLength(const char* data, size_t i, size_t n) {
+    size_t j = i + 1;
+    while(j < n && data[j] == data[i]) {
+        j++;
+    }
+    return j - i;
+}
+
+// Appends records describing ranges of the modified data to a patch.
+class Writer {
+  public:
+    Writer(const std::string& modified, std::string* patch)
+      : data_(modified.data()), patch_(patch) {}
 
-        size_t plen = 0;
-        while(plen < 0xFFFF && plen+i < len &&
-              original.at(i+plen) != modified.at(i+plen)) {
-            plen += 1;
+    void Literal(size_t start, size_t end) {
+        while(start < end) {
+            if (start == kEofOffset) {
+                // Back up a byte; rewriting it is harmless.
+                start--;
+            }
+            size_t len = std::min(end - start, kMaxRecord);
+            write_uint3(patch_, start);
+            write_uint2(patch_, len);
+            patch_->append(data_ + start, len);
+            start += len;
         }
+    }
 
-        write_uint3(&patch, i);
-        write_uint2(&patch, plen);
-        patch.append(modified.substr(i, plen));
-        i += plen;
+    void Rle(size_t start, size_t end) {
+        if (start == kEofOffset) {
+            Literal(start, start + 1);
+            start++;
+        }
+        while(start < end) {
+            size_t len = std::min(end - start, kMaxRecord);
+            write_uint3(patch_, start);
+            write_uint2(patch_, 0);
+            write_uint2(patch_, len);
+            patch_->append(1, data_[start]);
+            start += len;
+        }
+    }
+
+    // Emit the changed range [start, end), using RLE records for runs
+    // which are cheaper that way than as part of a literal record.
+    void Hunk(size_t start, size_t end) {
+        size_t literal = start;
+        size_t i = start;
+        while(i < end) {
+            size_t run = RunLength(data_, i, end);
+            // Splitting the run out costs an RLE record, plus a header
+            // for each literal left on either side of it.
+            size_t cost = kRleRecord - kHeader;
+            if (i > literal) cost += kHeader;
+            if (i + run < end) cost += kHeader;
+            if (run > cost) {
+                Literal(literal, i);
+                Rle(i, i + run);
+                literal = i + run;
+            }
+            // No suffix of a run is worth more than the whole run.
+            i += run;
+        }
+        Literal(literal, end);
     }
 
-    while(i < modified.size()) {
-        size_t chunk = modified.size() - i;
-        if (chunk > 0xFFFF) chunk = 0xFFFF;
+  private:
+    const char* data_;
+    std::string* patch_;
+};
+
+}  // namespace
+
+// IPS offsets are 24 bits, so only the first 16 MiB of a file can be
+// patched.
+std::string CreatePatch(const std::string& original, const std::string& modified) {
+    return CreatePatch(original, modified, {{0, uint32_t(modified.size())}});
+}
+
+std::string CreatePatch(const std::string& original, const std::string& modified,
+                        const std::vector<std::pair<uint32_t, uint32_t>>& ranges) {
+    std::string patch = "PATCH";
+    Writer writer(modified, &patch);
+    const char* a = original.data();
+    const char* b = modified.data();
+    // Everything past the end of the original counts as changed.
+    size_t n = std::min(original.size(), modified.size());
+    size_t m = modified.size();
+    auto next_diff = [&](size_t i) {
+        if (i >= n)
+            return m;
+        for(const auto& r : ranges) {
+            size_t end = std::min<size_t>(r.second, n);
+            if (end <= i)
+                continue;
+            size_t j = FindDiff(a, b, std::max<size_t>(i, r.first), end);
+            if (j < end)
+                return j;
+        }
+        return n;
+    };
+    auto next_same = [&](size_t i) {
+        size_t j = i < n ? FindSame(a, b, i, n) : n;
+        return j == n ? m : j;
+    };
 
-        write_uint3(&patch, i);
-        write_uint2(&patch, chunk);
-        patch.append(modified.substr(i, chunk));
-        i += chunk;
+    size_t i = next_diff(0);
+    while(i < m) {
+        size_t start = i;
+        size_t end = next_same(i);
+        size_t next = end < m ? next_diff(end) : m;
+        // Unchanged gaps shorter than a record header are cheaper to
+        // send as data than to start a new record.
+        while(next < m && next - end < kHeader) {
+            end = next_same(next);
+            next = end < m ? next_diff(end) : m;
+        }
+        writer.Hunk(start, end);
+        i = next;
     }
     patch.append("EOF");
+    if (modified.size() < original.size()) {
+        write_uint3(&patch, modified.size());
+    }
     return patch;
 }
 
 StatusOr<std::string> ApplyPatch(const std::string& original,
                                  const std::string& patch) {
+    std::string modified = original;
+    util::Status status = ApplyPatchInPlace(&modified, patch);
+    if (!status.ok()) {
+        return status;
+    }
+    return modified;
+}
+
+util::Status ApplyPatchInPlace(std::string* data, const std::string& patch) {
     size_t i = 0;
     int32_t offset, len;
     bool rle_chunk;
 
-    if (patch.substr(i, 5) != "PATCH") {
+    if (patch.compare(i, 5, "PATCH") != 0) {
         return util::Status(util::error::Code::INVALID_ARGUMENT,
                             "Bad IPS header");
     }
     i += 5;
-    std::string modified = original;
     while(i < patch.size()) {
-        if (patch.substr(i, 3) == "EOF")
+        if (patch.compare(i, 3, "EOF") == 0) {
+            i += 3;
+            // An optional size after EOF truncates the file.
+            if (i + 3 == patch.size()) {
+                size_t size = read_uint(patch, i, 3);
+                if (size < data->size()) {
+                    data->resize(size);
+                }
+            }
             break;
+        }
         if ((offset = read_uint(patch, i, 3)) < 0) {
             return util::Status(util::error::Code::INVALID_ARGUMENT,
                                 "Premature end of patch reading offset");
@@ -102,40 +246,32 @@ StatusOr<std::string> ApplyPatch(const std::string& original,
             }
             i += 2;
         }
-
-        if (unsigned(offset+len) > modified.size()) {
-            modified.resize(offset+len, '\xff');
+        // An RLE chunk is "len" of the same byte; otherwise the record
+        // holds "len" bytes of data.
+        size_t datalen = rle_chunk ? 1 : len;
+        if (i + datalen > patch.size()) {
+            return util::Status(util::error::Code::INVALID_ARGUMENT,
+                                "Premature end of patch reading data");
+        }
+        if (size_t(offset + len) > data->size()) {
+            data->resize(offset + len, '\xff');
         }
-
 #ifdef DEBUG_PRINT
         // TODO: distinguish between PRG and CHR banks.
         int addr = 0x8000 | ((offset - 0x10) & 0x3FFF);
         int bank = (offset - 0x10) / 16384;
         if (bank == 7) addr |= 0xC000;
-        printf("Applying patch at bank=%d addr=0x%x for 0x%x bytes\n", bank, addr, len);
-        printf("   ");
-#endif
-        for(int32_t j=0; j<len; j++) {
-            if (i >= patch.size()) {
-                return util::Status(util::error::Code::INVALID_ARGUMENT,
-                                "Premature end of patch reading data");
-            }
-            modified[offset+j] = patch.at(i);
-#ifdef DEBUG_PRINT
-            printf(" %02x", patch.at(i) & 0xff);
+        printf("Applying patch at bank=%d addr=0x%x for 0x%x bytes%s\n",
+               bank, addr, len, rle_chunk ? " (RLE)" : "");
 #endif
-
-            // An RLE chunk is "len" of the same byte
-            // In non-RLE mode, we increment the patch offset in the loop
-            if (!rle_chunk) i++;
+        if (rle_chunk) {
+            memset(&(*data)[offset], patch[i], len);
+        } else {
+            memcpy(&(*data)[offset], patch.data() + i, len);
         }
-#ifdef DEBUG_PRINT
-        printf("\n");
-#endif
-        // In RLE mode, we increment the patch offset once outside the loop
-        if (rle_chunk) i++;
+        i += datalen;
     }
-    return modified;
+    return util::Status();
 }
 
 }  // namespace ips
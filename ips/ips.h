@@ -1,13 +1,28 @@
 #ifndef Z2UTIL_IPS_IPS_H
 #define Z2UTIL_IPS_IPS_H
 
+#include <cstdint>
 #include <string>
+#include <utility>
+#include <vector>
+#include "util/status.h"
 #include "util/statusor.h"
 
 namespace ips {
 
+// Create an IPS patch which turns original into modified.  Nearby
+// differences are merged into one record and runs of a repeated byte are
+// emitted as RLE records when that makes the patch smaller.  If modified
+// is shorter than original, the patch ends with a truncation size.
 std::string CreatePatch(const std::string& original, const std::string& modified);
+// As above, but only the given sorted [first, second) ranges of modified
+// may differ from original, so nothing outside them is compared.
+std::string CreatePatch(const std::string& original, const std::string& modified,
+                        const std::vector<std::pair<uint32_t, uint32_t>>& ranges);
 StatusOr<std::string> ApplyPatch(const std::string& original, const std::string& patch);
+// Apply patch to data without copying it.  On error, data may be
+// partially patched.
+util::Status ApplyPatchInPlace(std::string* data, const std::string& patch);
 
 }  // namespace
 
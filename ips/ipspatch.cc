@@ -2,20 +2,23 @@
 #include <string>
 #include <gflags/gflags.h>
 
+#include "ips/bps.h"
 #include "ips/ips.h"
 #include "util/file.h"
 
 DEFINE_bool(create, false, "Create an IPS patch");
 DEFINE_bool(apply, false, "Apply an IPS patch");
+DEFINE_bool(bps, false, "Create a BPS patch instead of IPS");
 
 const char kUsage[] =
 R"ZZZ(<flags> [files...]
 
 Description:
-  A Simple IPS patch utility.
+  A Simple IPS and BPS patch utility.  The patch format is detected
+  when applying.
 
 Usage:
-  ipspatch -create [original] [modified] [patch-output-file]
+  ipspatch -create [-bps] [original] [modified] [patch-output-file]
   ipspatch -apply [original] [patch-file] [modified-output-file]
 )ZZZ";
 
@@ -27,18 +30,28 @@ int main(int argc, char *argv[]) {
     if (FLAGS_create && argc == 4) {
         File::GetContents(argv[1], &original);
         File::GetContents(argv[2], &modified);
-        patch = ips::CreatePatch(original, modified);
+        patch = FLAGS_bps ? bps::CreatePatch(original, modified)
+                          : ips::CreatePatch(original, modified);
         File::SetContents(argv[3], patch);
         printf("Wrote patch to %s\n", argv[3]);
     } else if (FLAGS_apply && argc == 4) {
         File::GetContents(argv[1], &original);
         File::GetContents(argv[2], &patch);
-        auto mod = ips::ApplyPatch(original, patch);
-        if (mod.ok()) {
-            File::SetContents(argv[3], mod.ValueOrDie());
+        util::Status status;
+        if (bps::IsPatch(patch)) {
+            auto mod = bps::ApplyPatch(original, patch);
+            status = mod.status();
+            if (mod.ok()) {
+                original = mod.ValueOrDie();
+            }
+        } else {
+            status = ips::ApplyPatchInPlace(&original, patch);
+        }
+        if (status.ok()) {
+            File::SetContents(argv[3], original);
             printf("Applied patch and wrote new file %s\n", argv[3]);
         } else {
-            printf("Error: %s\n", mod.status().ToString().c_str());
+            printf("Error: %s\n", status.ToString().c_str());
         }
     } else {
         printf("%s %s\n", argv[0], kUsage);
@@ -0,0 +1,198 @@
+#include "nes/area_index.h"
+
+#include "nes/sideview.h"
+#include "nes/z2decompress.h"
+#include "util/config.h"
+#include "util/logging.h"
+
+namespace z2util {
+
+AreaIndex* AreaIndex::Get() {
+    static AreaIndex index;
+    return &index;
+}
+
+AreaIndex::AreaIndex()
+  : config_generation_(-1),
+    generation_(0),
+    pending_(0) {}
+
+AreaIndex::~AreaIndex() {
+    generation_++;
+    executor_.reset();
+}
+
+const char* AreaIndex::KindName(Kind kind) {
+    switch(kind) {
+        case TILE: return "tile";
+        case ITEM: return "item";
+        case ENEMY: return "enemy";
+        default: return "unknown";
+    }
+}
+
+bool AreaIndex::ParseKind(const std::string& name, Kind* kind) {
+    for(int k=0; k<NR_KINDS; k++) {
+        if (name == KindName(Kind(k))) {
+            *kind = Kind(k);
+            return true;
+        }
+    }
+    return false;
+}
+
+void AreaIndex::IndexEnemies(RomContext* rom, const Map& map,
+                             Postings* postings) {
+    SideviewEnemies enemies(rom);
+    enemies.set_load_text(false);
+    enemies.Parse(map);
+    // Encounter areas have a second (large enemy) list.
+    for(auto* list = &enemies; list; list = list->large()) {
+        for(const auto& e : list->data()) {
+            (*postings)[ENEMY][e.enemy].push_back(
+                Point{uint8_t(e.x), uint8_t(e.y)});
+        }
+    }
+}
+
+void AreaIndex::Index(RomContext* rom, const Map& map, Postings* postings) {
+    Z2Decompress decomp;
+    decomp.set_mapper(rom->mapper());
+    decomp.Decompress(map);
+
+    bool overworld = map.type() == MapType::OVERWORLD;
+    // Sideview maps are decompressed 4 screens wide regardless of how many
+    // screens they really have.
+    int width = overworld ? decomp.width() : decomp.mapwidth();
+    for(int y=0; y<decomp.height(); y++) {
+        for(int x=0; x<width; x++) {
+            Point p{uint8_t(x), uint8_t(y)};
+            (*postings)[TILE][decomp.map(x, y)].push_back(p);
+            uint8_t item = decomp.item(x, y);
+            if (item != 0xFF) {
+                (*postings)[ITEM][item].push_back(p);
+            }
+        }
+    }
+    // Background maps (world -1) aren't rooms and don't have enemies.
+    if (!overworld && map.world() != -1 && map.pointer().address()) {
+        IndexEnemies(rom, map, postings);
+    }
+}
+
+int AreaIndex::Reset() {
+    const auto& ri = ConfigLoader<RomInfo>::GetConfig();
+    std::lock_guard<std::mutex> lock(mu_);
+    for(auto& k : index_) {
+        k.clear();
+    }
+    updated_.assign(ri.map_size(), false);
+    config_generation_ = ConfigLoader<RomInfo>::Generation();
+    pending_ = ri.map_size();
+    return ++generation_;
+}
+
+void AreaIndex::Build(RomContext* rom) {
+    const auto& ri = ConfigLoader<RomInfo>::GetConfig();
+    Reset();
+    for(int i=0; i<ri.map_size(); i++) {
+        Postings postings;
+        Index(rom, ri.map(i), &postings);
+        std::lock_guard<std::mutex> lock(mu_);
+        Replace(i, &postings);
+        pending_--;
+    }
+}
+
+void AreaIndex::Rebuild(RomContext* rom) {
+    const auto& ri = ConfigLoader<RomInfo>::GetConfig();
+    int generation = Reset();
+    if (!executor_) {
+        executor_.reset(new util::Executor);
+    }
+    auto snapshot = std::make_shared<RomContext>(*rom->cartridge());
+    for(int i=0; i<ri.map_size(); i++) {
+        executor_->Submit([this, snapshot, generation, i]() {
+            if (generation != generation_)
+                return;
+            const auto& map = ConfigLoader<RomInfo>::GetConfig().map(i);
+            Postings postings;
+            Index(snapshot.get(), map, &postings);
+
+            std::lock_guard<std::mutex> lock(mu_);
+            if (generation != generation_)
+                return;
+            if (!updated_[i]) {
+                Replace(i, &postings);
+            }
+            pending_--;
+        });
+    }
+}
+
+void AreaIndex::Wait() {
+    if (executor_) {
+        executor_->Wait();
+    }
+}
+
+void AreaIndex::Update(RomContext* rom, const Map& map) {
+    const auto& ri = ConfigLoader<RomInfo>::GetConfig();
+    int area = -1;
+    for(int i=0; i<ri.map_size(); i++) {
+        if (ri.map(i).name() == map.name()) {
+            area = i;
+            break;
+        }
+    }
+    if (area < 0) {
+        LOG(ERROR, "Can't index unknown area ", map.name());
+        return;
+    }
+    Postings postings;
+    Index(rom, ri.map(area), &postings);
+
+    std::lock_guard<std::mutex> lock(mu_);
+    if (updated_.size() != size_t(ri.map_size())) {
+        updated_.assign(ri.map_size(), false);
+    }
+    updated_[area] = true;
+    Replace(area, &postings);
+}
+
+void AreaIndex::Replace(int area, Postings* postings) {
+    for(int k=0; k<NR_KINDS; k++) {
+        auto& index = index_[k];
+        for(auto it=index.begin(); it != index.end(); ) {
+            it->second.erase(area);
+            if (it->second.empty()) {
+                it = index.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        for(auto& p : (*postings)[k]) {
+            index[p.first][area] = std::move(p.second);
+        }
+    }
+}
+
+std::vector<AreaIndex::Result> AreaIndex::Find(Kind kind, int id) {
+    std::vector<Result> result;
+    std::lock_guard<std::mutex> lock(mu_);
+    auto it = index_[kind].find(id);
+    if (it == index_[kind].end()) {
+        return result;
+    }
+    for(const auto& a : it->second) {
+        result.push_back(Result{a.first, a.second});
+    }
+    return result;
+}
+
+bool AreaIndex::valid() {
+    std::lock_guard<std::mutex> lock(mu_);
+    return config_generation_ == ConfigLoader<RomInfo>::Generation();
+}
+
+}  // namespace z2util
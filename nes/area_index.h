@@ -0,0 +1,88 @@
+#ifndef Z2UTIL_NES_AREA_INDEX_H
+#define Z2UTIL_NES_AREA_INDEX_H
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "nes/rom_context.h"
+#include "proto/rominfo.pb.h"
+#include "util/executor.h"
+
+namespace z2util {
+
+// An inverted index over the decompressed contents of every area in the
+// ROM: which areas contain a given tile, item or enemy, and where.  Areas
+// are identified by their index in RomInfo.map.
+//
+// Rebuild indexes the whole ROM on a thread pool, working from a private
+// copy of the ROM so the editors can keep changing it.  The editors call
+// Update after saving an area to keep the index current; an area updated
+// while a rebuild is running keeps its updated entries.  All methods may
+// be called from any thread except the pool's own.
+class AreaIndex {
+  public:
+    enum Kind {
+        TILE,
+        ITEM,
+        ENEMY,
+        NR_KINDS,
+    };
+    struct Point {
+        uint8_t x, y;
+    };
+    struct Result {
+        int area;
+        std::vector<Point> points;
+    };
+
+    AreaIndex();
+    ~AreaIndex();
+
+    // The index of the ROM open in the editor.
+    static AreaIndex* Get();
+
+    // Index every area on the calling thread.
+    void Build(RomContext* rom);
+    // Start reindexing every area in the background.
+    void Rebuild(RomContext* rom);
+    // Wait for a background rebuild to finish.
+    void Wait();
+    // Reindex one area from the current ROM contents.
+    void Update(RomContext* rom, const Map& map);
+
+    // All areas containing id, in RomInfo.map order.
+    std::vector<Result> Find(Kind kind, int id);
+    // The number of areas still waiting to be indexed.
+    inline int pending() const { return pending_; }
+    // True if the index was built for the loaded config.
+    bool valid();
+
+    static const char* KindName(Kind kind);
+    static bool ParseKind(const std::string& name, Kind* kind);
+
+  private:
+    typedef std::map<int, std::vector<Point>> Postings[NR_KINDS];
+
+    static void Index(RomContext* rom, const Map& map, Postings* postings);
+    static void IndexEnemies(RomContext* rom, const Map& map,
+                             Postings* postings);
+    int Reset();
+    void Replace(int area, Postings* postings);
+
+    std::mutex mu_;
+    // id -> area -> locations, for each kind.
+    std::map<int, std::map<int, std::vector<Point>>> index_[NR_KINDS];
+    // Areas changed by Update since the last Rebuild started.
+    std::vector<bool> updated_;
+    int config_generation_;
+    std::atomic<int> generation_;
+    std::atomic<int> pending_;
+    std::unique_ptr<util::Executor> executor_;
+};
+
+}  // namespace z2util
+#endif // Z2UTIL_NES_AREA_INDEX_H
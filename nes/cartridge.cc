@@ -1,20 +1,33 @@
+#include <algorithm>
 #include <cstdio>
 #include <cstdlib>
 #include <cstdint>
+#include <cstring>
 
 #include "nes/cartridge.h"
 #include "util/file.h"
 
+const uint32_t Cartridge::kPageSize;
+const uint8_t Cartridge::kAllConsumers;
+
 Cartridge::Cartridge()
     : prg_(nullptr), prglen_(0),
     chr_(nullptr), chrlen_(0),
-    trainer_(nullptr) { }
+    trainer_(nullptr),
+    generation_(1), rom_generation_(0) {
+    memset(&header_, 0, sizeof(header_));
+    Relayout();
+}
 
 Cartridge::Cartridge(const Cartridge& orig)
   : header_(orig.header_),
     prglen_(orig.prglen_),
     chrlen_(orig.chrlen_),
-    mirror_(orig.mirror_) {
+    mirror_(orig.mirror_),
+    prgoff_(orig.prgoff_),
+    chroff_(orig.chroff_),
+    dirty_(orig.dirty_),
+    generation_(1), rom_generation_(0) {
     if (header_.trainer) {
         trainer_.reset(new uint8_t[512]);
         memcpy(trainer_.get(), orig.trainer_.get(), 512);
@@ -40,9 +53,12 @@ bool Cartridge::IsNESFile(const std::string& filename) {
 }
 
 void Cartridge::LoadRom(const std::string& rom) {
-    const char *data = rom.data();
+    LoadRom(rom.data(), rom.size());
+}
+
+void Cartridge::LoadRom(const char* data, size_t size) {
     unsigned offset = 0;
-    unsigned size = rom.size();
+    generation_++;
 
     // Read the header
     memcpy(&header_, data, sizeof(header_));
@@ -79,30 +95,66 @@ void Cartridge::LoadRom(const std::string& rom) {
     }
     memcpy(chr_.get(), data + offset, 8192 * header_.chrsz);
     offset += 8192 * header_.chrsz;
+    Relayout();
+}
+
+bool Cartridge::Restore(const std::string& rom) {
+    const std::string& cur = SaveRom();
+    if (rom.size() != cur.size() ||
+        rom.compare(0, sizeof(header_), cur, 0, sizeof(header_)) != 0) {
+        return false;
+    }
+    for(uint32_t start = 0; start < cur.size(); start += kPageSize) {
+        uint32_t end = std::min<uint32_t>(start + kPageSize, cur.size());
+        if (memcmp(cur.data() + start, rom.data() + start, end - start) == 0)
+            continue;
+        // The headers match, so a page differs in the trainer, PRG or CHR.
+        for(uint32_t a = start; a < end; a++) {
+            uint8_t val = rom[a];
+            if (a >= chroff_) {
+                chr_[a - chroff_] = val;
+            } else if (a >= prgoff_) {
+                prg_[a - prgoff_] = val;
+            } else if (a >= sizeof(header_)) {
+                trainer_[a - sizeof(header_)] = val;
+            }
+        }
+        MarkDirty(start, end - start);
+    }
+    return true;
 }
 
-std::string Cartridge::SaveRom() {
-    std::string rom;
-    rom.append((const char*)(&header_), sizeof(header_));
+const std::string& Cartridge::SaveRom() {
+    if (rom_generation_ == generation_) {
+        return rom_;
+    }
+    rom_.clear();
+    rom_.append((const char*)(&header_), sizeof(header_));
     if (header_.trainer) {
-        rom.append((const char*)(trainer_.get()), 512);
+        rom_.append((const char*)(trainer_.get()), 512);
     }
-    rom.append((const char*)(prg_.get()), 16384 * header_.prgsz);
-    rom.append((const char*)(chr_.get()), 8192 * header_.chrsz);
-    return rom;
+    rom_.append((const char*)(prg_.get()), 16384 * header_.prgsz);
+    rom_.append((const char*)(chr_.get()), 8192 * header_.chrsz);
+    rom_generation_ = generation_;
+    return rom_;
 }
 
 void Cartridge::LoadFile(const std::string& filename) {
-    std::string rom;
-    File::GetContents(filename, &rom);
-    LoadRom(rom);
+    // Parse straight out of the mapped file rather than reading it into
+    // a temporary string first.
+    auto file = MappedFile::Open(filename);
+    if (file == nullptr) {
+        fprintf(stderr, "Couldn't read %s.\n", filename.c_str());
+        abort();
+    }
+    LoadRom(file->data(), file->size());
 }
 
 void Cartridge::SaveFile(const std::string& filename) {
     File::SetContents(filename, SaveRom());
 }
 
-void Cartridge::LoadFile(DebugConsole* console, int argc, char **argv) {
+void Cartridge::LoadFile(Console* console, int argc, char **argv) {
     if (argc != 2) {
         console->AddLog("[error] Usage: %s [filename]", argv[0]);
         return;
@@ -110,7 +162,7 @@ void Cartridge::LoadFile(DebugConsole* console, int argc, char **argv) {
     LoadFile(argv[1]);
 }
 
-void Cartridge::SaveFile(DebugConsole* console, int argc, char **argv) {
+void Cartridge::SaveFile(Console* console, int argc, char **argv) {
     if (argc != 2) {
         console->AddLog("[error] Usage: %s [filename]", argv[0]);
         return;
@@ -118,7 +170,7 @@ void Cartridge::SaveFile(DebugConsole* console, int argc, char **argv) {
     SaveFile(argv[1]);
 }
 
-void Cartridge::PrintHeader(DebugConsole* console, int argc, char **argv) {
+void Cartridge::PrintHeader(Console* console, int argc, char **argv) {
     uint8_t *bytes = (uint8_t*)&header_;
     console->AddLog("NES header:\n");
     console->AddLog("  %02x %02x %02x %02x %02x %02x %02x %02x\n",
@@ -153,6 +205,7 @@ void Cartridge::InsertPrg(int bank, uint8_t *data) {
     prglen_ += 16384;
     header_.prgsz++;
     prg_.reset(newprg);
+    Relayout();
 }
 
 void Cartridge::InsertChr(int bank, uint8_t *data) {
@@ -171,4 +224,69 @@ void Cartridge::InsertChr(int bank, uint8_t *data) {
     chrlen_ += 8192;
     header_.chrsz++;
     chr_.reset(newchr);
+    Relayout();
+}
+
+void Cartridge::WritePrg(uint32_t addr, const uint8_t* src, uint32_t len) {
+    MarkDirty(prgoff_ + addr, len);
+    memcpy(prg_.get() + addr, src, len);
+}
+
+void Cartridge::WriteChr(uint32_t addr, const uint8_t* src, uint32_t len) {
+    MarkDirty(chroff_ + addr, len);
+    memcpy(chr_.get() + addr, src, len);
+}
+
+void Cartridge::Relayout() {
+    generation_++;
+    prgoff_ = sizeof(header_) + (header_.trainer ? 512 : 0);
+    chroff_ = prgoff_ + prglen_;
+    // Cover CHR RAM too, even though it isn't part of the image.
+    uint32_t pages = (chroff_ + chrlen_ + kPageSize - 1) / kPageSize;
+    dirty_.assign(pages, kAllConsumers);
+}
+
+void Cartridge::MarkDirty(uint32_t start, uint32_t len) {
+    generation_++;
+    if (len == 0)
+        return;
+    uint32_t end = (start + len - 1) / kPageSize;
+    for(uint32_t i = start / kPageSize; i <= end; i++) {
+        dirty_[i] = kAllConsumers;
+    }
+}
+
+bool Cartridge::IsDirty(Consumer c, uint32_t start, uint32_t end) const {
+    uint32_t last = std::min<uint64_t>((uint64_t(end) + kPageSize - 1) / kPageSize,
+                                       dirty_.size());
+    for(uint32_t i = start / kPageSize; i < last; i++) {
+        if (dirty_[i] & (1 << c))
+            return true;
+    }
+    return false;
+}
+
+Cartridge::Ranges Cartridge::DirtyRanges(Consumer c) const {
+    Ranges ranges;
+    uint32_t size = chroff_ + 8192 * header_.chrsz;
+    for(uint32_t i = 0; i < dirty_.size(); i++) {
+        if (!(dirty_[i] & (1 << c)))
+            continue;
+        uint32_t start = i * kPageSize;
+        uint32_t end = std::min(start + kPageSize, size);
+        if (start >= end)
+            break;
+        if (!ranges.empty() && ranges.back().second == start) {
+            ranges.back().second = end;
+        } else {
+            ranges.emplace_back(start, end);
+        }
+    }
+    return ranges;
+}
+
+void Cartridge::ClearDirty(Consumer c) {
+    for(auto& d : dirty_) {
+        d &= ~(1 << c);
+    }
 }
@@ -3,8 +3,10 @@
 #include <string>
 #include <memory>
 #include <cstdint>
+#include <utility>
+#include <vector>
 
-#include "imwidget/debug_console.h"
+#include "util/console.h"
 
 class Cartridge {
   public:
@@ -30,14 +32,35 @@ class Cartridge {
         SINGLE1,
         FOUR,
     };
+    // Users of the dirty page map.  Each consumer has its own dirty bits,
+    // so clearing them for one doesn't hide writes from the others.
+    enum Consumer {
+        COMMIT,
+        EXPORT,
+        REFRESH,
+        NUM_CONSUMERS,
+    };
+    // Writes are tracked in pages of this many bytes of the iNES image.
+    static const uint32_t kPageSize = 256;
+    // Byte ranges [first, second) of the iNES image.
+    typedef std::vector<std::pair<uint32_t, uint32_t>> Ranges;
     Cartridge();
     Cartridge(const Cartridge& orig);
     ~Cartridge();
 
     static bool IsNESFile(const std::string& filename);
 
-    std::string SaveRom();
+    // The iNES image of the cartridge.  The image is cached and only
+    // rebuilt after the cartridge has been written, so repeated saves of
+    // an unchanged cartridge are cheap.  The reference is valid until the
+    // next write.
+    const std::string& SaveRom();
     void LoadRom(const std::string& rom);
+    void LoadRom(const char* data, size_t size);
+    // Load rom if it has the same layout as the cartridge, writing and
+    // marking dirty only the pages which differ.  Returns false, leaving
+    // the cartridge alone, if the layout differs.
+    bool Restore(const std::string& rom);
 
     void LoadFile(const std::string& filename);
     void SaveFile(const std::string& filename);
@@ -51,6 +74,8 @@ class Cartridge {
         return header_.mapperl | header_.mapperh << 4;
     }
     inline void set_mapper(uint8_t m) {
+        generation_++;
+        dirty_[0] = kAllConsumers;
         header_.mapperl = m;
         header_.mapperh = m>>4;
     }
@@ -60,21 +85,50 @@ class Cartridge {
     inline uint8_t prgsz() const { return header_.prgsz; }
     inline uint8_t chrsz() const { return header_.chrsz; }
 
-    inline uint8_t* prg() const { return prg_.get(); }
-    inline uint8_t* chr() const { return chr_.get(); }
+    inline const uint8_t* prg() const { return prg_.get(); }
+    inline const uint8_t* chr() const { return chr_.get(); }
+    // Incremented by every write to the cartridge.
+    inline uint64_t generation() const { return generation_; }
 
     inline uint8_t ReadPrg(uint32_t addr) { return prg_[addr]; }
     inline uint8_t ReadChr(uint32_t addr) { return chr_[addr]; }
-    inline void WritePrg(uint32_t addr, uint8_t val) { prg_[addr] = val; }
-    inline void WriteChr(uint32_t addr, uint8_t val) { chr_[addr] = val; }
+    inline void WritePrg(uint32_t addr, uint8_t val) {
+        generation_++;
+        dirty_[(prgoff_ + addr) / kPageSize] = kAllConsumers;
+        prg_[addr] = val;
+    }
+    inline void WriteChr(uint32_t addr, uint8_t val) {
+        generation_++;
+        dirty_[(chroff_ + addr) / kPageSize] = kAllConsumers;
+        chr_[addr] = val;
+    }
+    void WritePrg(uint32_t addr, const uint8_t* src, uint32_t len);
+    void WriteChr(uint32_t addr, const uint8_t* src, uint32_t len);
 
-    void PrintHeader(DebugConsole* console, int argc, char **argv);
-    void LoadFile(DebugConsole* console, int argc, char **argv);
-    void SaveFile(DebugConsole* console, int argc, char **argv);
+    // Offsets of the PRG and CHR data in the iNES image.
+    inline uint32_t prg_offset() const { return prgoff_; }
+    inline uint32_t chr_offset() const { return chroff_; }
+    // True if any of [start, end) of the image was written since consumer
+    // c last cleared its dirty bits.  Loading a ROM marks everything dirty.
+    bool IsDirty(Consumer c, uint32_t start, uint32_t end) const;
+    inline bool IsDirty(Consumer c) const { return IsDirty(c, 0, UINT32_MAX); }
+    // The written ranges of the image, rounded out to whole pages.
+    Ranges DirtyRanges(Consumer c) const;
+    void ClearDirty(Consumer c);
+
+    void PrintHeader(Console* console, int argc, char **argv);
+    void LoadFile(Console* console, int argc, char **argv);
+    void SaveFile(Console* console, int argc, char **argv);
 
     void InsertPrg(int bank, uint8_t* newprg);
     void InsertChr(int bank, uint8_t* newchr);
   private:
+    static const uint8_t kAllConsumers = (1 << NUM_CONSUMERS) - 1;
+    // Recompute the data offsets and mark the whole image dirty, after
+    // the layout of the cartridge has changed.
+    void Relayout();
+    void MarkDirty(uint32_t start, uint32_t len);
+
     struct iNESHeader header_;
     std::unique_ptr<uint8_t[]> prg_;
     uint32_t prglen_;
@@ -82,6 +136,15 @@ class Cartridge {
     uint32_t chrlen_;
     std::unique_ptr<uint8_t[]> trainer_;
     MirrorMode mirror_;
+    uint32_t prgoff_;
+    uint32_t chroff_;
+    // One byte per page of the image: a bit for each consumer which
+    // hasn't seen the latest writes to the page.
+    std::vector<uint8_t> dirty_;
+    uint64_t generation_;
+    // The image returned by SaveRom and the generation it was built at.
+    std::string rom_;
+    uint64_t rom_generation_;
 };
 
 #endif // Z2UTIL_NES_CARTRIDGE_H
@@ -3,6 +3,10 @@
 #include <cstdint>
 #include "nes/mapper.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 namespace z2util {
 const uint8_t chrxdigits[16][8] = {
     { 2, 5, 5, 5, 5, 5, 2, 0 },    // 0
@@ -56,4 +60,71 @@ void ChrUtil::Swap(int dbank, uint8_t dst, int sbank, uint8_t src) {
 }
 
 
+#if defined(__SSE2__)
+// Expand each plane byte to eight bytes (one per pixel) by interleaving
+// the register with itself, then test each pixel's bit with a mask.  All
+// eight rows of a tile are done with four 16-byte stores.
+void ChrUtil::DecodeTiles(const uint8_t* chr, int ntiles, uint8_t* pixels) {
+    const __m128i bits = _mm_set_epi8(
+        0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, (char)0x80,
+        0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, (char)0x80);
+    const __m128i one = _mm_set1_epi8(1);
+    const __m128i two = _mm_set1_epi8(2);
+    for(int t=0; t<ntiles; t++, chr+=16, pixels+=64) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(chr));
+        // a: plane 0 rows 0-7, each byte doubled; b: the same for plane 1.
+        __m128i a = _mm_unpacklo_epi8(x, x);
+        __m128i b = _mm_unpackhi_epi8(x, x);
+        __m128i a4[2] = { _mm_unpacklo_epi16(a, a), _mm_unpackhi_epi16(a, a) };
+        __m128i b4[2] = { _mm_unpacklo_epi16(b, b), _mm_unpackhi_epi16(b, b) };
+        for(int i=0; i<4; i++) {
+            // Rows 2i and 2i+1, each byte repeated eight times.
+            __m128i ra = (i & 1) ? _mm_unpackhi_epi32(a4[i/2], a4[i/2])
+                                 : _mm_unpacklo_epi32(a4[i/2], a4[i/2]);
+            __m128i rb = (i & 1) ? _mm_unpackhi_epi32(b4[i/2], b4[i/2])
+                                 : _mm_unpacklo_epi32(b4[i/2], b4[i/2]);
+            ra = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(ra, bits), bits),
+                               one);
+            rb = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(rb, bits), bits),
+                               two);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + 16*i),
+                             _mm_or_si128(ra, rb));
+        }
+    }
+}
+#else
+void ChrUtil::DecodeTiles(const uint8_t* chr, int ntiles, uint8_t* pixels) {
+    DecodeTilesScalar(chr, ntiles, pixels);
+}
+#endif
+
+void ChrUtil::DecodeTilesScalar(const uint8_t* chr, int ntiles,
+                                uint8_t* pixels) {
+    for(int t=0; t<ntiles; t++, chr+=16) {
+        for(int row=0; row<8; row++) {
+            uint8_t a = chr[row];
+            uint8_t b = chr[row + 8];
+            for(int col=0; col<8; col++, a<<=1, b<<=1) {
+                *pixels++ = (a & 0x80) >> 7 | (b & 0x80) >> 6;
+            }
+        }
+    }
+}
+
+void ChrUtil::DecodeTiles(const uint8_t* chr, int ntiles,
+                          const uint32_t* palette, uint32_t* pixels) {
+    // Decode in small batches to keep the index buffer on the stack.
+    uint8_t index[16 * 64];
+    while (ntiles > 0) {
+        int n = ntiles < 16 ? ntiles : 16;
+        DecodeTiles(chr, n, index);
+        for(int i=0; i<n*64; i++) {
+            pixels[i] = palette[index[i]];
+        }
+        chr += 16 * n;
+        pixels += 64 * n;
+        ntiles -= n;
+    }
+}
+
 }  // namespace
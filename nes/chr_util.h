@@ -15,6 +15,17 @@ class ChrUtil {
     void Swap(int dbank, uint8_t dst, int sbank, uint8_t src);
     inline void set_mapper(Mapper* m) { mapper_ = m; }
 
+    // Decode 2bpp planar CHR data.  Each 16-byte tile becomes 64 color
+    // indices (0-3), eight rows of eight pixels, stored tile after tile.
+    static void DecodeTiles(const uint8_t* chr, int ntiles, uint8_t* pixels);
+    // The portable version of the above.  DecodeTiles uses it when there
+    // is no SIMD implementation for the target.
+    static void DecodeTilesScalar(const uint8_t* chr, int ntiles,
+                                  uint8_t* pixels);
+    // As above, but map each color index through a 4-entry palette.
+    static void DecodeTiles(const uint8_t* chr, int ntiles,
+                            const uint32_t* palette, uint32_t* pixels);
+
   private:
     Mapper* mapper_;
 };
@@ -1,16 +1,16 @@
 #include <cstdio>
 #include <cstdint>
 #include <inttypes.h>
+#include <mutex>
 #include <gflags/gflags.h>
 #include "nes/cpu6502.h"
 #include "absl/strings/ascii.h"
 #include "absl/strings/str_split.h"
 
 void Cpu::Branch(uint16_t addr) {
-    static uint16_t last_pc, last_addr;
-    if (pc_ == last_pc && addr == last_addr && addr == pc_ - 2)
+    if (pc_ == last_branch_pc_ && addr == last_branch_addr_ && addr == pc_ - 2)
         abort();
-    last_pc = pc_; last_addr = addr;
+    last_branch_pc_ = pc_; last_branch_addr_ = addr;
     if (PagesDiffer(pc_, addr))
         cycles_++;
     pc_ = addr;
@@ -28,6 +28,8 @@ Cpu::Cpu(Mapper* mapper) :
     stall_(0),
     nmi_pending_(false),
     irq_pending_(false),
+    last_branch_pc_(0),
+    last_branch_addr_(0),
     bank_(0) {
         BuildAsmInfo();
 }
@@ -725,10 +727,11 @@ int Cpu::Emulate(void) {
 }
 
 void Cpu::BuildAsmInfo() {
-    static bool once;
-    if (once) return;
-    once = true;
+    static std::once_flag once;
+    std::call_once(once, BuildAsmInfoOnce);
+}
 
+void Cpu::BuildAsmInfoOnce() {
     for(int i=0; i<256; i++) {
         const char *ii = instruction_names_[i];
         if (strstr(ii, "illop_"))
@@ -155,6 +155,9 @@ class Cpu {
     int stall_;
     bool nmi_pending_;
     bool irq_pending_;
+    // Used by Branch to detect "jump to self" loops.
+    uint16_t last_branch_pc_;
+    uint16_t last_branch_addr_;
 
     int bank_;
     std::map<std::string, uint32_t> labels_;
@@ -162,6 +165,7 @@ class Cpu {
     std::map<uint16_t, std::pair<int, std::string>> data_fixups_;
 
     static void BuildAsmInfo();
+    static void BuildAsmInfoOnce();
     struct AsmInfo {
         std::string instruction;
         int opcode[14];
@@ -3,6 +3,7 @@
 #include "nes/enemylist.h"
 
 #include "nes/mapper.h"
+#include "nes/rom_context.h"
 #include "proto/rominfo.pb.h"
 #include "util/config.h"
 #include <gflags/gflags.h>
@@ -19,7 +20,7 @@ void EnemyListPack::LoadEncounters() {
     addr.set_bank(bank_);
 
     for(int i=0; i<14; i++) {
-        encounters_.push_back(mapper_->Read(addr, i) & 0x3f);
+        encounters_.push_back(rom_->mapper()->Read(addr, i) & 0x3f);
     }
 }
 
@@ -30,7 +31,7 @@ bool EnemyListPack::IsEncounter(int area) {
     // overworld.
     addr.set_bank(bank_);
     addr.set_address(0x8500);
-    uint16_t ovptr = mapper_->ReadWord(addr, 10);
+    uint16_t ovptr = rom_->mapper()->ReadWord(addr, 10);
     if (ovptr == 0 || ovptr == 0xFFFF)
         return false;
 
@@ -54,9 +55,9 @@ void EnemyListPack::ReadOne(int area, Address addr) {
 
     for(int j=0; j<lists; j++) {
         int i;
-        uint8_t len = mapper_->Read(addr, 0);
+        uint8_t len = rom_->mapper()->Read(addr, 0);
         for(i=0; i<len; i++) {
-            entry.data.push_back(mapper_->Read(addr, i));
+            entry.data.push_back(rom_->mapper()->Read(addr, i));
         }
         addr.set_address(addr.address() + i);
     }
@@ -86,7 +87,7 @@ void EnemyListPack::Unpack(int bank) {
     for(Address addr : misc.enemy_pointer()) {
         addr.set_bank(bank_);
         for(int n=0; n<63; n++, i++) {
-            Address pointer = mapper_->ReadAddr(addr, 2*n);
+            Address pointer = rom_->mapper()->ReadAddr(addr, 2*n);
             uint16_t pa = pointer.address();
             if (pa >= misc.enemy_data_ram() &&
                     pa < misc.enemy_data_ram() + size_) {
@@ -165,7 +166,7 @@ bool EnemyListPack::Pack() {
                 continue;
 
             List& entry = entry_[addr];
-            mapper_->WriteWordLegit(pointer, n*2, entry.newaddr);
+            rom_->mapper()->WriteWordLegit(pointer, n*2, entry.newaddr);
         }
     }
 
@@ -176,7 +177,7 @@ bool EnemyListPack::Pack() {
     addr.set_bank(bank_);
     addr.set_address(misc.enemy_data_rom());
     for(size_t i=0; i<packed.size(); i++) {
-        mapper_->WriteLegit(addr, i, packed[i]);
+        rom_->mapper()->WriteLegit(addr, i, packed[i]);
     }
     return true;
 }
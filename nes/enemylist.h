@@ -5,24 +5,26 @@
 #include <vector>
 #include "proto/rominfo.pb.h"
 
-class Mapper;
 namespace z2util {
+class RomContext;
 
 class EnemyListPack {
   public:
-    EnemyListPack(Mapper* m) : mapper_(m), newareas_(0), bank_(0) {}
+    EnemyListPack(RomContext* rom) : rom_(rom), newareas_(0), bank_(0) {}
     EnemyListPack() : EnemyListPack(nullptr) {}
 
     void Unpack(int bank);
     void Add(int area, const std::vector<uint8_t>& data);
     bool Pack();
-    inline void set_mapper(Mapper* m) { mapper_ = m; }
+    // Whether area has an overworld encounter (two enemy lists).  Only
+    // valid after Unpack.
+    bool IsEncounter(int area);
+    inline void set_rom(RomContext* rom) { rom_ = rom; }
   private:
     void LoadEncounters();
-    bool IsEncounter(int area);
     void ReadOne(int area, Address addr);
 
-    Mapper* mapper_;
+    RomContext* rom_;
     int newareas_;
     int bank_;
     size_t size_;
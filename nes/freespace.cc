@@ -0,0 +1,162 @@
+#include <algorithm>
+#include <iterator>
+#include <vector>
+
+#include "nes/freespace.h"
+#include "nes/mapper.h"
+#include "nes/memory.h"
+
+namespace z2util {
+
+// The allocator never hands out the first byte of a bank or anything at
+// or above offset 0x3fe1 (the bank switching code and vectors live there).
+static const int kFirstOffset = 0x0001;
+static const int kLastOffset = 0x3fe1;
+
+int FreeSpace::Find(int bank, int length, Policy policy) {
+    int offset = Search(*Get(bank), length, policy);
+    if (!offset || !IsFree(bank, offset, length)) {
+        // Either someone wrote into the space behind our back, or freed
+        // space we haven't seen yet.  Re-index the bank from the current
+        // ROM contents and try once more.
+        Invalidate(bank);
+        offset = Search(*Get(bank), length, policy);
+    }
+    return offset;
+}
+
+int FreeSpace::Reserve(int bank, int length, Policy policy) {
+    int offset = Find(bank, length, policy);
+    if (offset) {
+        Remove(Get(bank), offset, offset + length);
+    }
+    return offset;
+}
+
+void FreeSpace::Release(int bank, int offset, int length) {
+    auto it = banks_.find(bank);
+    if (it == banks_.end()) {
+        // Not indexed yet; it'll be built from the ROM when needed.
+        return;
+    }
+    Insert(bank, &it->second, offset, offset + length);
+}
+
+FreeSpace::Extents* FreeSpace::Get(int bank) {
+    auto it = banks_.find(bank);
+    if (it == banks_.end()) {
+        it = banks_.emplace(bank, Extents()).first;
+        Build(bank, &it->second);
+    }
+    return &it->second;
+}
+
+void FreeSpace::Build(int bank, Extents* extents) {
+    auto data = mapper_->PrgBankSpan(bank, 0x8000, 0x4000);
+    int len = std::min(int(data.size()), kLastOffset);
+    int start = -1;
+    for(int i=kFirstOffset; i<len; ++i) {
+        uint8_t b = data[i];
+        if (b == 0x00 || b == 0xFF) {
+            if (start < 0) start = i;
+        } else if (start >= 0) {
+            Insert(bank, extents, start, i);
+            start = -1;
+        }
+    }
+    if (start >= 0) {
+        Insert(bank, extents, start, len);
+    }
+}
+
+void FreeSpace::Insert(int bank, Extents* extents, int start, int end) {
+    start = std::max(start, kFirstOffset);
+    end = std::min(end, kLastOffset);
+    if (start >= end)
+        return;
+
+    // Cut the keepout regions out of the range.  The keepout regions are
+    // expressed as CPU addresses in the $8000-$BFFF window.
+    std::vector<std::pair<int, int>> pieces{{start, end}};
+    for(const auto& k : KeepoutTable::Get().regions(bank)) {
+        int klo = k.first - 0x8000;
+        int khi = k.second - 0x8000;
+        if (khi <= start || klo >= end)
+            continue;
+        std::vector<std::pair<int, int>> next;
+        for(const auto& p : pieces) {
+            if (khi <= p.first || klo >= p.second) {
+                next.push_back(p);
+                continue;
+            }
+            if (p.first < klo) next.emplace_back(p.first, klo);
+            if (khi < p.second) next.emplace_back(khi, p.second);
+        }
+        pieces.swap(next);
+    }
+
+    // Merge each piece with any adjacent or overlapping extents.
+    for(auto p : pieces) {
+        auto it = extents->upper_bound(p.first);
+        if (it != extents->begin()) {
+            auto prev = std::prev(it);
+            if (prev->second >= p.first) {
+                p.first = prev->first;
+                p.second = std::max(p.second, prev->second);
+                extents->erase(prev);
+            }
+        }
+        while (it != extents->end() && it->first <= p.second) {
+            p.second = std::max(p.second, it->second);
+            it = extents->erase(it);
+        }
+        (*extents)[p.first] = p.second;
+    }
+}
+
+void FreeSpace::Remove(Extents* extents, int start, int end) {
+    auto it = extents->upper_bound(start);
+    if (it != extents->begin()) {
+        --it;
+    }
+    while (it != extents->end() && it->first < end) {
+        int lo = it->first, hi = it->second;
+        if (hi <= start) {
+            ++it;
+            continue;
+        }
+        it = extents->erase(it);
+        if (lo < start) (*extents)[lo] = start;
+        if (end < hi) (*extents)[end] = hi;
+    }
+}
+
+int FreeSpace::Search(const Extents& extents, int length, Policy policy) {
+    // Space is always taken from the top of an extent.
+    int best = 0, bestlen = 0;
+    for(auto it = extents.rbegin(); it != extents.rend(); ++it) {
+        int size = it->second - it->first;
+        if (size < length)
+            continue;
+        if (policy == FIRST_FIT)
+            return it->second - length;
+        if (!best || size < bestlen) {
+            best = it->second - length;
+            bestlen = size;
+        }
+    }
+    return best;
+}
+
+bool FreeSpace::IsFree(int bank, int offset, int length) {
+    auto data = mapper_->PrgBankSpan(bank, 0x8000 | offset, length);
+    if (int(data.size()) != length)
+        return false;
+    for(uint8_t b : data) {
+        if (!(b == 0x00 || b == 0xFF))
+            return false;
+    }
+    return true;
+}
+
+}  // namespace z2util
@@ -0,0 +1,56 @@
+#ifndef Z2UTIL_NES_FREESPACE_H
+#define Z2UTIL_NES_FREESPACE_H
+#include <cstdint>
+#include <map>
+
+class Mapper;
+
+namespace z2util {
+
+// Index of the free extents (runs of 0x00 or 0xFF bytes outside of the
+// allocator keepout regions) in each PRG bank.  The index for a bank is
+// built the first time it is needed and then kept up to date as the
+// allocator hands out and releases space.
+//
+// Other code is free to write into the ROM without telling the index, so
+// every extent is re-checked against the ROM before it is handed out.  If
+// the check fails, the bank's index is rebuilt.
+class FreeSpace {
+  public:
+    enum Policy {
+        // Use the highest-addressed extent that fits (the historical
+        // behavior of the allocator).
+        FIRST_FIT,
+        // Use the smallest extent that fits.
+        BEST_FIT,
+    };
+    explicit FreeSpace(Mapper* m) : mapper_(m) {}
+
+    // Find |length| free bytes in |bank|.  Returns the bank offset
+    // (0x0000-0x3FFF) of the space or 0 if there isn't enough space.
+    int Find(int bank, int length, Policy policy);
+    // Like Find, but also removes the space from the index.
+    int Reserve(int bank, int length, Policy policy);
+    // Return space to the index.
+    void Release(int bank, int offset, int length);
+
+    void Invalidate() { banks_.clear(); }
+    void Invalidate(int bank) { banks_.erase(bank); }
+
+  private:
+    // Extents are kept as start -> end (exclusive) bank offsets.
+    typedef std::map<int, int> Extents;
+
+    Extents* Get(int bank);
+    void Build(int bank, Extents* extents);
+    void Insert(int bank, Extents* extents, int start, int end);
+    void Remove(Extents* extents, int start, int end);
+    int Search(const Extents& extents, int length, Policy policy);
+    bool IsFree(int bank, int offset, int length);
+
+    Mapper* mapper_;
+    std::map<int, Extents> banks_;
+};
+
+}  // namespace z2util
+#endif // Z2UTIL_NES_FREESPACE_H
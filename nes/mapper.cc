@@ -1,3 +1,7 @@
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
 #include "nes/mapper.h"
 #include "nes/memory.h"
 
@@ -28,50 +32,133 @@ Mapper* MapperRegistry::New(Cartridge* cart, int n) {
     return mi->second(cart);
 }
 
-z2util::Address Mapper::FindFreeSpace(z2util::Address addr, int length) {
-    int end;
-    int offset;
+uint32_t Mapper::PrgOffset(int bank, uint32_t addr, uint32_t* avail) {
+    uint32_t offset;
+    if (bank < 0) bank += cartridge_->prgsz();
+    if (bank < 0x10) {
+        addr &= 0x3FFF;
+        offset = bank * 0x4000 + addr;
+        *avail = 0x4000 - addr;
+    } else {
+        offset = bank * 0x2000 - 0x8000 + addr;
+        *avail = cartridge_->prglen();
+    }
+    if (offset >= cartridge_->prglen()) {
+        *avail = 0;
+    } else if (offset + *avail > cartridge_->prglen()) {
+        *avail = cartridge_->prglen() - offset;
+    }
+    return offset;
+}
 
-    addr.set_address(0);
-    if (length < 8)
-        length = 8;
+uint32_t Mapper::ChrOffset(int bank, uint32_t addr, uint32_t* avail) {
+    if (bank < 0) bank += cartridge_->chrsz();
+    addr &= 0x0FFF;
+    uint32_t offset = bank * 0x1000 + addr;
+    *avail = 0x1000 - addr;
+    if (offset >= cartridge_->chrlen()) {
+        *avail = 0;
+    } else if (offset + *avail > cartridge_->chrlen()) {
+        *avail = cartridge_->chrlen() - offset;
+    }
+    return offset;
+}
+
+absl::Span<const uint8_t> Mapper::PrgBankSpan(int bank, uint32_t addr,
+                                              uint32_t len) {
+    uint32_t avail;
+    uint32_t offset = PrgOffset(bank, addr, &avail);
+    if (avail == 0)
+        return absl::Span<const uint8_t>();
+    return absl::Span<const uint8_t>(cartridge_->prg() + offset,
+                                     std::min(len, avail));
+}
 
-    // Search backwards from the end for free space
-    offset = 0x3fe0;
-    while(offset > 0) {
-        uint8_t b = Read(addr, offset);
-        if (b == 00 || b == 0xFF) {
-            end = offset;
-            while (offset > 0 && ((b = Read(addr, offset)) == 0x00 || b == 0xFF)) {
-                if (end - offset + 1 == length) {
-                    z2util::Address startaddr = addr;
-                    z2util::Address endaddr = addr;
-                    startaddr.set_address(0x8000 | offset);
-                    endaddr.set_address(0x8000 | end);
-                    if (z2util::Memory::InKeepoutRegion(startaddr)
-                        || z2util::Memory::InKeepoutRegion(endaddr)) {
-                        break;
-                    }
-                    return startaddr;
-                }
-                offset--;
-            }
+absl::Span<const uint8_t> Mapper::ChrBankSpan(int bank, uint32_t addr,
+                                              uint32_t len) {
+    uint32_t avail;
+    uint32_t offset = ChrOffset(bank, addr, &avail);
+    if (avail == 0)
+        return absl::Span<const uint8_t>();
+    return absl::Span<const uint8_t>(cartridge_->chr() + offset,
+                                     std::min(len, avail));
+}
+
+void Mapper::ReadPrgBytes(int bank, uint32_t addr, uint8_t* dst,
+                          uint32_t len) {
+    while (len) {
+        uint32_t avail;
+        uint32_t offset = PrgOffset(bank, addr, &avail);
+        if (avail == 0) {
+            memset(dst, 0, len);
+            return;
         }
-        offset--;
+        uint32_t n = std::min(len, avail);
+        memcpy(dst, cartridge_->prg() + offset, n);
+        dst += n; addr += n; len -= n;
     }
+}
 
-    addr.set_address(0);
+void Mapper::ReadChrBytes(int bank, uint32_t addr, uint8_t* dst,
+                          uint32_t len) {
+    while (len) {
+        uint32_t avail;
+        uint32_t offset = ChrOffset(bank, addr, &avail);
+        if (avail == 0) {
+            memset(dst, 0, len);
+            return;
+        }
+        uint32_t n = std::min(len, avail);
+        memcpy(dst, cartridge_->chr() + offset, n);
+        dst += n; addr += n; len -= n;
+    }
+}
+
+void Mapper::WritePrgBytesLegit(int bank, uint32_t addr, const uint8_t* src,
+                                uint32_t len) {
+    while (len) {
+        uint32_t avail;
+        uint32_t offset = PrgOffset(bank, addr, &avail);
+        if (avail == 0)
+            return;
+        uint32_t n = std::min(len, avail);
+        cartridge_->WritePrg(offset, src, n);
+        src += n; addr += n; len -= n;
+    }
+}
+
+void Mapper::WriteChrBytes(int bank, uint32_t addr, const uint8_t* src,
+                           uint32_t len) {
+    while (len) {
+        uint32_t avail;
+        uint32_t offset = ChrOffset(bank, addr, &avail);
+        if (avail == 0)
+            return;
+        uint32_t n = std::min(len, avail);
+        cartridge_->WriteChr(offset, src, n);
+        src += n; addr += n; len -= n;
+    }
+}
+
+z2util::Address Mapper::FindFreeSpace(z2util::Address addr, int length) {
+    if (length < 8)
+        length = 8;
+
+    int offset = freespace_.Find(addr.bank(), length, alloc_policy_);
+    addr.set_address(offset ? 0x8000 | offset : 0);
     return addr;
 }
 
 void Mapper::Erase(const z2util::Address& addr, uint16_t length) {
-    for(uint16_t i=0; i<length; i++) {
-        Write(addr, i, 0xFF);
-    }
+    std::vector<uint8_t> erased(length, 0xFF);
+    WriteBytes(addr, 0, erased.data(), length);
+    freespace_.Release(addr.bank(), addr.address() & 0x3FFF, length);
 }
 
 z2util::Address Mapper::Alloc(z2util::Address addr, int length) {
-    addr = FindFreeSpace(addr, length+4);
+    int size = std::max(length + 4, 8);
+    int offset = freespace_.Reserve(addr.bank(), size, alloc_policy_);
+    addr.set_address(offset ? 0x8000 | offset : 0);
     if (addr.address() != 0) {
         WriteWord(addr, 0, ALLOC_TOKEN);
         WriteWord(addr, 2, length);
@@ -3,17 +3,22 @@
 #include <functional>
 #include <map>
 #include <cstdint>
+#include "absl/types/span.h"
 #include "nes/cartridge.h"
-#include "imwidget/debug_console.h"
+#include "nes/freespace.h"
+#include "util/console.h"
 
 #include "proto/rominfo.pb.h"
 
 class Mapper {
   public:
-    Mapper(Cartridge* cart) : cartridge_(cart) {}
+    Mapper(Cartridge* cart)
+      : cartridge_(cart),
+        freespace_(this),
+        alloc_policy_(z2util::FreeSpace::FIRST_FIT) {}
     virtual uint8_t Read(uint16_t addr) = 0;
     virtual void Write(uint16_t addr, uint8_t val) = 0;
-    virtual void DebugWriteReg(DebugConsole* console, int argc, char** argv) {
+    virtual void DebugWriteReg(Console* console, int argc, char** argv) {
         console->AddLog("Not implemented");
     }
 
@@ -52,6 +57,46 @@ class Mapper {
         return cartridge_->WriteChr(bank * 0x1000 + (addr & 0x0FFF), val);
     }
 
+    // Bulk access to PRG and CHR banks.  The spans point directly into
+    // cartridge memory and stop at the end of the bank; they are only valid
+    // until the cartridge is resized (e.g. InsertPrg/InsertChr).
+    absl::Span<const uint8_t> PrgBankSpan(int bank, uint32_t addr,
+                                          uint32_t len);
+    absl::Span<const uint8_t> ChrBankSpan(int bank, uint32_t addr,
+                                          uint32_t len);
+
+    // Bulk copies which wrap within the bank just like the single-byte
+    // accessors do.
+    void ReadPrgBytes(int bank, uint32_t addr, uint8_t* dst, uint32_t len);
+    void ReadChrBytes(int bank, uint32_t addr, uint8_t* dst, uint32_t len);
+
+    // Like WritePrgBank, plain bulk writes are suppressed.
+    virtual void WritePrgBytes(int bank, uint32_t addr, const uint8_t* src,
+                               uint32_t len) {
+        return;
+    }
+    void WritePrgBytesLegit(int bank, uint32_t addr, const uint8_t* src,
+                            uint32_t len);
+    void WriteChrBytes(int bank, uint32_t addr, const uint8_t* src,
+                       uint32_t len);
+
+    absl::Span<const uint8_t> PrgSpan(const z2util::Address& addr, int offset,
+                                      uint32_t len) {
+        return PrgBankSpan(addr.bank(), addr.address() + offset, len);
+    }
+    void ReadBytes(const z2util::Address& addr, int offset, uint8_t* dst,
+                   uint32_t len) {
+        ReadPrgBytes(addr.bank(), addr.address() + offset, dst, len);
+    }
+    void WriteBytes(const z2util::Address& addr, int offset,
+                    const uint8_t* src, uint32_t len) {
+        WritePrgBytes(addr.bank(), addr.address() + offset, src, len);
+    }
+    void WriteBytesLegit(const z2util::Address& addr, int offset,
+                         const uint8_t* src, uint32_t len) {
+        WritePrgBytesLegit(addr.bank(), addr.address() + offset, src, len);
+    }
+
     uint8_t Read(const z2util::Address& addr, int offset) {
         return ReadPrgBank(addr.bank(), addr.address() + offset);
     }
@@ -109,9 +154,26 @@ class Mapper {
     uint16_t IsAlloc(z2util::Address start);
     void Free(z2util::Address start);
 
+    inline void set_alloc_policy(z2util::FreeSpace::Policy p) {
+        alloc_policy_ = p;
+    }
+    inline z2util::FreeSpace* freespace() { return &freespace_; }
+
     Cartridge* cartridge() { return cartridge_; }
+    // The 16 KiB PRG bank which holds addr.
+    inline int PrgBankOf(const z2util::Address& addr) {
+        uint32_t avail;
+        return PrgOffset(addr.bank(), addr.address(), &avail) / 0x4000;
+    }
   protected:
+    // Translate a bank/address pair into an offset into the PRG or CHR
+    // memory.  |avail| receives the number of bytes left in the bank.
+    uint32_t PrgOffset(int bank, uint32_t addr, uint32_t* avail);
+    uint32_t ChrOffset(int bank, uint32_t addr, uint32_t* avail);
+
     Cartridge* cartridge_;
+    z2util::FreeSpace freespace_;
+    z2util::FreeSpace::Policy alloc_policy_;
 };
 
 class MapperRegistry {
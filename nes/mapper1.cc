@@ -47,7 +47,7 @@ void Mapper1::Write(uint16_t addr, uint8_t val) {
     }
 }
 
-void Mapper1::DebugWriteReg(DebugConsole* console, int argc, char **argv) {
+void Mapper1::DebugWriteReg(Console* console, int argc, char **argv) {
     if (argc != 3) {
         console->AddLog("[error] Usage %s <reg-or-offset> <value>", argv[0]);
         console->AddLog("[error] Register Names:");
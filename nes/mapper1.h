@@ -3,7 +3,7 @@
 #include <cstdint>
 
 #include "nes/mapper.h"
-#include "imwidget/debug_console.h"
+#include "util/console.h"
 
 class Mapper1: public Mapper {
   public:
@@ -16,7 +16,7 @@ class Mapper1: public Mapper {
     int ChrBankOffset(int index);
     void WriteControl(uint8_t val);
     void LoadRegister(uint16_t addr, uint8_t val);
-    void DebugWriteReg(DebugConsole* console, int argc, char **argv);
+    void DebugWriteReg(Console* console, int argc, char **argv);
     void WriteRegister(uint16_t addr, uint8_t val);
     void UpdateOffsets();
 
@@ -1,5 +1,6 @@
+#include <algorithm>
 #include <map>
-#include <set>
+#include <mutex>
 #include "nes/memory.h"
 
 #include "proto/rominfo.pb.h"
@@ -9,6 +10,61 @@
 
 namespace z2util {
 
+const KeepoutTable& KeepoutTable::Get() {
+    static KeepoutTable table;
+    static std::mutex mu;
+    int generation = ConfigLoader<RomInfo>::Generation();
+    if (table.generation_.load(std::memory_order_acquire) != generation) {
+        std::lock_guard<std::mutex> lock(mu);
+        if (table.generation_.load(std::memory_order_relaxed) != generation) {
+            table.Build(ConfigLoader<RomInfo>::GetConfig());
+            table.generation_.store(generation, std::memory_order_release);
+        }
+    }
+    return table;
+}
+
+void KeepoutTable::Build(const RomInfo& ri) {
+    banks_.clear();
+    for(const auto& k : ri.misc().allocator_keepout()) {
+        auto& bank = banks_[k.bank()];
+        int start = std::max(k.address(), 0);
+        int end = std::min(k.address() + k.length(), 0x10000);
+        for(int a=start; a<end; ++a) {
+            bank.bits[a] = true;
+        }
+    }
+    // Derive the merged region list from the bitmap.
+    for(auto& b : banks_) {
+        int start = -1;
+        for(int a=0; a<0x10000; ++a) {
+            if (b.second.bits[a]) {
+                if (start < 0) start = a;
+            } else if (start >= 0) {
+                b.second.regions.emplace_back(start, a);
+                start = -1;
+            }
+        }
+        if (start >= 0) {
+            b.second.regions.emplace_back(start, 0x10000);
+        }
+    }
+}
+
+const KeepoutTable::Regions& KeepoutTable::regions(int bank) const {
+    static const Regions empty;
+    const auto it = banks_.find(bank);
+    return it == banks_.end() ? empty : it->second.regions;
+}
+
+std::vector<int> KeepoutTable::banks() const {
+    std::vector<int> result;
+    for(const auto& b : banks_) {
+        result.push_back(b.first);
+    }
+    return result;
+}
+
 Memory::Memory() {}
 
 int Memory::CheckForKeepout(Address baseaddr, const std::string& name, int len,
@@ -62,10 +118,11 @@ int Memory::CheckBank3Special(bool move) {
             if (dst.address() == 0) {
                 dst = mapper_->Alloc(src, len);
             }
-            for(int i=0; i<len; i++) {
-                mapper_->Write(dst, i, mapper_->Read(src, i));
-                mapper_->Write(src, i, 0);
-            }
+            uint8_t buf[35];
+            const uint8_t zero[35] = {0};
+            mapper_->ReadBytes(src, 0, buf, len);
+            mapper_->WriteBytes(dst, 0, buf, len);
+            mapper_->WriteBytes(src, 0, zero, len);
             mapper_->WriteWord(code, 0, dst.address());
             mapper_->WriteWord(code, 2, dst.address());
             mapper_->WriteWord(code, -60, dst.address() + 7);
@@ -106,12 +163,7 @@ int Memory::CheckBankForKeepout(int bank, bool move) {
 }
 
 void Memory::CheckAllBanksForKeepout(bool move) {
-    std::set<int> banks;
-    const auto& ri = ConfigLoader<RomInfo>::GetConfig();
-    for(const auto& k : ri.misc().allocator_keepout()) {
-        banks.insert(k.bank());
-    }
-    for(const auto& bank : banks) {
+    for(const auto& bank : KeepoutTable::Get().banks()) {
         CheckBankForKeepout(bank, move);
     }
 }
@@ -127,24 +179,13 @@ int Memory::MoveMapOutOfKeepout(const Address& pointer) {
 
     // Copy to the new location, zero out the old location.
     // LOGF(INFO, "Moving %d bytes from %04x to %04x", len, src.address(), dst.address());
-    for(int i=0; i<len; i++) {
-        mapper_->Write(dst, i, mapper_->Read(src, i));
-        mapper_->Write(src, i, 0);
-    }
+    uint8_t data[256];
+    const uint8_t zero[256] = {0};
+    mapper_->ReadBytes(src, 0, data, len);
+    mapper_->WriteBytes(dst, 0, data, len);
+    mapper_->WriteBytes(src, 0, zero, len);
     mapper_->WriteWord(pointer, 0, uint16_t(dst.address()));
     return dst.address();
 }
 
-bool Memory::InKeepoutRegion(const Address& addr) {
-    const auto& ri = ConfigLoader<RomInfo>::GetConfig();
-    for(const auto& k : ri.misc().allocator_keepout()) {
-        if (addr.bank() == k.bank() &&
-            addr.address() >= k.address() &&
-            addr.address() < k.address() + k.length()) {
-            return true;
-        }
-    }
-    return false;
-}
-
 }  // namespace
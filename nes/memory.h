@@ -1,12 +1,49 @@
 #ifndef Z2UTIL_NES_MEMORY_H
 #define Z2UTIL_NES_MEMORY_H
 
+#include <atomic>
+#include <bitset>
+#include <map>
+#include <utility>
+#include <vector>
 #include "proto/rominfo.pb.h"
 
 class Mapper;
 
 namespace z2util {
 
+// Per-bank lookup table of the allocator keepout regions.  The table is
+// built from the RomInfo config and rebuilt whenever the config is
+// (re)loaded.  Get() is safe to call from multiple threads, but reloading
+// the config while other threads are using the table is not.
+class KeepoutTable {
+  public:
+    typedef std::vector<std::pair<int, int>> Regions;
+
+    static const KeepoutTable& Get();
+
+    inline bool Contains(int bank, int address) const {
+        const auto it = banks_.find(bank);
+        return it != banks_.end() && it->second.bits[address & 0xFFFF];
+    }
+    // The sorted, merged keepout regions of |bank| as [start, end) CPU
+    // addresses.
+    const Regions& regions(int bank) const;
+    // The banks which have any keepout regions.
+    std::vector<int> banks() const;
+
+  private:
+    KeepoutTable() : generation_(-1) {}
+    void Build(const RomInfo& ri);
+
+    struct Bank {
+        std::bitset<0x10000> bits;
+        Regions regions;
+    };
+    std::map<int, Bank> banks_;
+    std::atomic<int> generation_;
+};
+
 class Memory {
   public:
     Memory();
@@ -22,7 +59,9 @@ class Memory {
 
     void Reset() { moved_.clear(); }
     inline void set_mapper(Mapper* m) { mapper_ = m; }
-    static bool InKeepoutRegion(const Address& addr);
+    static bool InKeepoutRegion(const Address& addr) {
+        return KeepoutTable::Get().Contains(addr.bank(), addr.address());
+    }
     static int key(const Address& a) {
         return (a.bank() << 16) | a.address();
     }
@@ -0,0 +1,41 @@
+#include "nes/object_names.h"
+#include <cstdio>
+
+namespace z2util {
+
+ObjectNames::ObjectNames(const RomInfo& ri) {
+    char buf[64];
+    for(int i=0; i<NR_AREAS; i++) {
+        for(int j=0; j<NR_SETS; j++) {
+            for(int k=0; k<16; k++) {
+                int val = (j==0 || j==3) ? k : k<<4;
+                snprintf(buf, sizeof(buf), "%02x: %s", val,
+                         (j==0 && k==15) ? "collectable" : "???");
+                object_names_[i][j][k] = buf;
+                info_[i][j][k] = nullptr;
+            }
+        }
+    }
+    for(const auto& d : ri.decompress()) {
+        int id = d.id();
+        int val = id;
+        if (id & 0xF0) {
+            id >>= 4;
+        }
+        snprintf(buf, sizeof(buf), "%02x: %s", val, d.comment().c_str());
+        object_names_[d.area()][d.type()][id] = buf;
+        info_[d.area()][d.type()][id] = &d;
+    }
+    for(int i=0; i<MAX_COLLECTABLE; i++) {
+        const auto& c = ri.items().info().find(i);
+        if (c == ri.items().info().end()) {
+            snprintf(buf, 32, "%02x: ???", i);
+        } else {
+            snprintf(buf, 32, "%02x: %s", i, c->second.name().c_str());
+        }
+        collectable_names_[i] = buf;
+        collectable_ptr_[i] = collectable_names_[i].c_str();
+    }
+}
+
+}  // namespace z2util
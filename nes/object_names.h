@@ -0,0 +1,51 @@
+#ifndef Z2UTIL_NES_OBJECT_NAMES_H
+#define Z2UTIL_NES_OBJECT_NAMES_H
+#include <string>
+
+#include "proto/rominfo.pb.h"
+
+namespace z2util {
+
+// The names of the sideview objects and collectable items, built from a
+// RomInfo config.  Each RomContext has its own, since the config can
+// change from ROM to ROM.
+class ObjectNames {
+  public:
+    // areas: overword sideviews, towns, palaces, great palace
+    const static int NR_AREAS = 4;
+    // sets: small objects, object set 0, object set 1,
+    // extra small objects, extra objects
+    const static int NR_SETS = 5;
+    const static int MAX_COLLECTABLE = 36;
+
+    explicit ObjectNames(const RomInfo& ri);
+    ObjectNames(const ObjectNames&) = delete;
+    ObjectNames& operator=(const ObjectNames&) = delete;
+
+    // The config entry for an object, or nullptr if there isn't one.  For
+    // the large object sets, id is the object's upper nybble.
+    inline const DecompressInfo* info(int area, int set, int id) const {
+        return info_[area][set][id];
+    }
+    // "<object id>: <comment>"
+    inline const char* object_name(int area, int set, int id) const {
+        return object_names_[area][set][id].c_str();
+    }
+    // "<item id>: <name>"
+    inline const char* collectable_name(int id) const {
+        return collectable_ptr_[id];
+    }
+    // All MAX_COLLECTABLE names, in the form ImGui::Combo wants.
+    inline const char* const* collectable_names() const {
+        return collectable_ptr_;
+    }
+
+  private:
+    const DecompressInfo* info_[NR_AREAS][NR_SETS][16];
+    std::string object_names_[NR_AREAS][NR_SETS][16];
+    std::string collectable_names_[MAX_COLLECTABLE];
+    const char* collectable_ptr_[MAX_COLLECTABLE];
+};
+
+}  // namespace z2util
+#endif // Z2UTIL_NES_OBJECT_NAMES_H
@@ -0,0 +1,70 @@
+#include "nes/rom_context.h"
+
+#include "proto/rominfo.pb.h"
+#include "util/config.h"
+
+namespace z2util {
+
+RomContext::RomContext(const Cartridge& cart)
+  : cartridge_(cart) {
+    if (NewMapper()) {
+        memory_.set_mapper(mapper_.get());
+    }
+}
+
+bool RomContext::LoadRom(const std::string& rom, bool movekeepout) {
+    // Cartridge::LoadRom aborts on truncated images, so check the sizes
+    // from the header first.
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(rom.data());
+    if (rom.size() < 16 || rom.compare(0, 4, "NES\x1a") != 0) {
+        return false;
+    }
+    size_t size = 16 + 16384 * size_t(data[4]) + 8192 * size_t(data[5]);
+    if (data[6] & 0x04) {
+        size += 512;
+    }
+    if (rom.size() < size) {
+        return false;
+    }
+    cartridge_.LoadRom(rom);
+    // The image now matches rom, so patches against it only need to look
+    // at what gets written from here on.
+    cartridge_.ClearDirty(Cartridge::EXPORT);
+    return Reload(movekeepout);
+}
+
+bool RomContext::NewMapper() {
+    mapper_.reset(MapperRegistry::New(&cartridge_, cartridge_.mapper()));
+    if (!mapper_) {
+        return false;
+    }
+    // Build the tables now rather than on first use, so that threads
+    // sharing a loaded context never have to.
+    object_names_.reset(
+        new ObjectNames(ConfigLoader<RomInfo>::GetConfig()));
+    return true;
+}
+
+bool RomContext::Reload(bool movekeepout) {
+    if (!NewMapper()) {
+        return false;
+    }
+    memory_.Reset();
+    memory_.set_mapper(mapper_.get());
+    memory_.CheckAllBanksForKeepout();
+    if (movekeepout) {
+        memory_.CheckAllBanksForKeepout(true);
+    }
+    return true;
+}
+
+
+const ObjectNames& RomContext::object_names() {
+    if (!object_names_) {
+        object_names_.reset(
+            new ObjectNames(ConfigLoader<RomInfo>::GetConfig()));
+    }
+    return *object_names_;
+}
+
+}  // namespace z2util
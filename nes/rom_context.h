@@ -0,0 +1,53 @@
+#ifndef Z2UTIL_NES_ROM_CONTEXT_H
+#define Z2UTIL_NES_ROM_CONTEXT_H
+#include <memory>
+#include <string>
+
+#include "nes/cartridge.h"
+#include "nes/mapper.h"
+#include "nes/memory.h"
+#include "nes/object_names.h"
+
+namespace z2util {
+
+// Everything needed to work on one ROM image: the cartridge, its mapper,
+// the keepout bookkeeping and the tables built from the config.  Nothing
+// in a context is shared with other contexts, so separate contexts may be
+// used from separate threads.  A loaded context may also be read by
+// several threads at once, as long as none of them writes to it.
+//
+// The RomInfo config is shared by all contexts.  It is read-only once it
+// has been loaded; don't reload it while other threads are working.
+class RomContext {
+  public:
+    RomContext() {}
+    // A copy of cart, without the keepout bookkeeping, for contexts which
+    // only read the ROM.  mapper() is null if cart's mapper is unknown.
+    explicit RomContext(const Cartridge& cart);
+
+    // Load an iNES image and do the post-load processing.  Returns false
+    // if the image is truncated or uses an unknown mapper.
+    bool LoadRom(const std::string& rom, bool movekeepout);
+    // Redo the post-load processing after the cartridge has been modified
+    // behind the mapper's back (e.g. a bank was restored from another ROM).
+    bool Reload(bool movekeepout);
+    inline const std::string& SaveRom() { return cartridge_.SaveRom(); }
+
+    inline Cartridge* cartridge() { return &cartridge_; }
+    inline Mapper* mapper() { return mapper_.get(); }
+    inline Memory* memory() { return &memory_; }
+    // Rebuilt from the config on every load.  Before the first load, this
+    // is built on first use.
+    const ObjectNames& object_names();
+
+  private:
+    bool NewMapper();
+
+    Cartridge cartridge_;
+    std::unique_ptr<Mapper> mapper_;
+    Memory memory_;
+    std::unique_ptr<ObjectNames> object_names_;
+};
+
+}  // namespace z2util
+#endif // Z2UTIL_NES_ROM_CONTEXT_H
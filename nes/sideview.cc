@@ -0,0 +1,485 @@
+#include <algorithm>
+
+#include "nes/sideview.h"
+
+#include "nes/enemylist.h"
+#include "util/config.h"
+#include "util/logging.h"
+#include "absl/strings/str_cat.h"
+
+namespace z2util {
+
+SideviewCommand::SideviewCommand(uint8_t position, uint8_t object,
+                                 uint8_t extra)
+  : absx_(position & 0xf),
+    x_(position & 0xf),
+    y_(position >> 4),
+    object_(object),
+    extra_(extra) {}
+
+SideviewCommand::SideviewCommand(int x0, uint8_t position, uint8_t object,
+                                 uint8_t extra)
+  : SideviewCommand(position, object, extra)
+{
+    if (y_ == 14) {
+        absx_ = x_ * 16;
+    } else {
+        absx_ = x_ + x0;
+    }
+}
+
+std::vector<uint8_t> SideviewCommand::Command() const {
+    uint8_t position = (y_ << 4) | x_;
+    if (y_ < 13 && object_ == 15) {
+        return {position, object_, extra_};
+    }
+    return {position, object_};
+}
+
+
+Sideview::Sideview(RomContext* rom)
+  : rom_(rom),
+    map_addr_(0),
+    map_bank_(0),
+    bytes_{1},
+    length_(1),
+    flags_(0),
+    ground_(0),
+    back_(0),
+    cursor_moves_left_(false) {
+    Unpack();
+}
+
+void Sideview::Unpack() {
+    data_.objset = !!(flags_ & 0x80);
+    data_.width = 1 + ((flags_ >> 5) & 3);
+    data_.grass = !!(flags_ & 0x08);
+    data_.bushes = !!(flags_ & 0x04);
+    data_.ceiling = !(ground_ & 0x80);
+    data_.ground = (ground_ >> 4) & 7;
+    data_.floor = ground_ & 0xf;
+    data_.spal = (back_ >> 6) & 3;
+    data_.bpal = (back_ >> 3) & 7;
+    data_.bmap = back_ & 7;
+}
+
+void Sideview::Pack() {
+    flags_ = (data_.objset << 7) |
+             ((data_.width-1) << 5) |
+             (int(data_.grass) << 3) |
+             (int(data_.bushes) << 2);
+    ground_ = (int(!data_.ceiling) << 7) | (data_.ground << 4) | (data_.floor);
+    back_ = (data_.spal << 6) | (data_.bpal << 3) | data_.bmap;
+}
+
+void Sideview::Parse(const Map& map, uint16_t altaddr) {
+    map_ = map;
+    // For side view maps, the map address is the address of a pointer
+    // to the real address.  Read it and set the real address.
+    Address address = rom_->mapper()->ReadAddr(map.pointer(), 0);
+    if (altaddr) {
+        address.set_address(altaddr);
+    }
+    if (map.type() == MapType::PALACE || map.type() == MapType::GREAT_PALACE) {
+        map_bank_ = 0x1c;
+    }
+    else {
+        map_bank_ = address.bank();
+    }
+    *map_.mutable_address() = address;
+    map_addr_ = address.address();
+
+    uint8_t length = rom_->mapper()->ReadPrgBank(map_bank_, map_addr_);
+    bytes_.clear();
+    for(int i=0; i<length; ++i) {
+        bytes_.push_back(rom_->mapper()->ReadPrgBank(map_bank_, map_addr_ + i));
+    }
+    Parse();
+}
+
+void Sideview::Parse(const std::vector<uint8_t>& bytes) {
+    bytes_ = bytes;
+    Parse();
+}
+
+void Sideview::Parse() {
+    // Missing header bytes read as zero.
+    auto byte = [this](size_t i) -> uint8_t {
+        return i < bytes_.size() ? bytes_[i] : 0;
+    };
+    length_ = byte(0);
+    flags_ = byte(1);
+    ground_ = byte(2);
+    back_ = byte(3);
+    Unpack();
+
+    command_.clear();
+    int absx = 0;
+    for(int i=4; i<length_ && i+1 < int(bytes_.size()); i+=2) {
+        uint8_t pos = bytes_[i];
+        uint8_t obj = bytes_[i + 1];
+        uint8_t extra = 0;
+
+        int y = pos >> 4;
+        if (y < 13 && obj == 15) {
+            i++;
+            extra = byte(i + 1);
+        }
+        command_.emplace_back(absx, pos, obj, extra);
+        absx = command_.back().absx();
+    }
+}
+
+std::vector<uint8_t> Sideview::MapDataWorker(
+        const std::vector<SideviewCommand>& list) {
+    std::vector<uint8_t> map = {length_, flags_, ground_, back_};
+    for(const auto& cmd : list) {
+        auto bytes = cmd.Command();
+        map.insert(map.end(), bytes.begin(), bytes.end());
+#ifndef NDEBUG
+        // Turn this log message off in non-debug builds, as this method is
+        // in the sideview editors draw loop.
+        LOG(INFO, "CMD: op = ", HEX(bytes[0]), " ", HEX(bytes[1]));
+#endif
+    }
+    map[0] = map.size();
+    return map;
+}
+
+void Sideview::Append(const SideviewCommand& cmd) {
+    command_.push_back(cmd);
+}
+
+void Sideview::Extend(const std::vector<SideviewCommand>& cmds) {
+    command_.insert(command_.end(), cmds.begin(), cmds.end());
+}
+
+std::vector<uint8_t> Sideview::MapData() {
+    return MapDataWorker(command_);
+}
+
+std::vector<uint8_t> Sideview::MapDataAbs() {
+    std::vector<SideviewCommand> copy = command_;
+    if (!cursor_moves_left_) {
+        std::stable_sort(copy.begin(), copy.end(),
+            [](const SideviewCommand& a, const SideviewCommand& b) {
+                if (a.absx() == b.absx()) {
+                    // Adjust y-coordinate so meta-ops appear before normal
+                    // map commands.
+                    int ya = (a.absy() + 3) % 16;
+                    int yb = (b.absy() + 3) % 16;
+                    return ya < yb;
+                }
+                return a.absx() < b.absx();
+            });
+    }
+    int x = 0;
+    for(auto it = copy.begin(); it < copy.end(); ++it) {
+        if (it->absy() == 14) {
+            // Erase any "skip" commands, as we'll re-synthesize them
+            // as needed.
+            it = copy.erase(it);
+            if (it == copy.end())
+                break;
+        }
+        int deltax = it->absx() - x;
+        if (deltax < 0 || deltax > 15) {
+            int nx = it->absx() & ~15;
+            it = copy.emplace(it, x, 0xE0 | (nx/16), 0, 0);
+            it++;
+            x = nx;
+            deltax = it->absx() - x;
+        }
+        it->set_relx(deltax);
+        x = it->absx();
+    }
+
+    return MapDataWorker(copy);
+}
+
+std::vector<const Map*> Sideview::SharedWith() const {
+    const auto& ri = ConfigLoader<RomInfo>::GetConfig();
+    std::vector<const Map*> sameptr;
+    for(const auto& m : ri.map()) {
+        Address mptr = rom_->mapper()->ReadAddr(m.pointer(), 0);
+        if (m.name() != map_.name() &&
+            mptr.bank() == map_.address().bank() &&
+            mptr.address() == map_.address().address()) {
+            sameptr.push_back(&m);
+        }
+    }
+    return sameptr;
+}
+
+const char* Sideview::ObjectName(const SideviewCommand& cmd) const {
+    int y = cmd.absy();
+    uint8_t object = cmd.object();
+    if (y == 13) {
+        return "new floor";
+    } else if (y == 14) {
+        return "x skip";
+    }
+
+    int set;
+    if (y == 15) {
+        set = (object & 0xF0) ? 4 : 3;
+    } else if ((object & 0xF0) == 0) {
+        set = 0;
+    } else {
+        set = 1 + !!(flags_ & 0x80);
+    }
+    const ObjectNames& names = rom_->object_names();
+    if ((set == 0 || set == 3) && object == 15) {
+        int extra = cmd.extra();
+        return extra < ObjectNames::MAX_COLLECTABLE
+               ? names.collectable_name(extra) : "collectable";
+    }
+    int id = (set == 0 || set == 3) ? object & 0x0F : object >> 4;
+    return names.object_name(map_.type(), set, id);
+}
+
+util::Status Sideview::Save(bool clone) {
+    Pack();
+    std::vector<uint8_t> data = MapDataAbs();
+    LOG(INFO, "Saving ", map_.name(), " (", data.size(), " bytes)");
+
+    std::vector<const Map*> sameptr = SharedWith();
+    for(const auto* m : sameptr) {
+        LOG(INFO, "Duplicate data: ", m->name());
+    }
+
+    Address addr = map_.address();
+    addr.set_bank(map_bank_);
+    addr.set_address(0x8000 | addr.address());
+    bool needfree = false;
+
+    if (data.size() > length_ || !sameptr.empty()) {
+        // Search the entire bank and allocate memory
+        addr.set_address(0);
+        addr = rom_->mapper()->Alloc(addr, data.size());
+        if (addr.address() == 0) {
+            LOG(ERROR, "Can't save map: can't find ", data.size(), "bytes"
+                       " in bank=", addr.bank());
+            return util::Status(util::error::Code::RESOURCE_EXHAUSTED,
+                absl::StrCat("Can't save map: ", map_.name(), "\n\n"
+                             "Can't find ", data.size(),
+                             " free bytes in bank ", addr.bank()));
+        }
+        needfree = true;
+        length_ = data.size();
+    }
+
+    if (clone) {
+        for(const auto* m : sameptr) {
+            rom_->mapper()->WriteWordLegit(m->pointer(), 0, addr.address());
+        }
+        // Free the existing memory if it was owned by the allocator.
+        if (needfree) {
+            LOGF(INFO, "Freeing old map at %04x", map_.address().address());
+            rom_->mapper()->Free(map_.address());
+        } else {
+            LOGF(INFO, "No free needed at %04x", map_.address().address());
+        }
+    }
+    *map_.mutable_address() = addr;
+    map_addr_ = addr.address();
+
+    LOGF(INFO, "Saving map to {bank: %d address: 0x%04x}",
+               addr.bank(), addr.address());
+
+    for(unsigned i=0; i<data.size(); i++) {
+        rom_->mapper()->WriteLegit(addr, i, data[i]);
+    }
+    rom_->mapper()->WriteWordLegit(map_.pointer(), 0, addr.address());
+    Parse(map_, 0);
+    return util::Status();
+}
+
+
+SideviewEnemies::SideviewEnemies(RomContext* rom)
+  : rom_(rom),
+    is_large_(false),
+    is_encounter_(false),
+    load_text_(true),
+    bytes_{1} {}
+
+void SideviewEnemies::LoadText(Unpacked* item) {
+    item->text[0] = item->text[1] = item->text[2] = -1;
+    if (map_.type() == MapType::TOWN && item->enemy >= 10) {
+        const auto& tt = ConfigLoader<RomInfo>::GetConfig().text_table();
+        const auto& ie = ConfigLoader<RomInfo>::GetConfig().item_effects();
+        int townsperson = item->enemy - 10;
+        int town = map_.code();
+        int idxtbl = (town >> 2) * 2;
+        int index = townsperson * 4 + (town & 3);
+        for(int j=0; j<2; j++, idxtbl++) {
+            if (index < tt.index(idxtbl).length()) {
+                item->text[j] = rom_->mapper()->Read(tt.index(idxtbl),
+                                                     index);
+                LOGF(INFO, "Enemy %d (townsperson %d), line %d: %04x -> %d",
+                     item->enemy, townsperson, j,
+                     tt.index(idxtbl).address()+index, item->text[j]);
+                if (item->text[j] == 255) {
+                    LOGF(ERROR, "Enemy $%02x has an invalid text index.", item->enemy);
+                }
+            }
+        }
+        if (item->enemy == 0x0f || item->enemy == 0x0d) {
+            // Wise man (wizard or knight) has a third dialog: "Go now..."
+            // Encoded under townsperson 15 dialog 2.
+            index = 15 * 4 + (town&3);
+            idxtbl = (town >> 2) * 2 + 1;
+            item->text[2] = rom_->mapper()->Read(tt.index(idxtbl), index);
+            if (item->text[2] == 255) {
+                LOGF(ERROR, "Enemy $%02x has an invalid text index.", item->enemy);
+            }
+        }
+        if (townsperson >= 9 && townsperson < 9+4) {
+            item->condition = rom_->mapper()->Read(ie.conditions_table(),
+                    (townsperson-9)*8 + town);
+        }
+    }
+}
+
+Address SideviewEnemies::pointer() const {
+    Address addr = map_.pointer();
+    addr.set_address(addr.address() + 0x7e);
+    return addr;
+}
+
+Address SideviewEnemies::address() const {
+    return rom_->mapper()->ReadAddr(pointer(), 0);
+}
+
+void SideviewEnemies::ReadEnemyList() {
+    Address addr = address();
+    uint16_t delta = kRomOffset;
+
+    bytes_.clear();
+    int lists = is_encounter_ ? 2 : 1;
+    for(int j=0; j<lists; j++) {
+        uint8_t length = rom_->mapper()->Read(addr, delta);
+        for(int i=0; i<length; ++i) {
+            bytes_.push_back(rom_->mapper()->Read(addr, delta + i));
+        }
+        delta += length;
+    }
+}
+
+void SideviewEnemies::Parse(const Map& map) {
+    map_ = map;
+
+    // Check if this is an overworld random encounter area
+    EnemyListPack pack(rom_);
+    pack.Unpack(map_.pointer().bank());
+    is_encounter_ = pack.IsEncounter(map_.area());
+    ReadEnemyList();
+    Parse();
+}
+
+void SideviewEnemies::Parse(const std::vector<uint8_t>& bytes) {
+    bytes_ = bytes;
+    Parse();
+}
+
+void SideviewEnemies::Parse() {
+    data_.clear();
+
+    size_t delta = 0;
+    if (is_large_ && !bytes_.empty()) {
+        delta = bytes_[0];
+    }
+    size_t length = delta < bytes_.size() ? bytes_[delta] : 0;
+    for(size_t i = 1; i + 1 < length && delta + i + 1 < bytes_.size();
+        i += 2) {
+        uint8_t pos = bytes_[delta + i];
+        uint8_t enemy = bytes_[delta + i + 1];
+        int y = pos >> 4;
+        y = (y == 0) ? 1 : y + 2;
+        data_.emplace_back(enemy & 0x3f,
+            (pos & 0xf) | (enemy & 0xc0) >> 2, y);
+
+        if (load_text_) {
+            LoadText(&data_.back());
+        }
+    }
+
+    // Encounters have 2 enemy lists; the large encounter's list follows
+    // the small one.
+    large_.reset(nullptr);
+    if (is_encounter_ && !is_large_) {
+        large_.reset(new SideviewEnemies(rom_));
+        large_->map_ = map_;
+        large_->is_large_ = true;
+        large_->is_encounter_ = true;
+        large_->load_text_ = load_text_;
+        large_->bytes_ = bytes_;
+        large_->Parse();
+    }
+}
+
+std::vector<uint8_t> SideviewEnemies::Pack() const {
+    std::vector<uint8_t> packed;
+
+    uint8_t n = 1 + data_.size() * 2;
+    packed.push_back(n);
+    for(const auto& data : data_) {
+        int y = data.y;
+        y = (y <= 1) ? 0 : y-2;
+        uint8_t pos = (y << 4) | (data.x & 0x0F);
+        uint8_t enemy = (data.enemy & 0x3f) | (data.x & 0x30) << 2;
+        packed.push_back(pos);
+        packed.push_back(enemy);
+    }
+    return packed;
+}
+
+bool SideviewEnemies::Save() {
+    EnemyListPack ep(rom_);
+    ep.Unpack(map_.pointer().bank());
+    auto data = Pack();
+    if (large_) {
+        auto more = large_->Pack();
+        data.insert(data.end(), more.begin(), more.end());
+    }
+    ep.Add(map_.area() + 63 * map_.subworld(), data);
+    bool ok = ep.Pack();
+
+    if (map_.type() == MapType::TOWN) {
+        const auto& tt = ConfigLoader<RomInfo>::GetConfig().text_table();
+        const auto& ie = ConfigLoader<RomInfo>::GetConfig().item_effects();
+        for(const auto& data : data_) {
+            if (data.enemy < 10)
+                continue;
+
+            int townsperson = data.enemy - 10;
+            int town = map_.code();
+            int idxtbl = (town >> 2) * 2;
+            int index = townsperson * 4 + (town & 3);
+            for(int j=0; j<2; j++, idxtbl++) {
+                if (index < tt.index(idxtbl).length()) {
+                    if (data.text[j] < 0) {
+                        LOGF(ERROR, "No text for EnemyID $%02x. Skipping.", data.enemy);
+                    } else {
+                        rom_->mapper()->WriteLegit(tt.index(idxtbl), index, data.text[j]);
+                    }
+                }
+            }
+            if (data.text[2] != -1) {
+                // Wise man (wizard or knight) has a third dialog: "Go now..."
+                // Encoded under townsperson 15 dialog 2.
+                index = 15 * 4 + (town & 3);
+                idxtbl = (town >> 2) * 2 + 1;
+                rom_->mapper()->WriteLegit(tt.index(idxtbl), index, data.text[2]);
+            }
+            if (townsperson >= 9 && townsperson < 9+4) {
+                rom_->mapper()->WriteLegit(ie.conditions_table(), (townsperson-9)*8 + town,
+                        data.condition);
+            }
+        }
+    }
+    Parse(map_);
+    return ok;
+}
+
+}  // namespace z2util
@@ -0,0 +1,215 @@
+#ifndef Z2UTIL_NES_SIDEVIEW_H
+#define Z2UTIL_NES_SIDEVIEW_H
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "nes/mapper.h"
+#include "nes/rom_context.h"
+#include "proto/rominfo.pb.h"
+#include "util/status.h"
+
+namespace z2util {
+
+// One object in a sideview's command list.  absx is the x coordinate in
+// the whole map; relx is relative to the previous command, which is what
+// gets stored in the ROM.
+class SideviewCommand {
+  public:
+    SideviewCommand(uint8_t position, uint8_t object, uint8_t extra);
+    SideviewCommand(int x0, uint8_t position, uint8_t object,
+                    uint8_t extra);
+
+    // The command's bytes as stored in the ROM.
+    std::vector<uint8_t> Command() const;
+
+    inline int absx() const { return absx_; }
+    inline int absy() const { return y_; }
+    inline int relx() const { return x_; }
+    inline void set_relx(int x) { x_ = x; }
+    inline uint8_t object() const { return object_; }
+    inline void set_object(uint8_t o) { object_ = o; }
+    inline uint8_t extra() const { return extra_; }
+    inline void set_extra(uint8_t e) { extra_ = e; }
+
+    // For the editor widgets, which edit the coordinates in place.
+    inline int* mutable_absx() { return &absx_; }
+    inline int* mutable_relx() { return &x_; }
+    inline int* mutable_absy() { return &y_; }
+  private:
+    int absx_;
+    int x_, y_;
+    uint8_t object_;
+    uint8_t extra_;
+};
+
+// Reads, edits and writes back the sideview (object list) of one area.
+// Nothing here touches the UI, so it is usable from the batch tool.
+class Sideview {
+  public:
+    struct Unpacked {
+        int objset;
+        int width;
+        bool grass;
+        bool bushes;
+        bool ceiling;
+        int ground;
+        int floor;
+        int spal;
+        int bpal;
+        int bmap;
+    };
+
+    Sideview() : Sideview(nullptr) {}
+    explicit Sideview(RomContext* rom);
+    inline void set_rom(RomContext* rom) { rom_ = rom; }
+
+    // Read the sideview of map from the ROM.  If altaddr is given, the
+    // sideview is read from there rather than from the map's pointer.
+    void Parse(const Map& map, uint16_t altaddr=0);
+    // Replace the sideview with bytes, which are in the ROM's format.
+    void Parse(const std::vector<uint8_t>& bytes);
+    // Re-parse the bytes last read or given to Parse.
+    void Parse();
+
+    // The sideview in the ROM's format, with the commands in list order.
+    std::vector<uint8_t> MapData();
+    // The sideview in the ROM's format, with the commands sorted by
+    // absolute x position and the x-skip commands recomputed.
+    std::vector<uint8_t> MapDataAbs();
+    // The other maps whose pointers point at this map's data.
+    std::vector<const Map*> SharedWith() const;
+    // The name of cmd's object or collectable, or the kind of
+    // meta-command.
+    const char* ObjectName(const SideviewCommand& cmd) const;
+    // Write the sideview back to the ROM, moving it if it has grown or is
+    // shared with other maps.  If clone is set, the maps sharing the data
+    // are pointed at the new data too.
+    util::Status Save(bool clone);
+
+    void Unpack();
+    void Pack();
+    void Clear(const Unpacked& data) {
+        command_.clear();
+        data_ = data;
+        cursor_moves_left_ = false;
+    }
+    void Append(const SideviewCommand& cmd);
+    void Extend(const std::vector<SideviewCommand>& cmds);
+    inline std::vector<SideviewCommand>* mutable_command() {
+        return &command_;
+    }
+    inline const std::vector<SideviewCommand>& command() const {
+        return command_;
+    }
+    inline Unpacked* mutable_data() { return &data_; }
+
+    inline uint8_t length() const { return length_; }
+    inline uint8_t flags() const { return flags_; };
+    inline uint8_t ground() const { return ground_; };
+    inline uint8_t back() const { return back_; };
+
+    inline void set_objset(int val) { data_.objset = val; }
+    inline void set_width(int val) { data_.width = val; }
+    inline void set_grass(bool val) { data_.grass = val; }
+    inline void set_bushes(bool val) { data_.bushes = val; }
+    inline void set_ceiling(bool val) { data_.ceiling = val; }
+    inline void set_ground(int val) { data_.ground = val; }
+    inline void set_floor(int val) { data_.floor = val; }
+    inline void set_spal(int val) { data_.spal = val; }
+    inline void set_bpal(int val) { data_.bpal = val; }
+    inline void set_bmap(int val) { data_.bmap = val; }
+
+    inline const Map& map() const { return map_; }
+    inline int bank() const { return map_bank_; }
+    inline uint16_t address() const { return map_addr_; }
+    inline void set_address(uint16_t addr) { map_addr_ = addr; }
+    inline const std::vector<uint8_t>& bytes() const { return bytes_; }
+    inline bool cursor_moves_left() const { return cursor_moves_left_; }
+    inline void set_cursor_moves_left(bool v) { cursor_moves_left_ = v; }
+
+  private:
+    std::vector<uint8_t> MapDataWorker(
+        const std::vector<SideviewCommand>& list);
+
+    RomContext* rom_;
+    Map map_;
+    uint16_t map_addr_;
+    uint16_t map_bank_;
+    std::vector<uint8_t> bytes_;
+    uint8_t length_;
+    uint8_t flags_;
+    uint8_t ground_;
+    uint8_t back_;
+    bool cursor_moves_left_;
+    std::vector<SideviewCommand> command_;
+    Unpacked data_;
+};
+
+// Reads, edits and writes back the enemy list of one area.  Overworld
+// encounter areas have a second list for the large encounter, which is
+// kept in large().
+class SideviewEnemies {
+  public:
+    struct Unpacked {
+        Unpacked(int e_, int x_, int y_)
+            : enemy(e_), x(x_), y(y_), text{-1, -1, -1}, condition{0} {}
+        int enemy;
+        int x, y;
+        int text[3];
+        int condition;
+    };
+
+    SideviewEnemies() : SideviewEnemies(nullptr) {}
+    explicit SideviewEnemies(RomContext* rom);
+    inline void set_rom(RomContext* rom) { rom_ = rom; }
+    // Whether Parse reads the townspeople's text indices.  On by default.
+    inline void set_load_text(bool v) { load_text_ = v; }
+
+    // Read the enemy list(s) of map from the ROM.
+    void Parse(const Map& map);
+    // Replace the lists with bytes, which are in the ROM's format: the
+    // length-prefixed list, followed by the large encounter list in
+    // encounter areas.
+    void Parse(const std::vector<uint8_t>& bytes);
+    // Re-parse the bytes last read or given to Parse.
+    void Parse();
+    // This list (not including the large encounter list) in the ROM's
+    // format.
+    std::vector<uint8_t> Pack() const;
+    // Write the lists back to the ROM, repacking all of the enemy lists
+    // in the bank.  In towns, also writes the townspeople's text indices.
+    // Returns false if the bank's enemy lists don't fit.
+    bool Save();
+    // Read the text indices and condition of a townsperson.
+    void LoadText(Unpacked* item);
+
+    // Where the map's enemy list pointer is, and the list's RAM address
+    // which it holds.  The ROM copy of the list is kRomOffset bytes above
+    // its RAM address.
+    Address pointer() const;
+    Address address() const;
+    static const uint16_t kRomOffset = 0x18a0;
+
+    inline const Map& map() const { return map_; }
+    inline bool is_encounter() const { return is_encounter_; }
+    inline const std::vector<uint8_t>& bytes() const { return bytes_; }
+    inline const std::vector<Unpacked>& data() const { return data_; }
+    inline std::vector<Unpacked>* mutable_data() { return &data_; }
+    inline SideviewEnemies* large() { return large_.get(); }
+
+  private:
+    void ReadEnemyList();
+
+    RomContext* rom_;
+    Map map_;
+    bool is_large_;
+    bool is_encounter_;
+    bool load_text_;
+    std::vector<uint8_t> bytes_;
+    std::vector<Unpacked> data_;
+    std::unique_ptr<SideviewEnemies> large_;
+};
+
+}  // namespace z2util
+#endif // Z2UTIL_NES_SIDEVIEW_H
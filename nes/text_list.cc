@@ -1,6 +1,7 @@
 #include "nes/text_list.h"
 
 #include "nes/mapper.h"
+#include "nes/rom_context.h"
 #include "nes/text_encoding.h"
 #include "proto/rominfo.pb.h"
 #include "util/config.h"
@@ -12,7 +13,7 @@ std::string TextListPack::ReadNesString(const Address& addr) {
     int ch;
     std::string result;
     for(int i=0; ;i++) {
-        ch = mapper_->Read(addr, i);
+        ch = rom_->mapper()->Read(addr, i);
         if (ch == 0xFF)
             break;
         result.push_back(TextEncoding::FromZelda2(ch));
@@ -24,9 +25,9 @@ std::string TextListPack::ReadNesString(const Address& addr) {
 void TextListPack::WriteNesString(const Address& addr, const std::string& val) {
     unsigned i;
     for(i=0; i<val.size(); i++) {
-        mapper_->Write(addr, i, TextEncoding::ToZelda2(val[i]));
+        rom_->mapper()->Write(addr, i, TextEncoding::ToZelda2(val[i]));
     }
-    mapper_->Write(addr, i, 0xFF);
+    rom_->mapper()->Write(addr, i, 0xFF);
 }
 
 void TextListPack::ReadOne(int world, int index, Address addr) {
@@ -48,10 +49,10 @@ void TextListPack::Unpack(int bank) {
     index_.resize(tt.length_size());
     int world = 0;
     for(const auto len : tt.length()) {
-        Address table = mapper_->ReadAddr(tt.pointer(), world*2);
+        Address table = rom_->mapper()->ReadAddr(tt.pointer(), world*2);
         index_[world].resize(len, 0);
         for(int i=0; i<len; ++i) {
-            Address addr = mapper_->ReadAddr(table, i*2);
+            Address addr = rom_->mapper()->ReadAddr(table, i*2);
             ReadOne(world, i, addr);
         }
         ++world;
@@ -68,7 +69,7 @@ void TextListPack::CheckIndex() {
         for(int i=0; i < i0.length(); ++i) {
             Address a;
             a.set_bank(i0.bank()); a.set_address(i0.address());
-            int value = mapper_->Read(a, i);
+            int value = rom_->mapper()->Read(a, i);
             if (value >= len) {
                 LOGF(ERROR, "Town %d: Enemy $%02x text1 index is out of bounds (%d)",
                         world*4 + i%4, 10+i/4, value);
@@ -78,7 +79,7 @@ void TextListPack::CheckIndex() {
                 continue;
 
             a.set_bank(i1.bank()); a.set_address(i1.address());
-            value = mapper_->Read(a, i);
+            value = rom_->mapper()->Read(a, i);
             if (value >= len) {
                 LOGF(ERROR, "Town %d: Enemy $%02x text2 index is out of bounds (%d)",
                         world*4 + i%4, 10+i/4, value);
@@ -136,14 +137,14 @@ bool TextListPack::Pack() {
     // Copy text pointers to ROM.
     world = 0;
     for(const auto len : tt.length()) {
-        Address table = mapper_->ReadAddr(tt.pointer(), world*2);
+        Address table = rom_->mapper()->ReadAddr(tt.pointer(), world*2);
         for(int i=0; i<len; ++i) {
             int addr = index_[world][i];
             if (addr == 0)
                 continue;
 
             List& entry = entry_[addr];
-            mapper_->WriteWord(table, i*2, entry.newaddr);
+            rom_->mapper()->WriteWord(table, i*2, entry.newaddr);
         }
         ++world;
     }
@@ -151,7 +152,7 @@ bool TextListPack::Pack() {
     // And copy the text to the ROM.
     packed.resize(tt.text_data().length(), 0);
     for(size_t i=0; i<packed.size(); i++) {
-        mapper_->Write(tt.text_data(), i, packed[i]);
+        rom_->mapper()->Write(tt.text_data(), i, packed[i]);
     }
     return true;
 }
@@ -5,12 +5,12 @@
 #include <vector>
 #include "proto/rominfo.pb.h"
 
-class Mapper;
 namespace z2util {
+class RomContext;
 
 class TextListPack {
   public:
-    TextListPack(Mapper* m) : mapper_(m), newtext_(0), bank_(0) {}
+    TextListPack(RomContext* rom) : rom_(rom), newtext_(0), bank_(0) {}
     TextListPack() : TextListPack(nullptr) {}
 
     void Unpack(int bank);
@@ -21,14 +21,14 @@ class TextListPack {
     bool Set(int world, int index, const std::string& val);
     int Length(int world);
     //void Add(int index, const std::vector<uint8_t>& data);
-    inline void set_mapper(Mapper* m) { mapper_ = m; }
+    inline void set_rom(RomContext* rom) { rom_ = rom; }
   private:
     void ReadOne(int world, int index, Address addr);
     std::string ReadNesString(const Address& addr);
     void WriteNesString(const Address& addr, const std::string& val);
     void ResetAddrs();
 
-    Mapper* mapper_;
+    RomContext* rom_;
     int newtext_;
     int bank_;
 
@@ -3,33 +3,90 @@
 
 namespace z2util {
 
-void Z2Decompress::Invalid(int x, int y, uint8_t item,
-                           const DecompressInfo* info) {
-    const char *dbg = "<null>";
-    if (info)
-        dbg = info->DebugString().c_str();
-    LOG(ERROR, "Invalid item ", HEX(item), ": ", dbg);
+namespace {
+struct CustomHandler {
+    const char* name;
+    uint8_t handler;
+};
+}  // namespace
+
+Z2Decompress::Handler Z2Decompress::LookupHandler(const DecompressInfo& info) {
+    static const CustomHandler custom[] = {
+        { "RenderHorizontal",   HORIZONTAL },
+        { "RenderVertical",     VERTICAL },
+        { "RenderTopUnique",    TOP_UNIQUE },
+        { "RenderBottomUnique", BOTTOM_UNIQUE },
+        { "RenderGrid",         GRID },
+        { "RenderLava3High",    LAVA3HIGH },
+        { "RenderCactus1",      CACTUS1 },
+        { "RenderCactus2",      CACTUS2 },
+        { "RenderStonehenge",   STONEHENGE },
+        { "RenderBuilding",     BUILDING },
+        { "RenderWindow",       WINDOW },
+        { "RenderItem",         ITEM },
+        { "Invalid",            INVALID },
+    };
+
+    switch(info.render()) {
+        case DecompressInfo::RENDER_HORIZONTAL: return HORIZONTAL;
+        case DecompressInfo::RENDER_VERTICAL: return VERTICAL;
+        case DecompressInfo::RENDER_TOP_UNIQUE: return TOP_UNIQUE;
+        case DecompressInfo::RENDER_BOTTOM_UNIQUE: return BOTTOM_UNIQUE;
+        case DecompressInfo::RENDER_CUSTOM:
+            for(const auto& c : custom) {
+                if (info.custom() == c.name) {
+                    return Handler(c.handler);
+                }
+            }
+            LOG(ERROR, "Couldn't find renderer '", info.custom(), "': ",
+                       info.DebugString());
+            return INVALID;
+        default:
+            LOG(ERROR, "Couldn't find renderer ", info.render());
+            return INVALID;
+    }
+}
+
+void Z2Decompress::Put(int x, int y, uint8_t item, const Op& op) {
+    switch(op.handler) {
+        case HORIZONTAL:    RenderHorizontal(x, y, item, op); break;
+        case VERTICAL:      RenderVertical(x, y, item, op); break;
+        case TOP_UNIQUE:    RenderTopUnique(x, y, item, op); break;
+        case BOTTOM_UNIQUE: RenderBottomUnique(x, y, item, op); break;
+        case GRID:          RenderGrid(x, y, item, op); break;
+        case LAVA3HIGH:     RenderLava3High(x, y, item, op); break;
+        case CACTUS1:       RenderCactus1(x, y, item, op); break;
+        case CACTUS2:       RenderCactus2(x, y, item, op); break;
+        case STONEHENGE:    RenderStonehenge(x, y, item, op); break;
+        case BUILDING:      RenderBuilding(x, y, item, op); break;
+        case WINDOW:        RenderWindow(x, y, item, op); break;
+        case ITEM:          RenderItem(x, y, item, op); break;
+        case INVALID:
+        default:            Invalid(x, y, item, op); break;
+    }
+}
+
+void Z2Decompress::Invalid(int x, int y, uint8_t item, const Op& op) {
+    LOG(ERROR, "Invalid item ", HEX(item), ": ",
+               op.info ? op.info->DebugString() : "<null>");
 }
 
-void Z2Decompress::NotYet(int x, int y, uint8_t item,
-                          const DecompressInfo* info) {
-    const char *dbg = "<null>";
-    if (info)
-        dbg = info->DebugString().c_str();
-    LOG(WARN, "Item ", HEX(item), " not implemented yet:", dbg);
+void Z2Decompress::NotYet(int x, int y, uint8_t item, const Op& op) {
+    LOG(WARN, "Item ", HEX(item), " not implemented yet:",
+              op.info ? op.info->DebugString() : "<null>");
 }
 
 // Render an 'item & 15' horizontal stripe of a 'height' tall object
 void Z2Decompress::RenderHorizontal(int x, int y, uint8_t item,
-                                    const DecompressInfo* info) {
-    int width = info->width() ? info->width() : (item & 0xF) + 1;
-    int height = info->height() ? info->height() : 1;
-    int n = info->objid_size();
-    if (info->fixed_y()) y = info->fixed_y();
+                                    const Op& op) {
+    int width = op.width ? op.width : (item & 0xF) + 1;
+    int height = op.height ? op.height : 1;
+    int n = op.nobj;
+    if (op.fixed_y) y = op.fixed_y;
     for(int yy=0; yy<height; yy++) {
         for(int xx=0; xx<width; xx++) {
             if (y + yy < height_) {
-                set_map(x+xx, y+yy, info->objid(yy % n));
+                set_map(x+xx, y+yy, op.objid[yy % n]);
             }
         }
     }
@@ -37,19 +94,18 @@ void Z2Decompress::RenderHorizontal(int x, int y, uint8_t item,
 
 // Render an 'item & 15' horizontal stripe of a building-type object
 void Z2Decompress::RenderBuilding(int x, int y, uint8_t item,
-                                 const DecompressInfo* info) {
-    int width = info->width() ? info->width() : (item & 0xF) + 1;
-    int height = info->height() ? info->height() : 13;
-    int n = info->objid_size();
-    if (n != 2) {
-        LOG(ERROR, "Expecting exactly 2 objids in: ", info->DebugString());
+                                 const Op& op) {
+    int width = op.width ? op.width : (item & 0xF) + 1;
+    int height = op.height ? op.height : 13;
+    if (op.nobj != 2) {
+        LOG(ERROR, "Expecting exactly 2 objids in: ", op.info->DebugString());
         return;
     }
-    if (info->fixed_y()) y = info->fixed_y();
+    if (op.fixed_y) y = op.fixed_y;
     for(int yy=0; yy<height; yy++) {
         for(int xx=0; xx<width; xx++) {
             // FIXME(cfrantz): compute the real floor value
-            int objid = (xx < width-1) ? info->objid(0) : info->objid(1);
+            int objid = (xx < width-1) ? op.objid[0] : op.objid[1];
             if (objid && y + yy < 11) {
                 set_map(x+xx, y+yy, objid);
             }
@@ -59,15 +115,15 @@ void Z2Decompress::RenderBuilding(int x, int y, uint8_t item,
 
 // Render an 'item & 15' vertical stripe of a 'width' wide object
 void Z2Decompress::RenderVertical(int x, int y, uint8_t item,
-                                  const DecompressInfo* info) {
-    int width = info->width() ? info->width() : 1;
-    int height = info->height() ? info->height() : (item & 0xF) + 1;
-    int n = info->objid_size();
-    if (info->fixed_y()) y = info->fixed_y();
+                                  const Op& op) {
+    int width = op.width ? op.width : 1;
+    int height = op.height ? op.height : (item & 0xF) + 1;
+    int n = op.nobj;
+    if (op.fixed_y) y = op.fixed_y;
     for(int yy=0; yy<height; yy++) {
         for(int xx=0; xx<width; xx++) {
             if (y+yy < height_) {
-                set_map(x+xx, y+yy, info->objid(xx % n));
+                set_map(x+xx, y+yy, op.objid[xx % n]);
             }
         }
     }
@@ -75,13 +131,13 @@ void Z2Decompress::RenderVertical(int x, int y, uint8_t item,
 
 // Render an 'item & 15' vertical repeats of a house window
 void Z2Decompress::RenderWindow(int x, int y, uint8_t item,
-                                const DecompressInfo* info) {
-    int height = info->height() ? info->height() : (item & 0xF) + 1;
-    int n = info->objid_size();
-    if (info->fixed_y()) y = info->fixed_y();
+                                const Op& op) {
+    int height = op.height ? op.height : (item & 0xF) + 1;
+    int n = op.nobj;
+    if (op.fixed_y) y = op.fixed_y;
     height *= n;
     for(int yy=0; yy<height; yy++) {
-        int objid = info->objid(yy % n);
+        int objid = op.objid[yy % n];
         // Windows should stop repeating at tile height 10.
         if (objid && y+yy < 10) {
             set_map(x, y+yy, objid);
@@ -91,16 +147,16 @@ void Z2Decompress::RenderWindow(int x, int y, uint8_t item,
 
 // Render an 'item & 15' tall object with a unique top piece 
 void Z2Decompress::RenderTopUnique(int x, int y, uint8_t item,
-                                  const DecompressInfo* info) {
-    int width = info->width() ? info->width() : 1;
-    int height = info->height() ? info->height() : (item & 0xF) + 1;
-    if (info->fixed_y()) y = info->fixed_y();
+                                  const Op& op) {
+    int width = op.width ? op.width : 1;
+    int height = op.height ? op.height : (item & 0xF) + 1;
+    if (op.fixed_y) y = op.fixed_y;
     for(int yy=0; yy<height; yy++) {
         for(int xx=0; xx<width; xx++) {
             if (yy == 0) {
-                set_map(x+xx, y+yy, info->objid(0));
+                set_map(x+xx, y+yy, op.objid[0]);
             } else if (y+yy < height_) {
-                set_map(x+xx, y+yy, info->objid(1));
+                set_map(x+xx, y+yy, op.objid[1]);
             }
         }
     }
@@ -108,38 +164,38 @@ void Z2Decompress::RenderTopUnique(int x, int y, uint8_t item,
 
 // Render an 'item & 15' tall object with a unique bottom piece 
 void Z2Decompress::RenderBottomUnique(int x, int y, uint8_t item,
-                                      const DecompressInfo* info) {
-    int width = info->width() ? info->width() : 1;
-    int height = info->height() ? info->height() : (item & 0xF) + 1;
-    if (info->fixed_y()) y = info->fixed_y();
+                                      const Op& op) {
+    int width = op.width ? op.width : 1;
+    int height = op.height ? op.height : (item & 0xF) + 1;
+    if (op.fixed_y) y = op.fixed_y;
     for(int yy=0; yy<height; yy++) {
         for(int xx=0; xx<width; xx++) {
             if (yy == height-1) {
-                set_map(x+xx, y+yy, info->objid(1));
+                set_map(x+xx, y+yy, op.objid[1]);
             } else if (y+yy < height_) {
-                set_map(x+xx, y+yy, info->objid(0));
+                set_map(x+xx, y+yy, op.objid[0]);
             }
         }
     }
 }
 
 void Z2Decompress::RenderGrid(int x, int y, uint8_t item,
-                              const DecompressInfo* info) {
-    int width = info->width();
-    int height = info->height();
+                              const Op& op) {
+    int width = op.width;
+    int height = op.height;
     int n = 0;
-    if (info->fixed_y()) y = info->fixed_y();
+    if (op.fixed_y) y = op.fixed_y;
     for(int yy=0; yy<height; yy++) {
         for(int xx=0; xx<width; xx++, n++) {
-            if (y+yy < height_ && info->objid(n) != 0) {
-                set_map(x+xx, y+yy, info->objid(n));
+            if (y+yy < height_ && op.objid[n] != 0) {
+                set_map(x+xx, y+yy, op.objid[n]);
             }
         }
     }
 }
 
 void Z2Decompress::RenderStonehenge(int x, int y, uint8_t item,
-                                    const DecompressInfo* info) {
+                                    const Op& op) {
     set_map(x+0, y+0, 0x56);
     set_map(x+1, y+0, 0x57);
     set_map(x+2, y+0, 0x57);
@@ -152,45 +208,29 @@ void Z2Decompress::RenderStonehenge(int x, int y, uint8_t item,
 }
 
 void Z2Decompress::RenderLava3High(int x, int y, uint8_t item,
-                                   const DecompressInfo* info) {
-    DecompressInfo i = *info;
-    i.set_width((item & 0xF) + 1);
-    RenderTopUnique(x, i.fixed_y(), item, &i);
+                                   const Op& op) {
+    Op o = op;
+    o.width = (item & 0xF) + 1;
+    RenderTopUnique(x, o.fixed_y, item, o);
 }
 
 void Z2Decompress::RenderCactus1(int x, int y, uint8_t item,
-                                 const DecompressInfo* info) {
+                                 const Op& op) {
     int height = (item & 0xF) + 1;
-    RenderTopUnique(x, 10-height, item, info);
+    RenderTopUnique(x, 10-height, item, op);
 }
 
 void Z2Decompress::RenderCactus2(int x, int y, uint8_t item,
-                                 const DecompressInfo* info) {
-    RenderTopUnique(x, 8, item, info);
+                                 const Op& op) {
+    RenderTopUnique(x, 8, item, op);
 }
 
 void Z2Decompress::RenderItem(int x, int y, uint8_t item,
-                              const DecompressInfo* info) {
-    if (info->fixed_y()) y = info->fixed_y();
+                              const Op& op) {
+    if (op.fixed_y) y = op.fixed_y;
     if (x >= 0 && y >= 0 && x < width_ && y < height_) {
-        items_[y][x] = info->objid(0);
+        items_[y][x] = op.objid[0];
     }
 }
 
-std::map<std::string, Z2Decompress::PutFn> Z2Decompress::put_ = {
-    { "RenderHorizontal",   &Z2Decompress::RenderHorizontal },
-    { "RenderVertical",     &Z2Decompress::RenderVertical },
-    { "RenderTopUnique",    &Z2Decompress::RenderTopUnique },
-    { "RenderBottomUnique", &Z2Decompress::RenderBottomUnique },
-    { "RenderGrid",         &Z2Decompress::RenderGrid },
-    { "RenderLava3High",    &Z2Decompress::RenderLava3High },
-    { "RenderCactus1",      &Z2Decompress::RenderCactus1 },
-    { "RenderCactus2",      &Z2Decompress::RenderCactus2 },
-    { "RenderStonehenge",   &Z2Decompress::RenderStonehenge },
-    { "RenderBuilding",     &Z2Decompress::RenderBuilding },
-    { "RenderWindow",       &Z2Decompress::RenderWindow },
-    { "RenderItem",         &Z2Decompress::RenderItem },
-    { "Invalid",            &Z2Decompress::Invalid },
-};
-
 }  // namespace z2util
@@ -1,4 +1,5 @@
 #include "nes/z2decompress.h"
+#include <mutex>
 #include <gflags/gflags.h>
 
 #include "util/logging.h"
@@ -19,29 +20,128 @@ DECLARE_bool(hackjam2020);
 
 namespace z2util {
 
-Z2Decompress::Z2Decompress() {}
+namespace {
+// Layer buffers of destroyed decompressors.  Decompressors come and go
+// (one per area rendered), so this saves allocating and growing a new
+// buffer for each one.
+class LayerPool {
+  public:
+    static LayerPool* Get() {
+        static LayerPool pool;
+        return &pool;
+    }
+    std::vector<uint8_t> Take() {
+        std::lock_guard<std::mutex> lock(mu_);
+        std::vector<uint8_t> buf;
+        if (!free_.empty()) {
+            buf.swap(free_.back());
+            free_.pop_back();
+        }
+        return buf;
+    }
+    void Give(std::vector<uint8_t>* buf) {
+        std::lock_guard<std::mutex> lock(mu_);
+        if (buf->capacity() && free_.size() < kMaxFree) {
+            free_.emplace_back();
+            free_.back().swap(*buf);
+        }
+    }
+  private:
+    static const size_t kMaxFree = 16;
+    std::mutex mu_;
+    std::vector<std::vector<uint8_t>> free_;
+};
+}  // namespace
+
+Z2Decompress::Z2Decompress()
+  : width_(64),
+    mapwidth_(64),
+    height_(13),
+    layers_(LayerPool::Get()->Take()),
+    nlayers_(0),
+    layer_(0) {
+    Layer(0);
+}
+
+Z2Decompress::~Z2Decompress() {
+    LayerPool::Get()->Give(&layers_);
+}
 
 void Z2Decompress::Init() {
-    const auto& ri = ConfigLoader<RomInfo>::GetConfig();
-    memset(info_, 0, sizeof(info_));
+    ops_ = GetOpTable();
     layer_ = 0;
+}
+
+std::shared_ptr<const Z2Decompress::OpTable> Z2Decompress::GetOpTable() {
+    static std::mutex mu;
+    static std::shared_ptr<const OpTable> table;
+    int generation = ConfigLoader<RomInfo>::Generation();
+    std::lock_guard<std::mutex> lock(mu);
+    if (table && table->generation == generation) {
+        return table;
+    }
+
+    const auto& ri = ConfigLoader<RomInfo>::GetConfig();
+    auto t = std::make_shared<OpTable>();
+    memset(t.get(), 0, sizeof(OpTable));
+    t->generation = generation;
     for(const auto& d : ri.decompress()) {
         int id = d.id();
         if (id & 0xF0) {
             id >>= 4;
         }
-        info_[d.area()][d.type()][id] = &d;
+        Op* op = &t->op[d.area()][d.type()][id];
+        op->handler = LookupHandler(d);
+        op->width = d.width();
+        op->height = d.height();
+        op->fixed_y = d.fixed_y();
+        op->nobj = d.objid_size();
+        op->objid = d.objid().data();
+        op->info = &d;
+    }
+    for(const auto& bg : ri.background()) {
+        if (bg.type() < 0 || bg.type() >= NR_AREAS ||
+            bg.index() < 0 || bg.index() >= 8) {
+            continue;
+        }
+        auto& b = t->background[bg.type()][bg.index()];
+        // The first match wins, as it did when this was a linear search.
+        if (!b) b = &bg;
     }
+    table = t;
+    return table;
 }
 
 void Z2Decompress::Clear() {
     layer_ = 0;
     cursor_moves_left_ = false;
-    memset(map_, 0, sizeof(map_));
+    nlayers_ = 0;
+    Layer(0);
     memset(items_, 0xFF, sizeof(items_));
 }
 
+void Z2Decompress::Resize(int width, int height) {
+    if (width != width_ || height != height_) {
+        width_ = width;
+        height_ = height;
+        nlayers_ = 0;
+    }
+}
+
+uint8_t* Z2Decompress::Layer(int n) {
+    size_t size = width_ * height_;
+    if (n >= nlayers_) {
+        if (layers_.size() < (n + 1) * size) {
+            layers_.resize((n + 1) * size);
+        }
+        memset(&layers_[nlayers_ * size], 0, (n + 1 - nlayers_) * size);
+        nlayers_ = n + 1;
+    }
+    return &layers_[n * size];
+}
+
 void Z2Decompress::Decompress(const Map& map) {
+    if (!ops_) Init();
     compressed_map_ = map;
     Address p = map.pointer();
 
@@ -67,30 +167,37 @@ void Z2Decompress::Decompress(const Map& map) {
 
 void Z2Decompress::DecompressOverWorld(const Map& map) {
     const auto& misc = ConfigLoader<RomInfo>::GetConfig().misc();
-    uint8_t *mm = (uint8_t*)map_;
     // FIXME: how to determine the map length instead of specifying manually
     LOG(INFO, "DecompressOverWorld: bank=", map.address().bank(),
               " address=", HEX(map.address().address()),
               " length=", map.length());
 
-    width_ = misc.overworld_width();
-    if (width_ != 64) {
+    int width = misc.overworld_width();
+    if (width != 64) {
         LOG(FATAL, "Overworld width must be 64.");
     }
-    height_ = misc.overworld_height();
-    if (FLAGS_max_map_height) height_ = FLAGS_max_map_height;
+    int height = misc.overworld_height();
+    if (FLAGS_max_map_height) height = FLAGS_max_map_height;
+    Resize(width, height);
+    mapwidth_ = width;
+    uint8_t *mm = Layer(0);
+    uint8_t *end = mm + width_ * height_;
+    // The compressed map can't be longer than the rest of its bank.
+    auto data = mapper_->PrgSpan(map.address(), 0, 0x4000);
     int i = 0;
-    for(int n=0; n < width_ * height_; i++) {
-        uint8_t val = Read(map.address(), i);
+    for(int n=0; n < width_ * height_ && i < int(data.size()); i++) {
+        uint8_t val = data[i];
         //val = FLAGS_convert_unprogrammed_overworld_tiles;
         uint8_t type = val & 0x0f;
         uint8_t len = (val >> 4) + 1;
         if (FLAGS_hackjam2020 && type == 0x0F && len > 1) {
             // Handle expansion tiles.
             len--;
-            type = Read(map.address(), ++i);
+            if (++i >= int(data.size()))
+                break;
+            type = data[i];
         }
-        for(int j=0; j<len; j++) {
+        for(int j=0; j<len && mm < end; j++) {
             *mm++ = type;
             n++;
         }
@@ -116,16 +223,14 @@ const ItemInfo& Z2Decompress::EnemyInfo() {
 }
 
 const BackgroundInfo& Z2Decompress::GetBackgroundInfo() {
-    const auto& ri = ConfigLoader<RomInfo>::GetConfig();
     int n = (ground_ >> 4) & 0x7;
-    for (const auto& bg : ri.background()) {
-        if (n == bg.index() && compressed_map_.type() == bg.type()) {
-            return bg;
-        }
+    const BackgroundInfo* bg = ops_->background[compressed_map_.type()][n];
+    if (bg) {
+        return *bg;
     }
     LOG(ERROR, "Could not find background info for type=",
             compressed_map_.type(), " index=", n);
-    return ri.background(0);
+    return ConfigLoader<RomInfo>::GetConfig().background(0);
 }
 
 
@@ -197,26 +302,26 @@ Address Z2Decompress::palette() {
 void Z2Decompress::CollapseLayers(int top_layer) {
     const auto& bg = GetBackgroundInfo();
     uint8_t bgtile = uint8_t(bg.background());
-    for(int y=0; y<height_; y++) {
-        for(int x=0; x<width_; x++) {
-            for(int t = top_layer; t>0; t--) {
-                uint8_t val = map_[t][y][x];
-                if (val && val != bgtile) {
-                    map_[0][y][x] = val;
-                    break;
-                }
+    size_t size = width_ * height_;
+    uint8_t* base = Layer(0);
+    for(size_t i=0; i<size; i++) {
+        for(int t = top_layer; t>0; t--) {
+            uint8_t val = base[t * size + i];
+            if (val && val != bgtile) {
+                base[i] = val;
+                break;
             }
         }
     }
+    // Everything is in layer 0 now.
+    nlayers_ = 1;
 }
 
 void Z2Decompress::DecompressSideView(const Address& address,
                                       const Address* foreground) {
     uint8_t len = Read(address, 0);
     uint8_t data[256];
-    for(int i=0; i<len; i++) {
-        data[i] = Read(address, i);
-    }
+    mapper_->ReadBytes(address, 0, data, len);
 
     // Get the tileset of the foreground map, but use the floor and
     // ceiling parameters in the background map.
@@ -231,6 +336,7 @@ void Z2Decompress::DecompressSideView(const uint8_t* data, bool collapse) {
     // the background correctly, but rendering a background map will
     // modify them.  Rather than design this class proerply, I'm lazy
     // and just overwrite the values again after rendering the background.
+    Resize(64, 13);
     ground_ = data[2];
     back_ = data[3];
     const auto& bg = GetBackgroundInfo();
@@ -249,8 +355,9 @@ void Z2Decompress::DecompressSideView(const uint8_t* data, bool collapse) {
         }
     } else {
         layer_ = 0;
-        memset(&map_[layer_], uint8_t(bg.background()), sizeof(map_[0]));
+        memset(Layer(0), uint8_t(bg.background()), width_ * height_);
     }
+    Layer(layer_);
 
     uint8_t len = data[0];
     length_ = len;
@@ -270,8 +377,6 @@ void Z2Decompress::DecompressSideView(const uint8_t* data, bool collapse) {
                  " BackPal=", (back_ >> 3) & 7,
                  " BackMap=", back_ & 7);
 
-    width_ = 64;
-    height_ = 13;
     mapwidth_ = (1 + ((flags_ >> 5) & 3)) * 16;
     uint8_t floor = ground_ & 0x0f;
     uint8_t ceiling = !(ground_ & 0x80);
@@ -348,38 +453,12 @@ void Z2Decompress::DecompressSideView(const uint8_t* data, bool collapse) {
                 findex = obj >> 4;
             }
 
-            std::string fn = "Invalid";
-            int type = compressed_map_.type();
-            const DecompressInfo* info = info_[type][oindex][findex];
-            if (info) {
-                switch(info->render()) {
-                    case DecompressInfo::RENDER_HORIZONTAL:
-                        fn = "RenderHorizontal"; break;
-                    case DecompressInfo::RENDER_VERTICAL:
-                        fn = "RenderVertical"; break;
-                    case DecompressInfo::RENDER_TOP_UNIQUE:
-                        fn = "RenderTopUnique"; break;
-                    case DecompressInfo::RENDER_BOTTOM_UNIQUE:
-                        fn = "RenderBottomUnique"; break;
-                    case DecompressInfo::RENDER_CUSTOM:
-                        fn = info->custom(); break;
-                    default:
-                        LOG(ERROR, "Couldn't find renderer ", info->render());
-                        ; // Do nothing
-                }
-            } else {
+            const Op& op = ops_->op[compressed_map_.type()][oindex][findex];
+            if (!op.info) {
                 LOG(ERROR, "Couldn't look up ", HEX(obj), " for o=",
                            oindex, " f=", findex, " extra=", extra);
             }
-
-            // Look up the put funtion and call it
-            PutFn put = put_[fn];
-            if (!put) {
-                LOG(ERROR, "Couldn't find PutFn for '", fn, "': ",
-                        info->DebugString());
-                put = &Z2Decompress::Invalid;
-            }
-            (this->*put)(x, y, obj, info);
+            Put(x, y, obj, op);
         }
     }
     while (x < width_) {
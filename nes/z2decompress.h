@@ -1,7 +1,9 @@
 #ifndef Z2UTIL_NES_Z2DECOMPRESS_H
 #define Z2UTIL_NES_Z2DECOMPRESS_H
 #include <map>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "proto/rominfo.pb.h"
 #include "nes/mapper.h"
@@ -11,6 +13,7 @@ namespace z2util {
 class Z2Decompress {
   public:
     Z2Decompress();
+    ~Z2Decompress();
     void Init();
 
     void Print();
@@ -19,7 +22,7 @@ class Z2Decompress {
     void set_mapper(Mapper* m) { mapper_ = m; }
 
     inline uint8_t map(int x, int y) const {
-        return map_[layer_][y][x];
+        return layers_[(layer_ * height_ + y) * width_ + x];
     }
     inline uint8_t item(int x, int y) const {
         return type() == MapType::OVERWORLD ? 0xFF: items_[y][x];
@@ -27,10 +30,12 @@ class Z2Decompress {
 
     inline void set_map(int x, int y, uint8_t val) {
         if (x >= 0 && y >= 0 && x < width_ && y < height_) {
-            map_[layer_][y][x] = val;
+            layers_[(layer_ * height_ + y) * width_ + x] = val;
         }
     }
     inline bool isbackground(int x, int y, int val) {
+        if (x < 0 || y < 0 || x >= width_ || y >= height_)
+            return false;
         return map(x, y) == 0 || map(x, y) == val;
     }
     inline MapType type() const {
@@ -59,9 +64,46 @@ class Z2Decompress {
     int width_;
     int mapwidth_;
     int height_;
-    typedef void (Z2Decompress::*PutFn)(int x, int y, uint8_t item,
-                  const DecompressInfo* info);
-
+    // How an object is drawn.  The names of the custom handlers are
+    // resolved once in Init, so decompression never looks at strings.
+    enum Handler : uint8_t {
+        INVALID,
+        HORIZONTAL,
+        VERTICAL,
+        TOP_UNIQUE,
+        BOTTOM_UNIQUE,
+        GRID,
+        LAVA3HIGH,
+        CACTUS1,
+        CACTUS2,
+        STONEHENGE,
+        BUILDING,
+        WINDOW,
+        ITEM,
+    };
+    // An entry in the object table: a DecompressInfo flattened into the
+    // values the handlers need.
+    struct Op {
+        Handler handler;
+        int width;
+        int height;
+        int fixed_y;
+        int nobj;
+        const int32_t* objid;
+        const DecompressInfo* info;
+    };
+    // The object and background tables for one config generation, shared
+    // by all instances and rebuilt by Init when the config is reloaded.
+    struct OpTable {
+        int generation;
+        Op op[NR_AREAS][NR_SETS][16];
+        const BackgroundInfo* background[NR_AREAS][8];
+    };
+    static std::shared_ptr<const OpTable> GetOpTable();
+    static Handler LookupHandler(const DecompressInfo& info);
+
+    void Resize(int width, int height);
+    uint8_t* Layer(int n);
     void DecompressOverWorld(const Map& map);
     void DecompressSideView(const Address& address, const Address* foreground);
     void CollapseLayers(int top_layer);
@@ -69,38 +111,27 @@ class Z2Decompress {
 
     void DrawFloor(int x, uint8_t floor, uint8_t ceiling);
 
-    void Invalid(int x, int y, uint8_t item,
-                 const DecompressInfo* info);
-    void NotYet(int x, int y, uint8_t item,
-                const DecompressInfo* info);
-    void RenderHorizontal(int x, int y, uint8_t item,
-                          const DecompressInfo* info);
-    void RenderVertical(int x, int y, uint8_t item,
-                        const DecompressInfo* info);
-    void RenderTopUnique(int x, int y, uint8_t item,
-                         const DecompressInfo* info);
-    void RenderBottomUnique(int x, int y, uint8_t item,
-                            const DecompressInfo* info);
-    void RenderGrid(int x, int y, uint8_t item,
-                    const DecompressInfo* info);
-    void RenderLava3High(int x, int y, uint8_t item,
-                         const DecompressInfo* info);
-    void RenderCactus1(int x, int y, uint8_t item,
-                       const DecompressInfo* info);
-    void RenderCactus2(int x, int y, uint8_t item,
-                       const DecompressInfo* info);
-    void RenderStonehenge(int x, int y, uint8_t item,
-                          const DecompressInfo* info);
-    void RenderBuilding(int x, int y, uint8_t item,
-                        const DecompressInfo* info);
-    void RenderWindow(int x, int y, uint8_t item,
-                      const DecompressInfo* info);
-    void RenderItem(int x, int y, uint8_t item,
-                    const DecompressInfo* info);
-
+    void Put(int x, int y, uint8_t item, const Op& op);
+    void Invalid(int x, int y, uint8_t item, const Op& op);
+    void NotYet(int x, int y, uint8_t item, const Op& op);
+    void RenderHorizontal(int x, int y, uint8_t item, const Op& op);
+    void RenderVertical(int x, int y, uint8_t item, const Op& op);
+    void RenderTopUnique(int x, int y, uint8_t item, const Op& op);
+    void RenderBottomUnique(int x, int y, uint8_t item, const Op& op);
+    void RenderGrid(int x, int y, uint8_t item, const Op& op);
+    void RenderLava3High(int x, int y, uint8_t item, const Op& op);
+    void RenderCactus1(int x, int y, uint8_t item, const Op& op);
+    void RenderCactus2(int x, int y, uint8_t item, const Op& op);
+    void RenderStonehenge(int x, int y, uint8_t item, const Op& op);
+    void RenderBuilding(int x, int y, uint8_t item, const Op& op);
+    void RenderWindow(int x, int y, uint8_t item, const Op& op);
+    void RenderItem(int x, int y, uint8_t item, const Op& op);
 
     Mapper* mapper_;
-    uint8_t map_[8][128][64];
+    // The decompressed layers, each width_ x height_.  Only the first
+    // nlayers_ are live; the rest of the buffer is zeroed as it's needed.
+    std::vector<uint8_t> layers_;
+    int nlayers_;
     uint8_t items_[16][64];
     Map compressed_map_;
 
@@ -110,8 +141,7 @@ class Z2Decompress {
     int length_;
     int layer_;
     bool cursor_moves_left_;
-    const DecompressInfo* info_[NR_AREAS][NR_SETS][16];
-    static std::map<std::string, PutFn> put_;
+    std::shared_ptr<const OpTable> ops_;
 
     inline uint8_t Read(const Address& addr, uint16_t offset) {
         return mapper_->ReadPrgBank(addr.bank(), addr.address() + offset);
@@ -1,4 +1,7 @@
 #include "nes/z2objcache.h"
+#include <algorithm>
+#include <cstring>
+#include "nes/chr_util.h"
 #include "nes/mapper.h"
 #include "imwidget/hwpalette.h"
 #include "proto/rominfo.pb.h"
@@ -7,8 +10,37 @@
 
 namespace z2util {
 
+void Z2ObjectCache::Object::Draw(int w, int h) const {
+    if (w == 0) w = width_;
+    if (h == 0) h = height_;
+    ImGui::Image(texture_id(), ImVec2(w, h), uv0(), uv1());
+}
+
+void Z2ObjectCache::Object::DrawAt(int x, int y, int w, int h) const {
+    ImGui::SetCursorPos(ImVec2(x, y));
+    Draw(w, h);
+}
+
+void Z2ObjectCache::Object::DrawAt(int x, int y, float scale) const {
+    ImGui::SetCursorPos(ImVec2(x, y));
+    Draw(int(width_*scale), int(height_*scale));
+}
+
 Z2ObjectCache::Z2ObjectCache()
-  : use_iteminfo_chr_(false) {}
+  : mapper_(nullptr),
+    use_iteminfo_chr_(false),
+    shelf_x_(0),
+    shelf_y_(0),
+    shelf_height_(0) {}
+
+void Z2ObjectCache::Clear() {
+    for(auto& obj : cache_) {
+        obj.atlas_ = nullptr;
+        obj.pixels_.reset();
+    }
+    Retire(std::move(atlas_));
+    shelf_x_ = shelf_y_ = shelf_height_ = 0;
+}
 
 void Z2ObjectCache::Init(const Map& map) {
     Clear();
@@ -43,14 +75,72 @@ void Z2ObjectCache::Init(const Address& addr, const Address& chr,
         obj_[i] = addr;
 }
 
-GLBitmap& Z2ObjectCache::Get(uint8_t object) {
-    auto item = cache_.find(object);
-    if (item == cache_.end()) {
+void Z2ObjectCache::Retire(std::unique_ptr<GLBitmap> atlas) {
+    if (atlas && atlas->has_texture()) {
+        retired_.emplace_back(ImGui::GetFrameCount(), std::move(atlas));
+    }
+}
+
+void Z2ObjectCache::Reap() {
+    int frame = ImGui::GetFrameCount();
+    retired_.erase(
+        std::remove_if(retired_.begin(), retired_.end(),
+            [frame](const std::pair<int, std::unique_ptr<GLBitmap>>& r) {
+                return r.first < frame;
+            }),
+        retired_.end());
+}
+
+const Z2ObjectCache::Object& Z2ObjectCache::Get(uint8_t object) {
+    if (!retired_.empty()) {
+        Reap();
+    }
+    if (!cache_[object].atlas_) {
         CreateObject(object);
     }
     return cache_[object];
 }
 
+void Z2ObjectCache::Place(Object* object, int w, int h) {
+    if (shelf_x_ + w > kAtlasWidth) {
+        shelf_x_ = 0;
+        shelf_y_ += shelf_height_;
+        shelf_height_ = 0;
+    }
+    int width = std::max(kAtlasWidth, w);
+    int height = atlas_ ? atlas_->height() : 0;
+    if (!atlas_ || shelf_y_ + h > height || width > atlas_->width()) {
+        // Grow the atlas and copy the existing objects into the new one.
+        height = std::max(64, height);
+        while (shelf_y_ + h > height)
+            height *= 2;
+        if (atlas_)
+            width = std::max(width, atlas_->width());
+        std::unique_ptr<GLBitmap> atlas(new GLBitmap(width, height));
+        if (atlas_) {
+            for(int y=0; y<atlas_->height(); y++) {
+                memcpy(atlas->data() + y * width,
+                       atlas_->data() + y * atlas_->width(),
+                       atlas_->width() * sizeof(uint32_t));
+            }
+            atlas->Update();
+        }
+        atlas_.swap(atlas);
+        Retire(std::move(atlas));
+        for(auto& obj : cache_) {
+            if (obj.atlas_)
+                obj.atlas_ = atlas_.get();
+        }
+    }
+    object->atlas_ = atlas_.get();
+    object->x_ = shelf_x_;
+    object->y_ = shelf_y_;
+    object->width_ = w;
+    object->height_ = h;
+    shelf_x_ += w;
+    shelf_height_ = std::max(shelf_height_, h);
+}
+
 
 void Z2ObjectCache::BlitTile(uint32_t* dest, int x, int y, int tile, int pal,
                              int width, bool flip) {
@@ -66,16 +156,25 @@ void Z2ObjectCache::BlitTile(uint32_t* dest, int x, int y, int tile, int pal,
         tile &= ~1;
     }
 
+    // Fetch the tile's bitplanes and the 4-color palette once, then
+    // decode from the local copies.
+    uint8_t chr[32];
+    mapper_->ReadChrBytes(chr_.bank() + bofs, chr_.address() + 16*tile,
+                          chr, 2 * height);
+    uint8_t colors[4];
+    mapper_->ReadBytes(palette_, pal * 4, colors, 4);
+    uint32_t rgba[4];
+    for(int i=0; i<4; i++) {
+        rgba[i] = colors[i] == 0xFF
+            ? 0 : NesHardwarePalette::Get()->palette(colors[i]);
+    }
+
+    uint32_t pixels[128];
+    ChrUtil::DecodeTiles(chr, height / 8, rgba, pixels);
     for(int row=0; row<height; row++, dest+=width) {
-        uint8_t a = mapper_->ReadChrBank(chr_.bank() + bofs,
-                 chr_.address() + 16*(tile + (row / 8)) + (row & 7));
-        uint8_t b = mapper_->ReadChrBank(chr_.bank() + bofs,
-                 chr_.address() + 16*(tile + (row / 8)) + (row & 7) + 8);
-        for(int col=0; col<8; col++, a<<=1, b<<=1) {
-            uint8_t color = (a & 0x80) >> 7 | (b & 0x80) >> 6;
-            color = mapper_->Read(palette_, pal * 4 + color);
-            dest[flip ? 7-col : col] = 
-                color == 0xFF ? 0 : NesHardwarePalette::Get()->palette(color);
+        const uint32_t* src = pixels + 8*row;
+        for(int col=0; col<8; col++) {
+            dest[flip ? 7-col : col] = src[col];
         }
     }
 }
@@ -161,7 +260,11 @@ void Z2ObjectCache::CreateObject(uint8_t obj) {
             }
         }
     }
-    cache_.emplace(std::make_pair(obj, GLBitmap(width, height, dest)));
+    Object* object = &cache_[obj];
+    object->pixels_.reset(dest);
+    Place(object, width, height);
+    atlas_->Blit(object->x_, object->y_, width, height, dest);
+    atlas_->Update(object->x_, object->y_, width, height);
 }
 
 }  // namespace
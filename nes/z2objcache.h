@@ -1,17 +1,55 @@
 #ifndef Z2UTIL_NES_Z2OBJCACHE_H
 #define Z2UTIL_NES_Z2OBJCACHE_H
 #include <cstdint>
-#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
 #include "proto/rominfo.pb.h"
 #include "imwidget/glbitmap.h"
+#include "imgui.h"
 
 class Mapper;
 class NesHardwarePalette;
 
 namespace z2util {
 
+// Renders map objects, items and enemies from CHR data.  All objects in
+// a cache are packed into a single texture atlas so that drawing many of
+// them doesn't change the texture binding (and ImGui can merge the draws).
 class Z2ObjectCache {
   public:
+    // A rendered object.  Has the drawing interface of a GLBitmap, but
+    // its texture is a sub-rectangle of the cache's atlas.
+    class Object {
+      public:
+        Object() : atlas_(nullptr), x_(0), y_(0), width_(0), height_(0) {}
+        void Draw(int w=0, int h=0) const;
+        void DrawAt(int x, int y, int w=0, int h=0) const;
+        void DrawAt(int x, int y, float scale) const;
+
+        // A CPU-side copy of the pixels, for compositing into other bitmaps.
+        inline uint32_t* data() const { return pixels_.get(); }
+        inline ImTextureID texture_id() const {
+            return ImTextureID(uintptr_t(atlas_->texture_id()));
+        }
+        inline ImVec2 uv0() const {
+            return ImVec2(float(x_) / atlas_->width(),
+                          float(y_) / atlas_->height());
+        }
+        inline ImVec2 uv1() const {
+            return ImVec2(float(x_ + width_) / atlas_->width(),
+                          float(y_ + height_) / atlas_->height());
+        }
+        inline int width() const { return width_; }
+        inline int height() const { return height_; }
+      private:
+        friend class Z2ObjectCache;
+        GLBitmap* atlas_;
+        int x_, y_;
+        int width_, height_;
+        std::unique_ptr<uint32_t[]> pixels_;
+    };
+
     enum Schema {
         OVERWORLD = 0,
         MAP = 1,
@@ -22,21 +60,31 @@ class Z2ObjectCache {
     };
     Z2ObjectCache();
     explicit Z2ObjectCache(Mapper* mapper)
-        : mapper_(mapper) {}
+        : Z2ObjectCache() { mapper_ = mapper; }
 
     void Init(const Map& map);
     void Init(const ItemInfo& info);
     void Init(const Address& addr, const Address& chr, Schema schema);
-    GLBitmap& Get(uint8_t object);
+    const Object& Get(uint8_t object);
 
     inline void set_mapper(Mapper* m) { mapper_ = m; }
     inline void set_palette(const Address& pal) { palette_ = pal; }
     inline void set_chr(const Address& chr) { chr_ = chr; }
     inline void set_use_iteminfo_chr(bool v) { use_iteminfo_chr_ = v; }
     inline const Address& chr() { return chr_; }
-    inline void Clear() { cache_.clear(); }
+    void Clear();
   private:
     void CreateObject(uint8_t obj);
+    // Reserve space for a w x h object in the atlas, growing the atlas if
+    // needed.
+    void Place(Object* object, int w, int h);
+    // Draw commands already queued for this frame may still reference a
+    // replaced atlas, so it is kept alive until a later frame.  An atlas
+    // which was never drawn has no texture and is freed right away; this
+    // keeps caches used off the UI thread (e.g. by AreaRenderer's
+    // workers) from touching ImGui.
+    void Retire(std::unique_ptr<GLBitmap> atlas);
+    void Reap();
     void BlitTile(uint32_t* dest, int x, int y, int tile, int pal,
                   int width, bool flip=false);
 
@@ -49,7 +97,15 @@ class Z2ObjectCache {
     Address chr_;
     ItemInfo info_;
 
-    std::map<uint8_t, GLBitmap> cache_;
+    static const int kAtlasWidth = 256;
+    Object cache_[256];
+    std::unique_ptr<GLBitmap> atlas_;
+    std::vector<std::pair<int, std::unique_ptr<GLBitmap>>> retired_;
+    // Shelf packing state: the current position and the height of the
+    // tallest object on the current shelf.
+    int shelf_x_;
+    int shelf_y_;
+    int shelf_height_;
 };
 
 }  // namespace
@@ -0,0 +1,115 @@
+#include <cstdio>
+#include <string>
+#include <gflags/gflags.h>
+
+#include "postprocess.h"
+
+DECLARE_int32(bank5_enemy_list_size);
+
+namespace z2util {
+
+static void GetName(const RomInfo* config, int world,
+             int overworld, int subworld, int id, std::string* name) {
+    for(const auto& area : config->areas()) {
+        if (world == area.world()
+            && overworld == area.overworld()
+            && subworld == area.subworld()) {
+            const auto& it = area.info().find(id);
+            if (it != area.info().end())
+                *name = it->second.name();
+        }
+    }
+}
+
+void PostProcessConfig(RomInfo* config,
+                       const OverworldEditorKeybinds* keybinds) {
+    char buf[128];
+    for(const auto& s : config->sideview()) {
+        for(int map=0; map<s.length(); map++) {
+            auto* m = config->add_map();
+
+            std::string name = "";
+            GetName(config, s.world(), s.overworld(), s.subworld(), map, &name);
+            m->set_area(s.area_offset() + map);
+            int bgoffset =
+                (s.area().find("background") != std::string::npos) ? 1 : 0;
+            if (name.empty()) {
+                snprintf(buf, sizeof(buf), "%02d: %s %02d",
+                         m->area()+bgoffset, s.area().c_str(), map+bgoffset);
+            } else {
+                snprintf(buf, sizeof(buf), "%02d: %s %02d - %s",
+                         m->area()+bgoffset, s.area().c_str(), map+bgoffset,
+                         name.c_str());
+            }
+            for(const auto& c : s.code()) {
+                if (map >= c.offset() && map < c.offset() + c.length()) {
+                    m->set_code(c.code());
+                }
+            }
+            m->set_name(buf);
+            m->set_type(s.type());
+            m->set_world(s.world());
+            m->set_overworld(s.overworld());
+            m->set_subworld(s.subworld());
+            m->mutable_pointer()->set_bank(s.address().bank());
+            m->mutable_pointer()->set_address(s.address().address() + 2*map);
+
+            // If the connector table is not null
+            if (s.connector().address()) {
+                m->mutable_connector()->set_bank(s.connector().bank());
+                m->mutable_connector()->set_address(
+                        s.connector().address() + 4*map);
+            }
+
+            // If the door table is not null
+            if (s.doors().address()) {
+                m->mutable_doors()->set_bank(s.doors().bank());
+                m->mutable_doors()->set_address(
+                        s.doors().address() + 4*map);
+            }
+
+            *(m->mutable_chr()) = s.chr();
+            *(m->mutable_palette()) = s.palette();
+            *(m->mutable_palettes()) = s.palettes();
+            for(int i=0; i<4; i++) {
+                auto *obj = m->add_objtable();
+                obj->set_bank(s.address().bank());
+                obj->set_address(0x8500 + i*2);
+            }
+            if (map == 0 && s.area().find("background") == std::string::npos) {
+                // Add a dummy "map" for initializing the object table editor
+                auto* o = config->add_objtable();
+                *o = *m;
+                o->set_name(s.area());
+            }
+        }
+    }
+    for(auto& elist: *config->mutable_enemies()) {
+        for(auto& e: *elist.mutable_info()) {
+            snprintf(buf, sizeof(buf), "%02x: %s",
+                     e.first, e.second.name().c_str());
+            e.second.set_name(buf);
+        }
+    }
+    uint16_t b5_enemy_end;
+    for(auto& ko: *config->mutable_misc()->mutable_allocator_keepout()) {
+        if (ko.bank() == 5 && ko.address() == 0x88a0) {
+            ko.set_length(FLAGS_bank5_enemy_list_size);
+            b5_enemy_end = 0x88a0 + FLAGS_bank5_enemy_list_size;
+        }
+    }
+    for(auto& sr: *config->mutable_misc()->mutable_static_regions()) {
+        if (sr.bank() == 5 && sr.address() == 0x8a50) {
+            sr.set_address(b5_enemy_end);
+            sr.set_length(0x8b50 - b5_enemy_end);
+        }
+    }
+
+    if (keybinds) {
+        config->mutable_overworld_editor_keybind()->Clear();
+        config->mutable_overworld_editor_keybind()->MergeFrom(
+            keybinds->overworld_editor_keybind());
+    }
+}
+
+}  // namespace z2util
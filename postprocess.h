@@ -0,0 +1,15 @@
+#ifndef Z2UTIL_POSTPROCESS_H
+#define Z2UTIL_POSTPROCESS_H
+#include "proto/keybinds.pb.h"
+#include "proto/rominfo.pb.h"
+
+namespace z2util {
+
+// Expand the sideview descriptions in the config into the per-map list and
+// apply the config overrides from the command line flags.  If |keybinds|
+// is non-null, it replaces the overworld editor keybinds.
+void PostProcessConfig(RomInfo* config,
+                       const OverworldEditorKeybinds* keybinds);
+
+}  // namespace z2util
+#endif // Z2UTIL_POSTPROCESS_H
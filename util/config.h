@@ -1,5 +1,6 @@
 #ifndef UTIL_CONFIG_H
 #define UTIL_CONFIG_H
+#include <atomic>
 #include <string>
 #include <functional>
 
@@ -17,6 +18,9 @@ class ConfigLoader {
     }
     static inline const T& GetConfig() { return Get()->config_; }
     static inline T* MutableConfig() { return &Get()->config_; }
+    // Incremented every time the config is (re)loaded, so that tables
+    // derived from the config know when to rebuild themselves.
+    static inline int Generation() { return Get()->generation_; }
 
     void Load(const std::string& filename,
               std::function<void(T*)> postprocess=nullptr) {
@@ -25,6 +29,7 @@ class ConfigLoader {
         Load(filename_, &config_);
         if (postprocess_)
             postprocess_(&config_);
+        generation_++;
     }
     void Parse(const std::string& data,
               std::function<void(T*)> postprocess=nullptr) {
@@ -32,12 +37,14 @@ class ConfigLoader {
         Load("", &config_, &data);
         if (postprocess_)
             postprocess_(&config_);
+        generation_++;
     }
     void Reload() {
         config_.Clear();
         Load(filename_, &config_);
         if (postprocess_)
             postprocess_(&config_);
+        generation_++;
     }
     inline const T& config() const { return config_; }
 
@@ -64,8 +71,9 @@ class ConfigLoader {
         config->MergeFrom(local_config);
     }
 
-    ConfigLoader() {};
+    ConfigLoader() : generation_(0) {};
     T config_;
+    std::atomic<int> generation_;
     std::string filename_;
     std::function<void(T*)> postprocess_;
 };
@@ -0,0 +1,152 @@
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdarg.h>
+#include <strings.h>
+
+#include "util/console.h"
+#include "util/logging.h"
+
+Console::Console() {
+    shorthelp_.insert(std::make_pair("clear", "Clear the window"));
+    shorthelp_.insert(std::make_pair("history", "Show command history"));
+    shorthelp_.insert(std::make_pair("help", "Show command help"));
+}
+
+void Console::PushLineCallback(LineCallback line_cb) {
+    line_cb_.push_back(line_cb);
+}
+
+void Console::PopLineCallback() {
+    line_cb_.pop_back();
+}
+
+void Console::RegisterCommand(const char* command, const char* shorthelp,
+                              Command fn) {
+    shorthelp_.insert(std::make_pair(command, shorthelp));
+    commands_.insert(std::make_pair(command, fn));
+}
+
+void Console::AddLog(const char* fmt, ...) {
+    char buf[1024];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, args);
+    buf[sizeof(buf)-1] = 0;
+    va_end(args);
+    Output(buf);
+}
+
+const char* Console::PlainText(const char* line) {
+    if (line[0] == '#' && line[1] == '{' && strlen(line) >= 6)
+        line += 6;
+    return line;
+}
+
+void Console::Output(const char* line) {
+    std::string log(PlainText(line));
+    while(!log.empty() && (log.back() == '\r' || log.back() == '\n')) {
+        log.pop_back();
+    }
+    LOG(INFO, "$$ ", log);
+}
+
+bool Console::Source(const std::string& filename) {
+    char buf[4096];
+    char *p;
+    FILE *fp = fopen(filename.c_str(), "r");
+    if (!fp) {
+        return false;
+    }
+    while((p = fgets(buf, sizeof(buf), fp)) != nullptr) {
+        char *end = p + strlen(p);
+        while(end > p && isspace(end[-1])) {
+            *--end = '\0';
+        }
+        ExecCommand(p);
+    }
+    fclose(fp);
+    return true;
+}
+
+void Console::ExecCommand(const char* command_line) {
+    if (!line_cb_.empty()) {
+        line_cb_.back()(this, command_line);
+        return;
+    }
+    AddLog("#{fc8}%s\n", command_line);
+
+    // Insert into history. First find match and delete it so it can be pushed to the back. This isn't trying to be smart or optimal.
+    for (int i = int(history_.size())-1; i >= 0; i--)
+        if (strcasecmp(history_[i].c_str(), command_line) == 0) {
+            history_.erase(history_.begin() + i);
+            break;
+        }
+    history_.push_back(command_line);
+
+    // Process command
+    if (strcasecmp(command_line, "CLEAR") == 0) {
+        ClearLog();
+    } else if (strcasecmp(command_line, "HELP") == 0) {
+        AddLog("Commands:");
+        for(const auto& c : shorthelp_) {
+            AddLog("- %s: %s", c.first, c.second);
+        }
+    } else if (strcasecmp(command_line, "HISTORY") == 0) {
+        int size = history_.size();
+        for (int i = size >= 10 ? size - 10 : 0; i < size; i++)
+            AddLog("%3d: %s\n", i, history_[i].c_str());
+    } else {
+        int argc = 0;
+        char *argv[128];
+        char *command = strdup(command_line);
+        char *orig = command;
+
+        argv[argc] = nullptr;
+        while(*command) {
+            while(isspace(*command))
+                *command++ = '\0';
+
+            if (*command == '#') {
+                *command++ = '\0';
+                break;
+            }
+
+            if (*command) {
+                bool quote = *command == '"';
+                if (quote) {
+                    argv[argc++] = ++command;
+                    while(*command && *command != '"') {
+                        command +=  (*command == '\\' && command[1]) ? 2 : 1;
+                    }
+                    if (*command == '"') {
+                        *command++ = '\0';
+                    } else {
+                        AddLog("[error] Unterminated string.");
+                        argc = 0;
+                        break;
+                    }
+                } else {
+                    argv[argc++] = command;
+                    while(*command && !isspace(*command)) {
+                        command++;
+                    }
+                }
+            } else {
+                break;
+            }
+        }
+        if (argc && strlen(argv[0])) {
+            for(const auto& c : commands_) {
+                if (!strcasecmp(argv[0], c.first)) {
+                    c.second(this, argc, argv);
+                    free(orig);
+                    return;
+                }
+            }
+            AddLog("Unknown command: '%s'\n", argv[0]);
+        }
+        free(orig);
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef Z2UTIL_UTIL_CONSOLE_H
+#define Z2UTIL_UTIL_CONSOLE_H
+#include <string>
+#include <map>
+#include <functional>
+#include <vector>
+
+// A command interpreter without any user interface.  DebugConsole puts an
+// ImGui window on top of this; headless tools use it directly.
+class Console {
+  public:
+    typedef std::function<void(Console* console, int argc, char **argv)>
+        Command;
+    typedef std::function<void(Console* console, const char* line)>
+        LineCallback;
+
+    Console();
+    virtual ~Console() {}
+
+    void RegisterCommand(const char* cmd, const char* shorthelp, Command fn);
+
+    template<typename T>
+    inline void RegisterCommand(const char* cmd, const char* shorthelp,
+                         T* that, void (T::*fn)(Console* console,
+                                                int argc, char **argv)) {
+        RegisterCommand(cmd, shorthelp, [=](Console* console,
+                                            int argc, char **argv) {
+            (that->*fn)(console, argc, argv);
+        });
+    }
+
+    virtual void ClearLog() {}
+    void AddLog(const char* fmt, ...);
+    virtual void ExecCommand(const char* command_line);
+    // Read and execute commands from a file.  Returns false if the file
+    // couldn't be read.
+    bool Source(const std::string& filename);
+    void PushLineCallback(LineCallback line_cb);
+    void PopLineCallback();
+
+  protected:
+    // Receives every line passed to AddLog.  The default implementation
+    // sends the line to the log.
+    virtual void Output(const char* line);
+    // Skip the '#{rgb}' color prefix on a log line.
+    static const char* PlainText(const char* line);
+
+    std::vector<std::string> history_;
+    std::map<const char*, const char*> shorthelp_;
+    std::map<const char*, Command> commands_;
+    std::vector<LineCallback> line_cb_;
+};
+
+#endif // Z2UTIL_UTIL_CONSOLE_H
@@ -0,0 +1,110 @@
+#include <algorithm>
+
+#include "util/executor.h"
+
+namespace util {
+namespace {
+// The executor and queue index of the worker running on this thread.
+thread_local Executor* current_executor = nullptr;
+thread_local int current_worker = -1;
+}  // namespace
+
+Executor::Executor(int nthreads)
+  : queued_(0),
+    outstanding_(0),
+    next_(0),
+    stop_(false) {
+    if (nthreads <= 0) {
+        nthreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for(int i=0; i<nthreads; ++i) {
+        queues_.emplace_back(new Queue);
+    }
+    for(int i=0; i<nthreads; ++i) {
+        threads_.emplace_back(&Executor::Worker, this, i);
+    }
+}
+
+Executor::~Executor() {
+    Wait();
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        stop_ = true;
+    }
+    work_cv_.notify_all();
+    for(auto& t : threads_) {
+        t.join();
+    }
+}
+
+void Executor::Submit(std::function<void()> fn) {
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        int q = (current_executor == this) ? current_worker
+                                           : next_++ % queues_.size();
+        std::lock_guard<std::mutex> qlock(queues_[q]->mu);
+        queues_[q]->tasks.push_back(std::move(fn));
+        queued_++;
+        outstanding_++;
+    }
+    work_cv_.notify_one();
+}
+
+void Executor::Wait() {
+    std::unique_lock<std::mutex> lock(mu_);
+    done_cv_.wait(lock, [this]() { return outstanding_ == 0; });
+}
+
+void Executor::ParallelFor(int n, std::function<void(int)> fn) {
+    for(int i=0; i<n; ++i) {
+        Submit([fn, i]() { fn(i); });
+    }
+    Wait();
+}
+
+bool Executor::Pop(int id, std::function<void()>* fn) {
+    int n = queues_.size();
+    for(int i=0; i<n; ++i) {
+        Queue* q = queues_[(id + i) % n].get();
+        std::lock_guard<std::mutex> lock(q->mu);
+        if (q->tasks.empty()) {
+            continue;
+        }
+        if (i == 0) {
+            *fn = std::move(q->tasks.back());
+            q->tasks.pop_back();
+        } else {
+            *fn = std::move(q->tasks.front());
+            q->tasks.pop_front();
+        }
+        return true;
+    }
+    return false;
+}
+
+void Executor::Worker(int id) {
+    current_executor = this;
+    current_worker = id;
+    for(;;) {
+        std::function<void()> fn;
+        if (Pop(id, &fn)) {
+            {
+                std::lock_guard<std::mutex> lock(mu_);
+                queued_--;
+            }
+            fn();
+            std::lock_guard<std::mutex> lock(mu_);
+            if (--outstanding_ == 0) {
+                done_cv_.notify_all();
+            }
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(mu_);
+        work_cv_.wait(lock, [this]() { return stop_ || queued_ > 0; });
+        if (stop_ && queued_ == 0) {
+            return;
+        }
+    }
+}
+
+}  // namespace util
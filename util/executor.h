@@ -0,0 +1,53 @@
+#ifndef Z2UTIL_UTIL_EXECUTOR_H
+#define Z2UTIL_UTIL_EXECUTOR_H
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace util {
+
+// A fixed pool of worker threads with one task queue per worker.  A worker
+// runs its own tasks newest-first and, when it runs dry, steals the oldest
+// tasks from the other workers.  Tasks submitted from a worker go on that
+// worker's own queue.
+class Executor {
+  public:
+    // nthreads <= 0 means one thread per CPU.
+    explicit Executor(int nthreads=0);
+    ~Executor();
+
+    void Submit(std::function<void()> fn);
+    // Wait until every submitted task has finished.  Must not be called
+    // from a task.
+    void Wait();
+    // Run fn(0) ... fn(n-1) on the pool and wait for them.
+    void ParallelFor(int n, std::function<void(int)> fn);
+
+    inline int size() const { return threads_.size(); }
+
+  private:
+    struct Queue {
+        std::mutex mu;
+        std::deque<std::function<void()>> tasks;
+    };
+    void Worker(int id);
+    bool Pop(int id, std::function<void()>* fn);
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> threads_;
+    std::mutex mu_;
+    std::condition_variable work_cv_;
+    std::condition_variable done_cv_;
+    // Tasks sitting in a queue, and tasks either queued or running.
+    int queued_;
+    int outstanding_;
+    unsigned next_;
+    bool stop_;
+};
+
+}  // namespace util
+#endif // Z2UTIL_UTIL_EXECUTOR_H
@@ -3,8 +3,14 @@
 #include <string>
 #include <vector>
 
+#include <fcntl.h>
 #include <libgen.h>
 #include <limits.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#else
+#include <windows.h>
+#endif
 
 #include "util/file.h"
 #include "util/status.h"
@@ -92,6 +98,24 @@ util::Status File::MakeDir(const std::string& path, mode_t mode) {
     return util::Status();
 }
 
+util::Status File::Rename(const std::string& from, const std::string& to) {
+#ifdef _WIN32
+    // rename() won't replace an existing file on Windows, and remove+rename
+    // leaves a window where |to| doesn't exist at all.
+    if (!MoveFileExA(from.c_str(), to.c_str(),
+                     MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+        return util::Status(util::error::Code::UNKNOWN,
+                            absl::StrCat("MoveFileEx(", from, ", ", to,
+                                         ") failed: error ", GetLastError()));
+    }
+#else
+    if (rename(from.c_str(), to.c_str()) == -1) {
+        return util::PosixStatus(errno);
+    }
+#endif
+    return util::Status();
+}
+
 util::Status File::MakeDirs(const std::string& path, mode_t mode) {
     std::vector<std::string> p = absl::StrSplit(path, absl::ByAnyChar("\\/"));
     if (p[0] == "") {
@@ -171,3 +195,37 @@ void File::Close() {
         fp_ = nullptr;
     }
 }
+
+std::unique_ptr<MappedFile> MappedFile::Open(const std::string& filename) {
+    std::unique_ptr<MappedFile> m(new MappedFile);
+#ifndef _WIN32
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd == -1)
+        return nullptr;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            m->data_ = static_cast<const char*>(p);
+            m->size_ = st.st_size;
+            m->mapped_ = true;
+        }
+    }
+    close(fd);
+    if (m->mapped_)
+        return m;
+#endif
+    if (!File::GetContents(filename, &m->buffer_))
+        return nullptr;
+    m->data_ = m->buffer_.data();
+    m->size_ = m->buffer_.size();
+    return m;
+}
+
+MappedFile::~MappedFile() {
+#ifndef _WIN32
+    if (mapped_) {
+        munmap(const_cast<char*>(data_), size_);
+    }
+#endif
+}
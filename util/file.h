@@ -3,6 +3,7 @@
 #include <cstdio>
 #include <cstdint>
 #include <memory>
+#include <string>
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -90,6 +91,8 @@ class File {
     static util::Status Access(const std::string& path);
     static util::Status MakeDir(const std::string& path, mode_t mode=0755);
     static util::Status MakeDirs(const std::string& path, mode_t mode=0755);
+    // Rename from to to, replacing to if it exists.
+    static util::Status Rename(const std::string& from, const std::string& to);
 
     virtual ~File();
     Stat FStat();
@@ -109,4 +112,22 @@ class File {
     FILE* fp_;
 };
 
+// A read-only view of a whole file.  The file is mapped into memory where
+// the platform supports it, and read into a buffer otherwise.
+class MappedFile {
+  public:
+    static std::unique_ptr<MappedFile> Open(const std::string& filename);
+    ~MappedFile();
+
+    inline const char* data() const { return data_; }
+    inline size_t size() const { return size_; }
+  private:
+    MappedFile() : data_(nullptr), size_(0), mapped_(false) {}
+
+    const char* data_;
+    size_t size_;
+    bool mapped_;
+    std::string buffer_;
+};
+
 #endif // Z2HD_UTIL_FILE_H
@@ -65,6 +65,22 @@ void logging_init() {
     }
 }
 
+void LockLog() {
+#ifdef _WIN32
+    _lock_file(logfp);
+#else
+    flockfile(logfp);
+#endif
+}
+
+void UnlockLog() {
+#ifdef _WIN32
+    _unlock_file(logfp);
+#else
+    funlockfile(logfp);
+#endif
+}
+
 void SetLogColor(int color) {
 #ifdef _WIN32
     static int bold;
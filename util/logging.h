@@ -41,6 +41,8 @@ extern FILE* logfp;
 extern int logfp_isatty;
 
 extern void SetLogColor(int color);
+extern void LockLog();
+extern void UnlockLog();
 extern std::string Hex(uint8_t x, bool lz=true, bool zx=true);
 extern std::string Hex(uint16_t x, bool lz=true, bool zx=true);
 extern std::string Hex(uint32_t x, bool lz=true, bool zx=true);
@@ -97,17 +99,21 @@ void Log(LogLevel level, Args ...args) {
             ; // Do nothing
     }
 
+    std::string msg = absl::StrCat(args...);
+    // Keep lines logged from different threads from interleaving.
+    LockLog();
     if (logfp_isatty) {
         SetLogColor(color);
         fputs(prefix, logfp);
-        fputs(absl::StrCat(args...).c_str(), logfp);
+        fputs(msg.c_str(), logfp);
         SetLogColor(RESET);
         fputs("\n", logfp);
     } else {
         fputs(prefix, logfp);
-        fputs(absl::StrCat(args...).c_str(), logfp);
+        fputs(msg.c_str(), logfp);
         fputs("\n", logfp);
     }
+    UnlockLog();
     if (level == LL_FATAL) {
         abort();
     }